@@ -0,0 +1,111 @@
+/**
+ * elf_reader.h - In-process ELF symbol and DWARF line table reader
+ *
+ * Reads the symbol table (.symtab) and, if present, the DWARF line table
+ * (.debug_line, versions 2 to 5) of a 32-bit ELF file such as a linked m68k
+ * ROM image (big-endian; little-endian files are read too). No external
+ * tools are needed and the whole file is parsed from memory, so large ELFs
+ * load in milliseconds.
+ *
+ * Usage:
+ *   GX::ElfReader elf;
+ *   if (elf.Load("game.elf")) {
+ *       for (const GX::ElfSymbol& sym : elf.GetSymbols()) { ... }
+ *       const GX::SourceLine* line = elf.FindLine(0x1234);
+ *       if (line) printf("%s:%u\n", elf.GetFiles()[line->file].c_str(), line->line);
+ *   }
+ */
+
+#ifndef GXTEST_ELF_READER_H
+#define GXTEST_ELF_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GX {
+
+/**
+ * Symbol from the ELF symbol table
+ */
+struct ElfSymbol {
+    std::string name;
+    uint32_t addr = 0;
+    uint32_t size = 0;       // From the symbol table; code symbols without one
+                             // extend to the next code symbol or the section end
+    bool code = false;       // Defined in an executable section (nm type T/t)
+    bool function = false;   // Typed as a function (STT_FUNC)
+    bool global = false;     // Global or weak binding
+};
+
+/**
+ * Row of the line table: addresses from addr up to the next row's address
+ * belong to this source line
+ */
+struct SourceLine {
+    uint32_t addr = 0;
+    uint32_t file = 0;       // Index into ElfReader::GetFiles()
+    uint32_t line = 0;       // 0 = no source (end of a sequence)
+};
+
+/**
+ * ELF32 symbol and line table reader
+ */
+class ElfReader {
+public:
+    /**
+     * Load an ELF file (replaces anything loaded before)
+     * @return false if the file is missing or not a 32-bit ELF
+     */
+    bool Load(const std::string& path);
+
+    /**
+     * Load an ELF image from memory
+     * @return false if the data is not a 32-bit ELF
+     */
+    bool Load(const uint8_t* data, size_t size);
+
+    /** Forget the loaded file */
+    void Clear();
+
+    /** Defined symbols (no section or file symbols), sorted by address */
+    const std::vector<ElfSymbol>& GetSymbols() const { return symbols_; }
+
+    /** Source file names referenced by the line table */
+    const std::vector<std::string>& GetFiles() const { return files_; }
+
+    /** Line table rows, sorted by address (empty without .debug_line) */
+    const std::vector<SourceLine>& GetLines() const { return lines_; }
+
+    /**
+     * Source line of an address
+     * @return Row covering addr, or nullptr if it has no line info
+     */
+    const SourceLine* FindLine(uint32_t addr) const;
+
+private:
+    struct Section {
+        std::string name;
+        uint32_t name_offset = 0;
+        uint32_t type = 0;
+        uint32_t flags = 0;
+        uint32_t addr = 0;
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        uint32_t link = 0;
+    };
+
+    bool ParseSymbols(const std::vector<Section>& sections, size_t index);
+    void ParseLines(const Section& debug_line, const Section* line_str, const Section* str);
+
+    const uint8_t* data_ = nullptr;   // Image being parsed (during Load only)
+    bool big_endian_ = true;
+    std::vector<ElfSymbol> symbols_;
+    std::vector<std::string> files_;
+    std::vector<SourceLine> lines_;
+};
+
+} // namespace GX
+
+#endif // GXTEST_ELF_READER_H
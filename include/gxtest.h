@@ -61,6 +61,7 @@
 #include <vector>
 #include <cstdint>
 #include <functional>
+#include <memory>
 
 namespace GX {
 
@@ -88,6 +89,111 @@ struct Input {
     }
 };
 
+/**
+ * In-memory emulator snapshot
+ *
+ * Holds the serialized core state in a single contiguous arena that is reused
+ * across captures, so repeated SaveSnapshot() calls into the same Snapshot do
+ * not allocate. Restoring a Snapshot skips the frame buffer and pattern cache
+ * clears that LoadState() pays for (both are rebuilt from the restored VDP
+ * memories anyway), which makes it suitable for search and fuzzing loops that
+ * restore thousands of times per second.
+ *
+ * Snapshots are only valid within the process that created them and for the
+ * ROM that was loaded when they were captured.
+ */
+class Snapshot {
+public:
+    /** Check if the snapshot holds a captured state */
+    bool IsValid() const { return size_ > 0; }
+
+    /** Size of the captured state in bytes */
+    size_t GetSize() const { return size_; }
+
+    /** Pointer to the captured state */
+    const uint8_t* GetData() const { return arena_.get(); }
+
+    /** Replace the snapshot contents with a raw state buffer */
+    void Assign(const uint8_t* data, size_t size);
+
+    /** Drop the captured state (keeps the arena allocated) */
+    void Clear() { size_ = 0; }
+
+private:
+    friend class Emulator;
+    friend class StateStore;
+
+    /** Grow the arena to at least `capacity` bytes (contents are discarded) */
+    void Reserve(size_t capacity);
+
+    // Left uninitialized on purpose: pages past the serialized state size are
+    // never touched, so a snapshot only costs what the state actually uses
+    std::unique_ptr<uint8_t[]> arena_;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+};
+
+class Emulator;
+
+/**
+ * Deterministic boot sequence, run once after LoadRom()
+ *
+ * The key identifies the script in the boot snapshot cache, so two scripts
+ * with the same key must drive the emulator to the same state. Inputs held by
+ * the script are released when it finishes.
+ */
+struct BootScript {
+    std::string key;
+    std::function<void(Emulator&)> run;
+
+    /** Boot by running a fixed number of frames with no input */
+    static BootScript Frames(int frames);
+};
+
+/**
+ * Boot snapshot cache counters (process-wide)
+ */
+struct BootCacheStats {
+    uint64_t hits = 0;        // Restored from the in-process cache
+    uint64_t disk_hits = 0;   // Restored from the on-disk cache
+    uint64_t misses = 0;      // Boot script actually executed
+};
+
+/**
+ * Decoded ROM cache counters and usage (process-wide)
+ */
+struct RomCacheStats {
+    uint64_t hits = 0;      // Loads served from a cached decoded image
+    uint64_t misses = 0;    // Loads that decoded the ROM
+    size_t entries = 0;     // ROMs currently cached
+    size_t bytes = 0;       // Memory held by cached images
+};
+
+/**
+ * Process memory usage
+ *
+ * The core's state is process-global, so the process figures are also the
+ * footprint of the one active Emulator (or of one forked worker). Resident
+ * figures are 0 where the platform does not expose them.
+ */
+struct MemoryStats {
+    size_t rss = 0;             // Resident set size
+    size_t shared = 0;          // Resident pages also mapped by other processes
+    size_t private_dirty = 0;   // Pages written by this process alone
+    size_t rom_bytes = 0;       // Extent of ROM memory in use (image + mapper areas)
+    size_t rom_cache_bytes = 0; // Decoded ROM cache
+};
+
+/**
+ * SVP (SSP1601 DSP) cycle counters, since the cartridge was reset
+ *
+ * Counters wrap at 32 bits; compare deltas over a run.
+ */
+struct SvpStats {
+    uint32_t cycles = 0;        // SSP cycles run, including skipped ones
+    uint32_t idle_cycles = 0;   // SSP cycles skipped in idle loops
+};
+
 /**
  * Emulator wrapper class providing the test harness interface
  *
@@ -106,13 +212,19 @@ public:
 
     /**
      * Load a ROM file from disk
-     * @param path Path to the ROM file (.bin, .md, .gen, .smd)
+     *
+     * Gzip and zip files (detected by content; the first file of a zip is
+     * used) are inflated straight into ROM memory. Interleaved .smd images
+     * are de-interleaved while loading.
+     *
+     * @param path Path to the ROM file (.bin, .md, .gen, .smd, .gz, .zip)
      * @return true if loaded successfully
      */
     bool LoadRom(const std::string& path);
 
     /**
      * Load a ROM from memory buffer
+     * (plain or .smd image with the copier's 0xAA 0xBB header marker)
      * @param data ROM data
      * @param size Size of ROM in bytes
      * @return true if loaded successfully
@@ -225,6 +337,93 @@ public:
     /** Load state from buffer */
     bool LoadState(const std::vector<uint8_t>& state);
 
+    /**
+     * Capture current state into a reusable snapshot
+     * @param snapshot Destination (its arena is reused if already allocated)
+     * @return true on success
+     */
+    bool SaveSnapshot(Snapshot& snapshot) const;
+
+    /**
+     * Restore a snapshot captured with SaveSnapshot()
+     * @param snapshot Previously captured snapshot
+     * @return true on success
+     */
+    bool RestoreSnapshot(const Snapshot& snapshot);
+
+    // -------------------------------------------------------------------------
+    // Boot Snapshot Cache
+    // -------------------------------------------------------------------------
+
+    /**
+     * Run a boot script on the loaded ROM, or restore its cached result
+     *
+     * The post-boot state is cached per process, keyed by the ROM content
+     * hash, the script key and the core version (STATE_VERSION). When a cache
+     * directory is set (see SetBootCacheDir()), entries are also persisted
+     * there so later test binaries skip the boot entirely.
+     * @param script Boot sequence to run on a cache miss
+     * @return true on success
+     */
+    bool Boot(const BootScript& script);
+
+    /**
+     * Set the on-disk boot cache directory ("" disables it)
+     * Defaults to the GXTEST_BOOT_CACHE_DIR environment variable.
+     */
+    static void SetBootCacheDir(const std::string& dir);
+
+    /** Get the on-disk boot cache directory ("" if disabled) */
+    static std::string GetBootCacheDir();
+
+    /** Drop all in-process boot cache entries and reset the counters */
+    static void ClearBootCache();
+
+    /** Get boot cache hit/miss counters */
+    static BootCacheStats GetBootCacheStats();
+
+    // -------------------------------------------------------------------------
+    // Decoded ROM Cache
+    //
+    // LoadRom() keeps the byteswapped image and parsed header of each ROM,
+    // keyed by content hash, so loading the same ROM again (e.g. in the next
+    // test) is a single copy. Shared by all Emulator instances in the process.
+    // -------------------------------------------------------------------------
+
+    /** Limit memory used by cached ROM images (default 256MB, 0 disables) */
+    static void SetRomCacheLimit(size_t bytes);
+
+    /** Drop all cached ROM images and reset the counters */
+    static void ClearRomCache();
+
+    /** Get ROM cache counters and usage */
+    static RomCacheStats GetRomCacheStats();
+
+    /** Get resident memory of this process (see MemoryStats) */
+    static MemoryStats GetMemoryStats();
+
+    /**
+     * Enable or disable skipping of 68k idle loops (disabled by default)
+     *
+     * A BRA to itself only advances the cycle counter, so the rest of the
+     * timeslice is consumed at once instead of dispatching the branch again.
+     * Emulation is identical either way; ROMs that wait for VBlank this way
+     * run several times faster.
+     */
+    static void SetIdleSkipEnabled(bool enabled);
+
+    /**
+     * Enable or disable skipping of SVP idle loops (enabled by default)
+     *
+     * Short SSP1601 loops that repeat with identical state (the DSP waiting
+     * for a 68k command) are fast-forwarded to the end of the timeslice.
+     * Emulation is identical either way.
+     */
+    static void SetSvpIdleSkipEnabled(bool enabled);
+
+    /** Get SVP cycle counters (zero unless an SVP cartridge is loaded) */
+    SvpStats GetSvpStats() const;
+
     // -------------------------------------------------------------------------
     // Info
     // -------------------------------------------------------------------------
@@ -255,6 +454,22 @@ protected:
 
     // Convenience wrappers that forward to emu
     bool LoadRom(const std::string& path) { return emu.LoadRom(path); }
+
+    /**
+     * Load a ROM and boot it, restoring the cached post-boot state if another
+     * test in this process (or an earlier run, with a cache directory) already
+     * booted the same ROM with the same script:
+     *
+     *   void SetUp() override {
+     *       ASSERT_TRUE(BootRom("game.bin", GX::BootScript::Frames(600)));
+     *   }
+     */
+    bool BootRom(const std::string& path, const BootScript& script) {
+        return emu.LoadRom(path) && emu.Boot(script);
+    }
+    bool BootRom(const uint8_t* data, size_t size, const BootScript& script) {
+        return emu.LoadRom(data, size) && emu.Boot(script);
+    }
     void Reset() { emu.Reset(); }
     void HardReset() { emu.HardReset(); }
     void RunFrames(int frames) { emu.RunFrames(frames); }
@@ -0,0 +1,141 @@
+/**
+ * profile_diff.h - Compare two profiles, e.g. of two ROM builds
+ *
+ * Loads profiles written by Profiler::WriteProfile() or address histograms
+ * written by Profiler::WriteAddressHistogram() (summed per function with a
+ * symbol table), matches functions by name so that code moving between
+ * builds does not matter, and reports the cycle and call count changes,
+ * biggest first. FindRegressions() checks the changes against thresholds;
+ * the gxprof-diff tool exits nonzero on a regression so CI can gate merges.
+ *
+ * Usage:
+ *   GX::ProfileData base, current;
+ *   GX::LoadProfile("base.gxprof", base);
+ *   GX::LoadProfile("current.gxprof", current);
+ *
+ *   GX::ProfileDiff diff = GX::DiffProfiles(base, current);
+ *   GX::PrintDiff(std::cout, diff, 20);
+ *   for (const std::string& message : GX::FindRegressions(diff, GX::RegressionThresholds())) {
+ *       std::cout << message << "\n";
+ *   }
+ *
+ * Both profiles should cover the same run (same input and frame count).
+ */
+
+#ifndef GXTEST_PROFILE_DIFF_H
+#define GXTEST_PROFILE_DIFF_H
+
+#include "profiler.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace GX {
+
+/**
+ * Results of one function in a loaded profile
+ */
+struct ProfileFunction {
+    std::string name;
+    uint32_t addr = 0;                  // Start address (first one, if several share the name)
+    uint64_t calls = 0;                 // 0 for address histograms
+    uint64_t cycles = 0;                // Exclusive cycles
+    uint64_t cycles_inclusive = 0;      // CallStack mode only
+};
+
+/**
+ * A loaded profile
+ */
+struct ProfileData {
+    ProfileCpu cpu = ProfileCpu::M68K;
+    uint32_t sample_rate = 1;
+    uint64_t total_cycles = 0;
+    uint64_t frames = 0;                // 0 if unknown (address histograms)
+    std::vector<ProfileFunction> functions;  // One per name, sorted by name
+};
+
+/**
+ * Load a profile file
+ *
+ * Reads Profiler::WriteProfile() files and both WriteAddressHistogram()
+ * formats. Histogram addresses are summed per function of symbols;
+ * addresses outside any function are named by address ("$001234").
+ * Functions with the same name (static functions of different files) are
+ * merged.
+ * @param path Profile file path
+ * @param profile Receives the profile
+ * @param symbols Function table for address histograms (e.g. Profiler::GetFunctions())
+ * @param error Receives the reason on failure (optional)
+ * @return true on success
+ */
+bool LoadProfile(const std::string& path, ProfileData& profile,
+                 const std::vector<FunctionDef>& symbols = {}, std::string* error = nullptr);
+
+/**
+ * Change of one function between two profiles
+ */
+struct FunctionDelta {
+    std::string name;
+    uint64_t base_cycles = 0;
+    uint64_t cycles = 0;
+    uint64_t base_calls = 0;
+    uint64_t calls = 0;
+    bool added = false;                 // Only in the current profile
+    bool removed = false;               // Only in the base profile
+
+    int64_t CycleDelta() const { return static_cast<int64_t>(cycles - base_cycles); }
+    int64_t CallDelta() const { return static_cast<int64_t>(calls - base_calls); }
+
+    /** Relative cycle change (0.1 = 10% slower), infinite if base_cycles is 0 */
+    double CycleChange() const;
+
+    /** Relative call count change, infinite if base_calls is 0 */
+    double CallChange() const;
+};
+
+/**
+ * Changes between two profiles
+ */
+struct ProfileDiff {
+    uint64_t base_total_cycles = 0;
+    uint64_t total_cycles = 0;
+    uint64_t base_frames = 0;
+    uint64_t frames = 0;
+    std::vector<FunctionDelta> functions;   // Largest absolute cycle change first
+
+    int64_t TotalDelta() const { return static_cast<int64_t>(total_cycles - base_total_cycles); }
+
+    /** Relative change of the total cycles, infinite if the base total is 0 */
+    double TotalChange() const;
+};
+
+/**
+ * Compare a profile against a base profile, matching functions by name
+ */
+ProfileDiff DiffProfiles(const ProfileData& base, const ProfileData& current);
+
+/**
+ * Regression thresholds (relative changes, 0.05 = 5%)
+ */
+struct RegressionThresholds {
+    double function_change = 0.05;      // Slowdown of any one function
+    double total_change = 0.01;         // Slowdown of the whole profile
+    uint64_t min_cycles = 10000;        // Ignore functions that slowed down by fewer cycles
+};
+
+/**
+ * Check a diff against thresholds
+ * @return One message per regression, empty if none
+ */
+std::vector<std::string> FindRegressions(const ProfileDiff& diff, const RegressionThresholds& thresholds);
+
+/**
+ * Print a diff table, largest changes first
+ * @param max_functions Functions to print (0 = all that changed)
+ */
+void PrintDiff(std::ostream& out, const ProfileDiff& diff, size_t max_functions = 0);
+
+} // namespace GX
+
+#endif // GXTEST_PROFILE_DIFF_H
@@ -1,27 +1,44 @@
 /**
- * profiler.h - 68k CPU cycle profiler for Genesis Plus GX
+ * profiler.h - 68k / Z80 CPU cycle profiler for Genesis Plus GX
  *
  * Provides per-function cycle counting using the emulator's native cpu_hook
  * mechanism. No ROM modification required - profiling is done entirely in
  * the emulator by tracking PC values and cycle counts.
  *
+ * The Z80 (sound driver) and the SVP DSP can be profiled the same way by
+ * setting ProfileOptions::cpu; symbols are then Z80 addresses or SSP1601
+ * word addresses. SVP idle loop skipping is turned off while an SVP profile
+ * runs, so every iteration of an idle loop is seen at its own addresses.
+ *
+ * With ProfileOptions::collect_memory_access, 68k reads and writes are also
+ * counted per function and memory region, with a heatmap of work RAM that
+ * gives per-variable counts.
+ *
+ * With ProfileOptions::collect_call_cycles, every call is kept with its
+ * cycles and frame, for per-call maximums and percentiles (see
+ * profiler_assertions.h for cycle budget assertions).
+ *
  * Usage:
  *   GX::Profiler profiler;
  *   profiler.AddFunction(0x001000, 0x001100, "generate_moves");
  *   profiler.AddFunction(0x001100, 0x001200, "score_move");
- *   // Or load from ELF: profiler.LoadSymbolsFromELF("game.elf");
+ *   // Or load from ELF (with source lines): profiler.LoadSymbolsFromELF("game.elf");
  *
  *   profiler.Start();
  *   emu.RunFrames(1000);
  *   profiler.Stop();
  *
  *   profiler.PrintReport(std::cout);
+ *   profiler.WriteFoldedStacks("profile.folded");  // flamegraph.pl, speedscope
+ *   profiler.WritePprof("profile.pb.gz");          // pprof -http
  */
 
 #ifndef GXTEST_PROFILER_H
 #define GXTEST_PROFILER_H
 
+#include "elf_reader.h"
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -34,7 +51,17 @@ namespace GX {
  */
 enum class ProfileMode {
     Simple,     // Fast - just tracks which function PC is in
-    CallStack   // Tracks call stack for inclusive cycle counts
+    CallStack,  // Tracks call stack for inclusive cycle counts
+    Scanline    // Statistical - samples the 68k PC at each scanline end, no per-instruction hook
+};
+
+/**
+ * CPU being profiled
+ */
+enum class ProfileCpu {
+    M68K,       // Main CPU (68k addresses)
+    Z80,        // Sound CPU (Z80 addresses), also tracks 68k bus stalls and frame load
+    SVP         // SVP DSP (SSP1601 word addresses, SSP cycles)
 };
 
 /**
@@ -42,6 +69,7 @@ enum class ProfileMode {
  */
 struct ProfileOptions {
     ProfileMode mode = ProfileMode::Simple;
+    ProfileCpu cpu = ProfileCpu::M68K;
     uint32_t sample_rate = 1;  // 1 = every instruction, N = every Nth instruction
 
     // Collect per-address cycle counts for line-level profiling.
@@ -51,6 +79,68 @@ struct ProfileOptions {
     // use sample_rate = 1. Sampling is still useful for reducing overhead when
     // only function-level stats are needed.
     bool collect_address_histogram = false;
+
+    // ProfileMode::Scanline (68k only): sample every Nth scanline - 1 gives
+    // about 15,700 samples per second of emulated time (NTSC). Each sample
+    // gets the cycles since the previous one. With stack_walk_depth > 0, up
+    // to that many callers are found from return addresses on the stack, for
+    // inclusive cycles and call stacks (0 = PC only).
+    uint32_t sample_lines = 1;
+    uint32_t stack_walk_depth = 0;
+
+    // Record a FrameProfile for every frame (68k, not Scanline mode), see GetTimeline()
+    bool collect_timeline = false;
+
+    // Main loop code that waits for VBlank, [start, end) - e.g. a
+    // wait_vblank function. A frame lags if the main loop is not there when
+    // VBlank starts. Left empty, lag frames are judged by input polling only.
+    uint32_t vblank_wait_start = 0;
+    uint32_t vblank_wait_end = 0;
+
+    // Count 68k data reads and writes per function and MemoryRegion, and per
+    // work RAM byte (68k only). Needs the memory access hooks, so the 68k
+    // runs the instrumented core even in Scanline mode.
+    bool collect_memory_access = false;
+
+    // Keep the cycles and frame of every completed call (CallStack mode) and
+    // of every 68k exception handler run (any 68k mode but Scanline), see
+    // GetCalls() and GetInterruptCalls(). Memory grows with the call count.
+    bool collect_call_cycles = false;
+};
+
+/**
+ * 68k memory region, for memory access profiling
+ */
+enum class MemoryRegion {
+    Rom,        // Cartridge ROM and SRAM, $000000-$3FFFFF
+    Z80,        // Z80 RAM and YM2612 through the Z80 bus, $A00000-$A0FFFF
+    Io,         // Version and controller / expansion ports, $A10000-$A1001F
+    System,     // Z80 bus request and reset, TMSS and other registers, $A11000-$A1FFFF
+    VdpData,    // VDP data port, $C00000-$C00003 and mirrors
+    VdpControl, // VDP control port, $C00004-$C00007 and mirrors
+    VdpOther,   // HV counter, PSG and the rest of $C00000-$DFFFFF
+    WorkRam,    // 64KB work RAM, $E00000-$FFFFFF (mirrored)
+    Other       // Anything else
+};
+
+constexpr size_t MEMORY_REGION_COUNT = 9;
+
+/** Region of a 68k address */
+MemoryRegion GetMemoryRegion(uint32_t addr);
+
+/** Report name of a memory region */
+const char* MemoryRegionName(MemoryRegion region);
+
+/**
+ * Address histogram file format
+ *
+ * Binary files hold "GXHIST01", then u32 sample rate, u32 CPU (ProfileCpu
+ * value), u64 total cycles, u64 address count and, sorted by address, one
+ * {u32 address, u64 cycles} pair per address. All integers are little-endian.
+ */
+enum class HistogramFormat {
+    JSON,       // For the disassembly viewer
+    Binary      // Compact and fast to write for large ROMs
 };
 
 /**
@@ -60,14 +150,152 @@ struct FunctionStats {
     uint64_t call_count = 0;       // Number of times function was entered
     uint64_t cycles_exclusive = 0; // Cycles spent in this function only
     uint64_t cycles_inclusive = 0; // Cycles including callees (CallStack mode only)
+    uint64_t bus_stall_cycles = 0; // 68k cycles stalled by this function's 68k bus accesses (Z80 only)
+};
+
+/**
+ * 68k data accesses (memory access profiling)
+ *
+ * An access is counted once, at its start address, whatever its width.
+ */
+struct MemoryAccessStats {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t read_bytes = 0;
+    uint64_t write_bytes = 0;
+
+    uint64_t Accesses() const { return reads + writes; }
 };
 
+/**
+ * Accesses to one work RAM variable
+ */
+struct VariableAccess {
+    std::string name;
+    uint32_t addr = 0;
+    uint32_t size = 0;
+    MemoryAccessStats access;      // Accesses starting inside the variable
+};
+
+/**
+ * Cycles spent on one source line (address histogram summed by line)
+ */
+struct LineStats {
+    std::string file;
+    uint32_t line = 0;
+    uint64_t cycles = 0;
+};
+
+/**
+ * CPU activity during one emulated frame (68k and Z80 profiling)
+ *
+ * All values are master clock cycles.
+ */
+struct FrameLoad {
+    uint64_t cpu_cycles = 0;       // Cycles the profiled CPU spent executing
+    uint64_t frame_cycles = 0;     // Length of the frame
+    uint64_t bus_stall_cycles = 0; // 68k cycles lost to Z80 accesses of the 68k bus (Z80 only)
+    uint64_t interrupt_cycles = 0; // Cycles spent in exception handlers (68k only)
+
+    /** Fraction of the frame the CPU was running (0.0 - 1.0) */
+    double Load() const {
+        return frame_cycles ? static_cast<double>(cpu_cycles) / frame_cycles : 0.0;
+    }
+
+    /** Fraction of the frame spent in exception handlers, e.g. V-INT (0.0 - 1.0) */
+    double InterruptLoad() const {
+        return frame_cycles ? static_cast<double>(interrupt_cycles) / frame_cycles : 0.0;
+    }
+};
+
+/**
+ * Timeline entry for one emulated frame (68k profiling with collect_timeline)
+ *
+ * Frames run from the start of VBlank to the end of active display, so the
+ * V-INT handler runs near the start of each frame. Cycles are master clock
+ * cycles.
+ */
+struct FrameProfile {
+    uint64_t frame = 0;            // Index in the timeline
+    uint64_t cpu_cycles = 0;       // 68k cycles executed
+    uint64_t vint_cycles = 0;      // Cycles in the V-INT handler, including its calls
+    int wait_line = -1;            // Scanline where the main loop reached its VBlank wait (-1 = not this frame)
+    bool input_polled = false;     // A controller data port was read
+    bool lag = false;              // Input not polled, or main loop not waiting when VBlank started
+    std::vector<std::pair<uint32_t, uint64_t>> functions;  // Function start, exclusive cycles; most first
+};
+
+/**
+ * 68k exception vector numbers, as used by Profiler::GetInterruptStats()
+ */
+constexpr uint32_t VECTOR_EXT_INT = 26;  // Level 2 autovector (external / pad TH)
+constexpr uint32_t VECTOR_HINT = 28;     // Level 4 autovector
+constexpr uint32_t VECTOR_VINT = 30;     // Level 6 autovector
+constexpr uint32_t VECTOR_TRAP0 = 32;    // TRAP #n is VECTOR_TRAP0 + n
+
+/** Report name of a 68k exception vector ("V-INT", "TRAP #0"...) */
+std::string ExceptionName(uint32_t vector);
+
+/**
+ * Time spent in one 68k exception handler
+ */
+struct InterruptStats {
+    uint64_t count = 0;      // Times the exception was taken
+    uint64_t cycles = 0;     // Cycles from entry to return, including nested exceptions
+};
+
+/**
+ * One completed call of a function or exception handler
+ */
+struct CallSample {
+    uint64_t frame = 0;      // Frames completed since Start() or Reset() when the call returned
+    uint64_t cycles = 0;     // Cycles from entry to return, including callees
+};
+
+/**
+ * Per-call cycles of a function or exception handler
+ */
+struct CallCycleStats {
+    uint64_t calls = 0;
+    uint64_t total_cycles = 0;
+    uint64_t min_cycles = 0;
+    uint64_t max_cycles = 0;
+    uint64_t max_frame = 0;  // Frame of the slowest call (the first, on a tie)
+    uint64_t p50 = 0;        // Median
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+
+    /** Mean cycles per call */
+    double Average() const {
+        return calls ? static_cast<double>(total_cycles) / calls : 0.0;
+    }
+};
+
+/**
+ * Nearest-rank percentile (0 - 100) of the cycles of calls (0 if empty)
+ */
+uint64_t CallCyclesPercentile(const std::vector<CallSample>& calls, double percentile);
+
+/**
+ * Summarize calls into a CallCycleStats
+ */
+CallCycleStats SummarizeCalls(const std::vector<CallSample>& calls);
+
 /**
  * Call stack frame for tracking nested function calls
+ *
+ * On the 68k, frames form a shadow stack that also holds exception handlers.
+ * A frame is popped once the stack pointer rises above the return address
+ * (or exception frame) pushed on entry, which covers RTS/RTR/RTE as well as
+ * tail calls and code that unwinds the stack itself.
  */
 struct CallFrame {
-    uint32_t func_addr;      // Start address of function
+    uint32_t func_addr;      // Start address of function (vector number for exceptions)
     int64_t entry_cycles;    // Cycle count when function was entered
+    uint32_t sp = 0;         // 68k stack pointer right after entry
+    uint32_t stack = 0;      // 68k stack holding the frame (0 = user, 4 = supervisor)
+    bool exception = false;  // 68k exception handler
+    uint32_t node = 0;       // Call tree node of the stack up to the frame's entry (CallStack mode)
 };
 
 /**
@@ -80,18 +308,29 @@ struct FunctionDef {
 };
 
 /**
- * 68k CPU cycle profiler
+ * Work RAM variable definition
+ */
+struct VariableDef {
+    uint32_t addr;
+    uint32_t size;
+    std::string name;
+};
+
+/**
+ * 68k / Z80 CPU cycle profiler
  *
  * Tracks cycles per function using the emulator's cpu_hook callback.
  * Simply attributes cycles to whichever function the PC is currently in.
- * Minimal overhead - just a binary search lookup per instruction.
+ * Minimal overhead - symbols are compiled into a page table mapping each
+ * code address to a function index, and stats are kept in a flat vector,
+ * so attributing an instruction is a couple of array loads.
  */
 class Profiler {
 public:
     Profiler();
     ~Profiler();
 
-    // Prevent copying (uses global hook)
+    // Prevent copying (registered as a hook subscriber)
     Profiler(const Profiler&) = delete;
     Profiler& operator=(const Profiler&) = delete;
 
@@ -108,12 +347,52 @@ public:
     void AddFunction(uint32_t start_addr, uint32_t end_addr, const std::string& name);
 
     /**
-     * Load symbols from an ELF file
+     * Load symbols from a 32-bit ELF file (read in-process, no nm needed)
+     *
+     * Code symbols from .symtab become functions, sized data objects in
+     * work RAM become variables. If the ELF has a DWARF
+     * .debug_line section, its line table is kept for LookupLine() and
+     * GetLineHistogram().
      * @param elf_path Path to ELF file with debug symbols
      * @return Number of functions loaded, or -1 on error
      */
     int LoadSymbolsFromELF(const std::string& elf_path);
 
+    /**
+     * Get number of line table rows loaded from the ELF
+     */
+    size_t GetLineCount() const { return elf_.GetLines().size(); }
+
+    /**
+     * Look up the source line of an address
+     * @return false if the address has no line info
+     */
+    bool LookupLine(uint32_t addr, std::string* file, uint32_t* line) const;
+
+    /**
+     * Add a work RAM variable, for memory access profiling
+     * @param addr Address in $FF0000-$FFFFFF (others are ignored)
+     * @param size Size in bytes
+     * @param name Variable name for reporting
+     */
+    void AddVariable(uint32_t addr, uint32_t size, const std::string& name);
+
+    /**
+     * Load work RAM variables from nm output, as read by tools/elf2sym.py
+     * Format: "address type name" (nm -n) or "address size type name"
+     * (nm -n -S), hex numbers. Without sizes, a variable extends to the
+     * next symbol (one byte for the last); linker symbols such as _end and
+     * __bss_end only end the previous variable.
+     * @param path Path to nm output
+     * @return Number of variables loaded, or -1 on error
+     */
+    int LoadVariablesFromFile(const std::string& path);
+
+    /**
+     * Get number of work RAM variables
+     */
+    size_t GetVariableCount() const { return variables_.size(); }
+
     /**
      * Load symbols from nm-style text output
      * Format: "address size name" per line (hex address, decimal size)
@@ -132,24 +411,37 @@ public:
      */
     size_t GetSymbolCount() const { return functions_.size(); }
 
+    /**
+     * Get the symbol table, sorted by start address
+     */
+    const std::vector<FunctionDef>& GetFunctions() const { return functions_; }
+
+    /**
+     * Find a function by name
+     * @return The first function with that name, or nullptr
+     */
+    const FunctionDef* FindFunctionByName(const std::string& name) const;
+
     // -------------------------------------------------------------------------
     // Profiling Control
     // -------------------------------------------------------------------------
 
     /**
-     * Start profiling - installs the cpu_hook callback
+     * Start profiling the 68k - subscribes to 68k execute hooks
+     *
+     * Several profilers (and other hook subscribers) can run at once.
      * @param mode ProfileMode::Simple (fast) or ProfileMode::CallStack (inclusive cycles)
      */
     void Start(ProfileMode mode = ProfileMode::Simple);
 
     /**
      * Start profiling with options
-     * @param options ProfileOptions struct with mode and sample_rate
+     * @param options ProfileOptions struct with mode, cpu and sample_rate
      */
     void Start(const ProfileOptions& options);
 
     /**
-     * Stop profiling - removes the cpu_hook callback
+     * Stop profiling - removes the hook subscription
      */
     void Stop();
 
@@ -175,9 +467,9 @@ public:
 
     /**
      * Get all function statistics
-     * @return Map of function start address to stats
+     * @return Map of function start address to stats (rebuilt on each call)
      */
-    const std::unordered_map<uint32_t, FunctionStats>& GetAllStats() const { return stats_; }
+    const std::unordered_map<uint32_t, FunctionStats>& GetAllStats() const;
 
     /**
      * Get total cycles recorded
@@ -189,6 +481,101 @@ public:
      */
     uint32_t GetSampleRate() const { return sample_rate_; }
 
+    /**
+     * Get the number of PC samples taken (ProfileMode::Scanline)
+     */
+    uint64_t GetSampleCount() const { return samples_; }
+
+    /**
+     * Get the CPU being profiled (as of the last Start)
+     */
+    ProfileCpu GetCpu() const { return cpu_; }
+
+    /**
+     * Get the profiling mode (as of the last Start)
+     */
+    ProfileMode GetMode() const { return mode_; }
+
+    /**
+     * Get total 68k cycles stalled by Z80 accesses to the 68k bus (Z80 only)
+     */
+    uint64_t GetBusStallCycles() const { return bus_stall_cycles_; }
+
+    /**
+     * Get per-frame CPU load, one entry per completed frame (68k and Z80)
+     */
+    const std::vector<FrameLoad>& GetFrameLoads() const { return frame_loads_; }
+
+    /**
+     * Get time spent in each 68k exception handler, by vector number
+     * (VECTOR_VINT, VECTOR_HINT...)
+     */
+    const std::map<uint32_t, InterruptStats>& GetInterruptStats() const { return interrupt_stats_; }
+
+    /**
+     * Get the per-frame timeline, one entry per completed frame
+     * (68k, needs ProfileOptions::collect_timeline)
+     */
+    const std::vector<FrameProfile>& GetTimeline() const { return timeline_; }
+
+    /**
+     * Get the timeline indexes of lag frames in [first, last)
+     */
+    std::vector<uint64_t> GetLagFrames(uint64_t first = 0, uint64_t last = UINT64_MAX) const;
+
+    /**
+     * Get the completed calls of a function, in return order
+     * (CallStack mode with ProfileOptions::collect_call_cycles). Calls still
+     * running when profiling stops are not included.
+     */
+    const std::vector<CallSample>& GetCalls(uint32_t func_addr) const;
+
+    /**
+     * Get the per-call cycles of a function (see GetCalls())
+     */
+    CallCycleStats GetCallCycles(uint32_t func_addr) const { return SummarizeCalls(GetCalls(func_addr)); }
+
+    /**
+     * Get the completed runs of a 68k exception handler by vector number
+     * (ProfileOptions::collect_call_cycles)
+     */
+    const std::vector<CallSample>& GetInterruptCalls(uint32_t vector) const;
+
+    /**
+     * Get 68k data accesses to a memory region, all code
+     * (needs ProfileOptions::collect_memory_access)
+     */
+    MemoryAccessStats GetMemoryAccess(MemoryRegion region) const;
+
+    /**
+     * Get 68k data accesses to a memory region by the function at func_addr
+     */
+    MemoryAccessStats GetMemoryAccess(uint32_t func_addr, MemoryRegion region) const;
+
+    /**
+     * Get accesses per work RAM byte, indexed by address & 0xFFFF
+     * (empty unless memory access was collected)
+     */
+    const std::vector<MemoryAccessStats>& GetWorkRamAccess() const { return ram_access_; }
+
+    /**
+     * Get accesses per variable (see AddVariable()), most accessed first
+     */
+    std::vector<VariableAccess> GetVariableAccess() const;
+
+    /**
+     * Write the work RAM access heatmap, with per-variable totals in JSON
+     *
+     * Binary files hold "GXHEAT01", then u32 base address ($FF0000), u32
+     * byte count (65536) and one {u64 reads, u64 writes, u64 read bytes, u64
+     * write bytes} entry per byte. All integers are little-endian.
+     * @param path Output file path
+     * @param format JSON (addresses with accesses only) or Binary (every byte)
+     * @return true on success
+     */
+    bool WriteMemoryHeatmap(const std::string& path,
+                            HistogramFormat format = HistogramFormat::JSON) const;
+
     /**
      * Print a formatted profile report
      * @param out Output stream
@@ -202,18 +589,65 @@ public:
 
     /**
      * Get per-address cycle histogram
-     * @return Map of PC address to cycles spent at that address
+     * @return Map of PC address to cycles spent at that address (rebuilt on each call)
      */
-    const std::unordered_map<uint32_t, uint64_t>& GetAddressHistogram() const {
-        return address_cycles_;
-    }
+    const std::unordered_map<uint32_t, uint64_t>& GetAddressHistogram() const;
+
+    /**
+     * Get the address histogram summed per source line, most cycles first
+     * (needs collect_address_histogram and an ELF with line info)
+     */
+    std::vector<LineStats> GetLineHistogram() const;
+
+    /**
+     * Write address histogram to a file
+     * @param path Output file path
+     * @param format JSON (for the disassembly viewer) or Binary
+     * @return true on success
+     */
+    bool WriteAddressHistogram(const std::string& path,
+                               HistogramFormat format = HistogramFormat::JSON) const;
+
+    /**
+     * Write per-function results for gxprof-diff (see profile_diff.h)
+     *
+     * Binary file: "GXPROF01", u32 CPU (ProfileCpu value), u32 sample rate,
+     * u64 total cycles, u64 frames, u32 function count and, per function in
+     * address order, u32 start, u32 end, u64 calls, u64 exclusive cycles,
+     * u64 inclusive cycles, u16 name length and the name. All integers are
+     * little-endian.
+     * @param path Output file path
+     * @return true on success
+     */
+    bool WriteProfile(const std::string& path) const;
+
+    // -------------------------------------------------------------------------
+    // Flame Graph / pprof Export
+    // -------------------------------------------------------------------------
+
+    /**
+     * Write folded stacks ("main;update;draw 1234" per line, root first) for
+     * flamegraph.pl or speedscope
+     *
+     * Stacks are recorded in CallStack mode, with 68k exceptions as frames
+     * such as "[V-INT]", and by Scanline mode with a stack walk. Other modes
+     * write a single-frame stack per function.
+     * @param path Output file path
+     * @return true on success
+     */
+    bool WriteFoldedStacks(const std::string& path) const;
 
     /**
-     * Write address histogram to JSON file for use with disassembly viewer
+     * Write a gzip-compressed pprof profile (profile.proto) for `pprof -http`
+     *
+     * Locations are CPU addresses with their function (and source line, if
+     * the ELF loaded had line info); callers are located at their call site.
+     * Without CallStack mode, samples come from the address histogram if
+     * collected, otherwise from the function start addresses.
      * @param path Output file path
      * @return true on success
      */
-    bool WriteAddressHistogram(const std::string& path) const;
+    bool WritePprof(const std::string& path) const;
 
     // -------------------------------------------------------------------------
     // Internal (called by cpu_hook)
@@ -222,36 +656,215 @@ public:
     /** Called by cpu_hook on each instruction execute */
     void OnExecute(uint32_t pc);
 
+    /** Called by cpu_hook when the 68k takes an exception (frame already stacked) */
+    void OnException(uint32_t vector);
+
+    /** Called by cpu_hook on each SSP1601 instruction execute */
+    void OnSvpExecute(uint32_t pc, uint32_t cycles);
+
+    /** Called by cpu_hook when the Z80 accesses the 68k bus */
+    void OnBusRequest(uint32_t stall_cycles);
+
+    /** Called by cpu_hook when the Z80 restarts after BUSREQ/RESET */
+    void OnZ80Sync(uint32_t cycles);
+
+    /** Called by cpu_hook at the end of each frame */
+    void OnFrameEnd(uint32_t frame_cycles);
+
+    /** Called by cpu_hook when the 68k reads a controller data port */
+    void OnInputRead();
+
+    /** Called by cpu_hook at the end of each scanline (Scanline mode) */
+    void OnScanline();
+
+    /** Called by cpu_hook on each 68k instruction execute (memory access profiling) */
+    void OnAccessInstruction(uint32_t pc) { access_pc_ = pc; }
+
+    /** Called by cpu_hook on each 68k data read or write (memory access profiling) */
+    void OnMemoryAccess(uint32_t addr, uint32_t width, bool write);
+
 private:
-    /** Look up function containing address */
-    const FunctionDef* LookupFunction(uint32_t addr) const;
+    static constexpr uint32_t NO_FUNCTION = 0xFFFFFFFFu;
+    static constexpr int LOOKUP_PAGE_BITS = 12;
+
+    /** Compile functions_ into the address lookup table for the profiled CPU */
+    void BuildLookup();
+
+    /** Size the dense histogram for the profiled CPU's code range */
+    void SetupHistogram();
+
+    /** Add cycles spent at addr to the address histogram */
+    void AddToHistogram(uint32_t addr, int64_t cycles) {
+        if (addr < histogram_limit_) {
+            histogram_[addr >> histogram_shift_] += cycles;
+        } else {
+            histogram_overflow_[addr] += cycles;
+        }
+    }
+
+    /** Nonzero histogram entries sorted by address */
+    std::vector<std::pair<uint32_t, uint64_t>> SortedHistogram() const;
+
+    /** Index of the function containing addr (or NO_FUNCTION) - O(1) */
+    uint32_t FunctionIndex(uint32_t addr) const {
+        uint32_t slot = (addr & lookup_addr_mask_) >> lookup_shift_;
+        return lookup_pages_[(static_cast<size_t>(lookup_dir_[slot >> LOOKUP_PAGE_BITS]) << LOOKUP_PAGE_BITS) |
+                             (slot & ((1u << LOOKUP_PAGE_BITS) - 1))];
+    }
+
+    /** Index of the function containing addr (or NO_FUNCTION) - binary search, for reports */
+    uint32_t FindFunction(uint32_t addr) const;
+
+    /** Cycle counter of the profiled CPU */
+    int64_t CurrentCycles() const;
+
+    /** Attribute cycles up to current_cycles and move to pc */
+    void Execute(uint32_t pc, int64_t current_cycles);
+
+    /** Push a call stack frame entered from call_site */
+    void PushFrame(CallFrame frame, uint32_t call_site);
+
+    /** Pop the top call stack frame, accumulating its inclusive time */
+    void PopFrame(int64_t current_cycles);
+
+    /** Complete the current timeline frame */
+    void EndTimelineFrame();
+
+    /**
+     * Find the call sites of the current 68k call stack, innermost first, by
+     * scanning the stack for return addresses that follow a JSR or BSR
+     */
+    void WalkStack(std::vector<uint32_t>& call_sites) const;
+
+    /** Address of the JSR/BSR returning to ret (or NO_FUNCTION) */
+    uint32_t CallSiteBefore(uint32_t ret) const;
+
+    /** Call tree node for addr (or an exception vector) below parent, created on first use */
+    uint32_t CallTreeChild(uint32_t parent, uint32_t addr, bool exception);
+
+    /** Call tree node of the current stack, the leaf excluded */
+    uint32_t StackNode() const { return call_stack_.empty() ? 0 : call_stack_.back().node; }
+
+    /**
+     * Stacks and their cycles for export, leaf first; frames are code
+     * addresses or EXCEPTION_FRAME | vector
+     */
+    std::vector<std::pair<std::vector<uint64_t>, uint64_t>> CollectStacks() const;
+
+    /** Display name of a CollectStacks() frame */
+    std::string FrameName(uint64_t frame) const;
+
+    /** Current value of a 68k stack pointer (0 = user, 4 = supervisor) */
+    uint32_t StackPointer(uint32_t stack) const;
 
     /** Read 16-bit word from 68k address space */
     uint16_t ReadWord(uint32_t addr) const;
 
+    /** Read byte from Z80 RAM */
+    uint8_t ReadZ80Byte(uint32_t addr) const;
+
+    /** Check if the Z80 instruction at from_pc called a subroutine (landing at to_pc) */
+    bool IsZ80Call(uint32_t from_pc, uint32_t to_pc) const;
+
+    /** Check if the Z80 instruction at from_pc returned (landing at to_pc) */
+    bool IsZ80Return(uint32_t from_pc, uint32_t to_pc) const;
+
+    /** Read word from SSP1601 program memory */
+    uint16_t ReadSvpWord(uint32_t addr) const;
+
     /** Check if opcode is JSR or BSR */
     bool IsCallOpcode(uint16_t opcode) const;
 
-    /** Check if opcode is RTS or RTR */
-    bool IsReturnOpcode(uint16_t opcode) const;
-
     std::vector<FunctionDef> functions_;  // Sorted by start_addr
-    std::unordered_map<uint32_t, FunctionStats> stats_;
-    std::unordered_map<uint32_t, uint64_t> address_cycles_;  // Per-address histogram
-    std::vector<CallFrame> call_stack_;   // For CallStack mode
+    std::vector<FunctionStats> stats_;    // Parallel to functions_
+    mutable std::unordered_map<uint32_t, FunctionStats> stats_view_;  // For GetAllStats()
+
+    // Address lookup: slot = address >> lookup_shift_ (code alignment), the
+    // directory maps each page of slots to a page of function indexes
+    // (page 0 is shared by all addresses outside any function)
+    std::vector<uint32_t> lookup_dir_;
+    std::vector<uint32_t> lookup_pages_;
+    uint32_t lookup_addr_mask_ = 0;
+    uint32_t lookup_shift_ = 0;
+    bool lookup_dirty_ = true;            // Symbols changed since BuildLookup()
+
+    // Per-address histogram: one counter per code slot (address >> shift)
+    // below histogram_limit_, anything else in the overflow map
+    std::vector<uint64_t> histogram_;
+    std::unordered_map<uint32_t, uint64_t> histogram_overflow_;
+    mutable std::unordered_map<uint32_t, uint64_t> histogram_view_;  // For GetAddressHistogram()
+    uint32_t histogram_limit_ = 0;
+    uint32_t histogram_shift_ = 0;
+    ElfReader elf_;                       // Line table of the last ELF loaded
+    std::vector<CallFrame> call_stack_;   // For CallStack mode (and 68k exceptions)
+
+    // Call tree of CallStack mode, node 0 is the root
+    struct CallTreeNode {
+        uint32_t parent = 0;
+        uint32_t addr = 0;          // Code address, or exception vector
+        bool exception = false;
+        uint64_t cycles = 0;        // Cycles spent with this node as the leaf
+    };
+    static constexpr uint64_t EXCEPTION_FRAME = 1ull << 32;
+    std::vector<CallTreeNode> call_tree_ = std::vector<CallTreeNode>(1);
+    std::unordered_map<uint64_t, uint32_t> call_tree_index_;  // (parent, exception, addr) -> node
+
+    std::vector<FrameLoad> frame_loads_;  // 68k and Z80
+    std::map<uint32_t, InterruptStats> interrupt_stats_;  // 68k only
+    uint32_t exception_depth_ = 0;        // Exception frames on call_stack_
+    uint32_t vint_depth_ = 0;             // V-INT frames on call_stack_
+    bool exception_entered_ = false;      // Next instruction is an exception handler's first
+
+    // Per-frame timeline (68k only)
+    std::vector<FrameProfile> timeline_;
+    FrameProfile timeline_frame_;         // Current frame
+    std::vector<uint64_t> frame_start_cycles_;  // stats_ exclusive cycles at frame start
+    bool collect_timeline_ = false;
+    uint32_t vblank_wait_start_ = 0;
+    uint32_t vblank_wait_end_ = 0;
+    bool waiting_for_vblank_ = false;     // Main loop is in the VBlank wait code
+    int input_hook_id_ = -1;
+
+    // Memory access profiling (68k only): memory_access_ holds
+    // MEMORY_REGION_COUNT counters per function, then a row for code
+    // outside any function
+    std::vector<VariableDef> variables_;  // Sorted by addr
+    std::vector<MemoryAccessStats> memory_access_;
+    std::vector<MemoryAccessStats> ram_access_;  // Per work RAM byte
+    bool collect_memory_access_ = false;
+    uint32_t access_pc_ = 0;              // Instruction making the accesses
+    int memory_hook_id_ = -1;
+
+    // Per-call cycles, by function start address and by exception vector
+    std::unordered_map<uint32_t, std::vector<CallSample>> call_samples_;
+    std::map<uint32_t, std::vector<CallSample>> interrupt_samples_;
+    bool collect_call_cycles_ = false;
+
+    // Scanline sampling (68k only)
+    uint32_t sample_lines_ = 1;
+    uint32_t stack_walk_depth_ = 0;
+    uint32_t line_counter_ = 0;
+    uint64_t samples_ = 0;
+    std::vector<uint32_t> call_sites_;    // WalkStack() result of the last sample
 
     ProfileMode mode_ = ProfileMode::Simple;
+    ProfileCpu cpu_ = ProfileCpu::M68K;
     bool running_ = false;
+    int hook_id_ = -1;
+    int svp_idle_skip_ = 0;       // ssp1601_idle_skip to restore on Stop()
     bool collect_address_histogram_ = false;
     uint32_t last_pc_ = 0;
+    bool has_last_pc_ = false;    // last_pc_ is valid (Z80 code starts at address 0)
     int64_t last_cycles_ = 0;
     uint64_t total_cycles_ = 0;
     uint32_t sample_rate_ = 1;
     uint32_t sample_counter_ = 0;
     int64_t pending_cycles_ = 0;  // Accumulated cycles since last sample (for sampling mode)
+    uint64_t bus_stall_cycles_ = 0;
+    FrameLoad frame_;             // Current frame
 };
 
-/** Global profiler instance (needed for cpu_hook callback) */
+/** Most recently started profiler that is still running (or nullptr) */
 Profiler* GetActiveProfiler();
 
 } // namespace GX
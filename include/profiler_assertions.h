@@ -0,0 +1,481 @@
+/**
+ * profiler_assertions.h - Google Test assertions on Profiler and VdpProfiler results
+ *
+ * Usage:
+ *   GX::ProfileOptions options;
+ *   options.collect_timeline = true;
+ *   options.vblank_wait_start = 0x1200;  // wait_vblank
+ *   options.vblank_wait_end = 0x1220;
+ *   profiler.Start(options);
+ *   emu.RunFrames(600);
+ *   profiler.Stop();
+ *
+ *   EXPECT_NO_LAG_FRAMES(profiler, 60, 600);  // Timeline frames [60, 600)
+ *
+ *   EXPECT_DMA_WITHIN_BUDGET(vdp, 7000, 60, 600);  // VdpProfiler frames [60, 600)
+ *   EXPECT_NO_SPRITE_OVERFLOW(vdp, 60, 600);
+ *
+ * Cycle budgets of ROM functions, by name or start address (per-call checks
+ * need CallStack mode and ProfileOptions::collect_call_cycles, which
+ * ProfileTest::ProfileFrames() sets):
+ *
+ *   EXPECT_FUNC_CYCLES_LE(profiler, "run_sieve", 400000);
+ *   EXPECT_FUNC_AVG_CALL_CYCLES_LE(profiler, "update_enemies", 2000);
+ *   EXPECT_FUNC_MAX_CALL_CYCLES_LE(profiler, "update_enemies", 5000);
+ *   EXPECT_FUNC_CALL_PERCENTILE_LE(profiler, "update_enemies", 99, 4000);
+ *   EXPECT_INTERRUPT_LOAD_LE(profiler, GX::VECTOR_VINT, 0.10);  // 10% of a frame
+ */
+
+#ifndef GXTEST_PROFILER_ASSERTIONS_H
+#define GXTEST_PROFILER_ASSERTIONS_H
+
+#include "gxtest.h"
+#include "profiler.h"
+#include "vdp_profiler.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace GX {
+
+/**
+ * Test fixture with a Profiler, for cycle budget tests:
+ *
+ *   class SieveBudget : public GX::ProfileTest {
+ *   protected:
+ *       void SetUp() override {
+ *           ASSERT_TRUE(LoadRom("sieve.bin"));
+ *           ASSERT_GT(profiler.LoadSymbolsFromELF("sieve.elf"), 0);
+ *       }
+ *   };
+ *
+ *   TEST_F(SieveBudget, RunSieve) {
+ *       ProfileFrames(60);
+ *       EXPECT_FUNC_CYCLES_LE(profiler, "run_sieve", 400000);
+ *   }
+ */
+class ProfileTest : public Test {
+protected:
+    Profiler profiler;
+
+    /** Options used by ProfileFrames(): CallStack mode, keeping every call */
+    static ProfileOptions CallCycleOptions() {
+        ProfileOptions options;
+        options.mode = ProfileMode::CallStack;
+        options.collect_call_cycles = true;
+        return options;
+    }
+
+    /** Profile the next frames, discarding earlier results (symbols are kept) */
+    void ProfileFrames(int frames, const ProfileOptions& options = CallCycleOptions()) {
+        profiler.Stop();
+        profiler.Reset();
+        profiler.Start(options);
+        RunFrames(frames);
+        profiler.Stop();
+    }
+
+    /** Per-call cycles of the function with that name (all zero if unknown) */
+    CallCycleStats CallCycles(const std::string& name) const {
+        const FunctionDef* func = profiler.FindFunctionByName(name);
+        return func ? profiler.GetCallCycles(func->start_addr) : CallCycleStats();
+    }
+};
+
+namespace internal {
+
+/** Function of the budget assertions, by start address or name */
+inline const FunctionDef* BudgetFunction(const Profiler& profiler, uint32_t addr) {
+    for (const FunctionDef& func : profiler.GetFunctions()) {
+        if (func.start_addr == addr) return &func;
+    }
+    return nullptr;
+}
+
+inline const FunctionDef* BudgetFunction(const Profiler& profiler, const std::string& name) {
+    return profiler.FindFunctionByName(name);
+}
+
+inline std::string BudgetFunctionLabel(uint32_t addr) {
+    char label[16];
+    snprintf(label, sizeof(label), "$%06X", addr);
+    return label;
+}
+
+inline std::string BudgetFunctionLabel(const std::string& name) {
+    return name;
+}
+
+/** " (+12.5%)" over budget */
+inline std::string OverBudget(double value, double budget) {
+    char text[32];
+    snprintf(text, sizeof(text), " (+%.1f%%)", budget > 0 ? (value - budget) * 100.0 / budget : 100.0);
+    return text;
+}
+
+/**
+ * Find the calls of a function for a per-call assertion, or fail explaining
+ * why there are none
+ */
+template <typename Func>
+::testing::AssertionResult BudgetCalls(const Profiler& profiler, const Func& func,
+                                       const FunctionDef*& def, const std::vector<CallSample>*& calls) {
+    def = BudgetFunction(profiler, func);
+    if (!def) {
+        return ::testing::AssertionFailure()
+            << "No function " << BudgetFunctionLabel(func) << " in the symbol table";
+    }
+    calls = &profiler.GetCalls(def->start_addr);
+    if (calls->empty()) {
+        return ::testing::AssertionFailure()
+            << "No completed calls of " << def->name << " (profile in CallStack mode with"
+            << " ProfileOptions::collect_call_cycles)";
+    }
+    return ::testing::AssertionSuccess();
+}
+
+/** Append the frames with calls over max_cycles, slowest call first */
+inline void ListSlowCallFrames(::testing::AssertionResult& result, const std::vector<CallSample>& calls,
+                               uint64_t max_cycles) {
+    std::map<uint64_t, std::pair<uint64_t, uint64_t>> frames;  // Frame -> calls over, slowest
+    for (const CallSample& call : calls) {
+        if (call.cycles > max_cycles) {
+            auto& frame = frames[call.frame];
+            frame.first++;
+            frame.second = std::max(frame.second, call.cycles);
+        }
+    }
+    std::vector<std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> sorted(frames.begin(), frames.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.second.second > b.second.second;
+    });
+    for (size_t i = 0; i < sorted.size() && i < 20; i++) {
+        result << "\n  frame " << sorted[i].first << ": " << sorted[i].second.first
+               << " call(s) over, slowest " << sorted[i].second.second << " cycles";
+    }
+    if (sorted.size() > 20) {
+        result << "\n  ...";
+    }
+}
+
+} // namespace internal
+
+/**
+ * Check the cycles a function used: inclusive cycles of its completed calls
+ * in CallStack mode, exclusive cycles otherwise. With per-call cycles, the
+ * failure message gives the frame where the function used the most.
+ */
+template <typename Func>
+::testing::AssertionResult FuncCyclesLE(const Profiler& profiler, const Func& func, uint64_t max_cycles) {
+    const FunctionDef* def = internal::BudgetFunction(profiler, func);
+    if (!def) {
+        return ::testing::AssertionFailure()
+            << "No function " << internal::BudgetFunctionLabel(func) << " in the symbol table";
+    }
+    const FunctionStats* stats = profiler.GetStats(def->start_addr);
+    bool inclusive = profiler.GetMode() == ProfileMode::CallStack;
+    uint64_t cycles = inclusive ? stats->cycles_inclusive : stats->cycles_exclusive;
+    if (cycles <= max_cycles) {
+        return ::testing::AssertionSuccess();
+    }
+    ::testing::AssertionResult result = ::testing::AssertionFailure();
+    result << def->name << " used " << cycles << (inclusive ? " inclusive" : " exclusive")
+           << " cycles, budget " << max_cycles << internal::OverBudget(cycles, max_cycles);
+    const std::vector<CallSample>& calls = profiler.GetCalls(def->start_addr);
+    if (!calls.empty()) {
+        std::map<uint64_t, std::pair<uint64_t, uint64_t>> frames;  // Frame -> calls, cycles
+        for (const CallSample& call : calls) {
+            frames[call.frame].first++;
+            frames[call.frame].second += call.cycles;
+        }
+        auto worst = std::max_element(frames.begin(), frames.end(), [](const auto& a, const auto& b) {
+            return a.second.second < b.second.second;
+        });
+        CallCycleStats summary = SummarizeCalls(calls);
+        result << "\n  " << summary.calls << " call(s) in " << frames.size() << " frame(s)"
+               << "\n  worst frame " << worst->first << ": " << worst->second.second << " cycles in "
+               << worst->second.first << " call(s)"
+               << "\n  slowest call: " << summary.max_cycles << " cycles in frame " << summary.max_frame;
+    }
+    return result;
+}
+
+/**
+ * Check the mean cycles per call of a function; the failure message gives
+ * the percentiles and the slowest call's frame
+ */
+template <typename Func>
+::testing::AssertionResult FuncAvgCallCyclesLE(const Profiler& profiler, const Func& func, double max_cycles) {
+    const FunctionDef* def = nullptr;
+    const std::vector<CallSample>* calls = nullptr;
+    ::testing::AssertionResult found = internal::BudgetCalls(profiler, func, def, calls);
+    if (!found) return found;
+    CallCycleStats summary = SummarizeCalls(*calls);
+    if (summary.Average() <= max_cycles) {
+        return ::testing::AssertionSuccess();
+    }
+    return ::testing::AssertionFailure()
+        << def->name << " averaged " << summary.Average() << " cycles per call over "
+        << summary.calls << " call(s), budget " << max_cycles
+        << internal::OverBudget(summary.Average(), max_cycles)
+        << "\n  p50 " << summary.p50 << ", p90 " << summary.p90 << ", p99 " << summary.p99
+        << "\n  slowest call: " << summary.max_cycles << " cycles in frame " << summary.max_frame;
+}
+
+/**
+ * Check that no call of a function took more than max_cycles; the failure
+ * message lists the frames with slow calls, worst first
+ */
+template <typename Func>
+::testing::AssertionResult FuncMaxCallCyclesLE(const Profiler& profiler, const Func& func, uint64_t max_cycles) {
+    const FunctionDef* def = nullptr;
+    const std::vector<CallSample>* calls = nullptr;
+    ::testing::AssertionResult found = internal::BudgetCalls(profiler, func, def, calls);
+    if (!found) return found;
+    CallCycleStats summary = SummarizeCalls(*calls);
+    if (summary.max_cycles <= max_cycles) {
+        return ::testing::AssertionSuccess();
+    }
+    uint64_t over = std::count_if(calls->begin(), calls->end(),
+                                  [&](const CallSample& call) { return call.cycles > max_cycles; });
+    ::testing::AssertionResult result = ::testing::AssertionFailure();
+    result << over << " of " << summary.calls << " call(s) of " << def->name << " over "
+           << max_cycles << " cycles, slowest " << summary.max_cycles << " in frame " << summary.max_frame
+           << internal::OverBudget(summary.max_cycles, max_cycles)
+           << " (p50 " << summary.p50 << ", p90 " << summary.p90 << ", p99 " << summary.p99 << "):";
+    internal::ListSlowCallFrames(result, *calls, max_cycles);
+    return result;
+}
+
+/**
+ * Check a percentile (0 - 100, nearest rank) of the per-call cycles of a
+ * function; the failure message lists the frames with calls over the budget
+ */
+template <typename Func>
+::testing::AssertionResult FuncCallPercentileLE(const Profiler& profiler, const Func& func,
+                                                double percentile, uint64_t max_cycles) {
+    const FunctionDef* def = nullptr;
+    const std::vector<CallSample>* calls = nullptr;
+    ::testing::AssertionResult found = internal::BudgetCalls(profiler, func, def, calls);
+    if (!found) return found;
+    uint64_t cycles = CallCyclesPercentile(*calls, percentile);
+    if (cycles <= max_cycles) {
+        return ::testing::AssertionSuccess();
+    }
+    ::testing::AssertionResult result = ::testing::AssertionFailure();
+    result << "p" << percentile << " of " << def->name << " is " << cycles << " cycles over "
+           << calls->size() << " call(s), budget " << max_cycles << internal::OverBudget(cycles, max_cycles)
+           << ":";
+    internal::ListSlowCallFrames(result, *calls, max_cycles);
+    return result;
+}
+
+/**
+ * Check that every run of a 68k exception handler (e.g. VECTOR_VINT) took at
+ * most max_load of its frame (0.1 = 10%); needs collect_call_cycles. The
+ * failure message lists the runs over budget, worst first.
+ */
+inline ::testing::AssertionResult InterruptLoadLE(const Profiler& profiler, uint32_t vector, double max_load) {
+    const std::vector<CallSample>& calls = profiler.GetInterruptCalls(vector);
+    const std::vector<FrameLoad>& frames = profiler.GetFrameLoads();
+    if (calls.empty() || frames.empty()) {
+        return ::testing::AssertionFailure()
+            << "No completed " << ExceptionName(vector) << " runs in " << frames.size()
+            << " frame(s) (is ProfileOptions::collect_call_cycles set?)";
+    }
+    // A run in the frame still in progress is measured against the last complete one
+    std::vector<std::pair<double, const CallSample*>> over;
+    for (const CallSample& call : calls) {
+        const FrameLoad& frame = frames[std::min<uint64_t>(call.frame, frames.size() - 1)];
+        double load = frame.frame_cycles ? static_cast<double>(call.cycles) / frame.frame_cycles : 0.0;
+        if (load > max_load) {
+            over.emplace_back(load, &call);
+        }
+    }
+    if (over.empty()) {
+        return ::testing::AssertionSuccess();
+    }
+    std::stable_sort(over.begin(), over.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    ::testing::AssertionResult result = ::testing::AssertionFailure();
+    result << over.size() << " of " << calls.size() << " " << ExceptionName(vector) << " run(s) over "
+           << max_load * 100.0 << "% of a frame:";
+    for (size_t i = 0; i < over.size() && i < 20; i++) {
+        result << "\n  frame " << over[i].second->frame << ": " << over[i].second->cycles
+               << " cycles (" << over[i].first * 100.0 << "%)";
+    }
+    if (over.size() > 20) {
+        result << "\n  ...";
+    }
+    return result;
+}
+
+/**
+ * Check that timeline frames [first, last) have no lag frames; the failure
+ * message lists the lag frames with their wait scanline and input polling
+ */
+inline ::testing::AssertionResult NoLagFrames(const Profiler& profiler, uint64_t first, uint64_t last) {
+    const std::vector<FrameProfile>& timeline = profiler.GetTimeline();
+    if (first >= last || timeline.size() < last) {
+        return ::testing::AssertionFailure()
+            << "Timeline has " << timeline.size() << " frames, expected at least " << last
+            << " (is ProfileOptions::collect_timeline set?)";
+    }
+    std::vector<uint64_t> lag = profiler.GetLagFrames(first, last);
+    if (lag.empty()) {
+        return ::testing::AssertionSuccess();
+    }
+    ::testing::AssertionResult result = ::testing::AssertionFailure();
+    result << lag.size() << " lag frame(s) in [" << first << ", " << last << "):";
+    for (size_t i = 0; i < lag.size() && i < 20; i++) {
+        const FrameProfile& frame = timeline[lag[i]];
+        result << "\n  frame " << frame.frame << ": " << frame.cpu_cycles << " cycles, wait line "
+               << frame.wait_line << (frame.input_polled ? "" : ", input not polled");
+    }
+    if (lag.size() > 20) {
+        result << "\n  ...";
+    }
+    return result;
+}
+
+/**
+ * Check that VdpProfiler frames [first, last) each transfer at most max_bytes
+ * by DMA; the failure message lists the frames over budget by DMA kind
+ */
+inline ::testing::AssertionResult DmaWithinBudget(const VdpProfiler& vdp, uint64_t max_bytes,
+                                                  uint64_t first, uint64_t last) {
+    const std::vector<VdpFrameStats>& frames = vdp.GetFrames();
+    if (first >= last || frames.size() < last) {
+        return ::testing::AssertionFailure()
+            << "VDP profiler has " << frames.size() << " frames, expected at least " << last;
+    }
+    std::vector<const VdpFrameStats*> over;
+    for (uint64_t i = first; i < last; i++) {
+        if (frames[i].DmaBytes() > max_bytes) {
+            over.push_back(&frames[i]);
+        }
+    }
+    if (over.empty()) {
+        return ::testing::AssertionSuccess();
+    }
+    ::testing::AssertionResult result = ::testing::AssertionFailure();
+    result << over.size() << " frame(s) over the DMA budget of " << max_bytes
+           << " bytes in [" << first << ", " << last << "):";
+    for (size_t i = 0; i < over.size() && i < 20; i++) {
+        const VdpFrameStats& frame = *over[i];
+        result << "\n  frame " << frame.frame << ": " << frame.DmaBytes() << " bytes (";
+        for (size_t k = 0; k < VDP_DMA_KIND_COUNT; k++) {
+            result << (k == 0 ? "" : ", ") << VdpDmaKindName(static_cast<VdpDmaKind>(k))
+                   << " " << frame.dma_bytes[k];
+        }
+        result << "), " << frame.dma_active_bytes << " in active display";
+    }
+    if (over.size() > 20) {
+        result << "\n  ...";
+    }
+    return result;
+}
+
+/**
+ * Check that VdpProfiler frames [first, last) have no line over the sprite
+ * or sprite pixel limit; the failure message gives the overflow line counts
+ * of each such frame
+ */
+inline ::testing::AssertionResult NoSpriteOverflow(const VdpProfiler& vdp, uint64_t first, uint64_t last) {
+    const std::vector<VdpFrameStats>& frames = vdp.GetFrames();
+    if (first >= last || frames.size() < last) {
+        return ::testing::AssertionFailure()
+            << "VDP profiler has " << frames.size() << " frames, expected at least " << last;
+    }
+    std::vector<const VdpFrameStats*> over;
+    for (uint64_t i = first; i < last; i++) {
+        if (frames[i].sprite_overflow_lines > 0 || frames[i].pixel_overflow_lines > 0) {
+            over.push_back(&frames[i]);
+        }
+    }
+    if (over.empty()) {
+        return ::testing::AssertionSuccess();
+    }
+    ::testing::AssertionResult result = ::testing::AssertionFailure();
+    result << over.size() << " frame(s) with sprite overflow in [" << first << ", " << last << "):";
+    for (size_t i = 0; i < over.size() && i < 20; i++) {
+        const VdpFrameStats& frame = *over[i];
+        result << "\n  frame " << frame.frame << ": " << frame.sprite_overflow_lines
+               << " line(s) over the sprite limit, " << frame.pixel_overflow_lines
+               << " over the pixel limit, peak " << frame.max_sprites << " sprites / "
+               << frame.max_sprite_pixels << " pixels";
+    }
+    if (over.size() > 20) {
+        result << "\n  ...";
+    }
+    return result;
+}
+
+} // namespace GX
+
+/** Expect no lag frames in timeline frames [first, last) */
+#define EXPECT_NO_LAG_FRAMES(profiler, first, last) \
+    EXPECT_TRUE(::GX::NoLagFrames((profiler), (first), (last)))
+
+/** Assert no lag frames in timeline frames [first, last) */
+#define ASSERT_NO_LAG_FRAMES(profiler, first, last) \
+    ASSERT_TRUE(::GX::NoLagFrames((profiler), (first), (last)))
+
+/** Expect at most max_bytes of DMA in each VdpProfiler frame of [first, last) */
+#define EXPECT_DMA_WITHIN_BUDGET(vdp, max_bytes, first, last) \
+    EXPECT_TRUE(::GX::DmaWithinBudget((vdp), (max_bytes), (first), (last)))
+
+/** Assert at most max_bytes of DMA in each VdpProfiler frame of [first, last) */
+#define ASSERT_DMA_WITHIN_BUDGET(vdp, max_bytes, first, last) \
+    ASSERT_TRUE(::GX::DmaWithinBudget((vdp), (max_bytes), (first), (last)))
+
+/** Expect no sprite or sprite pixel overflow in VdpProfiler frames [first, last) */
+#define EXPECT_NO_SPRITE_OVERFLOW(vdp, first, last) \
+    EXPECT_TRUE(::GX::NoSpriteOverflow((vdp), (first), (last)))
+
+/** Assert no sprite or sprite pixel overflow in VdpProfiler frames [first, last) */
+#define ASSERT_NO_SPRITE_OVERFLOW(vdp, first, last) \
+    ASSERT_TRUE(::GX::NoSpriteOverflow((vdp), (first), (last)))
+
+/** Expect a function (name or start address) to use at most max_cycles */
+#define EXPECT_FUNC_CYCLES_LE(profiler, func, max_cycles) \
+    EXPECT_TRUE(::GX::FuncCyclesLE((profiler), (func), (max_cycles)))
+
+/** Assert a function (name or start address) uses at most max_cycles */
+#define ASSERT_FUNC_CYCLES_LE(profiler, func, max_cycles) \
+    ASSERT_TRUE(::GX::FuncCyclesLE((profiler), (func), (max_cycles)))
+
+/** Expect a function to average at most max_cycles per call */
+#define EXPECT_FUNC_AVG_CALL_CYCLES_LE(profiler, func, max_cycles) \
+    EXPECT_TRUE(::GX::FuncAvgCallCyclesLE((profiler), (func), (max_cycles)))
+
+/** Assert a function averages at most max_cycles per call */
+#define ASSERT_FUNC_AVG_CALL_CYCLES_LE(profiler, func, max_cycles) \
+    ASSERT_TRUE(::GX::FuncAvgCallCyclesLE((profiler), (func), (max_cycles)))
+
+/** Expect no call of a function to take more than max_cycles */
+#define EXPECT_FUNC_MAX_CALL_CYCLES_LE(profiler, func, max_cycles) \
+    EXPECT_TRUE(::GX::FuncMaxCallCyclesLE((profiler), (func), (max_cycles)))
+
+/** Assert no call of a function takes more than max_cycles */
+#define ASSERT_FUNC_MAX_CALL_CYCLES_LE(profiler, func, max_cycles) \
+    ASSERT_TRUE(::GX::FuncMaxCallCyclesLE((profiler), (func), (max_cycles)))
+
+/** Expect a percentile (0 - 100) of a function's per-call cycles to be at most max_cycles */
+#define EXPECT_FUNC_CALL_PERCENTILE_LE(profiler, func, percentile, max_cycles) \
+    EXPECT_TRUE(::GX::FuncCallPercentileLE((profiler), (func), (percentile), (max_cycles)))
+
+/** Assert a percentile (0 - 100) of a function's per-call cycles is at most max_cycles */
+#define ASSERT_FUNC_CALL_PERCENTILE_LE(profiler, func, percentile, max_cycles) \
+    ASSERT_TRUE(::GX::FuncCallPercentileLE((profiler), (func), (percentile), (max_cycles)))
+
+/** Expect every run of an exception handler to take at most max_load of its frame */
+#define EXPECT_INTERRUPT_LOAD_LE(profiler, vector, max_load) \
+    EXPECT_TRUE(::GX::InterruptLoadLE((profiler), (vector), (max_load)))
+
+/** Assert every run of an exception handler takes at most max_load of its frame */
+#define ASSERT_INTERRUPT_LOAD_LE(profiler, vector, max_load) \
+    ASSERT_TRUE(::GX::InterruptLoadLE((profiler), (vector), (max_load)))
+
+#endif // GXTEST_PROFILER_ASSERTIONS_H
@@ -0,0 +1,169 @@
+/**
+ * state_store.h - Content-addressed, deduplicating store for emulator states
+ *
+ * Input-search and fuzzing jobs keep very large numbers of states of a single
+ * ROM, and most of their bytes are identical (unchanged RAM pages, VRAM, the
+ * CPU block of idle frames...). The store splits each serialized state into
+ * fixed-size chunks, hashes every chunk with xxHash and keeps each distinct
+ * chunk only once. A stored state is just a list of chunk references.
+ *
+ * Usage:
+ *   GX::StateStore store;
+ *   GX::StateStore::StateId id = store.Insert(emu);
+ *   ...
+ *   store.Restore(id, emu);
+ *
+ *   GX::StateStore::Stats stats = store.GetStats();
+ *   std::cout << stats.GetDedupRatio() << "x" << std::endl;
+ */
+
+#ifndef GXTEST_STATE_STORE_H
+#define GXTEST_STATE_STORE_H
+
+#include "gxtest.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace GX {
+
+/**
+ * Deduplicating state store
+ *
+ * NOT THREAD-SAFE. Chunk payloads live in fixed-size slabs so that inserting
+ * a state never moves previously stored chunks; removed chunks are recycled.
+ */
+class StateStore {
+public:
+    using StateId = uint32_t;
+
+    static constexpr StateId INVALID_STATE = 0xFFFFFFFFu;
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
+
+    /**
+     * Memory usage report
+     */
+    struct Stats {
+        size_t state_count = 0;       // Live states
+        size_t chunk_count = 0;       // Distinct chunks stored
+        size_t chunk_refs = 0;        // Chunk references held by live states
+        uint64_t logical_bytes = 0;   // Sum of the serialized state sizes
+        uint64_t stored_bytes = 0;    // Bytes of chunk payload allocated (slabs)
+        uint64_t overhead_bytes = 0;  // Index, chunk metadata and reference lists
+
+        /** Total memory held by the store */
+        uint64_t GetTotalBytes() const { return stored_bytes + overhead_bytes; }
+
+        /** Logical bytes per byte of memory used (1.0 = no savings) */
+        double GetDedupRatio() const {
+            uint64_t total = GetTotalBytes();
+            return total ? static_cast<double>(logical_bytes) / total : 0.0;
+        }
+    };
+
+    /**
+     * @param chunk_size Chunk granularity in bytes (must be non-zero)
+     */
+    explicit StateStore(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    StateStore(const StateStore&) = delete;
+    StateStore& operator=(const StateStore&) = delete;
+
+    /**
+     * Store a raw serialized state
+     * @return Id of the stored state, or INVALID_STATE if size is 0
+     */
+    StateId Insert(const uint8_t* data, size_t size);
+
+    /** Store the contents of a snapshot */
+    StateId Insert(const Snapshot& snapshot);
+
+    /** Capture the emulator's current state and store it */
+    StateId Insert(const Emulator& emu);
+
+    /**
+     * Reassemble a stored state into a snapshot
+     * @return false if the id is unknown
+     */
+    bool Restore(StateId id, Snapshot& snapshot) const;
+
+    /** Restore a stored state into the emulator */
+    bool Restore(StateId id, Emulator& emu);
+
+    /** Reassemble a stored state into a new buffer (empty if unknown) */
+    std::vector<uint8_t> Get(StateId id) const;
+
+    /**
+     * Drop a state, releasing chunks no other state references
+     * @return false if the id is unknown
+     */
+    bool Remove(StateId id);
+
+    /** Check if an id refers to a live state */
+    bool Contains(StateId id) const;
+
+    /** Size of a stored state in bytes (0 if unknown) */
+    size_t GetStateSize(StateId id) const;
+
+    /** Number of live states */
+    size_t GetStateCount() const { return state_count_; }
+
+    /** Chunk granularity in bytes */
+    size_t GetChunkSize() const { return chunk_size_; }
+
+    /** Report memory usage */
+    Stats GetStats() const;
+
+    /** Drop all states and free all memory */
+    void Clear();
+
+private:
+    static constexpr uint32_t NO_CHUNK = 0xFFFFFFFFu;
+    static constexpr size_t CHUNKS_PER_SLAB = 256;
+
+    struct Chunk {
+        uint64_t hash;
+        uint32_t size;      // Payload size (the tail chunk of a state may be short)
+        uint32_t refs;      // 0 = on the free list
+        uint32_t next;      // Next chunk with the same hash, or free list link
+    };
+
+    struct State {
+        std::vector<uint32_t> chunks;
+        uint32_t size = 0;
+        bool live = false;
+    };
+
+    uint8_t* ChunkData(uint32_t index) {
+        return slabs_[index / CHUNKS_PER_SLAB].get() + (index % CHUNKS_PER_SLAB) * chunk_size_;
+    }
+    const uint8_t* ChunkData(uint32_t index) const {
+        return slabs_[index / CHUNKS_PER_SLAB].get() + (index % CHUNKS_PER_SLAB) * chunk_size_;
+    }
+
+    uint32_t InternChunk(const uint8_t* data, uint32_t size);
+    uint32_t AllocateChunk();
+    void ReleaseChunk(uint32_t index);
+    void Assemble(const State& state, uint8_t* out) const;
+
+    size_t chunk_size_;
+
+    std::vector<std::unique_ptr<uint8_t[]>> slabs_;
+    std::vector<Chunk> chunks_;
+    std::unordered_map<uint64_t, uint32_t> index_;  // hash -> first chunk in chain
+    uint32_t free_chunks_ = NO_CHUNK;
+    size_t live_chunks_ = 0;
+
+    std::vector<State> states_;
+    std::vector<StateId> free_states_;
+    size_t state_count_ = 0;
+    size_t chunk_refs_ = 0;
+    uint64_t logical_bytes_ = 0;
+
+    Snapshot scratch_;  // Reused for Emulator captures and restores
+};
+
+} // namespace GX
+
+#endif // GXTEST_STATE_STORE_H
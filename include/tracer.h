@@ -0,0 +1,267 @@
+/**
+ * tracer.h - Compact binary 68k instruction trace recorder
+ *
+ * Records every executed 68k instruction (PC, cycle count, opcode and
+ * optionally the registers) into a delta-encoded binary stream. Records are
+ * varints relative to the previous instruction, so a typical instruction takes
+ * 4-5 bytes before compression. The stream is cut into chunks that each start
+ * with a keyframe (the absolute decoder state), and full chunks are compressed
+ * with zlib on a background thread. Only a bounded number of uncompressed
+ * chunks is ever queued, and a trace written to a file keeps nothing but the
+ * chunk index in memory.
+ *
+ * Usage:
+ *   GX::Tracer tracer;
+ *   tracer.Start("trace.gxt");        // Or Start() to keep the trace in memory
+ *   emu.RunFrames(600);
+ *   tracer.Stop();
+ *
+ *   GX::TraceReader reader;
+ *   reader.Open("trace.gxt");         // Or reader.Open(tracer)
+ *   reader.SeekFrame(500);
+ *   GX::TraceEvent event;
+ *   while (reader.Next(event) && event.frame == 500) {
+ *       printf("%06X %04X\n", event.pc, event.opcode);
+ *   }
+ */
+
+#ifndef GXTEST_TRACER_H
+#define GXTEST_TRACER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GX {
+
+/**
+ * Trace recording options
+ */
+struct TraceOptions {
+    bool record_registers = false;          // Also record D0-D7/A0-A7/SR (as deltas)
+    size_t chunk_size = 256 * 1024;         // Uncompressed bytes per chunk (keyframe interval)
+    size_t max_pending_chunks = 8;          // Chunks queued for compression before recording waits
+    int compression_level = 1;              // zlib level (1 = fastest, 9 = smallest)
+};
+
+/**
+ * One traced instruction, as returned by TraceReader
+ */
+struct TraceEvent {
+    uint64_t index = 0;     // Instruction number since Start()
+    uint64_t cycle = 0;     // Master cycles since Start() when the instruction began
+    uint32_t frame = 0;     // Frames completed since Start()
+    uint32_t pc = 0;
+    uint16_t opcode = 0;
+    bool has_registers = false;
+    uint32_t d[8] = {};     // Registers before the instruction (if recorded)
+    uint32_t a[8] = {};
+    uint16_t sr = 0;
+};
+
+/**
+ * Index entry of one compressed chunk
+ */
+struct TraceChunk {
+    uint64_t first_instruction = 0;
+    uint32_t instruction_count = 0;
+    uint32_t first_frame = 0;       // Frame of the chunk's keyframe
+    uint32_t frame_count = 0;       // Frame ends recorded in the chunk
+    uint32_t raw_size = 0;
+    uint32_t compressed_size = 0;
+    uint64_t file_offset = 0;       // Compressed data offset (file traces)
+    std::shared_ptr<const std::vector<uint8_t>> data;  // Compressed data (memory traces)
+};
+
+/**
+ * 68k instruction trace recorder
+ *
+ * Traces the instructions executed between Start() and Stop(). Cycle counts
+ * are master cycles (7 per 68k clock) and keep increasing across frames.
+ */
+class Tracer {
+public:
+    Tracer();
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /**
+     * Start tracing into memory (discards any previous trace)
+     * @return false if no hook slot is available
+     */
+    bool Start(const TraceOptions& options = TraceOptions());
+
+    /**
+     * Start tracing into a file (discards any previous trace)
+     * @return false if the file cannot be created or no hook slot is available
+     */
+    bool Start(const std::string& path, const TraceOptions& options = TraceOptions());
+
+    /**
+     * Stop tracing, compress the last chunk and wait for the background thread
+     * @return false if writing the trace file failed
+     */
+    bool Stop();
+
+    /** Check if tracing is active */
+    bool IsRunning() const { return running_; }
+
+    /** Whether registers are recorded */
+    bool HasRegisters() const { return record_registers_; }
+
+    /** Instructions recorded */
+    uint64_t GetInstructionCount() const { return instructions_; }
+
+    /** Frames completed while tracing */
+    uint32_t GetFrameCount() const { return frame_; }
+
+    /** Uncompressed stream size in bytes (complete once stopped) */
+    uint64_t GetRawBytes() const;
+
+    /** Compressed size in bytes (complete once stopped) */
+    uint64_t GetCompressedBytes() const;
+
+    /** Chunk index (complete once stopped) */
+    std::vector<TraceChunk> GetChunks() const;
+
+    /** Called by the hook before each 68k instruction */
+    void OnExecute(uint32_t pc);
+
+    /** Called by the hook when a frame ends, before the cycle counters rewind */
+    void OnFrameEnd(uint32_t frame_cycles);
+
+private:
+    struct PendingChunk {
+        TraceChunk info;
+        std::vector<uint8_t> data;
+    };
+
+    bool StartTrace(const TraceOptions& options);
+    void BeginChunk();
+    void SubmitChunk();
+    void WorkerLoop();
+    void ReadRegisters(uint32_t* regs) const;
+
+    // Recording state (emulation thread)
+    bool running_ = false;
+    bool record_registers_ = false;
+    int hook_id_ = -1;
+    int compression_level_ = 1;
+    size_t chunk_size_ = 0;
+    size_t chunk_limit_ = 0;        // Start a new chunk once the buffer passes this
+    size_t max_pending_ = 0;
+    std::vector<uint8_t> buffer_;
+    size_t pos_ = 0;
+    TraceChunk chunk_;
+    uint64_t instructions_ = 0;
+    uint64_t total_cycles_ = 0;
+    int64_t last_cycles_ = 0;
+    uint32_t last_pc_ = 0;
+    uint32_t frame_ = 0;
+    uint32_t regs_[17] = {};
+
+    // Compression thread and results
+    std::thread worker_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable space_cv_;
+    std::deque<PendingChunk> queue_;
+    std::vector<std::vector<uint8_t>> free_buffers_;
+    bool stopping_ = false;
+    std::vector<TraceChunk> chunks_;
+    uint64_t raw_bytes_ = 0;
+    uint64_t compressed_bytes_ = 0;
+    FILE* file_ = nullptr;
+    bool write_error_ = false;
+};
+
+/**
+ * Reads traces recorded by a Tracer, from memory or from a file
+ *
+ * Chunks are decompressed one at a time as the reader advances.
+ */
+class TraceReader {
+public:
+    TraceReader();
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    /**
+     * Open a trace file written by Tracer::Start(path)
+     * @return false if the file is missing or not a trace
+     */
+    bool Open(const std::string& path);
+
+    /**
+     * Open the in-memory trace of a stopped tracer (the reader keeps its own
+     * reference to the data, so the tracer may be restarted afterwards)
+     * @return false if the tracer is running or traced into a file
+     */
+    bool Open(const Tracer& tracer);
+
+    /** Release the trace */
+    void Close();
+
+    /** Whether events carry registers */
+    bool HasRegisters() const { return has_registers_; }
+
+    /** Instructions in the trace */
+    uint64_t GetInstructionCount() const;
+
+    /** Frames completed in the trace */
+    uint32_t GetFrameCount() const;
+
+    /** Number of compressed chunks */
+    size_t GetChunkCount() const { return chunks_.size(); }
+
+    /** Go back to the first instruction */
+    void Rewind();
+
+    /**
+     * Position the reader on the first instruction of a frame
+     * (frames count from 0 at Tracer::Start)
+     * @return false if the frame is past the end of the trace
+     */
+    bool SeekFrame(uint32_t frame);
+
+    /**
+     * Read the next instruction
+     * @return false at the end of the trace or on corrupt data
+     */
+    bool Next(TraceEvent& event);
+
+private:
+    bool LoadChunk(size_t index);
+    bool ReadVarint(uint64_t& value);
+
+    std::vector<TraceChunk> chunks_;
+    FILE* file_ = nullptr;
+    bool has_registers_ = false;
+
+    // Decoder state
+    size_t chunk_index_ = 0;
+    bool chunk_loaded_ = false;
+    std::vector<uint8_t> raw_;
+    std::vector<uint8_t> compressed_;
+    size_t pos_ = 0;
+    uint64_t index_ = 0;
+    uint64_t cycle_ = 0;
+    uint32_t pc_ = 0;
+    uint32_t frame_ = 0;
+    uint32_t regs_[17] = {};
+    uint32_t skip_until_frame_ = 0;
+};
+
+} // namespace GX
+
+#endif // GXTEST_TRACER_H
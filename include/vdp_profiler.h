@@ -0,0 +1,160 @@
+/**
+ * vdp_profiler.h - Per-frame VDP workload counters
+ *
+ * Counts, for every frame, the DMA transfers and bytes by kind, the 68k
+ * cycles lost waiting on the VDP (full FIFO or DMA from the 68k bus), the
+ * VRAM / CRAM / VSRAM bytes written by the CPU and by DMA, and the sprites
+ * and sprite pixels found on each display line. A game that fits its CPU
+ * budget can still drop frames when VBlank is too short for its DMA.
+ *
+ * Usage:
+ *   GX::VdpProfiler vdp;
+ *   vdp.Start();
+ *   emu.RunFrames(600);
+ *   vdp.Stop();
+ *   vdp.PrintReport(std::cout);
+ *
+ *   EXPECT_DMA_WITHIN_BUDGET(vdp, 7000, 60, 600);  // profiler_assertions.h
+ *   EXPECT_NO_SPRITE_OVERFLOW(vdp, 60, 600);
+ *
+ * Frames end with active display, like the Profiler's frame loads: each
+ * frame starts with the VBlank before it.
+ */
+
+#ifndef GXTEST_VDP_PROFILER_H
+#define GXTEST_VDP_PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace GX {
+
+/**
+ * DMA transfer kinds
+ */
+enum class VdpDmaKind {
+    Ext68k,     // From ROM or other 68k bus memory outside work RAM
+    Ram68k,     // From 68k work RAM
+    Fill,       // VRAM / CRAM / VSRAM fill
+    Copy,       // VRAM to VRAM copy
+};
+
+constexpr size_t VDP_DMA_KIND_COUNT = 4;
+
+/** Short display name ("68k ext", "68k ram", "fill", "copy") */
+const char* VdpDmaKindName(VdpDmaKind kind);
+
+/**
+ * VDP memories written through the data port
+ */
+enum class VdpTarget {
+    Vram,
+    Cram,
+    Vsram,
+};
+
+constexpr size_t VDP_TARGET_COUNT = 3;
+
+/** Display name ("VRAM", "CRAM", "VSRAM") */
+const char* VdpTargetName(VdpTarget target);
+
+/**
+ * VDP workload of one frame
+ */
+struct VdpFrameStats {
+    uint64_t frame = 0;                                 // Frames completed since Start() or Reset()
+    uint32_t dma_transfers[VDP_DMA_KIND_COUNT] = {};    // DMA operations started, by kind
+    uint64_t dma_bytes[VDP_DMA_KIND_COUNT] = {};        // Bytes transferred, by kind
+    uint64_t dma_active_bytes = 0;                      // Bytes transferred during active display
+    uint64_t fifo_stall_cycles = 0;                     // 68k master cycles waiting on a full FIFO
+    uint64_t dma_stall_cycles = 0;                      // 68k master cycles halted by DMA from the 68k bus
+    uint64_t cpu_write_bytes[VDP_TARGET_COUNT] = {};    // Bytes written through the data port
+    uint64_t dma_write_bytes[VDP_TARGET_COUNT] = {};    // Bytes written by DMA
+    uint32_t max_sprites = 0;                           // Most sprites on a line
+    uint32_t max_sprite_pixels = 0;                     // Most sprite pixels on a line
+    uint32_t sprite_overflow_lines = 0;                 // Lines with more sprites than the limit (16 H32, 20 H40)
+    uint32_t pixel_overflow_lines = 0;                  // Lines with more sprite pixels than the limit (256 H32, 320 H40)
+    std::vector<uint8_t> sprites_per_line;              // By display line
+    std::vector<uint16_t> sprite_pixels_per_line;       // By display line
+
+    /** DMA bytes of all kinds */
+    uint64_t DmaBytes() const;
+
+    /** 68k master cycles lost to the VDP */
+    uint64_t StallCycles() const { return fifo_stall_cycles + dma_stall_cycles; }
+};
+
+/**
+ * VDP workload profiler
+ *
+ * Collects VdpFrameStats from the core's VDP hook events between Start() and
+ * Stop(). Sprites are only counted in Mode 5. The harness runs the core with
+ * the sprite limit off, so every sprite on a line is counted and checked
+ * against the hardware limits; with the limit on, the core stops parsing at
+ * one sprite past the limit.
+ */
+class VdpProfiler {
+public:
+    VdpProfiler();
+    ~VdpProfiler();
+
+    VdpProfiler(const VdpProfiler&) = delete;
+    VdpProfiler& operator=(const VdpProfiler&) = delete;
+
+    /**
+     * Start collecting (frames already collected are kept)
+     * @return false if already running or no hook slot is available
+     */
+    bool Start();
+
+    /** Stop collecting; a partial frame is kept until the next Start() */
+    void Stop();
+
+    /** Check if collecting */
+    bool IsRunning() const { return running_; }
+
+    /** Discard all frames */
+    void Reset();
+
+    /** Completed frames, oldest first */
+    const std::vector<VdpFrameStats>& GetFrames() const { return frames_; }
+
+    /**
+     * Sum of the frames in [first, last) (clamped to the frames collected).
+     * Maximums are the peaks over those frames; the per-line vectors are
+     * left empty.
+     */
+    VdpFrameStats GetTotals(uint64_t first = 0, uint64_t last = UINT64_MAX) const;
+
+    /** Print averages and peaks per frame */
+    void PrintReport(std::ostream& out) const;
+
+    /** Called by the hook for each DMA timeslice */
+    void OnDma(uint32_t mode, uint32_t target, uint32_t length);
+
+    /** Called by the hook when the VDP halts the 68k */
+    void OnStall(uint32_t reason, uint32_t cycles);
+
+    /** Called by the hook for each VRAM / CRAM / VSRAM write */
+    void OnWrite(VdpTarget target, uint32_t width);
+
+    /** Called by the hook once the sprites of a display line are parsed */
+    void OnSpriteLine(uint32_t line, uint32_t sprites, uint32_t pixels);
+
+    /** Called by the hook at the end of active display */
+    void OnFrameEnd();
+
+private:
+    bool running_ = false;
+    int hook_id_ = -1;
+    std::vector<VdpFrameStats> frames_;
+    VdpFrameStats current_;
+    bool dma_in_progress_ = false;
+    uint32_t pending_dma_words_ = 0;   // 68k bus DMA words still to arrive as writes
+};
+
+} // namespace GX
+
+#endif // GXTEST_VDP_PROFILER_H
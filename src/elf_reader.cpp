@@ -0,0 +1,549 @@
+/**
+ * elf_reader.cpp - In-process ELF symbol and DWARF line table reader
+ *
+ * Only what the profiler needs is decoded: section headers, the symbol table
+ * and the line number programs of .debug_line. Every read is bounds-checked
+ * against the image, so truncated or corrupt files load partially at worst.
+ */
+
+#include "elf_reader.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace GX {
+
+namespace {
+
+// ELF constants
+constexpr size_t ELF_HEADER_SIZE = 52;
+constexpr size_t SECTION_HEADER_SIZE = 40;
+constexpr size_t SYMBOL_SIZE = 16;
+constexpr uint32_t SHT_SYMTAB = 2;
+constexpr uint32_t SHT_NOBITS = 8;
+constexpr uint32_t SHF_EXECINSTR = 4;
+constexpr uint16_t SHN_UNDEF = 0;
+constexpr uint16_t SHN_LORESERVE = 0xFF00;
+constexpr uint16_t SHN_ABS = 0xFFF1;
+constexpr uint8_t STT_NOTYPE = 0;
+constexpr uint8_t STT_FUNC = 2;
+constexpr uint8_t STT_SECTION = 3;
+constexpr uint8_t STT_FILE = 4;
+constexpr uint8_t STB_LOCAL = 0;
+
+// DWARF line program opcodes
+enum : uint8_t {
+    DW_LNS_copy = 1,
+    DW_LNS_advance_pc = 2,
+    DW_LNS_advance_line = 3,
+    DW_LNS_set_file = 4,
+    DW_LNS_const_add_pc = 8,
+    DW_LNS_fixed_advance_pc = 9,
+};
+enum : uint8_t {
+    DW_LNE_end_sequence = 1,
+    DW_LNE_set_address = 2,
+    DW_LNE_define_file = 3,
+};
+
+// DWARF 5 entry formats
+enum : uint64_t {
+    DW_LNCT_path = 1,
+    DW_LNCT_directory_index = 2,
+};
+enum : uint64_t {
+    DW_FORM_block2 = 0x03,
+    DW_FORM_block4 = 0x04,
+    DW_FORM_data2 = 0x05,
+    DW_FORM_data4 = 0x06,
+    DW_FORM_data8 = 0x07,
+    DW_FORM_string = 0x08,
+    DW_FORM_block = 0x09,
+    DW_FORM_block1 = 0x0A,
+    DW_FORM_data1 = 0x0B,
+    DW_FORM_strp = 0x0E,
+    DW_FORM_udata = 0x0F,
+    DW_FORM_data16 = 0x1E,
+    DW_FORM_line_strp = 0x1F,
+};
+
+uint16_t Get16(const uint8_t* p, bool big_endian) {
+    return static_cast<uint16_t>(big_endian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0]);
+}
+
+uint32_t Get32(const uint8_t* p, bool big_endian) {
+    return big_endian ? (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]
+                      : (static_cast<uint32_t>(p[3]) << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+// Bounds-checked reader; reads past the end return 0 and clear Ok()
+class Cursor {
+public:
+    Cursor(const uint8_t* data, size_t size, bool big_endian)
+        : p_(data), end_(data + size), big_endian_(big_endian) {}
+
+    bool Ok() const { return ok_; }
+    size_t Remaining() const { return static_cast<size_t>(end_ - p_); }
+    const uint8_t* Pos() const { return p_; }
+
+    bool Skip(uint64_t n) {
+        if (n > Remaining()) {
+            ok_ = false;
+            p_ = end_;
+            return false;
+        }
+        p_ += n;
+        return true;
+    }
+
+    uint64_t Fixed(int bytes) {
+        if (!Skip(bytes)) return 0;
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value = (value << 8) | (big_endian_ ? p_[i - bytes] : p_[-1 - i]);
+        }
+        return value;
+    }
+
+    uint8_t U8() { return static_cast<uint8_t>(Fixed(1)); }
+    uint16_t U16() { return static_cast<uint16_t>(Fixed(2)); }
+    uint32_t U32() { return static_cast<uint32_t>(Fixed(4)); }
+
+    uint64_t Uleb() {
+        uint64_t value = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t b = U8();
+            if (shift < 64) value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80) || !ok_) return value;
+        }
+    }
+
+    int64_t Sleb() {
+        int64_t value = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            b = U8();
+            if (shift < 64) value |= static_cast<int64_t>(b & 0x7F) << shift;
+            shift += 7;
+        } while ((b & 0x80) && ok_);
+        if (shift < 64 && (b & 0x40)) {
+            value |= -(static_cast<int64_t>(1) << shift);
+        }
+        return value;
+    }
+
+    // NUL-terminated string
+    std::string String() {
+        const uint8_t* start = p_;
+        while (p_ < end_ && *p_) p_++;
+        if (p_ == end_) {
+            ok_ = false;
+            return std::string();
+        }
+        return std::string(reinterpret_cast<const char*>(start), p_++ - start);
+    }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool big_endian_;
+    bool ok_ = true;
+};
+
+// String at an offset of a string section
+std::string SectionString(const uint8_t* data, uint32_t size, uint64_t offset) {
+    if (offset >= size) return std::string();
+    const char* start = reinterpret_cast<const char*>(data + offset);
+    const void* nul = memchr(start, 0, size - offset);
+    return nul ? std::string(start, static_cast<const char*>(nul) - start) : std::string();
+}
+
+} // namespace
+
+bool ElfReader::Load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        Clear();
+        return false;
+    }
+    std::streamsize size = file.tellg();
+    std::vector<uint8_t> data(size > 0 ? static_cast<size_t>(size) : 0);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+        Clear();
+        return false;
+    }
+    return Load(data.data(), data.size());
+}
+
+bool ElfReader::Load(const uint8_t* data, size_t size) {
+    Clear();
+
+    // 32-bit (class 1), big-endian (data 2) or little-endian (data 1)
+    if (!data || size < ELF_HEADER_SIZE || memcmp(data, "\x7F" "ELF", 4) != 0 ||
+        data[4] != 1 || (data[5] != 1 && data[5] != 2)) {
+        return false;
+    }
+    big_endian_ = data[5] == 2;
+    uint32_t shoff = Get32(data + 0x20, big_endian_);
+    uint16_t shentsize = Get16(data + 0x2E, big_endian_);
+    uint16_t shnum = Get16(data + 0x30, big_endian_);
+    uint16_t shstrndx = Get16(data + 0x32, big_endian_);
+    if (shentsize < SECTION_HEADER_SIZE || shoff > size ||
+        static_cast<uint64_t>(shnum) * shentsize > size - shoff) {
+        return false;
+    }
+
+    data_ = data;
+    std::vector<Section> sections(shnum);
+    for (uint16_t i = 0; i < shnum; i++) {
+        const uint8_t* p = data + shoff + static_cast<size_t>(i) * shentsize;
+        Section& s = sections[i];
+        s.type = Get32(p + 4, big_endian_);
+        s.flags = Get32(p + 8, big_endian_);
+        s.addr = Get32(p + 12, big_endian_);
+        s.offset = Get32(p + 16, big_endian_);
+        s.size = Get32(p + 20, big_endian_);
+        s.link = Get32(p + 24, big_endian_);
+        s.name_offset = Get32(p, big_endian_);
+        if (s.type == SHT_NOBITS || s.offset > size || s.size > size - s.offset) {
+            s.offset = 0;   // No data in the file
+            s.size = s.type == SHT_NOBITS ? s.size : 0;
+        }
+    }
+    if (shstrndx < shnum && sections[shstrndx].type != SHT_NOBITS) {
+        const Section& names = sections[shstrndx];
+        for (Section& s : sections) {
+            s.name = SectionString(data + names.offset, names.size, s.name_offset);
+        }
+    }
+
+    const Section* debug_line = nullptr;
+    const Section* line_str = nullptr;
+    const Section* str = nullptr;
+    for (size_t i = 0; i < sections.size(); i++) {
+        const Section& s = sections[i];
+        if (s.type == SHT_SYMTAB) {
+            ParseSymbols(sections, i);
+        } else if (s.type != SHT_NOBITS && s.name == ".debug_line") {
+            debug_line = &s;
+        } else if (s.type != SHT_NOBITS && s.name == ".debug_line_str") {
+            line_str = &s;
+        } else if (s.type != SHT_NOBITS && s.name == ".debug_str") {
+            str = &s;
+        }
+    }
+    if (debug_line) {
+        ParseLines(*debug_line, line_str, str);
+    }
+
+    data_ = nullptr;
+    return true;
+}
+
+void ElfReader::Clear() {
+    symbols_.clear();
+    files_.clear();
+    lines_.clear();
+}
+
+bool ElfReader::ParseSymbols(const std::vector<Section>& sections, size_t index) {
+    const Section& symtab = sections[index];
+    if (symtab.link >= sections.size()) return false;
+    const Section& strtab = sections[symtab.link];
+    const uint8_t* strings = data_ + strtab.offset;
+    uint32_t strings_size = strtab.type == SHT_NOBITS ? 0 : strtab.size;
+
+    // Symbols with the section they are defined in, for sizing code symbols
+    std::vector<std::pair<ElfSymbol, uint16_t>> found;
+    size_t count = symtab.size / SYMBOL_SIZE;
+    found.reserve(count);
+    for (size_t i = 1; i < count; i++) {
+        const uint8_t* p = data_ + symtab.offset + i * SYMBOL_SIZE;
+        uint8_t type = p[12] & 0xF;
+        uint8_t bind = p[12] >> 4;
+        uint16_t shndx = Get16(p + 14, big_endian_);
+        if (shndx == SHN_UNDEF || (shndx >= SHN_LORESERVE && shndx != SHN_ABS) ||
+            type == STT_SECTION || type == STT_FILE) {
+            continue;
+        }
+        ElfSymbol sym;
+        sym.name = SectionString(strings, strings_size, Get32(p, big_endian_));
+        if (sym.name.empty() || sym.name.compare(0, 2, ".L") == 0) {
+            continue;   // Unnamed or assembler-local label
+        }
+        sym.addr = Get32(p + 4, big_endian_);
+        sym.size = Get32(p + 8, big_endian_);
+        sym.code = shndx < sections.size() && (sections[shndx].flags & SHF_EXECINSTR) &&
+                   (type == STT_FUNC || type == STT_NOTYPE);
+        sym.function = type == STT_FUNC;
+        sym.global = bind != STB_LOCAL;
+        found.emplace_back(std::move(sym), shndx);
+    }
+
+    std::stable_sort(found.begin(), found.end(),
+        [](const std::pair<ElfSymbol, uint16_t>& a, const std::pair<ElfSymbol, uint16_t>& b) {
+            return a.first.addr < b.first.addr;
+        });
+
+    // Unsized code symbols run to the next code symbol of their section
+    for (size_t i = 0; i < found.size(); i++) {
+        ElfSymbol& sym = found[i].first;
+        if (!sym.code || sym.size != 0) continue;
+        const Section& section = sections[found[i].second];
+        uint32_t end = section.addr + section.size;
+        for (size_t j = i + 1; j < found.size(); j++) {
+            if (found[j].first.code && found[j].second == found[i].second &&
+                found[j].first.addr > sym.addr) {
+                end = std::min(end, found[j].first.addr);
+                break;
+            }
+        }
+        sym.size = end > sym.addr ? end - sym.addr : 0;
+    }
+
+    symbols_.reserve(symbols_.size() + found.size());
+    for (auto& entry : found) {
+        symbols_.push_back(std::move(entry.first));
+    }
+    return true;
+}
+
+void ElfReader::ParseLines(const Section& debug_line, const Section* line_str, const Section* str) {
+    struct Row {
+        uint32_t addr;
+        uint32_t file;
+        uint32_t line;
+        bool end;
+    };
+    std::vector<Row> rows;
+    std::unordered_map<std::string, uint32_t> file_ids;
+    uint32_t unknown_file = UINT32_MAX;
+
+    auto file_id = [this, &file_ids](const std::string& path) {
+        auto it = file_ids.find(path);
+        if (it != file_ids.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(files_.size());
+        files_.push_back(path);
+        file_ids.emplace(path, id);
+        return id;
+    };
+    auto section_string = [this](const Section* s, uint64_t offset) {
+        return s ? SectionString(data_ + s->offset, s->size, offset) : std::string();
+    };
+
+    Cursor all(data_ + debug_line.offset, debug_line.size, big_endian_);
+    while (all.Remaining() > 0) {
+        // Unit header
+        uint64_t length = all.U32();
+        bool dwarf64 = length == 0xFFFFFFFF;
+        if (dwarf64) length = all.Fixed(8);
+        if (!all.Ok() || length > all.Remaining()) break;
+        Cursor unit(all.Pos(), static_cast<size_t>(length), big_endian_);
+        all.Skip(length);
+
+        uint16_t version = unit.U16();
+        if (version < 2 || version > 5) continue;
+        uint8_t address_size = 4;
+        if (version >= 5) {
+            address_size = unit.U8();
+            unit.U8();  // Segment selector size
+        }
+        uint64_t header_length = unit.Fixed(dwarf64 ? 8 : 4);
+        if (!unit.Ok() || header_length > unit.Remaining()) continue;
+        Cursor program(unit.Pos() + header_length, unit.Remaining() - static_cast<size_t>(header_length),
+                       big_endian_);
+
+        uint8_t min_inst_length = unit.U8();
+        if (version >= 4) unit.U8();  // Maximum operations per instruction
+        unit.U8();                    // Default is_stmt
+        int8_t line_base = static_cast<int8_t>(unit.U8());
+        uint8_t line_range = unit.U8();
+        uint8_t opcode_base = unit.U8();
+        std::vector<uint8_t> opcode_lengths;
+        for (int i = 1; i < opcode_base; i++) {
+            opcode_lengths.push_back(unit.U8());
+        }
+        if (!unit.Ok() || line_range == 0) continue;
+
+        // Directories and files; directory 0 is the compilation directory,
+        // left out of file names
+        std::vector<std::string> dirs;
+        std::vector<uint32_t> unit_files;
+        auto add_file = [&](const std::string& name, uint64_t dir) {
+            std::string path = name;
+            if (dir > 0 && dir < dirs.size() && !dirs[dir].empty() && name[0] != '/') {
+                path = dirs[dir] + "/" + name;
+            }
+            unit_files.push_back(file_id(path));
+        };
+        if (version >= 5) {
+            // Entry formats: (content type, form) pairs, then the entries
+            bool ok = true;
+            auto read_entries = [&](bool is_file) {
+                std::vector<std::pair<uint64_t, uint64_t>> formats(unit.U8());
+                for (auto& format : formats) {
+                    format.first = unit.Uleb();
+                    format.second = unit.Uleb();
+                }
+                uint64_t count = unit.Uleb();
+                for (uint64_t i = 0; i < count && ok && unit.Ok(); i++) {
+                    std::string path;
+                    uint64_t dir = 0;
+                    for (const auto& format : formats) {
+                        std::string text;
+                        uint64_t value = 0;
+                        switch (format.second) {
+                            case DW_FORM_string:    text = unit.String(); break;
+                            case DW_FORM_line_strp: text = section_string(line_str, unit.Fixed(dwarf64 ? 8 : 4)); break;
+                            case DW_FORM_strp:      text = section_string(str, unit.Fixed(dwarf64 ? 8 : 4)); break;
+                            case DW_FORM_data1:     value = unit.Fixed(1); break;
+                            case DW_FORM_data2:     value = unit.Fixed(2); break;
+                            case DW_FORM_data4:     value = unit.Fixed(4); break;
+                            case DW_FORM_data8:     value = unit.Fixed(8); break;
+                            case DW_FORM_udata:     value = unit.Uleb(); break;
+                            case DW_FORM_data16:    unit.Skip(16); break;
+                            case DW_FORM_block:     unit.Skip(unit.Uleb()); break;
+                            case DW_FORM_block1:    unit.Skip(unit.Fixed(1)); break;
+                            case DW_FORM_block2:    unit.Skip(unit.Fixed(2)); break;
+                            case DW_FORM_block4:    unit.Skip(unit.Fixed(4)); break;
+                            default:                ok = false; break;   // Needs .debug_str_offsets
+                        }
+                        if (format.first == DW_LNCT_path) path = text;
+                        if (format.first == DW_LNCT_directory_index) dir = value;
+                    }
+                    if (is_file) {
+                        add_file(path, dir);
+                    } else {
+                        dirs.push_back(path);
+                    }
+                }
+            };
+            read_entries(false);
+            read_entries(true);
+            if (!ok || !unit.Ok()) continue;
+        } else {
+            dirs.push_back(std::string());
+            for (std::string dir = unit.String(); !dir.empty() && unit.Ok(); dir = unit.String()) {
+                dirs.push_back(dir);
+            }
+            for (std::string name = unit.String(); !name.empty() && unit.Ok(); name = unit.String()) {
+                uint64_t dir = unit.Uleb();
+                unit.Uleb();  // Modification time
+                unit.Uleb();  // Length
+                add_file(name, dir);
+            }
+            if (!unit.Ok()) continue;
+        }
+        // File register numbering starts at 1 before DWARF 5
+        uint32_t file_base = version >= 5 ? 0 : 1;
+
+        // Line number program
+        uint32_t address = 0;
+        uint32_t file = 1;
+        int64_t line = 1;
+        auto emit = [&](bool end) {
+            uint32_t index = file - file_base;
+            uint32_t id;
+            if (index < unit_files.size()) {
+                id = unit_files[index];
+            } else {
+                if (unknown_file == UINT32_MAX) unknown_file = file_id("??");
+                id = unknown_file;
+            }
+            rows.push_back({address, id, static_cast<uint32_t>(line > 0 ? line : 0), end});
+        };
+        auto reset = [&]() {
+            address = 0;
+            file = 1;
+            line = 1;
+        };
+        while (program.Remaining() > 0 && program.Ok()) {
+            uint8_t opcode = program.U8();
+            if (opcode >= opcode_base) {
+                uint8_t adjusted = opcode - opcode_base;
+                address += (adjusted / line_range) * min_inst_length;
+                line += line_base + adjusted % line_range;
+                emit(false);
+                continue;
+            }
+            switch (opcode) {
+                case 0: {
+                    uint64_t size = program.Uleb();
+                    if (size == 0 || size > program.Remaining()) {
+                        program.Skip(size);
+                        break;
+                    }
+                    const uint8_t* next = program.Pos() + size;
+                    uint8_t sub = program.U8();
+                    if (sub == DW_LNE_end_sequence) {
+                        emit(true);
+                        reset();
+                    } else if (sub == DW_LNE_set_address) {
+                        address = static_cast<uint32_t>(program.Fixed(std::min<int>(address_size, 8)));
+                    } else if (sub == DW_LNE_define_file) {
+                        std::string name = program.String();
+                        add_file(name, program.Uleb());
+                    }
+                    program.Skip(next - program.Pos());
+                    break;
+                }
+                case DW_LNS_copy:
+                    emit(false);
+                    break;
+                case DW_LNS_advance_pc:
+                    address += static_cast<uint32_t>(program.Uleb() * min_inst_length);
+                    break;
+                case DW_LNS_advance_line:
+                    line += program.Sleb();
+                    break;
+                case DW_LNS_set_file:
+                    file = static_cast<uint32_t>(program.Uleb());
+                    break;
+                case DW_LNS_const_add_pc:
+                    address += ((255 - opcode_base) / line_range) * min_inst_length;
+                    break;
+                case DW_LNS_fixed_advance_pc:
+                    address += program.U16();
+                    break;
+                default:
+                    // Other standard opcodes only change registers we ignore
+                    for (uint8_t i = 0; i < opcode_lengths[opcode - 1]; i++) {
+                        program.Uleb();
+                    }
+                    break;
+            }
+        }
+    }
+
+    // One row per address: sequence ends sort first, so a sequence starting
+    // where another ended wins, and rows repeating a line are merged
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.addr != b.addr ? a.addr < b.addr : a.end > b.end;
+    });
+    lines_.reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (i + 1 < rows.size() && rows[i + 1].addr == rows[i].addr) continue;
+        SourceLine entry;
+        entry.addr = rows[i].addr;
+        entry.file = rows[i].file;
+        entry.line = rows[i].end ? 0 : rows[i].line;
+        if (!lines_.empty() && lines_.back().file == entry.file && lines_.back().line == entry.line) {
+            continue;
+        }
+        lines_.push_back(entry);
+    }
+}
+
+const SourceLine* ElfReader::FindLine(uint32_t addr) const {
+    auto it = std::upper_bound(lines_.begin(), lines_.end(), addr,
+        [](uint32_t a, const SourceLine& row) {
+            return a < row.addr;
+        });
+    if (it == lines_.begin() || (--it)->line == 0) return nullptr;
+    return &*it;
+}
+
+} // namespace GX
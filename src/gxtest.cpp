@@ -5,9 +5,40 @@
 #include "gxtest.h"
 #include "osd.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
+#include <random>
 #include <stdexcept>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GXTEST_HAVE_MMAP 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+// Vendored xxHash (shipped with zstd) for ROM content hashing
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+// Vendored zlib and minizip for .gz / .zip ROM images
+#include "zlib.h"
+#include "unzip.h"
 
 // Genesis Plus GX core headers (C linkage)
 extern "C" {
@@ -38,8 +69,13 @@ char MS_BIOS_JP[256] = "";
 
 namespace GX {
 
-// Frame buffer for headless rendering (required even if not displayed)
-static uint16_t frame_buffer[720 * 576];
+// Frame buffer for headless rendering (required even if not displayed).
+// Sized for the largest picture the core draws with the settings below
+// (H40 x V30, no overscan borders, no NTSC filter): render_reset() clears
+// the whole bitmap on every load, so any slack is touched memory.
+static const int FRAME_WIDTH = 320;
+static const int FRAME_HEIGHT = 240;
+static uint16_t frame_buffer[FRAME_WIDTH * FRAME_HEIGHT];
 
 /**
  * Initialize default configuration for headless operation
@@ -108,9 +144,9 @@ static void InitDefaultConfig() {
  */
 static void InitBitmap() {
     memset(&bitmap, 0, sizeof(bitmap));
-    bitmap.width = 720;
-    bitmap.height = 576;
-    bitmap.pitch = 720 * 2;  // 16-bit color
+    bitmap.width = FRAME_WIDTH;
+    bitmap.height = FRAME_HEIGHT;
+    bitmap.pitch = FRAME_WIDTH * 2;  // 16-bit color
     bitmap.data = reinterpret_cast<uint8*>(frame_buffer);
     bitmap.viewport.x = 0;
     bitmap.viewport.y = 0;
@@ -118,6 +154,385 @@ static void InitBitmap() {
     bitmap.viewport.h = 224;
 }
 
+// ---------------------------------------------------------------------------
+// ROM image loading
+// ---------------------------------------------------------------------------
+
+// Bytes at the start of cart.rom that may be non-zero. cart.rom is a global
+// zero-initialized buffer, so only this prefix needs clearing on the next
+// load instead of the whole MAXROMSIZE array (which would also fault in every
+// page of it).
+static size_t rom_dirty_size = 0;
+
+// Content hash of the decoded image currently in cart.rom (0 if unknown)
+static uint64_t resident_rom_hash = 0;
+
+/**
+ * Copy a big-endian ROM image into cart.rom, swapping each 16-bit word on
+ * little-endian hosts (the core's memory map expects byteswapped ROM words).
+ * An odd trailing byte is treated as the high byte of a zero-padded word.
+ * dst may equal src (in-place swap of an image already in cart.rom).
+ * Returns the number of bytes written.
+ */
+static size_t CopyRomImage(uint8_t* dst, const uint8_t* src, size_t size) {
+#ifdef LSB_FIRST
+    size_t i = 0;
+    size_t even = size & ~static_cast<size_t>(1);
+
+#if defined(__AVX2__)
+    for (; i + 32 <= even; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    for (; i + 16 <= even; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= even; i += 16) {
+        vst1q_u8(dst + i, vrev16q_u8(vld1q_u8(src + i)));
+    }
+#endif
+    for (; i < even; i += 2) {
+        uint8_t hi = src[i];
+        dst[i] = src[i + 1];
+        dst[i + 1] = hi;
+    }
+
+    if (size & 1) {
+        dst[size] = src[size - 1];
+        dst[size - 1] = 0;
+        return size + 1;
+    }
+    return size;
+#else
+    if (dst != src) memcpy(dst, src, size);
+    return size;
+#endif
+}
+
+/**
+ * Extent of cart.rom the core may have written since the last load: the ROM
+ * padding up to the mirroring size, every 64KB bank currently mapped from
+ * cart.rom (bank-switched and RAM-backed carts), and the areas some mappers
+ * keep after the ROM (Realtec boot ROM copies, SVP IRAM/DRAM).
+ */
+static size_t RomWrittenExtent(size_t loaded_size) {
+    size_t extent = std::max(loaded_size, static_cast<size_t>(cart.mask) + 1);
+
+    for (int i = 0; i < 256; i++) {
+        const uint8_t* base = m68k.memory_map[i].base;
+        if (base >= cart.rom && base < cart.rom + sizeof(cart.rom)) {
+            extent = std::max(extent, static_cast<size_t>(base - cart.rom) + 0x10000);
+        }
+    }
+    if (cart.hw.realtec) {
+        extent = std::max(extent, static_cast<size_t>(0x400000 + 8 * 0x2000));
+    }
+    if (svp) {
+        extent = std::max(extent, static_cast<size_t>(0x200000 + sizeof(svp_t)));
+    }
+
+    return std::min(extent, sizeof(cart.rom));
+}
+
+/**
+ * Account for everything the current ROM may have written to cart.rom before
+ * a new image starts overwriting it
+ */
+static void MarkRomDirty() {
+    if (rom_dirty_size > 0) {
+        rom_dirty_size = std::max(rom_dirty_size, RomWrittenExtent(cart.romsize));
+    }
+}
+
+/**
+ * Zero cart.rom[from, to)
+ *
+ * cart.rom is zero-initialized anonymous memory, so on Linux whole pages are
+ * handed back to the kernel (they read back as zeros) instead of being
+ * written: a small ROM loaded after a large one does not keep the large
+ * one's footprint.
+ */
+static void ClearRom(size_t from, size_t to) {
+    if (from >= to) return;
+#if defined(__linux__)
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(cart.rom + from);
+    uintptr_t end = reinterpret_cast<uintptr_t>(cart.rom + to);
+    uintptr_t first = (start + page - 1) & ~(page - 1);
+    uintptr_t last = end & ~(page - 1);
+    if (first < last && madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) == 0) {
+        memset(cart.rom + from, 0, first - start);
+        memset(reinterpret_cast<void*>(last), 0, end - last);
+        return;
+    }
+#endif
+    memset(cart.rom + from, 0, to - from);
+}
+
+// ---------------------------------------------------------------------------
+// Compressed and interleaved ROM images
+// ---------------------------------------------------------------------------
+
+// .gz and .zip images are inflated straight into cart.rom, and .smd images
+// (512-byte header, then 16KB blocks holding odd bytes in the first half and
+// even bytes in the second) are de-interleaved block by block as they are
+// read. Either way cart.rom ends up holding the plain big-endian image,
+// which LoadRomData() then byteswaps in place.
+
+enum class RomContainer { Raw, Gzip, Zip };
+
+static const size_t SMD_HEADER_SIZE = 512;
+static const size_t SMD_BLOCK_SIZE = 0x4000;
+
+static RomContainer DetectRomContainer(const uint8_t* head, size_t size) {
+    if (size >= 2 && head[0] == 0x1F && head[1] == 0x8B) {
+        return RomContainer::Gzip;
+    }
+    if (size >= 4 && memcmp(head, "PK\x03\x04", 4) == 0) {
+        return RomContainer::Zip;
+    }
+    return RomContainer::Raw;
+}
+
+static bool EndsWithNoCase(const std::string& str, const char* suffix) {
+    size_t n = strlen(suffix);
+    if (str.size() < n) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (tolower(static_cast<unsigned char>(str[str.size() - n + i])) != suffix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check for an .smd copier header: no "SEGA" signature where a plain image
+ * has it, and either an .smd file name or the copier's 0xAA 0xBB marker
+ */
+static bool IsSmdImage(const uint8_t* head, size_t size, const std::string& name) {
+    if (size < SMD_HEADER_SIZE || memcmp(head + 0x100, "SEGA", 4) == 0) {
+        return false;
+    }
+    return EndsWithNoCase(name, ".smd") || EndsWithNoCase(name, ".smd.gz") ||
+           (head[8] == 0xAA && head[9] == 0xBB);
+}
+
+/**
+ * Reads up to len bytes of a decompressed image, returning the byte count
+ * (0 at the end) or a negative value on error
+ */
+using RomReader = std::function<long(uint8_t* dst, size_t len)>;
+
+static long ReadFully(const RomReader& read, uint8_t* dst, size_t len) {
+    size_t total = 0;
+    while (total < len) {
+        long n = read(dst + total, len - total);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        total += static_cast<size_t>(n);
+    }
+    return static_cast<long>(total);
+}
+
+/**
+ * Stream a (possibly .smd interleaved) image into cart.rom. Returns the
+ * big-endian image size, or 0 on error or if the image does not fit.
+ */
+static size_t StreamRomImage(const RomReader& read, const std::string& name) {
+    const size_t max_size = static_cast<size_t>(MAXROMSIZE);
+    MarkRomDirty();
+    resident_rom_hash = 0;
+
+    // The first 512 bytes decide between a plain and an .smd image
+    long head = ReadFully(read, cart.rom, SMD_HEADER_SIZE);
+    if (head <= 0) return 0;
+    size_t size = static_cast<size_t>(head);
+    bool ok = true;
+
+    if (IsSmdImage(cart.rom, size, name)) {
+        // Drop the header, then de-interleave each block into place
+        uint8_t block[SMD_BLOCK_SIZE];
+        size = 0;
+        for (;;) {
+            long n = ReadFully(read, block, SMD_BLOCK_SIZE);
+            if (n <= 0) {
+                ok = (n == 0);
+                break;
+            }
+            if (size + SMD_BLOCK_SIZE > max_size) {
+                ok = false;
+                break;
+            }
+            memset(block + n, 0, SMD_BLOCK_SIZE - n);
+            uint8_t* dst = cart.rom + size;
+            for (size_t i = 0; i < SMD_BLOCK_SIZE / 2; i++) {
+                dst[i * 2 + 0] = block[SMD_BLOCK_SIZE / 2 + i];
+                dst[i * 2 + 1] = block[i];
+            }
+            size += SMD_BLOCK_SIZE;
+        }
+    } else {
+        for (;;) {
+            if (size == max_size) {
+                // cart.rom is full: any further byte means the image is oversized
+                uint8_t probe;
+                ok = (read(&probe, 1) == 0);
+                break;
+            }
+            long n = read(cart.rom + size, std::min<size_t>(max_size - size, 1 << 20));
+            if (n <= 0) {
+                ok = (n == 0);
+                break;
+            }
+            size += static_cast<size_t>(n);
+        }
+    }
+
+    if (!ok) {
+        // Whatever was written still has to be cleared by the next load
+        rom_dirty_size = std::max(rom_dirty_size, std::min(size + SMD_BLOCK_SIZE, sizeof(cart.rom)));
+        fprintf(stderr, "ROM image %s is corrupt or larger than %d bytes\n", name.c_str(), MAXROMSIZE);
+        return 0;
+    }
+    return size;
+}
+
+static size_t StreamGzipRom(const std::string& path) {
+    gzFile gz = gzopen(path.c_str(), "rb");
+    if (!gz) return 0;
+    gzbuffer(gz, 128 * 1024);
+
+    // gzread() inflates large requests directly into the destination
+    size_t size = StreamRomImage([gz](uint8_t* dst, size_t len) -> long {
+        return gzread(gz, dst, static_cast<unsigned>(len));
+    }, path);
+
+    // A truncated stream reads short without failing gzread()
+    int err = Z_OK;
+    gzerror(gz, &err);
+    if (err != Z_OK && size > 0) {
+        fprintf(stderr, "ROM image %s is truncated\n", path.c_str());
+        rom_dirty_size = std::max(rom_dirty_size, size);
+        size = 0;
+    }
+
+    gzclose(gz);
+    return size;
+}
+
+static size_t StreamZipRom(const std::string& path) {
+    unzFile zip = unzOpen64(path.c_str());
+    if (!zip) return 0;
+
+    // Use the first file in the archive
+    char name[512];
+    unz_file_info64 info;
+    int err = unzGoToFirstFile(zip);
+    while (err == UNZ_OK) {
+        err = unzGetCurrentFileInfo64(zip, &info, name, sizeof(name), nullptr, 0, nullptr, 0);
+        size_t len = strlen(name);
+        if (err != UNZ_OK || (len > 0 && name[len - 1] != '/')) break;
+        err = unzGoToNextFile(zip);
+    }
+
+    size_t size = 0;
+    if (err == UNZ_OK && info.uncompressed_size <= MAXROMSIZE + SMD_HEADER_SIZE &&
+        unzOpenCurrentFile(zip) == UNZ_OK) {
+        size = StreamRomImage([zip](uint8_t* dst, size_t len) -> long {
+            return unzReadCurrentFile(zip, dst, static_cast<unsigned>(len));
+        }, name);
+
+        // Reports a CRC mismatch once the whole entry has been read
+        if (unzCloseCurrentFile(zip) != UNZ_OK && size > 0) {
+            fprintf(stderr, "ROM image %s: CRC mismatch\n", name);
+            rom_dirty_size = std::max(rom_dirty_size, size);
+            size = 0;
+        }
+    }
+
+    unzClose(zip);
+    return size;
+}
+
+/**
+ * Process-wide cache of decoded ROM images
+ *
+ * Holds the byteswapped image and parsed header of recently loaded ROMs,
+ * keyed by content hash, so reloading a ROM (typically once per test) is a
+ * single bulk copy instead of byteswap + header parse + full checksum pass.
+ * cart.rom is a fixed array inside the core's cartridge struct, so it cannot
+ * point into the cache; the copy is the floor.
+ */
+struct RomCacheEntry {
+    std::unique_ptr<uint8_t[]> image;
+    size_t image_size = 0;
+    size_t source_size = 0;
+    ROMINFO info;
+    uint64_t last_use = 0;
+};
+
+struct RomCache {
+    std::unordered_map<uint64_t, RomCacheEntry> entries;
+    size_t bytes = 0;
+    size_t limit = 256 * 1024 * 1024;
+    uint64_t clock = 0;
+    RomCacheStats stats;
+};
+
+static RomCache& GetRomCache() {
+    static RomCache cache;
+    return cache;
+}
+
+static const RomCacheEntry* FindCachedRom(uint64_t hash, size_t source_size) {
+    RomCache& cache = GetRomCache();
+    auto it = cache.entries.find(hash);
+    if (it == cache.entries.end() || it->second.source_size != source_size) {
+        cache.stats.misses++;
+        return nullptr;
+    }
+    cache.stats.hits++;
+    it->second.last_use = ++cache.clock;
+    return &it->second;
+}
+
+static void StoreCachedRom(uint64_t hash, size_t source_size, const uint8_t* image,
+                           size_t image_size, const ROMINFO& info) {
+    RomCache& cache = GetRomCache();
+    if (image_size > cache.limit) return;
+
+    auto existing = cache.entries.find(hash);
+    if (existing != cache.entries.end()) {
+        cache.bytes -= existing->second.image_size;
+        cache.entries.erase(existing);
+    }
+
+    // Evict least recently used images until the new one fits
+    while (!cache.entries.empty() && cache.bytes + image_size > cache.limit) {
+        auto oldest = cache.entries.begin();
+        for (auto it = cache.entries.begin(); it != cache.entries.end(); ++it) {
+            if (it->second.last_use < oldest->second.last_use) oldest = it;
+        }
+        cache.bytes -= oldest->second.image_size;
+        cache.entries.erase(oldest);
+    }
+
+    RomCacheEntry& entry = cache.entries[hash];
+    entry.image.reset(new uint8_t[image_size]);
+    memcpy(entry.image.get(), image, image_size);
+    entry.image_size = image_size;
+    entry.source_size = source_size;
+    entry.info = info;
+    entry.last_use = ++cache.clock;
+    cache.bytes += image_size;
+}
+
 // ---------------------------------------------------------------------------
 // Emulator::Impl - Private implementation
 // ---------------------------------------------------------------------------
@@ -126,8 +541,8 @@ class Emulator::Impl {
 public:
     bool rom_loaded = false;
     uint64_t frame_count = 0;
+    uint64_t rom_hash = 0;
     Input inputs[2];
-    std::vector<uint8_t> rom_data;
 
     Impl() {
         InitDefaultConfig();
@@ -146,9 +561,6 @@ public:
             return false;
         }
 
-        // Store ROM data
-        rom_data.assign(data, data + size);
-
         // Initialize audio (required by core even in headless mode)
         // Note: audio_init returns 0 on success, negative on failure
         if (audio_init(48000, 60.0) < 0) {
@@ -156,28 +568,46 @@ public:
             return false;
         }
 
-        // Copy to cart ROM buffer
-        memset(cart.rom, 0, sizeof(cart.rom));
-        memcpy(cart.rom, rom_data.data(), rom_data.size());
-
-        // Set ROM size
-        cart.romsize = static_cast<int>(size);
+        MarkRomDirty();
+        rom_hash = XXH64(data, size, 0);
 
         // Set system hardware to Mega Drive (Genesis)
         system_hw = SYSTEM_MD;
 
-        // Byteswap ROM for little-endian systems
-        // This is required because Genesis Plus GX's memory map assumes byteswapped ROM
-#ifdef LSB_FIRST
-        for (size_t i = 0; i < size; i += 2) {
-            uint8_t temp = cart.rom[i];
-            cart.rom[i] = cart.rom[i + 1];
-            cart.rom[i + 1] = temp;
+        // Copy the image into cart.rom: straight from the decoded ROM cache if
+        // this ROM was loaded before, otherwise byteswap-copy it (on
+        // little-endian hosts) in a single pass and parse its header
+        size_t written;
+        const RomCacheEntry* cached = FindCachedRom(rom_hash, size);
+        if (cached) {
+            written = cached->image_size;
+
+            // Reloading the resident image writes nothing, so forked workers
+            // reloading their parent's ROM keep sharing its pages (the
+            // compare also catches mappers that wrote to ROM memory)
+            bool resident = resident_rom_hash == rom_hash &&
+                            static_cast<size_t>(cart.romsize) == written &&
+                            memcmp(cart.rom, cached->image.get(), written) == 0;
+            if (!resident) {
+                memcpy(cart.rom, cached->image.get(), written);
+            }
+        } else {
+            written = CopyRomImage(cart.rom, data, size);
         }
-#endif
 
-        // Extract ROM header info
-        getrominfo(reinterpret_cast<char*>(cart.rom));
+        // Clear what the previous ROM left past the new image
+        ClearRom(written, rom_dirty_size);
+
+        // Set ROM size (an odd image occupies its zero-padded last word)
+        cart.romsize = static_cast<int>(written);
+
+        // Extract ROM header info (includes a checksum over the whole ROM)
+        if (cached) {
+            rominfo = cached->info;
+        } else {
+            getrominfo(reinterpret_cast<char*>(cart.rom));
+            StoreCachedRom(rom_hash, size, cart.rom, written, rominfo);
+        }
 
         // Set console region from ROM header
         get_region(reinterpret_cast<char*>(cart.rom));
@@ -185,16 +615,53 @@ public:
         // Save detected system type
         romtype = system_hw;
 
+        // Power on with cleared 68k registers: system_reset() only reloads
+        // SP/PC, so D0-D7/A0-A6 would otherwise carry over from the previous
+        // ROM run and make boots depend on what ran before in the process
+        // (z80_init() already clears the Z80 the same way)
+        memset(&m68k, 0, sizeof(m68k));
+
         // Initialize system
         system_init();
         system_reset();
 
+        rom_dirty_size = RomWrittenExtent(written);
+        resident_rom_hash = rom_hash;
         rom_loaded = true;
         frame_count = 0;
 
         return true;
     }
 
+    /**
+     * Load a plain or .smd interleaved image from memory
+     */
+    bool LoadRomImage(const uint8_t* data, size_t size, const std::string& name) {
+        if (IsSmdImage(data, size, name) && size % SMD_BLOCK_SIZE == SMD_HEADER_SIZE) {
+            size_t offset = 0;
+            size_t image_size = StreamRomImage([&](uint8_t* dst, size_t len) -> long {
+                len = std::min(len, size - offset);
+                memcpy(dst, data + offset, len);
+                offset += len;
+                return static_cast<long>(len);
+            }, name);
+            return LoadStreamedRom(image_size);
+        }
+        return LoadRomData(data, size);
+    }
+
+    /**
+     * Finish loading an image that was streamed into cart.rom
+     */
+    bool LoadStreamedRom(size_t size) {
+        if (size == 0) {
+            // cart.rom no longer holds the previous ROM
+            rom_loaded = false;
+            return false;
+        }
+        return LoadRomData(cart.rom, size);
+    }
+
     void RunFrame() {
         if (!rom_loaded) return;
 
@@ -251,6 +718,49 @@ Emulator::~Emulator() {
 }
 
 bool Emulator::LoadRom(const std::string& path) {
+    // Archives are inflated straight into cart.rom
+    uint8_t magic[4] = {};
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+        switch (DetectRomContainer(magic, static_cast<size_t>(file.gcount()))) {
+        case RomContainer::Gzip:
+            return pImpl->LoadStreamedRom(StreamGzipRom(path));
+        case RomContainer::Zip:
+            return pImpl->LoadStreamedRom(StreamZipRom(path));
+        case RomContainer::Raw:
+            break;
+        }
+    }
+
+#ifdef GXTEST_HAVE_MMAP
+    // Map the file and byteswap-copy straight from the page cache
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    bool loaded = pImpl->LoadRomImage(static_cast<const uint8_t*>(map), size, path);
+    munmap(map, size);
+    return loaded;
+#else
     std::ifstream file(path, std::ios::binary | std::ios::ate);
     if (!file) {
         return false;
@@ -264,11 +774,12 @@ bool Emulator::LoadRom(const std::string& path) {
         return false;
     }
 
-    return pImpl->LoadRomData(buffer.data(), buffer.size());
+    return pImpl->LoadRomImage(buffer.data(), buffer.size(), path);
+#endif
 }
 
 bool Emulator::LoadRom(const uint8_t* data, size_t size) {
-    return pImpl->LoadRomData(data, size);
+    return pImpl->LoadRomImage(data, size, "");
 }
 
 void Emulator::Reset() {
@@ -476,13 +987,13 @@ void Emulator::PressButton(int player, const std::string& button) {
 // ---------------------------------------------------------------------------
 
 std::vector<uint8_t> Emulator::SaveState() const {
-    // Get state size
-    int size = state_save(nullptr);
+    // state_save() has no size query mode, so serialize into a buffer of the
+    // core's maximum state size and trim it afterwards
+    std::vector<uint8_t> buffer(STATE_SIZE);
+    int size = state_save(buffer.data());
     if (size <= 0) return {};
 
-    std::vector<uint8_t> buffer(size);
-    state_save(buffer.data());
-
+    buffer.resize(size);
     return buffer;
 }
 
@@ -491,6 +1002,330 @@ bool Emulator::LoadState(const std::vector<uint8_t>& state) {
     return state_load(const_cast<uint8_t*>(state.data())) != 0;
 }
 
+void Snapshot::Reserve(size_t capacity) {
+    if (capacity_ < capacity) {
+        arena_.reset(new uint8_t[capacity]);
+        capacity_ = capacity;
+        size_ = 0;
+    }
+}
+
+void Snapshot::Assign(const uint8_t* data, size_t size) {
+    // Keep room for a full capture so the arena can be reused by SaveSnapshot()
+    Reserve(std::max(size, static_cast<size_t>(STATE_SIZE)));
+    memcpy(arena_.get(), data, size);
+    size_ = size;
+}
+
+bool Emulator::SaveSnapshot(Snapshot& snapshot) const {
+    if (!pImpl->rom_loaded) return false;
+
+    // Allocate the arena once; later captures serialize in place
+    snapshot.Reserve(STATE_SIZE);
+
+    int size = state_save(snapshot.arena_.get());
+    snapshot.size_ = size > 0 ? static_cast<size_t>(size) : 0;
+    return snapshot.size_ > 0;
+}
+
+bool Emulator::RestoreSnapshot(const Snapshot& snapshot) {
+    if (!pImpl->rom_loaded || !snapshot.IsValid()) return false;
+    return state_load_fast(const_cast<uint8_t*>(snapshot.GetData())) != 0;
+}
+
+// ---------------------------------------------------------------------------
+// Boot Snapshot Cache / ROM Cache
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct BootCacheEntry {
+    Snapshot snapshot;
+    uint64_t frame_count = 0;
+};
+
+struct BootCache {
+    std::unordered_map<std::string, BootCacheEntry> entries;
+    std::string dir;
+    bool dir_initialized = false;
+    BootCacheStats stats;
+};
+
+BootCache& GetBootCache() {
+    static BootCache cache;
+    if (!cache.dir_initialized) {
+        const char* env = getenv("GXTEST_BOOT_CACHE_DIR");
+        cache.dir = env ? env : "";
+        cache.dir_initialized = true;
+    }
+    return cache;
+}
+
+// On-disk entry layout (host endianness; entries never leave the build tree):
+//   magic[8] | STATE_VERSION[16] | rom_hash u64 | key_len u32 | key |
+//   frame_count u64 | state_size u32 | state
+const char BOOT_CACHE_MAGIC[8] = {'G', 'X', 'B', 'O', 'O', 'T', '1', '\0'};
+
+// Tracks SetIdleSkipEnabled(); the core keeps no readable copy
+bool idle_skip_enabled = false;
+
+// Harness toggles are part of every cache key, so that a boot captured under
+// one setting is never restored under another
+std::string BootSettingsKey() {
+    std::string key = "idle_skip=";
+    key += idle_skip_enabled ? '1' : '0';
+    key += ",svp_idle_skip=";
+    key += ssp1601_idle_skip ? '1' : '0';
+    return key;
+}
+
+std::string BootCachePath(const std::string& dir, uint64_t rom_hash, const std::string& key) {
+    // Hash one std::string rather than streaming the STATE_VERSION literal:
+    // GCC inlines xxhash's streaming path and misreports -Warray-bounds on it
+    std::string id(reinterpret_cast<const char*>(&rom_hash), sizeof(rom_hash));
+    id += key;
+    id += STATE_VERSION;
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.gxboot",
+             static_cast<unsigned long long>(XXH64(id.data(), id.size(), 0)));
+    return dir + "/" + name;
+}
+
+bool ReadBootCacheFile(const std::string& path, uint64_t rom_hash, const std::string& key,
+                       BootCacheEntry& entry) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    char magic[8];
+    char version[16];
+    uint64_t file_rom_hash = 0;
+    uint32_t key_len = 0;
+    if (!file.read(magic, sizeof(magic)) ||
+        !file.read(version, sizeof(version)) ||
+        !file.read(reinterpret_cast<char*>(&file_rom_hash), sizeof(file_rom_hash)) ||
+        !file.read(reinterpret_cast<char*>(&key_len), sizeof(key_len))) {
+        return false;
+    }
+
+    // Reject other formats, core versions and (unlikely) file name collisions
+    if (memcmp(magic, BOOT_CACHE_MAGIC, sizeof(magic)) != 0 ||
+        memcmp(version, STATE_VERSION, sizeof(version)) != 0 ||
+        file_rom_hash != rom_hash || key_len != key.size()) {
+        return false;
+    }
+
+    std::string file_key(key_len, '\0');
+    uint32_t state_size = 0;
+    if (!file.read(&file_key[0], key_len) || file_key != key ||
+        !file.read(reinterpret_cast<char*>(&entry.frame_count), sizeof(entry.frame_count)) ||
+        !file.read(reinterpret_cast<char*>(&state_size), sizeof(state_size)) ||
+        state_size == 0 || state_size > STATE_SIZE) {
+        return false;
+    }
+
+    std::vector<uint8_t> state(state_size);
+    if (!file.read(reinterpret_cast<char*>(state.data()), state_size)) {
+        return false;
+    }
+
+    entry.snapshot.Assign(state.data(), state.size());
+    return true;
+}
+
+void WriteBootCacheFile(const std::string& path, uint64_t rom_hash, const std::string& key,
+                        const BootCacheEntry& entry) {
+    // Write to a unique temporary file and rename it into place, so that test
+    // binaries running in parallel never see a partially written entry
+    std::random_device random;
+    std::string tmp_path = path + ".tmp" + std::to_string(random());
+
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+
+        uint32_t key_len = static_cast<uint32_t>(key.size());
+        uint32_t state_size = static_cast<uint32_t>(entry.snapshot.GetSize());
+        file.write(BOOT_CACHE_MAGIC, sizeof(BOOT_CACHE_MAGIC));
+        file.write(STATE_VERSION, 16);
+        file.write(reinterpret_cast<const char*>(&rom_hash), sizeof(rom_hash));
+        file.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+        file.write(key.data(), key.size());
+        file.write(reinterpret_cast<const char*>(&entry.frame_count), sizeof(entry.frame_count));
+        file.write(reinterpret_cast<const char*>(&state_size), sizeof(state_size));
+        file.write(reinterpret_cast<const char*>(entry.snapshot.GetData()), state_size);
+        if (!file) {
+            file.close();
+            std::remove(tmp_path.c_str());
+            return;
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+    }
+}
+
+} // namespace
+
+BootScript BootScript::Frames(int frames) {
+    BootScript script;
+    script.key = "frames:" + std::to_string(frames);
+    script.run = [frames](Emulator& emu) { emu.RunFrames(frames); };
+    return script;
+}
+
+bool Emulator::Boot(const BootScript& script) {
+    if (!pImpl->rom_loaded) return false;
+
+    BootCache& cache = GetBootCache();
+    char hash_hex[17];
+    snprintf(hash_hex, sizeof(hash_hex), "%016llx",
+             static_cast<unsigned long long>(pImpl->rom_hash));
+    std::string script_key = script.key + "|" + BootSettingsKey();
+    std::string cache_key = std::string(hash_hex) + ":" + script_key;
+
+    auto it = cache.entries.find(cache_key);
+    if (it != cache.entries.end()) {
+        cache.stats.hits++;
+    } else {
+        BootCacheEntry entry;
+        std::string path;
+        if (!cache.dir.empty()) {
+            path = BootCachePath(cache.dir, pImpl->rom_hash, script_key);
+        }
+
+        if (!path.empty() && ReadBootCacheFile(path, pImpl->rom_hash, script_key, entry)) {
+            cache.stats.disk_hits++;
+        } else {
+            // Miss: boot from power-on and capture the result
+            cache.stats.misses++;
+            if (script.run) {
+                script.run(*this);
+            }
+            pImpl->inputs[0].Clear();
+            pImpl->inputs[1].Clear();
+
+            entry.frame_count = pImpl->frame_count;
+            if (!SaveSnapshot(entry.snapshot)) return false;
+            if (!path.empty()) {
+                WriteBootCacheFile(path, pImpl->rom_hash, script_key, entry);
+            }
+
+            // Restore below even though we are already in the post-boot state:
+            // a few internal timing details are not part of the save state, so
+            // this keeps the test that populated the cache on exactly the same
+            // execution path as the tests that hit it
+        }
+
+        it = cache.entries.emplace(cache_key, std::move(entry)).first;
+    }
+
+    if (!RestoreSnapshot(it->second.snapshot)) return false;
+    pImpl->inputs[0].Clear();
+    pImpl->inputs[1].Clear();
+    pImpl->frame_count = it->second.frame_count;
+    return true;
+}
+
+void Emulator::SetRomCacheLimit(size_t bytes) {
+    RomCache& cache = GetRomCache();
+    cache.limit = bytes;
+    if (cache.bytes > bytes) {
+        cache.entries.clear();
+        cache.bytes = 0;
+    }
+}
+
+void Emulator::ClearRomCache() {
+    RomCache& cache = GetRomCache();
+    cache.entries.clear();
+    cache.bytes = 0;
+    cache.stats = RomCacheStats();
+}
+
+RomCacheStats Emulator::GetRomCacheStats() {
+    RomCache& cache = GetRomCache();
+    RomCacheStats stats = cache.stats;
+    stats.entries = cache.entries.size();
+    stats.bytes = cache.bytes;
+    return stats;
+}
+
+void Emulator::SetIdleSkipEnabled(bool enabled) {
+    m68k_set_idle_skip(enabled ? 1 : 0);
+    idle_skip_enabled = enabled;
+}
+
+void Emulator::SetSvpIdleSkipEnabled(bool enabled) {
+    ssp1601_idle_skip = enabled ? 1 : 0;
+}
+
+SvpStats Emulator::GetSvpStats() const {
+    SvpStats stats;
+    if (pImpl->rom_loaded && svp) {
+        stats.cycles = ssp1601_cycles;
+        stats.idle_cycles = ssp1601_idle_cycles;
+    }
+    return stats;
+}
+
+MemoryStats Emulator::GetMemoryStats() {
+    MemoryStats stats;
+    stats.rom_bytes = rom_dirty_size;
+    stats.rom_cache_bytes = GetRomCache().bytes;
+
+#if defined(__linux__)
+    // smaps_rollup (Linux 4.14+) splits shared and private pages; statm only
+    // has totals
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    if (rollup) {
+        std::string line;
+        while (std::getline(rollup, line)) {
+            size_t kb = 0;
+            if (sscanf(line.c_str(), "%*[^:]: %zu kB", &kb) != 1) continue;
+            if (line.compare(0, 4, "Rss:") == 0) {
+                stats.rss = kb * 1024;
+            } else if (line.compare(0, 13, "Shared_Clean:") == 0 ||
+                       line.compare(0, 13, "Shared_Dirty:") == 0) {
+                stats.shared += kb * 1024;
+            } else if (line.compare(0, 14, "Private_Dirty:") == 0) {
+                stats.private_dirty = kb * 1024;
+            }
+        }
+    } else {
+        std::ifstream statm("/proc/self/statm");
+        size_t size_pages = 0, rss_pages = 0, shared_pages = 0;
+        if (statm >> size_pages >> rss_pages >> shared_pages) {
+            size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            stats.rss = rss_pages * page;
+            stats.shared = shared_pages * page;
+        }
+    }
+#endif
+
+    return stats;
+}
+
+void Emulator::SetBootCacheDir(const std::string& dir) {
+    BootCache& cache = GetBootCache();
+    cache.dir = dir;
+}
+
+std::string Emulator::GetBootCacheDir() {
+    return GetBootCache().dir;
+}
+
+void Emulator::ClearBootCache() {
+    BootCache& cache = GetBootCache();
+    cache.entries.clear();
+    cache.stats = BootCacheStats();
+}
+
+BootCacheStats Emulator::GetBootCacheStats() {
+    return GetBootCache().stats;
+}
+
 // ---------------------------------------------------------------------------
 // Info
 // ---------------------------------------------------------------------------
@@ -0,0 +1,367 @@
+/**
+ * profile_diff.cpp - Compare two profiles, e.g. of two ROM builds
+ */
+
+#include "profile_diff.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <sstream>
+
+namespace GX {
+
+namespace {
+
+uint64_t GetLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+bool Fail(std::string* error, const std::string& message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+/** Relative change from base to value, infinite from 0 */
+double Change(uint64_t base, uint64_t value) {
+    if (base == 0) {
+        return value == 0 ? 0.0 : std::numeric_limits<double>::infinity();
+    }
+    return (static_cast<double>(value) - static_cast<double>(base)) / static_cast<double>(base);
+}
+
+/** "+12.50%", "-3.00%" or "new" */
+std::string FormatChange(double change) {
+    if (std::isinf(change)) {
+        return "new";
+    }
+    std::ostringstream out;
+    out << std::showpos << std::fixed << std::setprecision(2) << 100.0 * change << "%";
+    return out.str();
+}
+
+std::string FormatDelta(int64_t delta) {
+    std::ostringstream out;
+    out << std::showpos << delta;
+    return out.str();
+}
+
+/** Function of symbols containing addr, or nullptr */
+const FunctionDef* FindSymbol(const std::vector<FunctionDef>& symbols, uint32_t addr) {
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+        [](uint32_t a, const FunctionDef& func) {
+            return a < func.start_addr;
+        });
+    if (it == symbols.begin()) {
+        return nullptr;
+    }
+    --it;
+    return addr < it->end_addr ? &*it : nullptr;
+}
+
+/** Sum address histogram entries into functions */
+void AddHistogram(const std::vector<std::pair<uint32_t, uint64_t>>& addresses,
+                  const std::vector<FunctionDef>& symbols,
+                  std::map<std::string, ProfileFunction>& functions) {
+    for (const auto& kv : addresses) {
+        const FunctionDef* func = FindSymbol(symbols, kv.first);
+        std::string name;
+        uint32_t addr = kv.first;
+        if (func) {
+            name = func->name;
+            addr = func->start_addr;
+        } else {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "$%06X", kv.first);
+            name = buf;
+        }
+        auto inserted = functions.emplace(name, ProfileFunction());
+        ProfileFunction& entry = inserted.first->second;
+        if (inserted.second) {
+            entry.name = name;
+            entry.addr = addr;
+        }
+        entry.cycles += kv.second;
+    }
+}
+
+bool ParseProfile(const std::vector<uint8_t>& data, ProfileData& profile,
+                  std::map<std::string, ProfileFunction>& functions, std::string* error) {
+    if (data.size() < 36) {
+        return Fail(error, "truncated header");
+    }
+    profile.cpu = static_cast<ProfileCpu>(GetLE(&data[8], 4));
+    profile.sample_rate = static_cast<uint32_t>(GetLE(&data[12], 4));
+    profile.total_cycles = GetLE(&data[16], 8);
+    profile.frames = GetLE(&data[24], 8);
+    uint32_t count = static_cast<uint32_t>(GetLE(&data[32], 4));
+    size_t offset = 36;
+    for (uint32_t i = 0; i < count; i++) {
+        if (data.size() < offset + 34) {
+            return Fail(error, "truncated function table");
+        }
+        const uint8_t* p = &data[offset];
+        size_t name_length = GetLE(p + 32, 2);
+        if (data.size() < offset + 34 + name_length) {
+            return Fail(error, "truncated function name");
+        }
+        std::string name(reinterpret_cast<const char*>(p + 34), name_length);
+        auto inserted = functions.emplace(name, ProfileFunction());
+        ProfileFunction& entry = inserted.first->second;
+        if (inserted.second) {
+            entry.name = name;
+            entry.addr = static_cast<uint32_t>(GetLE(p, 4));
+        }
+        entry.calls += GetLE(p + 8, 8);
+        entry.cycles += GetLE(p + 16, 8);
+        entry.cycles_inclusive += GetLE(p + 24, 8);
+        offset += 34 + name_length;
+    }
+    return true;
+}
+
+bool ParseBinaryHistogram(const std::vector<uint8_t>& data, ProfileData& profile,
+                          const std::vector<FunctionDef>& symbols,
+                          std::map<std::string, ProfileFunction>& functions, std::string* error) {
+    if (data.size() < 32) {
+        return Fail(error, "truncated header");
+    }
+    profile.sample_rate = static_cast<uint32_t>(GetLE(&data[8], 4));
+    profile.cpu = static_cast<ProfileCpu>(GetLE(&data[12], 4));
+    profile.total_cycles = GetLE(&data[16], 8);
+    uint64_t count = GetLE(&data[24], 8);
+    if ((data.size() - 32) / 12 < count) {
+        return Fail(error, "truncated address table");
+    }
+    std::vector<std::pair<uint32_t, uint64_t>> addresses(count);
+    for (uint64_t i = 0; i < count; i++) {
+        const uint8_t* p = &data[32 + 12 * i];
+        addresses[i] = {static_cast<uint32_t>(GetLE(p, 4)), GetLE(p + 4, 8)};
+    }
+    AddHistogram(addresses, symbols, functions);
+    return true;
+}
+
+/** Number following "key": in text, or false */
+bool FindJsonNumber(const std::string& text, const char* key, uint64_t& value) {
+    size_t pos = text.find(std::string("\"") + key + "\"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos = text.find(':', pos);
+    unsigned long long number = 0;
+    if (pos == std::string::npos || sscanf(text.c_str() + pos + 1, "%llu", &number) != 1) {
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+bool ParseJsonHistogram(const std::vector<uint8_t>& data, ProfileData& profile,
+                        const std::vector<FunctionDef>& symbols,
+                        std::map<std::string, ProfileFunction>& functions, std::string* error) {
+    std::string text(data.begin(), data.end());
+    uint64_t sample_rate = 1;
+    uint64_t total_cycles = 0;
+    FindJsonNumber(text, "sample_rate", sample_rate);
+    if (!FindJsonNumber(text, "total_cycles", total_cycles)) {
+        return Fail(error, "no total_cycles");
+    }
+    profile.sample_rate = static_cast<uint32_t>(sample_rate);
+    profile.total_cycles = total_cycles;
+
+    size_t pos = text.find("\"addresses\"");
+    if (pos == std::string::npos || (pos = text.find('{', pos)) == std::string::npos) {
+        return Fail(error, "no addresses");
+    }
+    std::vector<std::pair<uint32_t, uint64_t>> addresses;
+    while (true) {
+        size_t key = text.find_first_of("\"}", pos + 1);
+        if (key == std::string::npos) {
+            return Fail(error, "unterminated addresses");
+        }
+        if (text[key] == '}') {
+            break;
+        }
+        unsigned int addr = 0;
+        unsigned long long cycles = 0;
+        if (sscanf(text.c_str() + key, "\"%x\": %llu", &addr, &cycles) != 2) {
+            return Fail(error, "bad address entry");
+        }
+        addresses.emplace_back(addr, cycles);
+        pos = text.find_first_of(",}", key);
+        if (pos == std::string::npos) {
+            return Fail(error, "unterminated addresses");
+        }
+        if (text[pos] == '}') {
+            break;
+        }
+    }
+    AddHistogram(addresses, symbols, functions);
+    return true;
+}
+
+} // namespace
+
+bool LoadProfile(const std::string& path, ProfileData& profile,
+                 const std::vector<FunctionDef>& symbols, std::string* error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return Fail(error, "cannot open " + path);
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    profile = ProfileData();
+    std::map<std::string, ProfileFunction> functions;
+    bool ok;
+    if (data.size() >= 8 && memcmp(data.data(), "GXPROF01", 8) == 0) {
+        ok = ParseProfile(data, profile, functions, error);
+    } else if (data.size() >= 8 && memcmp(data.data(), "GXHIST01", 8) == 0) {
+        ok = ParseBinaryHistogram(data, profile, symbols, functions, error);
+    } else {
+        size_t start = 0;
+        while (start < data.size() && isspace(data[start])) {
+            start++;
+        }
+        if (start == data.size() || data[start] != '{') {
+            return Fail(error, path + ": not a profile or address histogram");
+        }
+        ok = ParseJsonHistogram(data, profile, symbols, functions, error);
+    }
+    if (!ok) {
+        if (error) {
+            *error = path + ": " + *error;
+        }
+        return false;
+    }
+
+    profile.functions.reserve(functions.size());
+    for (auto& kv : functions) {
+        profile.functions.push_back(std::move(kv.second));
+    }
+    return true;
+}
+
+double FunctionDelta::CycleChange() const {
+    return Change(base_cycles, cycles);
+}
+
+double FunctionDelta::CallChange() const {
+    return Change(base_calls, calls);
+}
+
+double ProfileDiff::TotalChange() const {
+    return Change(base_total_cycles, total_cycles);
+}
+
+ProfileDiff DiffProfiles(const ProfileData& base, const ProfileData& current) {
+    ProfileDiff diff;
+    diff.base_total_cycles = base.total_cycles;
+    diff.total_cycles = current.total_cycles;
+    diff.base_frames = base.frames;
+    diff.frames = current.frames;
+
+    std::map<std::string, FunctionDelta> deltas;
+    for (const ProfileFunction& func : base.functions) {
+        FunctionDelta& delta = deltas[func.name];
+        delta.name = func.name;
+        delta.base_cycles += func.cycles;
+        delta.base_calls += func.calls;
+        delta.removed = true;
+    }
+    for (const ProfileFunction& func : current.functions) {
+        auto inserted = deltas.emplace(func.name, FunctionDelta());
+        FunctionDelta& delta = inserted.first->second;
+        delta.name = func.name;
+        delta.cycles += func.cycles;
+        delta.calls += func.calls;
+        delta.added = inserted.second;
+        delta.removed = false;
+    }
+
+    diff.functions.reserve(deltas.size());
+    for (auto& kv : deltas) {
+        diff.functions.push_back(std::move(kv.second));
+    }
+    std::stable_sort(diff.functions.begin(), diff.functions.end(),
+        [](const FunctionDelta& a, const FunctionDelta& b) {
+            uint64_t impact_a = static_cast<uint64_t>(std::llabs(a.CycleDelta()));
+            uint64_t impact_b = static_cast<uint64_t>(std::llabs(b.CycleDelta()));
+            return impact_a > impact_b;
+        });
+    return diff;
+}
+
+std::vector<std::string> FindRegressions(const ProfileDiff& diff, const RegressionThresholds& thresholds) {
+    std::vector<std::string> regressions;
+    if (diff.TotalDelta() > 0 && diff.TotalChange() > thresholds.total_change) {
+        std::ostringstream message;
+        message << "Total: " << diff.base_total_cycles << " -> " << diff.total_cycles << " cycles ("
+                << FormatDelta(diff.TotalDelta()) << ", " << FormatChange(diff.TotalChange())
+                << ", threshold " << FormatChange(thresholds.total_change) << ")";
+        regressions.push_back(message.str());
+    }
+    for (const FunctionDelta& func : diff.functions) {
+        int64_t delta = func.CycleDelta();
+        if (delta <= 0 || static_cast<uint64_t>(delta) < thresholds.min_cycles ||
+            func.CycleChange() <= thresholds.function_change) {
+            continue;
+        }
+        std::ostringstream message;
+        message << func.name << ": " << func.base_cycles << " -> " << func.cycles << " cycles ("
+                << FormatDelta(delta) << ", " << FormatChange(func.CycleChange())
+                << ", threshold " << FormatChange(thresholds.function_change) << ")";
+        regressions.push_back(message.str());
+    }
+    return regressions;
+}
+
+void PrintDiff(std::ostream& out, const ProfileDiff& diff, size_t max_functions) {
+    out << "\nTotal: " << diff.base_total_cycles << " -> " << diff.total_cycles << " cycles ("
+        << FormatDelta(diff.TotalDelta()) << ", " << FormatChange(diff.TotalChange()) << ")\n";
+    if (diff.base_frames != diff.frames && diff.base_frames > 0 && diff.frames > 0) {
+        out << "Warning: profiles cover " << diff.base_frames << " and " << diff.frames << " frames\n";
+    }
+
+    out << std::setw(30) << std::left << "Function"
+        << std::setw(14) << std::right << "Base"
+        << std::setw(14) << "Current"
+        << std::setw(14) << "Delta"
+        << std::setw(10) << "%"
+        << std::setw(12) << "Calls"
+        << "\n";
+    out << std::string(94, '-') << "\n";
+
+    size_t printed = 0;
+    for (const FunctionDelta& func : diff.functions) {
+        if (func.CycleDelta() == 0 && func.CallDelta() == 0) {
+            continue;
+        }
+        if (max_functions > 0 && printed == max_functions) {
+            break;
+        }
+        out << std::setw(30) << std::left << func.name
+            << std::setw(14) << std::right << func.base_cycles
+            << std::setw(14) << func.cycles
+            << std::setw(14) << FormatDelta(func.CycleDelta())
+            << std::setw(10) << (func.removed ? "removed" : FormatChange(func.CycleChange()))
+            << std::setw(12) << FormatDelta(func.CallDelta())
+            << "\n";
+        printed++;
+    }
+}
+
+} // namespace GX
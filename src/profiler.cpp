@@ -1,9 +1,10 @@
 /**
- * profiler.cpp - 68k CPU cycle profiler implementation
+ * profiler.cpp - 68k / Z80 CPU cycle profiler implementation
  */
 
 #include "profiler.h"
 #include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
@@ -15,18 +16,242 @@ extern "C" {
 #include "cpuhook.h"
 }
 
+// Vendored zlib
+#include "zlib.h"
+
 namespace GX {
 
-// Global profiler for cpu_hook callback
+// Most recently started profiler
 static Profiler* g_active_profiler = nullptr;
 
-// cpu_hook callback - called before each 68k instruction
-static void ProfilerHook(hook_type_t type, int /*width*/, unsigned int address, unsigned int /*value*/) {
-    if (type == HOOK_M68K_E && g_active_profiler) {
-        g_active_profiler->OnExecute(address);
+// Limit call stack depth to prevent unbounded growth from unbalanced calls
+// (e.g., indirect jumps or non-standard control flow)
+static constexpr size_t MAX_CALL_STACK_DEPTH = 256;
+
+// Bytes of 68k stack scanned for return addresses per scanline sample
+static constexpr uint32_t STACK_SCAN_BYTES = 1024;
+
+// Hook subscriber callback for 68k profiling (execute, exception and frame events)
+static void ProfilerHook(void* param, hook_type_t type, int /*width*/,
+                         unsigned int address, unsigned int value) {
+    Profiler* profiler = static_cast<Profiler*>(param);
+    switch (type) {
+        case HOOK_M68K_E:   profiler->OnExecute(address); break;
+        case HOOK_M68K_EXC: profiler->OnException(value); break;
+        case HOOK_FRAME:    profiler->OnFrameEnd(value); break;
+        default: break;
+    }
+}
+
+// Hook subscriber callback for scanline sampling (line and frame events)
+static void ScanlineProfilerHook(void* param, hook_type_t type, int /*width*/,
+                                 unsigned int /*address*/, unsigned int value) {
+    Profiler* profiler = static_cast<Profiler*>(param);
+    switch (type) {
+        case HOOK_LINE:  profiler->OnScanline(); break;
+        case HOOK_FRAME: profiler->OnFrameEnd(value); break;
+        default: break;
+    }
+}
+
+// Hook subscriber callback for controller port reads (timeline input polling)
+static void InputReadHook(void* param, hook_type_t /*type*/, int /*width*/,
+                          unsigned int /*address*/, unsigned int /*value*/) {
+    static_cast<Profiler*>(param)->OnInputRead();
+}
+
+// Hook subscriber callback for memory access profiling (68k execute, read and write events)
+static void MemoryAccessHook(void* param, hook_type_t type, int width,
+                             unsigned int address, unsigned int /*value*/) {
+    Profiler* profiler = static_cast<Profiler*>(param);
+    if (type == HOOK_M68K_E) {
+        profiler->OnAccessInstruction(address);
+    } else {
+        profiler->OnMemoryAccess(address, static_cast<uint32_t>(width), type == HOOK_M68K_W);
+    }
+}
+
+// Hook subscriber callback for Z80 profiling (execute, bus and frame events)
+static void Z80ProfilerHook(void* param, hook_type_t type, int /*width*/,
+                            unsigned int address, unsigned int value) {
+    Profiler* profiler = static_cast<Profiler*>(param);
+    switch (type) {
+        case HOOK_Z80_E:      profiler->OnExecute(address); break;
+        case HOOK_Z80_BUSREQ: profiler->OnBusRequest(value); break;
+        case HOOK_Z80_SYNC:   profiler->OnZ80Sync(value); break;
+        case HOOK_FRAME:      profiler->OnFrameEnd(value); break;
+        default: break;
+    }
+}
+
+// Hook subscriber callback for SVP profiling - called before each SSP1601 instruction
+static void SvpProfilerHook(void* param, hook_type_t /*type*/, int /*width*/,
+                            unsigned int address, unsigned int value) {
+    static_cast<Profiler*>(param)->OnSvpExecute(address, value);
+}
+
+// Quote a string (such as a symbol name) as a JSON string literal
+static std::string JsonString(const std::string& str) {
+    std::string quoted = "\"";
+    for (unsigned char c : str) {
+        switch (c) {
+        case '"':  quoted += "\\\""; break;
+        case '\\': quoted += "\\\\"; break;
+        case '\n': quoted += "\\n"; break;
+        case '\r': quoted += "\\r"; break;
+        case '\t': quoted += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                quoted += escape;
+            } else {
+                quoted += static_cast<char>(c);
+            }
+        }
+    }
+    quoted += '"';
+    return quoted;
+}
+
+std::string ExceptionName(uint32_t vector) {
+    switch (vector) {
+        case 2:              return "Bus error";
+        case 3:              return "Address error";
+        case 4:              return "Illegal instruction";
+        case 5:              return "Zero divide";
+        case 6:              return "CHK";
+        case 7:              return "TRAPV";
+        case 8:              return "Privilege violation";
+        case 9:              return "Trace";
+        case 10:             return "Line 1010";
+        case 11:             return "Line 1111";
+        case VECTOR_EXT_INT: return "EXT-INT";
+        case VECTOR_HINT:    return "H-INT";
+        case VECTOR_VINT:    return "V-INT";
+        default: break;
+    }
+    if (vector >= VECTOR_TRAP0 && vector < VECTOR_TRAP0 + 16) {
+        return "TRAP #" + std::to_string(vector - VECTOR_TRAP0);
+    }
+    if (vector >= 24 && vector < 32) {
+        return "Level " + std::to_string(vector - 24) + " interrupt";
+    }
+    return "Vector " + std::to_string(vector);
+}
+
+MemoryRegion GetMemoryRegion(uint32_t addr) {
+    addr &= 0xFFFFFF;
+    if (addr < 0x400000) return MemoryRegion::Rom;
+    if (addr >= 0xE00000) return MemoryRegion::WorkRam;
+    if (addr >= 0xC00000) {
+        uint32_t port = addr & 0x1F;
+        return port < 4 ? MemoryRegion::VdpData : port < 8 ? MemoryRegion::VdpControl : MemoryRegion::VdpOther;
     }
+    if (addr >= 0xA00000 && addr < 0xA10000) return MemoryRegion::Z80;
+    if (addr >= 0xA10000 && addr < 0xA10020) return MemoryRegion::Io;
+    if (addr >= 0xA11000 && addr < 0xA20000) return MemoryRegion::System;
+    return MemoryRegion::Other;
 }
 
+const char* MemoryRegionName(MemoryRegion region) {
+    switch (region) {
+        case MemoryRegion::Rom:        return "ROM";
+        case MemoryRegion::Z80:        return "Z80";
+        case MemoryRegion::Io:         return "I/O";
+        case MemoryRegion::System:     return "System";
+        case MemoryRegion::VdpData:    return "VDP data";
+        case MemoryRegion::VdpControl: return "VDP control";
+        case MemoryRegion::VdpOther:   return "VDP other";
+        case MemoryRegion::WorkRam:    return "Work RAM";
+        default:                       return "Other";
+    }
+}
+
+uint64_t CallCyclesPercentile(const std::vector<CallSample>& calls, double percentile) {
+    if (calls.empty()) return 0;
+    std::vector<uint64_t> cycles(calls.size());
+    for (size_t i = 0; i < calls.size(); i++) {
+        cycles[i] = calls[i].cycles;
+    }
+    // Nearest rank: the smallest value with at least percentile% of the calls at or below it
+    double rank = std::ceil(percentile / 100.0 * cycles.size());
+    size_t index = rank < 1.0 ? 0 : std::min(static_cast<size_t>(rank) - 1, cycles.size() - 1);
+    std::nth_element(cycles.begin(), cycles.begin() + index, cycles.end());
+    return cycles[index];
+}
+
+CallCycleStats SummarizeCalls(const std::vector<CallSample>& calls) {
+    CallCycleStats stats;
+    if (calls.empty()) return stats;
+    stats.calls = calls.size();
+    stats.min_cycles = calls[0].cycles;
+    for (const CallSample& call : calls) {
+        stats.total_cycles += call.cycles;
+        stats.min_cycles = std::min(stats.min_cycles, call.cycles);
+        if (call.cycles > stats.max_cycles) {
+            stats.max_cycles = call.cycles;
+            stats.max_frame = call.frame;
+        }
+    }
+    stats.p50 = CallCyclesPercentile(calls, 50);
+    stats.p90 = CallCyclesPercentile(calls, 90);
+    stats.p99 = CallCyclesPercentile(calls, 99);
+    return stats;
+}
+
+// Minimal protocol buffer encoder for the pprof export
+class ProtoBuffer {
+public:
+    void Varint(uint64_t value) {
+        while (value >= 0x80) {
+            data_.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        data_.push_back(static_cast<uint8_t>(value));
+    }
+
+    // Integer field (zero is the default and is left out)
+    void Field(uint32_t field, uint64_t value) {
+        if (value == 0) return;
+        Varint(field << 3);
+        Varint(value);
+    }
+
+    void Bytes(uint32_t field, const void* data, size_t size) {
+        Varint((field << 3) | 2);
+        Varint(size);
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        data_.insert(data_.end(), bytes, bytes + size);
+    }
+
+    void String(uint32_t field, const std::string& value) {
+        Bytes(field, value.data(), value.size());
+    }
+
+    void Message(uint32_t field, const ProtoBuffer& message) {
+        Bytes(field, message.data_.data(), message.data_.size());
+    }
+
+    // Fields may come in any order, so messages can be built in parts
+    void Append(const ProtoBuffer& other) {
+        data_.insert(data_.end(), other.data_.begin(), other.data_.end());
+    }
+
+    void Packed(uint32_t field, const std::vector<uint64_t>& values) {
+        ProtoBuffer packed;
+        for (uint64_t value : values) {
+            packed.Varint(value);
+        }
+        Message(field, packed);
+    }
+
+    const std::vector<uint8_t>& Data() const { return data_; }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
 Profiler* GetActiveProfiler() {
     return g_active_profiler;
 }
@@ -56,59 +281,54 @@ void Profiler::AddFunction(uint32_t start_addr, uint32_t end_addr, const std::st
         [](const FunctionDef& a, const FunctionDef& b) {
             return a.start_addr < b.start_addr;
         });
-    functions_.insert(it, func);
 
     // Initialize stats for this function
-    stats_[start_addr] = FunctionStats();
+    stats_.insert(stats_.begin() + (it - functions_.begin()), FunctionStats());
+    if (!memory_access_.empty()) {
+        memory_access_.insert(memory_access_.begin() + (it - functions_.begin()) * MEMORY_REGION_COUNT,
+                              MEMORY_REGION_COUNT, MemoryAccessStats());
+    }
+    functions_.insert(it, func);
+    lookup_dirty_ = true;
 }
 
 int Profiler::LoadSymbolsFromELF(const std::string& elf_path) {
-    // Use nm to extract symbols
-    // Format: "address type name"
-    // Shell-quote the path to prevent command injection
-    std::string quoted_path = "'";
-    for (char c : elf_path) {
-        if (c == '\'') {
-            quoted_path += "'\\''";  // End quote, escaped quote, start quote
-        } else {
-            quoted_path += c;
-        }
-    }
-    quoted_path += "'";
-    std::string cmd = "nm -S --defined-only " + quoted_path + " 2>/dev/null";
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
+    ElfReader elf;
+    if (!elf.Load(elf_path)) {
         return -1;
     }
 
+    // Code symbols (nm type T/t), one per address: symbols sharing an address
+    // are aliases, prefer the one typed as a function, then a global one
+    auto rank = [](const ElfSymbol& s) { return (s.function ? 2 : 0) + (s.global ? 1 : 0); };
+    const std::vector<ElfSymbol>& symbols = elf.GetSymbols();
     int count = 0;
-    char line[512];
-    while (fgets(line, sizeof(line), pipe)) {
-        uint32_t addr, size;
-        char type;
-        char name[256];
-
-        // Parse nm -S output: "hex_address hex_size type name" (both in hex, with size) or "hex_address type name" (without size)
-        if (sscanf(line, "%x %x %c %255s", &addr, &size, &type, name) == 4) {
-            // Has size - use it
-            if (type == 'T' || type == 't') {  // Text (code) symbols only
-                // Guard against overflow
-                uint32_t end_addr = (size <= UINT32_MAX - addr) ? addr + size : UINT32_MAX;
-                AddFunction(addr, end_addr, name);
-                count++;
-            }
-        } else if (sscanf(line, "%x %c %255s", &addr, &type, name) == 3) {
-            // No size - estimate from next symbol (done after loading all)
-            if (type == 'T' || type == 't') {
-                // Guard against overflow (0x100 = 256 byte default)
-                uint32_t end_addr = (addr <= UINT32_MAX - 0x100) ? addr + 0x100 : UINT32_MAX;
-                AddFunction(addr, end_addr, name);
-                count++;
+    for (size_t i = 0; i < symbols.size();) {
+        const ElfSymbol* best = nullptr;
+        size_t j = i;
+        for (; j < symbols.size() && symbols[j].addr == symbols[i].addr; j++) {
+            const ElfSymbol& s = symbols[j];
+            if (s.code && s.size > 0 && (!best || rank(s) > rank(*best))) {
+                best = &s;
             }
         }
+        if (best) {
+            // Guard against overflow
+            uint32_t end_addr = (best->size <= UINT32_MAX - best->addr) ? best->addr + best->size : UINT32_MAX;
+            AddFunction(best->addr, end_addr, best->name);
+            count++;
+        }
+        i = j;
     }
 
-    pclose(pipe);
+    // Sized data objects become work RAM variables, the first one at each address
+    uint32_t last_variable = UINT32_MAX;
+    for (const ElfSymbol& s : symbols) {
+        if (!s.code && s.size > 0 && s.addr != last_variable) {
+            AddVariable(s.addr, s.size, s.name);
+            last_variable = s.addr;
+        }
+    }
 
     // Fix up end addresses based on next function start
     for (size_t i = 0; i + 1 < functions_.size(); i++) {
@@ -116,10 +336,20 @@ int Profiler::LoadSymbolsFromELF(const std::string& elf_path) {
             functions_[i].end_addr = functions_[i + 1].start_addr;
         }
     }
+    lookup_dirty_ = true;
+    elf_ = std::move(elf);
 
     return count;
 }
 
+bool Profiler::LookupLine(uint32_t addr, std::string* file, uint32_t* line) const {
+    const SourceLine* row = elf_.FindLine(addr);
+    if (!row) return false;
+    if (file) *file = elf_.GetFiles()[row->file];
+    if (line) *line = row->line;
+    return true;
+}
+
 int Profiler::LoadSymbolsFromFile(const std::string& path) {
     // Load symbols from a simple text file format:
     //   <hex_address> <decimal_size> <name>
@@ -129,8 +359,8 @@ int Profiler::LoadSymbolsFromFile(const std::string& path) {
     //
     // Parsing note:
     //   - This function parses the address as hex (%x) and the size as decimal (%u).
-    //   - This intentionally differs from LoadSymbolsFromELF (nm output), which uses
-    //     hex for both address and size (%x for each).
+    //   - This intentionally differs from `nm -S` output, which uses hex for
+    //     both address and size.
     std::ifstream file(path);
     if (!file) {
         return -1;
@@ -153,9 +383,89 @@ int Profiler::LoadSymbolsFromFile(const std::string& path) {
     return count;
 }
 
+void Profiler::AddVariable(uint32_t addr, uint32_t size, const std::string& name) {
+    if (addr < 0xFF0000 || addr > 0xFFFFFF || size == 0) {
+        return;  // Not in work RAM
+    }
+    VariableDef var = {addr, std::min<uint32_t>(size, 0x1000000 - addr), name};
+    auto it = std::upper_bound(variables_.begin(), variables_.end(), var,
+        [](const VariableDef& a, const VariableDef& b) {
+            return a.addr < b.addr;
+        });
+    variables_.insert(it, var);
+}
+
+int Profiler::LoadVariablesFromFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return -1;
+    }
+
+    // Work RAM symbols; linker symbols only mark where the previous one ends
+    struct Entry {
+        uint32_t addr;
+        uint32_t size;
+        std::string name;
+        bool marker;
+    };
+    std::vector<Entry> entries;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (fields >> token) {
+            tokens.push_back(token);
+        }
+        if (tokens.size() != 3 && tokens.size() != 4) continue;
+        if (tokens[tokens.size() - 2].size() != 1) continue;  // Symbol type letter
+        char* end = nullptr;
+        uint32_t addr = static_cast<uint32_t>(strtoul(tokens[0].c_str(), &end, 16));
+        if (*end != '\0' || addr < 0xFF0000 || addr > 0xFFFFFF) continue;
+        uint32_t size = 0;
+        if (tokens.size() == 4) {
+            size = static_cast<uint32_t>(strtoul(tokens[1].c_str(), &end, 16));
+            if (*end != '\0') continue;
+        }
+        const std::string& name = tokens.back();
+        bool marker = name.compare(0, 2, "__") == 0 || name == "_end" || name == "_edata" || name == "_etext";
+        entries.push_back({addr, size, name, marker});
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) {
+            return a.addr < b.addr;
+        });
+
+    int count = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& e = entries[i];
+        if (e.marker) continue;
+        uint32_t size = e.size;
+        if (size == 0) {
+            size = 1;
+            for (size_t j = i + 1; j < entries.size(); j++) {
+                if (entries[j].addr > e.addr) {
+                    size = entries[j].addr - e.addr;
+                    break;
+                }
+            }
+        }
+        AddVariable(e.addr, size, e.name);
+        count++;
+    }
+    return count;
+}
+
 void Profiler::ClearSymbols() {
     functions_.clear();
     stats_.clear();
+    call_samples_.clear();
+    variables_.clear();
+    if (!memory_access_.empty()) {
+        memory_access_.assign(MEMORY_REGION_COUNT, MemoryAccessStats());
+    }
+    elf_.Clear();
+    lookup_dirty_ = true;
 }
 
 void Profiler::Start(ProfileMode mode) {
@@ -169,84 +479,425 @@ void Profiler::Start(const ProfileOptions& options) {
     if (running_) return;
 
     mode_ = options.mode;
+    cpu_ = options.cpu;
     sample_rate_ = options.sample_rate > 0 ? options.sample_rate : 1;
+    if (mode_ == ProfileMode::Scanline && cpu_ != ProfileCpu::M68K) {
+        mode_ = ProfileMode::Simple;  // Scanline sampling is 68k only
+    }
+    sample_lines_ = options.sample_lines > 0 ? options.sample_lines : 1;
+    stack_walk_depth_ = options.stack_walk_depth;
+    line_counter_ = 0;
     collect_address_histogram_ = options.collect_address_histogram;
+    collect_timeline_ = options.collect_timeline && cpu_ == ProfileCpu::M68K &&
+                        mode_ != ProfileMode::Scanline;
+    vblank_wait_start_ = options.vblank_wait_start;
+    vblank_wait_end_ = options.vblank_wait_end;
+    collect_memory_access_ = options.collect_memory_access && cpu_ == ProfileCpu::M68K;
+    collect_call_cycles_ = options.collect_call_cycles;
+    if (collect_memory_access_) {
+        memory_access_.resize((functions_.size() + 1) * MEMORY_REGION_COUNT);
+        ram_access_.resize(0x10000);
+        access_pc_ = m68k.pc;
+    }
     sample_counter_ = 0;
     pending_cycles_ = 0;
+    BuildLookup();
+    if (collect_address_histogram_) {
+        SetupHistogram();
+    }
+    if (cpu_ == ProfileCpu::Z80) {
+        hook_id_ = cpu_hook_subscribe(HOOK_Z80_E | HOOK_Z80_BUSREQ | HOOK_Z80_SYNC | HOOK_FRAME,
+                                      0, 0xFFFFFF, Z80ProfilerHook, this);
+    } else if (cpu_ == ProfileCpu::SVP) {
+        hook_id_ = cpu_hook_subscribe(HOOK_SVP_E, 0, 0xFFFF, SvpProfilerHook, this);
+        if (hook_id_ >= 0) {
+            // Skipped iterations raise no execute hooks; their cycles would all
+            // land on the loop head instead of the loop's instructions
+            svp_idle_skip_ = ssp1601_idle_skip;
+            ssp1601_idle_skip = 0;
+        }
+    } else if (mode_ == ProfileMode::Scanline) {
+        // No execute hook: the 68k runs the uninstrumented core
+        hook_id_ = cpu_hook_subscribe(HOOK_LINE | HOOK_FRAME, 0, 0xFFFFFF, ScanlineProfilerHook, this);
+    } else {
+        hook_id_ = cpu_hook_subscribe(HOOK_M68K_E | HOOK_M68K_EXC | HOOK_FRAME,
+                                      0, 0xFFFFFF, ProfilerHook, this);
+    }
+    if (hook_id_ < 0) return;  // All hook slots in use
+    if (collect_timeline_) {
+        // Data ports of both controllers, byte and word reads
+        input_hook_id_ = cpu_hook_subscribe(HOOK_M68K_R, 0xA10002, 0xA10005, InputReadHook, this);
+    }
+    if (collect_memory_access_) {
+        memory_hook_id_ = cpu_hook_subscribe(HOOK_M68K_E | HOOK_M68K_RW, 0, 0xFFFFFF, MemoryAccessHook, this);
+    }
     g_active_profiler = this;
-    set_cpu_hook(ProfilerHook);
     running_ = true;
     last_pc_ = 0;
-    last_cycles_ = m68k.cycles;
+    has_last_pc_ = false;
+    last_cycles_ = CurrentCycles();
+    frame_ = FrameLoad();
     call_stack_.clear();
+    exception_depth_ = 0;
+    vint_depth_ = 0;
+    exception_entered_ = false;
+    timeline_frame_ = FrameProfile();
+    frame_start_cycles_.resize(stats_.size());
+    for (size_t i = 0; i < stats_.size(); i++) {
+        frame_start_cycles_[i] = stats_[i].cycles_exclusive;
+    }
+    // Started mid-wait, the main loop is already there
+    waiting_for_vblank_ = m68k.pc >= vblank_wait_start_ && m68k.pc < vblank_wait_end_;
 }
 
 void Profiler::Stop() {
     if (!running_) return;
 
-    set_cpu_hook(nullptr);
-    g_active_profiler = nullptr;
+    cpu_hook_unsubscribe(hook_id_);
+    hook_id_ = -1;
+    if (cpu_ == ProfileCpu::SVP) {
+        ssp1601_idle_skip = svp_idle_skip_;
+    }
+    if (input_hook_id_ >= 0) {
+        cpu_hook_unsubscribe(input_hook_id_);
+        input_hook_id_ = -1;
+    }
+    if (memory_hook_id_ >= 0) {
+        cpu_hook_unsubscribe(memory_hook_id_);
+        memory_hook_id_ = -1;
+    }
+
+    // Cycles held back by sampling go to the last instruction seen
+    if (pending_cycles_ > 0 && has_last_pc_) {
+        if (lookup_dirty_) BuildLookup();
+        if (collect_address_histogram_) {
+            AddToHistogram(last_pc_, pending_cycles_);
+        }
+        uint32_t func = FunctionIndex(last_pc_);
+        if (func != NO_FUNCTION) {
+            stats_[func].cycles_exclusive += pending_cycles_;
+        }
+        if (mode_ == ProfileMode::CallStack) {
+            call_tree_[CallTreeChild(StackNode(), last_pc_, false)].cycles += pending_cycles_;
+        }
+    }
+    pending_cycles_ = 0;
+    if (g_active_profiler == this) {
+        g_active_profiler = nullptr;
+    }
     running_ = false;
 }
 
 void Profiler::Reset() {
-    for (auto& kv : stats_) {
-        kv.second = FunctionStats();
-    }
-    address_cycles_.clear();
+    std::fill(stats_.begin(), stats_.end(), FunctionStats());
+    std::fill(histogram_.begin(), histogram_.end(), 0);
+    histogram_overflow_.clear();
     call_stack_.clear();
+    exception_depth_ = 0;
+    vint_depth_ = 0;
+    exception_entered_ = false;
+    frame_loads_.clear();
+    interrupt_stats_.clear();
+    timeline_.clear();
+    timeline_frame_ = FrameProfile();
+    frame_start_cycles_.assign(stats_.size(), 0);
+    waiting_for_vblank_ = false;
+    line_counter_ = 0;
+    samples_ = 0;
+    std::fill(memory_access_.begin(), memory_access_.end(), MemoryAccessStats());
+    std::fill(ram_access_.begin(), ram_access_.end(), MemoryAccessStats());
+    call_tree_.assign(1, CallTreeNode());
+    call_tree_index_.clear();
+    call_samples_.clear();
+    interrupt_samples_.clear();
+    frame_ = FrameLoad();
     total_cycles_ = 0;
     pending_cycles_ = 0;
+    bus_stall_cycles_ = 0;
     last_pc_ = 0;
+    has_last_pc_ = false;
     if (running_) {
-        last_cycles_ = m68k.cycles;
+        last_cycles_ = CurrentCycles();
     }
 }
 
 const FunctionStats* Profiler::GetStats(uint32_t func_addr) const {
-    auto it = stats_.find(func_addr);
-    return it != stats_.end() ? &it->second : nullptr;
+    // Last function starting at func_addr (the one addresses resolve to)
+    auto it = std::upper_bound(functions_.begin(), functions_.end(), func_addr,
+        [](uint32_t a, const FunctionDef& f) {
+            return a < f.start_addr;
+        });
+    if (it == functions_.begin() || (--it)->start_addr != func_addr) return nullptr;
+    return &stats_[it - functions_.begin()];
 }
 
-const FunctionDef* Profiler::LookupFunction(uint32_t addr) const {
-    if (functions_.empty()) return nullptr;
-
-    // Binary search for function containing addr
+uint32_t Profiler::FindFunction(uint32_t addr) const {
+    // Same resolution as FunctionIndex(), without the lookup table
     auto it = std::upper_bound(functions_.begin(), functions_.end(), addr,
         [](uint32_t a, const FunctionDef& f) {
             return a < f.start_addr;
         });
+    if (it == functions_.begin() || addr >= (--it)->end_addr) return NO_FUNCTION;
+    return static_cast<uint32_t>(it - functions_.begin());
+}
 
-    if (it == functions_.begin()) return nullptr;
-    --it;
-
-    if (addr >= it->start_addr && addr < it->end_addr) {
-        return &(*it);
+const FunctionDef* Profiler::FindFunctionByName(const std::string& name) const {
+    for (const FunctionDef& func : functions_) {
+        if (func.name == name) return &func;
     }
     return nullptr;
 }
 
-uint16_t Profiler::ReadWord(uint32_t addr) const {
-    // Read from ROM (cart.rom is byteswapped on little-endian)
-    if (addr < 0x400000 && addr + 1 < cart.romsize) {
-#ifdef LSB_FIRST
-        return (cart.rom[addr ^ 1] << 8) | cart.rom[(addr + 1) ^ 1];
-#else
-        return (cart.rom[addr] << 8) | cart.rom[addr + 1];
-#endif
+const std::unordered_map<uint32_t, FunctionStats>& Profiler::GetAllStats() const {
+    stats_view_.clear();
+    for (size_t i = 0; i < functions_.size(); i++) {
+        stats_view_[functions_[i].start_addr] = stats_[i];
+    }
+    return stats_view_;
+}
+
+void Profiler::BuildLookup() {
+    // Address space and code alignment of the profiled CPU: 68k code is
+    // word aligned, Z80 code is byte aligned, SSP1601 addresses are words
+    uint32_t space_bits = cpu_ == ProfileCpu::M68K ? 24 : 16;
+    lookup_shift_ = cpu_ == ProfileCpu::M68K ? 1 : 0;
+    lookup_addr_mask_ = (1u << space_bits) - 1;
+
+    constexpr size_t PAGE_SIZE = size_t(1) << LOOKUP_PAGE_BITS;
+    uint32_t slot_bits = space_bits - lookup_shift_;
+    lookup_dir_.assign(size_t(1) << (slot_bits - LOOKUP_PAGE_BITS), 0);
+    lookup_pages_.assign(PAGE_SIZE, NO_FUNCTION);
+
+    // An address belongs to the function with the highest start at or
+    // below it, if it is before that one's end
+    uint64_t space_end = uint64_t(1) << space_bits;
+    for (size_t i = 0; i < functions_.size(); i++) {
+        uint64_t start = functions_[i].start_addr;
+        uint64_t end = std::min<uint64_t>(functions_[i].end_addr, space_end);
+        if (i + 1 < functions_.size()) {
+            end = std::min<uint64_t>(end, functions_[i + 1].start_addr);
+        }
+        if (start >= end) continue;
+
+        uint64_t last_slot = (end - 1) >> lookup_shift_;
+        for (uint64_t slot = start >> lookup_shift_; slot <= last_slot; slot++) {
+            uint32_t& page = lookup_dir_[slot >> LOOKUP_PAGE_BITS];
+            if (page == 0) {
+                page = static_cast<uint32_t>(lookup_pages_.size() / PAGE_SIZE);
+                lookup_pages_.resize(lookup_pages_.size() + PAGE_SIZE, NO_FUNCTION);
+            }
+            lookup_pages_[page * PAGE_SIZE + (slot & (PAGE_SIZE - 1))] = static_cast<uint32_t>(i);
+        }
+    }
+    lookup_dirty_ = false;
+}
+
+void Profiler::SetupHistogram() {
+    // Dense range: the cartridge area for the 68k (word-aligned code, one
+    // counter per 2 bytes of ROM), the whole 64KB space for Z80 and SSP1601
+    uint32_t limit = 0x10000;
+    uint32_t shift = 0;
+    if (cpu_ == ProfileCpu::M68K) {
+        limit = std::min<uint32_t>((cart.romsize + 1) & ~1u, 0x400000);
+        shift = 1;
+    }
+
+    // Counters laid out for another CPU move to the overflow map
+    if (shift != histogram_shift_) {
+        for (size_t i = 0; i < histogram_.size(); i++) {
+            if (histogram_[i]) {
+                histogram_overflow_[static_cast<uint32_t>(i << histogram_shift_)] += histogram_[i];
+            }
+        }
+        histogram_.clear();
+        histogram_shift_ = shift;
+    }
+
+    // Only ever grows, so counts from earlier runs stay in place
+    if ((limit >> shift) > histogram_.size()) {
+        histogram_.resize(limit >> shift, 0);
+    }
+    histogram_limit_ = static_cast<uint32_t>(histogram_.size() << shift);
+}
+
+std::vector<std::pair<uint32_t, uint64_t>> Profiler::SortedHistogram() const {
+    std::vector<std::pair<uint32_t, uint64_t>> sorted;
+    for (size_t i = 0; i < histogram_.size(); i++) {
+        if (histogram_[i]) {
+            sorted.emplace_back(static_cast<uint32_t>(i << histogram_shift_), histogram_[i]);
+        }
+    }
+    if (histogram_overflow_.empty()) return sorted;
+
+    // Merge the overflow entries (an address may be in both after a CPU switch)
+    sorted.insert(sorted.end(), histogram_overflow_.begin(), histogram_overflow_.end());
+    std::sort(sorted.begin(), sorted.end());
+    size_t out = 0;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (out > 0 && sorted[out - 1].first == sorted[i].first) {
+            sorted[out - 1].second += sorted[i].second;
+        } else {
+            sorted[out++] = sorted[i];
+        }
+    }
+    sorted.resize(out);
+    return sorted;
+}
+
+const std::unordered_map<uint32_t, uint64_t>& Profiler::GetAddressHistogram() const {
+    histogram_view_ = histogram_overflow_;
+    for (size_t i = 0; i < histogram_.size(); i++) {
+        if (histogram_[i]) {
+            histogram_view_[static_cast<uint32_t>(i << histogram_shift_)] += histogram_[i];
+        }
+    }
+    return histogram_view_;
+}
+
+MemoryAccessStats Profiler::GetMemoryAccess(MemoryRegion region) const {
+    MemoryAccessStats total;
+    for (size_t i = static_cast<size_t>(region); i < memory_access_.size(); i += MEMORY_REGION_COUNT) {
+        total.reads += memory_access_[i].reads;
+        total.writes += memory_access_[i].writes;
+        total.read_bytes += memory_access_[i].read_bytes;
+        total.write_bytes += memory_access_[i].write_bytes;
+    }
+    return total;
+}
+
+MemoryAccessStats Profiler::GetMemoryAccess(uint32_t func_addr, MemoryRegion region) const {
+    auto it = std::lower_bound(functions_.begin(), functions_.end(), func_addr,
+        [](const FunctionDef& f, uint32_t addr) {
+            return f.start_addr < addr;
+        });
+    size_t index = (it - functions_.begin()) * MEMORY_REGION_COUNT + static_cast<size_t>(region);
+    if (it == functions_.end() || it->start_addr != func_addr || index >= memory_access_.size()) {
+        return MemoryAccessStats();
+    }
+    return memory_access_[index];
+}
+
+std::vector<VariableAccess> Profiler::GetVariableAccess() const {
+    std::vector<VariableAccess> result;
+    for (const VariableDef& var : variables_) {
+        VariableAccess v;
+        v.name = var.name;
+        v.addr = var.addr;
+        v.size = var.size;
+        if (!ram_access_.empty()) {
+            for (uint32_t addr = var.addr; addr < var.addr + var.size; addr++) {
+                const MemoryAccessStats& byte = ram_access_[addr & 0xFFFF];
+                v.access.reads += byte.reads;
+                v.access.writes += byte.writes;
+                v.access.read_bytes += byte.read_bytes;
+                v.access.write_bytes += byte.write_bytes;
+            }
+        }
+        result.push_back(std::move(v));
+    }
+    std::stable_sort(result.begin(), result.end(), [](const VariableAccess& a, const VariableAccess& b) {
+        return a.access.Accesses() > b.access.Accesses();
+    });
+    return result;
+}
+
+std::vector<LineStats> Profiler::GetLineHistogram() const {
+    // Sum by line table row's (file, line), in order of first appearance
+    std::vector<LineStats> lines;
+    std::unordered_map<uint64_t, size_t> index;
+    for (const auto& kv : SortedHistogram()) {
+        const SourceLine* row = elf_.FindLine(kv.first);
+        if (!row) continue;
+        uint64_t key = (static_cast<uint64_t>(row->file) << 32) | row->line;
+        auto it = index.find(key);
+        if (it == index.end()) {
+            it = index.emplace(key, lines.size()).first;
+            lines.push_back({elf_.GetFiles()[row->file], row->line, 0});
+        }
+        lines[it->second].cycles += kv.second;
+    }
+    std::stable_sort(lines.begin(), lines.end(), [](const LineStats& a, const LineStats& b) {
+        return a.cycles > b.cycles;
+    });
+    return lines;
+}
+
+int64_t Profiler::CurrentCycles() const {
+    switch (cpu_) {
+        case ProfileCpu::Z80: return Z80.cycles;
+        case ProfileCpu::SVP: return ssp1601_cycles;
+        default:              return m68k.cycles;
     }
-    return 0;
+}
+
+uint16_t Profiler::ReadWord(uint32_t addr) const {
+    // Read through the 68k memory map, so code and stacks in RAM work too
+    // (memory is stored as native 16-bit words)
+    const uint8_t* base = m68k.memory_map[(addr >> 16) & 0xFF].base;
+    return base ? *reinterpret_cast<const uint16_t*>(base + (addr & 0xFFFE)) : 0;
+}
+
+uint32_t Profiler::StackPointer(uint32_t stack) const {
+    // A7 is the active stack pointer, the other one is kept in sp[]
+    return m68k.s_flag == stack ? m68k.dar[15] : m68k.sp[stack];
+}
+
+uint8_t Profiler::ReadZ80Byte(uint32_t addr) const {
+    // Z80 code runs from its 8KB RAM (mirrored up to $3FFF)
+    return addr < 0x4000 ? zram[addr & 0x1FFF] : 0;
+}
+
+uint16_t Profiler::ReadSvpWord(uint32_t addr) const {
+    // IRAM and program ROM copy, 0x10000 words
+    return svp ? reinterpret_cast<const uint16_t*>(svp->iram_rom)[addr & 0xFFFF] : 0;
 }
 
 void Profiler::OnExecute(uint32_t pc) {
+    Execute(pc, CurrentCycles());
+}
+
+void Profiler::OnSvpExecute(uint32_t pc, uint32_t cycles) {
+    // The SSP cycle counter is only updated at the end of each timeslice,
+    // the hook passes the current value
+    Execute(pc, cycles);
+}
+
+void Profiler::Execute(uint32_t pc, int64_t current_cycles) {
+    if (lookup_dirty_) BuildLookup();  // Symbols changed while running
+
     // Get cycles since last instruction
-    int64_t current_cycles = m68k.cycles;
     int64_t delta = current_cycles - last_cycles_;
     last_cycles_ = current_cycles;
 
     if (delta <= 0) return;  // First call or cycle counter wrapped
 
     total_cycles_ += delta;
+    frame_.cpu_cycles += delta;
+
+    if (cpu_ == ProfileCpu::M68K) {
+        if (exception_depth_ > 0) {
+            frame_.interrupt_cycles += delta;
+        }
+        // Shadow stack: a frame ends once the stack pointer rises above it
+        // (RTS, RTR, RTE, or the stack being unwound some other way)
+        while (!call_stack_.empty() &&
+               StackPointer(call_stack_.back().stack) > call_stack_.back().sp) {
+            PopFrame(current_cycles);
+        }
+        if (collect_timeline_) {
+            if (vint_depth_ > 0) {
+                timeline_frame_.vint_cycles += delta;
+            }
+            // Main loop arriving at its VBlank wait (handlers don't count)
+            if (exception_depth_ == 0) {
+                bool waiting = pc >= vblank_wait_start_ && pc < vblank_wait_end_;
+                if (waiting && !waiting_for_vblank_ && timeline_frame_.wait_line < 0) {
+                    timeline_frame_.wait_line = v_counter;
+                }
+                waiting_for_vblank_ = waiting;
+            }
+        }
+    }
 
     // Sampling: only do expensive work every Nth instruction
     if (sample_rate_ > 1) {
@@ -256,6 +907,8 @@ void Profiler::OnExecute(uint32_t pc) {
             // Update last_pc_ even on skipped samples so CallStack mode
             // can track call/return instructions correctly
             last_pc_ = pc;
+            has_last_pc_ = true;
+            exception_entered_ = false;
             return;
         }
         sample_counter_ = 0;
@@ -266,52 +919,374 @@ void Profiler::OnExecute(uint32_t pc) {
 
     // Collect per-address histogram if enabled
     if (collect_address_histogram_) {
-        address_cycles_[pc] += delta;
+        AddToHistogram(pc, delta);
     }
 
     // Attribute cycles to current function
-    const FunctionDef* func = LookupFunction(pc);
-    if (func) {
-        auto& s = stats_[func->start_addr];
+    uint32_t func = FunctionIndex(pc);
+    if (func != NO_FUNCTION) {
+        auto& s = stats_[func];
         s.cycles_exclusive += delta;
 
         // Count function entry (PC moved into this function from outside)
         // Note: With sampling, this undercounts entries that happen between samples
-        if (last_pc_ != 0) {
-            const FunctionDef* last_func = LookupFunction(last_pc_);
-            if (last_func != func) {
-                s.call_count++;
-            }
+        if (has_last_pc_ && FunctionIndex(last_pc_) != func) {
+            s.call_count++;
         }
     }
 
-    // CallStack mode: track JSR/BSR/RTS for inclusive cycles
+    // CallStack mode: track calls and returns for inclusive cycles
     // Note: With sampling enabled, we only check every Nth instruction for
     // call/return opcodes, so inclusive timing will be less accurate.
-    if (mode_ == ProfileMode::CallStack && last_pc_ != 0) {
-        uint16_t opcode = ReadWord(last_pc_);
+    if (mode_ == ProfileMode::CallStack && has_last_pc_ && cpu_ == ProfileCpu::M68K) {
+        // 68k returns are found by the stack pointer, only calls are decoded.
+        // The first instruction of an exception handler follows whatever was
+        // interrupted, which is not a call even if it was a JSR.
+        if (!exception_entered_ && IsCallOpcode(ReadWord(last_pc_)) &&
+            func != NO_FUNCTION && call_stack_.size() < MAX_CALL_STACK_DEPTH) {
+            PushFrame({functions_[func].start_addr, current_cycles,
+                       m68k.dar[15], m68k.s_flag, false}, last_pc_);
+        }
+    } else if (mode_ == ProfileMode::CallStack && has_last_pc_) {
+        bool is_call = false;
+        bool is_return = false;
+        if (cpu_ == ProfileCpu::Z80) {
+            is_call = IsZ80Call(last_pc_, pc);
+            is_return = IsZ80Return(last_pc_, pc);
+        } else if (cpu_ == ProfileCpu::SVP) {
+            // call cond,addr (taken); ret is "ld PC,STACK"
+            uint16_t opcode = ReadSvpWord(last_pc_);
+            is_call = (opcode >> 9) == 0x24 && pc != ((last_pc_ + 2) & 0xFFFF);
+            is_return = opcode == 0x0065;
+        }
 
-        if (IsCallOpcode(opcode)) {
+        if (is_call) {
             // Entering a new function - push frame
-            // Limit stack depth to prevent unbounded growth from unbalanced calls
-            // (e.g., indirect jumps, exceptions, or non-standard control flow)
-            constexpr size_t MAX_CALL_STACK_DEPTH = 256;
-            if (func && call_stack_.size() < MAX_CALL_STACK_DEPTH) {
-                call_stack_.push_back({func->start_addr, current_cycles});
+            if (func != NO_FUNCTION && call_stack_.size() < MAX_CALL_STACK_DEPTH) {
+                PushFrame({functions_[func].start_addr, current_cycles}, last_pc_);
             }
-        } else if (IsReturnOpcode(opcode) && !call_stack_.empty()) {
+        } else if (is_return && !call_stack_.empty()) {
             // Returning from function - pop frame and accumulate inclusive time
-            CallFrame frame = call_stack_.back();
-            call_stack_.pop_back();
+            PopFrame(current_cycles);
+        }
+    }
+
+    // Stack samples for the flame graph and pprof exports
+    if (mode_ == ProfileMode::CallStack) {
+        call_tree_[CallTreeChild(StackNode(), pc, false)].cycles += delta;
+    }
 
-            int64_t inclusive = current_cycles - frame.entry_cycles;
-            if (inclusive > 0) {
-                stats_[frame.func_addr].cycles_inclusive += inclusive;
+    last_pc_ = pc;
+    has_last_pc_ = true;
+    exception_entered_ = false;
+}
+
+void Profiler::PushFrame(CallFrame frame, uint32_t call_site) {
+    if (mode_ == ProfileMode::CallStack) {
+        frame.node = CallTreeChild(StackNode(), call_site, false);
+    }
+    call_stack_.push_back(frame);
+}
+
+uint32_t Profiler::CallTreeChild(uint32_t parent, uint32_t addr, bool exception) {
+    uint64_t key = (static_cast<uint64_t>(parent) << 33) | (exception ? EXCEPTION_FRAME : 0) | addr;
+    auto it = call_tree_index_.find(key);
+    if (it != call_tree_index_.end()) {
+        return it->second;
+    }
+    uint32_t node = static_cast<uint32_t>(call_tree_.size());
+    CallTreeNode entry;
+    entry.parent = parent;
+    entry.addr = addr;
+    entry.exception = exception;
+    call_tree_.push_back(entry);
+    call_tree_index_.emplace(key, node);
+    return node;
+}
+
+void Profiler::PopFrame(int64_t current_cycles) {
+    CallFrame frame = call_stack_.back();
+    call_stack_.pop_back();
+
+    int64_t inclusive = current_cycles - frame.entry_cycles;
+    if (frame.exception) {
+        exception_depth_--;
+        if (frame.func_addr == VECTOR_VINT) {
+            vint_depth_--;
+        }
+        if (inclusive > 0) {
+            interrupt_stats_[frame.func_addr].cycles += inclusive;
+            if (collect_call_cycles_) {
+                interrupt_samples_[frame.func_addr].push_back(
+                    {frame_loads_.size(), static_cast<uint64_t>(inclusive)});
             }
         }
+        return;
+    }
+    uint32_t frame_func = FunctionIndex(frame.func_addr);
+    if (inclusive > 0 && frame_func != NO_FUNCTION) {
+        stats_[frame_func].cycles_inclusive += inclusive;
+        if (collect_call_cycles_) {
+            call_samples_[frame.func_addr].push_back(
+                {frame_loads_.size(), static_cast<uint64_t>(inclusive)});
+        }
     }
+}
 
-    last_pc_ = pc;
+void Profiler::OnException(uint32_t vector) {
+    if (lookup_dirty_) BuildLookup();
+
+    // The exception frame is on the supervisor stack: SR, then the return PC
+    uint32_t ssp = m68k.dar[15];
+    uint16_t stacked_sr = ReadWord(ssp);
+    uint32_t return_pc = (ReadWord(ssp + 2) << 16) | ReadWord(ssp + 4);
+
+    interrupt_stats_[vector].count++;
+    if (call_stack_.size() >= MAX_CALL_STACK_DEPTH) {
+        return;
+    }
+
+    // A JSR/BSR right before the exception has already jumped to the callee,
+    // which becomes the return address; its frame is pushed here because the
+    // next instruction executed belongs to the handler
+    if (mode_ == ProfileMode::CallStack && has_last_pc_ && IsCallOpcode(ReadWord(last_pc_))) {
+        uint32_t func = FunctionIndex(return_pc);
+        if (func != NO_FUNCTION && call_stack_.size() + 1 < MAX_CALL_STACK_DEPTH) {
+            bool supervisor = (stacked_sr & 0x2000) != 0;
+            PushFrame({functions_[func].start_addr, last_cycles_,
+                       supervisor ? ssp + 6 : m68k.sp[0],
+                       supervisor ? 4u : 0u, false}, last_pc_);
+        }
+    }
+
+    // In the call tree, the handler runs below the interrupted instruction
+    CallFrame frame = {vector, m68k.cycles, ssp, 4, true};
+    if (mode_ == ProfileMode::CallStack) {
+        frame.node = CallTreeChild(CallTreeChild(StackNode(), return_pc, false), vector, true);
+    }
+    call_stack_.push_back(frame);
+    exception_depth_++;
+    if (vector == VECTOR_VINT) {
+        vint_depth_++;
+    }
+    exception_entered_ = true;
+}
+
+void Profiler::OnBusRequest(uint32_t stall_cycles) {
+    bus_stall_cycles_ += stall_cycles;
+    frame_.bus_stall_cycles += stall_cycles;
+
+    // The access is made by the instruction currently executing
+    if (has_last_pc_) {
+        if (lookup_dirty_) BuildLookup();
+        uint32_t func = FunctionIndex(last_pc_);
+        if (func != NO_FUNCTION) {
+            stats_[func].bus_stall_cycles += stall_cycles;
+        }
+    }
+}
+
+void Profiler::OnZ80Sync(uint32_t cycles) {
+    // The Z80 was stopped: its counter jumped to the 68k time, skip the gap
+    last_cycles_ = cycles;
+}
+
+void Profiler::OnFrameEnd(uint32_t frame_cycles) {
+    if (collect_timeline_) {
+        timeline_frame_.cpu_cycles = frame_.cpu_cycles;
+        EndTimelineFrame();
+    }
+    frame_.frame_cycles = frame_cycles;
+    frame_loads_.push_back(frame_);
+    frame_ = FrameLoad();
+
+    // Cycle counters are rewound by the frame length once the frame ends
+    last_cycles_ -= frame_cycles;
+    for (auto& frame : call_stack_) {
+        frame.entry_cycles -= frame_cycles;
+    }
+}
+
+void Profiler::OnMemoryAccess(uint32_t addr, uint32_t width, bool write) {
+    if (lookup_dirty_) BuildLookup();  // Symbols changed while running
+
+    addr &= 0xFFFFFF;
+    uint32_t func = FunctionIndex(access_pc_);
+    size_t row = func == NO_FUNCTION ? functions_.size() : func;
+    MemoryAccessStats& region = memory_access_[row * MEMORY_REGION_COUNT +
+                                               static_cast<size_t>(GetMemoryRegion(addr))];
+    if (write) {
+        region.writes++;
+        region.write_bytes += width;
+    } else {
+        region.reads++;
+        region.read_bytes += width;
+    }
+    if (addr >= 0xE00000) {
+        MemoryAccessStats& byte = ram_access_[addr & 0xFFFF];
+        if (write) {
+            byte.writes++;
+            byte.write_bytes += width;
+        } else {
+            byte.reads++;
+            byte.read_bytes += width;
+        }
+    }
+}
+
+void Profiler::OnScanline() {
+    if (++line_counter_ < sample_lines_) return;
+    line_counter_ = 0;
+    if (lookup_dirty_) BuildLookup();  // Symbols changed while running
+
+    // The sample stands for all cycles since the previous one
+    int64_t current_cycles = m68k.cycles;
+    int64_t delta = current_cycles - last_cycles_;
+    last_cycles_ = current_cycles;
+    if (delta <= 0) return;
+
+    uint32_t pc = m68k.pc & 0xFFFFFF;
+    total_cycles_ += delta;
+    frame_.cpu_cycles += delta;
+    samples_++;
+
+    if (collect_address_histogram_) {
+        AddToHistogram(pc, delta);
+    }
+    uint32_t func = FunctionIndex(pc);
+    if (func != NO_FUNCTION) {
+        stats_[func].cycles_exclusive += delta;
+    }
+    if (stack_walk_depth_ == 0) return;
+
+    // Call tree from the outermost call site down to the sampled PC
+    WalkStack(call_sites_);
+    uint32_t node = 0;
+    for (auto it = call_sites_.rbegin(); it != call_sites_.rend(); ++it) {
+        node = CallTreeChild(node, *it, false);
+    }
+    call_tree_[CallTreeChild(node, pc, false)].cycles += delta;
+
+    // Inclusive cycles, once per function on the stack (recursion counted once)
+    auto stack_function = [this, func](size_t i) {
+        return i == 0 ? func : FunctionIndex(call_sites_[i - 1]);
+    };
+    for (size_t i = 0; i <= call_sites_.size(); i++) {
+        uint32_t f = stack_function(i);
+        bool seen = f == NO_FUNCTION;
+        for (size_t j = 0; j < i && !seen; j++) {
+            seen = stack_function(j) == f;
+        }
+        if (!seen) {
+            stats_[f].cycles_inclusive += delta;
+        }
+    }
+}
+
+void Profiler::WalkStack(std::vector<uint32_t>& call_sites) const {
+    call_sites.clear();
+
+    // Only work RAM is scanned, up to the initial stack pointer unless the
+    // program moved its stack above it
+    uint32_t sp = m68k.dar[15] & 0xFFFFFE;
+    if (sp < 0xE00000) return;
+    uint32_t top = ((static_cast<uint32_t>(ReadWord(0)) << 16) | ReadWord(2)) & 0xFFFFFF;
+    uint32_t limit = std::min<uint32_t>(sp + STACK_SCAN_BYTES, 0x1000000);
+    if (top >= sp) {
+        limit = std::min(limit, top);
+    }
+    while (sp + 4 <= limit && call_sites.size() < stack_walk_depth_) {
+        // Return addresses point into ROM or work RAM
+        uint32_t value = (static_cast<uint32_t>(ReadWord(sp)) << 16) | ReadWord(sp + 2);
+        uint32_t site = NO_FUNCTION;
+        if (value < 0x400000 || (value >= 0xFF0000 && value < 0x1000000)) {
+            site = CallSiteBefore(value);
+        }
+        if (site != NO_FUNCTION) {
+            call_sites.push_back(site);
+            sp += 4;
+        } else {
+            sp += 2;
+        }
+    }
+}
+
+uint32_t Profiler::CallSiteBefore(uint32_t ret) const {
+    if (ret < 6 || (ret & 1)) return NO_FUNCTION;
+
+    // JSR abs.l
+    if (ReadWord(ret - 6) == 0x4EB9) return ret - 6;
+
+    // BSR.w; JSR d16(An), d8(An,Xn), abs.w, d16(PC), d8(PC,Xn)
+    uint16_t opcode = ReadWord(ret - 4);
+    if (opcode == 0x6100 || (opcode >= 0x4EA8 && opcode <= 0x4EBB && opcode != 0x4EB9)) {
+        return ret - 4;
+    }
+
+    // BSR.s; JSR (An)
+    opcode = ReadWord(ret - 2);
+    uint8_t displacement = opcode & 0xFF;
+    if (((opcode & 0xFF00) == 0x6100 && displacement != 0 && displacement != 0xFF) ||
+        (opcode & 0xFFF8) == 0x4E90) {
+        return ret - 2;
+    }
+    return NO_FUNCTION;
+}
+
+void Profiler::OnInputRead() {
+    timeline_frame_.input_polled = true;
+}
+
+void Profiler::EndTimelineFrame() {
+    FrameProfile& frame = timeline_frame_;
+    frame.frame = timeline_.size();
+
+    // Per-function cycles since the last frame (symbols added while running
+    // start over)
+    if (frame_start_cycles_.size() != stats_.size()) {
+        frame_start_cycles_.assign(stats_.size(), 0);
+    }
+    for (size_t i = 0; i < stats_.size(); i++) {
+        uint64_t cycles = stats_[i].cycles_exclusive - frame_start_cycles_[i];
+        if (cycles > 0) {
+            frame.functions.emplace_back(functions_[i].start_addr, cycles);
+        }
+        frame_start_cycles_[i] = stats_[i].cycles_exclusive;
+    }
+    std::sort(frame.functions.begin(), frame.functions.end(),
+        [](const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b) {
+            return a.second > b.second;
+        });
+
+    // The frame ends as VBlank starts: the update is late unless the main
+    // loop is already waiting
+    bool late = vblank_wait_end_ > vblank_wait_start_ && !waiting_for_vblank_;
+    frame.lag = !frame.input_polled || late;
+
+    timeline_.push_back(std::move(frame));
+    timeline_frame_ = FrameProfile();
+}
+
+std::vector<uint64_t> Profiler::GetLagFrames(uint64_t first, uint64_t last) const {
+    std::vector<uint64_t> lag;
+    for (uint64_t i = first; i < std::min<uint64_t>(last, timeline_.size()); i++) {
+        if (timeline_[i].lag) {
+            lag.push_back(i);
+        }
+    }
+    return lag;
+}
+
+const std::vector<CallSample>& Profiler::GetCalls(uint32_t func_addr) const {
+    static const std::vector<CallSample> none;
+    auto it = call_samples_.find(func_addr);
+    return it != call_samples_.end() ? it->second : none;
+}
+
+const std::vector<CallSample>& Profiler::GetInterruptCalls(uint32_t vector) const {
+    static const std::vector<CallSample> none;
+    auto it = interrupt_samples_.find(vector);
+    return it != interrupt_samples_.end() ? it->second : none;
 }
 
 void Profiler::PrintReport(std::ostream& out, size_t max_functions) const {
@@ -325,15 +1300,15 @@ void Profiler::PrintReport(std::ostream& out, size_t max_functions) const {
     };
 
     std::vector<FuncReport> report;
-    for (const auto& func : functions_) {
-        auto it = stats_.find(func.start_addr);
-        if (it != stats_.end() && it->second.cycles_exclusive > 0) {
+    for (size_t i = 0; i < functions_.size(); i++) {
+        const FunctionStats& s = stats_[i];
+        if (s.cycles_exclusive > 0) {
             report.push_back({
-                func.name,
-                func.start_addr,
-                it->second.cycles_exclusive,
-                it->second.cycles_inclusive,
-                it->second.call_count
+                functions_[i].name,
+                functions_[i].start_addr,
+                s.cycles_exclusive,
+                s.cycles_inclusive,
+                s.call_count
             });
         }
     }
@@ -348,9 +1323,13 @@ void Profiler::PrintReport(std::ostream& out, size_t max_functions) const {
     }
 
     // Print header
-    bool show_inclusive = (mode_ == ProfileMode::CallStack);
+    bool show_inclusive = mode_ == ProfileMode::CallStack ||
+                          (mode_ == ProfileMode::Scanline && stack_walk_depth_ > 0);
     out << "\n";
-    if (sample_rate_ > 1) {
+    if (mode_ == ProfileMode::Scanline) {
+        out << "Scanline sampling: every " << sample_lines_ << " line(s), "
+            << samples_ << " samples (estimated cycles, calls not counted)\n";
+    } else if (sample_rate_ > 1) {
         out << "Sample rate: 1/" << sample_rate_ << " (estimated cycles)\n";
     }
     out << std::setw(30) << std::left << "Function"
@@ -384,9 +1363,180 @@ void Profiler::PrintReport(std::ostream& out, size_t max_functions) const {
     out << std::setw(30) << std::left << "Total"
         << std::setw(12) << std::right << total_cycles_
         << "\n";
+
+    if (cpu_ == ProfileCpu::Z80) {
+        out << std::setw(30) << std::left << "68k bus stall"
+            << std::setw(12) << std::right << bus_stall_cycles_
+            << "\n";
+        if (!frame_loads_.empty()) {
+            double sum = 0.0, peak = 0.0;
+            for (const auto& frame : frame_loads_) {
+                sum += frame.Load();
+                peak = std::max(peak, frame.Load());
+            }
+            out << "Z80 load: " << std::fixed << std::setprecision(1)
+                << 100.0 * sum / frame_loads_.size() << "% avg, "
+                << 100.0 * peak << "% peak over "
+                << frame_loads_.size() << " frames\n";
+        }
+    }
+
+    if (!interrupt_stats_.empty()) {
+        out << "\n" << std::setw(30) << std::left << "Exception"
+            << std::setw(12) << std::right << "Cycles"
+            << std::setw(10) << "Count"
+            << std::setw(8) << "%"
+            << std::setw(10) << "Cyc/Call"
+            << "\n";
+        out << std::string(70, '-') << "\n";
+        for (const auto& kv : interrupt_stats_) {
+            const InterruptStats& s = kv.second;
+            double pct = total_cycles_ > 0 ? 100.0 * s.cycles / total_cycles_ : 0.0;
+            out << std::setw(30) << std::left << ExceptionName(kv.first)
+                << std::setw(12) << std::right << s.cycles
+                << std::setw(10) << s.count
+                << std::setw(7) << std::fixed << std::setprecision(2) << pct << "%"
+                << std::setw(10) << (s.count > 0 ? s.cycles / s.count : 0)
+                << "\n";
+        }
+        if (!frame_loads_.empty()) {
+            double sum = 0.0, peak = 0.0;
+            for (const auto& frame : frame_loads_) {
+                sum += frame.InterruptLoad();
+                peak = std::max(peak, frame.InterruptLoad());
+            }
+            out << "Exception load: " << std::fixed << std::setprecision(1)
+                << 100.0 * sum / frame_loads_.size() << "% avg, "
+                << 100.0 * peak << "% peak over "
+                << frame_loads_.size() << " frames\n";
+        }
+    }
+
+    if (!timeline_.empty()) {
+        std::vector<uint64_t> lag = GetLagFrames();
+        uint64_t peak = 0;
+        for (const auto& frame : timeline_) {
+            peak = std::max(peak, frame.cpu_cycles);
+        }
+        out << "\nLag frames: " << lag.size() << " of " << timeline_.size();
+        for (size_t i = 0; i < lag.size() && i < 10; i++) {
+            out << (i == 0 ? " (" : ", ") << lag[i];
+        }
+        out << (lag.size() > 10 ? ", ...)" : lag.empty() ? "" : ")") << "\n";
+        out << "Peak frame: " << peak << " cycles\n";
+    }
+
+    if (collect_memory_access_) {
+        auto print_header = [&out](const char* title) {
+            out << "\n" << std::setw(30) << std::left << title
+                << std::setw(12) << std::right << "Reads"
+                << std::setw(12) << "Writes"
+                << std::setw(12) << "Read bytes"
+                << std::setw(12) << "Write bytes"
+                << "\n";
+            out << std::string(78, '-') << "\n";
+        };
+        auto print_row = [&out](const std::string& name, const MemoryAccessStats& s) {
+            out << std::setw(30) << std::left << name
+                << std::setw(12) << std::right << s.reads
+                << std::setw(12) << s.writes
+                << std::setw(12) << s.read_bytes
+                << std::setw(12) << s.write_bytes
+                << "\n";
+        };
+
+        print_header("Memory region");
+        for (size_t r = 0; r < MEMORY_REGION_COUNT; r++) {
+            MemoryAccessStats s = GetMemoryAccess(static_cast<MemoryRegion>(r));
+            if (s.Accesses() > 0) {
+                print_row(MemoryRegionName(static_cast<MemoryRegion>(r)), s);
+            }
+        }
+
+        // Busiest (function, region) pairs
+        std::vector<size_t> rows;
+        for (size_t i = 0; i < memory_access_.size(); i++) {
+            if (memory_access_[i].Accesses() > 0) {
+                rows.push_back(i);
+            }
+        }
+        std::stable_sort(rows.begin(), rows.end(), [this](size_t a, size_t b) {
+            return memory_access_[a].Accesses() > memory_access_[b].Accesses();
+        });
+        if (rows.size() > 10) {
+            rows.resize(10);
+        }
+        print_header("Function: region");
+        for (size_t i : rows) {
+            size_t func = i / MEMORY_REGION_COUNT;
+            std::string name = func < functions_.size() ? functions_[func].name : "(unknown)";
+            print_row(name + ": " + MemoryRegionName(static_cast<MemoryRegion>(i % MEMORY_REGION_COUNT)),
+                      memory_access_[i]);
+        }
+
+        if (!variables_.empty()) {
+            std::vector<VariableAccess> vars = GetVariableAccess();
+            if (vars.size() > 10) {
+                vars.resize(10);
+            }
+            print_header("Variable");
+            for (const auto& v : vars) {
+                print_row(v.name, v.access);
+            }
+        }
+    }
+
+    if (collect_address_histogram_ && !elf_.GetLines().empty()) {
+        std::vector<LineStats> lines = GetLineHistogram();
+        if (lines.size() > 10) {
+            lines.resize(10);
+        }
+        out << "\n" << std::setw(50) << std::left << "Source line"
+            << std::setw(12) << std::right << "Cycles"
+            << std::setw(8) << "%"
+            << "\n";
+        out << std::string(70, '-') << "\n";
+        for (const auto& l : lines) {
+            double pct = total_cycles_ > 0 ? 100.0 * l.cycles / total_cycles_ : 0.0;
+            out << std::setw(50) << std::left << (l.file + ":" + std::to_string(l.line))
+                << std::setw(12) << std::right << l.cycles
+                << std::setw(7) << std::fixed << std::setprecision(2) << pct << "%"
+                << "\n";
+        }
+    }
 }
 
-bool Profiler::WriteAddressHistogram(const std::string& path) const {
+bool Profiler::WriteAddressHistogram(const std::string& path, HistogramFormat format) const {
+    // Sort addresses for deterministic output
+    std::vector<std::pair<uint32_t, uint64_t>> sorted_addrs = SortedHistogram();
+
+    if (format == HistogramFormat::Binary) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            return false;
+        }
+
+        std::vector<uint8_t> data(32 + sorted_addrs.size() * 12);
+        auto put = [&data](size_t offset, uint64_t value, int bytes) {
+            for (int i = 0; i < bytes; i++) {
+                data[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        };
+        memcpy(data.data(), "GXHIST01", 8);
+        put(8, sample_rate_, 4);
+        put(12, static_cast<uint32_t>(cpu_), 4);
+        put(16, total_cycles_, 8);
+        put(24, sorted_addrs.size(), 8);
+        size_t offset = 32;
+        for (const auto& kv : sorted_addrs) {
+            put(offset, kv.first, 4);
+            put(offset + 4, kv.second, 8);
+            offset += 12;
+        }
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+        return out.good();
+    }
+
     std::ofstream out(path);
     if (!out) {
         return false;
@@ -398,14 +1548,9 @@ bool Profiler::WriteAddressHistogram(const std::string& path) const {
     out << "{\n";
     out << "  \"sample_rate\": " << sample_rate_ << ",\n";
     out << "  \"total_cycles\": " << total_cycles_ << ",\n";
-    out << "  \"address_count\": " << address_cycles_.size() << ",\n";
+    out << "  \"address_count\": " << sorted_addrs.size() << ",\n";
     out << "  \"addresses\": {\n";
 
-    // Sort addresses for deterministic output
-    std::vector<std::pair<uint32_t, uint64_t>> sorted_addrs(
-        address_cycles_.begin(), address_cycles_.end());
-    std::sort(sorted_addrs.begin(), sorted_addrs.end());
-
     bool first = true;
     for (const auto& kv : sorted_addrs) {
         if (!first) out << ",\n";
@@ -420,16 +1565,321 @@ bool Profiler::WriteAddressHistogram(const std::string& path) const {
     return out.good();
 }
 
+bool Profiler::WriteProfile(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    std::vector<uint8_t> data(36);
+    auto put = [&data](size_t offset, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            data[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    };
+    memcpy(data.data(), "GXPROF01", 8);
+    put(8, static_cast<uint32_t>(cpu_), 4);
+    put(12, sample_rate_, 4);
+    put(16, total_cycles_, 8);
+    put(24, frame_loads_.size(), 8);
+    put(32, functions_.size(), 4);
+    for (size_t i = 0; i < functions_.size(); i++) {
+        const FunctionDef& func = functions_[i];
+        size_t name_length = std::min<size_t>(func.name.size(), UINT16_MAX);
+        size_t offset = data.size();
+        data.resize(offset + 34 + name_length);
+        put(offset, func.start_addr, 4);
+        put(offset + 4, func.end_addr, 4);
+        put(offset + 8, stats_[i].call_count, 8);
+        put(offset + 16, stats_[i].cycles_exclusive, 8);
+        put(offset + 24, stats_[i].cycles_inclusive, 8);
+        put(offset + 32, name_length, 2);
+        memcpy(&data[offset + 34], func.name.data(), name_length);
+    }
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return out.good();
+}
+
+bool Profiler::WriteMemoryHeatmap(const std::string& path, HistogramFormat format) const {
+    static const MemoryAccessStats none;
+    auto byte_stats = [this](uint32_t offset) -> const MemoryAccessStats& {
+        return ram_access_.empty() ? none : ram_access_[offset];
+    };
+
+    if (format == HistogramFormat::Binary) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            return false;
+        }
+
+        std::vector<uint8_t> data(16 + 0x10000 * 32);
+        auto put = [&data](size_t offset, uint64_t value, int bytes) {
+            for (int i = 0; i < bytes; i++) {
+                data[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        };
+        memcpy(data.data(), "GXHEAT01", 8);
+        put(8, 0xFF0000, 4);
+        put(12, 0x10000, 4);
+        size_t offset = 16;
+        for (uint32_t i = 0; i < 0x10000; i++) {
+            const MemoryAccessStats& s = byte_stats(i);
+            put(offset, s.reads, 8);
+            put(offset + 8, s.writes, 8);
+            put(offset + 16, s.read_bytes, 8);
+            put(offset + 24, s.write_bytes, 8);
+            offset += 32;
+        }
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+        return out.good();
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+
+    // Addresses map to [reads, writes, read bytes, write bytes]
+    out << "{\n";
+    out << "  \"base\": " << 0xFF0000 << ",\n";
+    out << "  \"size\": " << 0x10000 << ",\n";
+    out << "  \"addresses\": {\n";
+    bool first = true;
+    for (uint32_t i = 0; i < 0x10000; i++) {
+        const MemoryAccessStats& s = byte_stats(i);
+        if (s.Accesses() == 0) continue;
+        if (!first) out << ",\n";
+        first = false;
+        out << "    \"" << std::hex << std::setfill('0') << std::setw(8) << (0xFF0000 + i)
+            << "\": " << std::dec << "[" << s.reads << ", " << s.writes << ", "
+            << s.read_bytes << ", " << s.write_bytes << "]";
+    }
+    out << "\n  },\n";
+    out << "  \"variables\": [\n";
+    first = true;
+    for (const VariableAccess& v : GetVariableAccess()) {
+        if (!first) out << ",\n";
+        first = false;
+        out << "    {\"name\": " << JsonString(v.name) << ", \"addr\": " << v.addr
+            << ", \"size\": " << v.size << ", \"reads\": " << v.access.reads
+            << ", \"writes\": " << v.access.writes << ", \"read_bytes\": " << v.access.read_bytes
+            << ", \"write_bytes\": " << v.access.write_bytes << "}";
+    }
+    out << "\n  ]\n";
+    out << "}\n";
+
+    return out.good();
+}
+
+std::vector<std::pair<std::vector<uint64_t>, uint64_t>> Profiler::CollectStacks() const {
+    std::vector<std::pair<std::vector<uint64_t>, uint64_t>> stacks;
+    if (call_tree_.size() > 1) {
+        for (size_t i = 1; i < call_tree_.size(); i++) {
+            if (call_tree_[i].cycles == 0) continue;
+            std::vector<uint64_t> frames;
+            for (uint32_t node = static_cast<uint32_t>(i); node != 0; node = call_tree_[node].parent) {
+                const CallTreeNode& n = call_tree_[node];
+                frames.push_back((n.exception ? EXCEPTION_FRAME : 0) | n.addr);
+            }
+            stacks.emplace_back(std::move(frames), call_tree_[i].cycles);
+        }
+    } else if (collect_address_histogram_) {
+        for (const auto& kv : SortedHistogram()) {
+            stacks.emplace_back(std::vector<uint64_t>{kv.first}, kv.second);
+        }
+    } else {
+        for (size_t i = 0; i < functions_.size(); i++) {
+            if (stats_[i].cycles_exclusive > 0) {
+                stacks.emplace_back(std::vector<uint64_t>{functions_[i].start_addr},
+                                    stats_[i].cycles_exclusive);
+            }
+        }
+    }
+    return stacks;
+}
+
+std::string Profiler::FrameName(uint64_t frame) const {
+    if (frame & EXCEPTION_FRAME) {
+        return "[" + ExceptionName(static_cast<uint32_t>(frame)) + "]";
+    }
+    uint32_t func = FindFunction(static_cast<uint32_t>(frame));
+    return func != NO_FUNCTION ? functions_[func].name : "[unknown]";
+}
+
+bool Profiler::WriteFoldedStacks(const std::string& path) const {
+    // Stacks that only differ in addresses within the same functions merge
+    std::map<std::string, uint64_t> folded;
+    for (const auto& stack : CollectStacks()) {
+        std::string line;
+        for (auto it = stack.first.rbegin(); it != stack.first.rend(); ++it) {
+            if (!line.empty()) line += ';';
+            line += FrameName(*it);
+        }
+        folded[line] += stack.second;
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    for (const auto& kv : folded) {
+        out << kv.first << ' ' << kv.second << '\n';
+    }
+    return out.good();
+}
+
+bool Profiler::WritePprof(const std::string& path) const {
+    std::vector<std::string> strings = {""};
+    std::unordered_map<std::string, uint64_t> string_ids = {{"", 0}};
+    auto string_id = [&strings, &string_ids](const std::string& s) {
+        auto it = string_ids.find(s);
+        if (it != string_ids.end()) return it->second;
+        strings.push_back(s);
+        return string_ids[s] = strings.size() - 1;
+    };
+
+    // Field numbers are those of profile.proto
+    ProtoBuffer profile;
+    ProtoBuffer value_type;
+    value_type.Field(1, string_id("cycles"));
+    value_type.Field(2, string_id("count"));
+    profile.Message(1, value_type);                     // sample_type
+
+    // Functions are symbols (by index) or exception vectors, locations are
+    // frames; both are numbered from 1 in order of first use
+    std::unordered_map<uint64_t, uint64_t> function_ids;
+    std::unordered_map<uint64_t, uint64_t> location_ids;
+    ProtoBuffer functions, locations;
+    auto location_id = [&](uint64_t frame) {
+        auto it = location_ids.find(frame);
+        if (it != location_ids.end()) return it->second;
+        uint64_t id = location_ids.size() + 1;
+        location_ids[frame] = id;
+
+        uint64_t function_key = frame;
+        if (!(frame & EXCEPTION_FRAME)) {
+            uint32_t func = FindFunction(static_cast<uint32_t>(frame));
+            function_key = func != NO_FUNCTION ? (2 * EXCEPTION_FRAME) | func : 0;
+        }
+        ProtoBuffer location;
+        location.Field(1, id);
+        if (!(frame & EXCEPTION_FRAME)) {
+            location.Field(2, 1);                       // mapping_id
+            location.Field(3, frame);                   // address
+        }
+        if (function_key != 0) {
+            auto fit = function_ids.find(function_key);
+            if (fit == function_ids.end()) {
+                fit = function_ids.emplace(function_key, function_ids.size() + 1).first;
+                std::string name = FrameName(frame);
+                ProtoBuffer function;
+                function.Field(1, fit->second);
+                function.Field(2, string_id(name));
+                function.Field(3, string_id(name));
+                if (!(frame & EXCEPTION_FRAME)) {
+                    uint32_t start = functions_[function_key & 0xFFFFFFFF].start_addr;
+                    if (const SourceLine* row = elf_.FindLine(start)) {
+                        function.Field(4, string_id(elf_.GetFiles()[row->file]));  // filename
+                        function.Field(5, row->line);                              // start_line
+                    }
+                }
+                functions.Message(5, function);
+            }
+            ProtoBuffer line;
+            line.Field(1, fit->second);
+            if (!(frame & EXCEPTION_FRAME)) {
+                if (const SourceLine* row = elf_.FindLine(static_cast<uint32_t>(frame))) {
+                    line.Field(2, row->line);
+                }
+            }
+            location.Message(4, line);
+        }
+        locations.Message(4, location);
+        return id;
+    };
+
+    for (const auto& stack : CollectStacks()) {
+        std::vector<uint64_t> ids;
+        for (uint64_t frame : stack.first) {
+            ids.push_back(location_id(frame));
+        }
+        ProtoBuffer sample;
+        sample.Packed(1, ids);                          // location_id, leaf first
+        sample.Packed(2, {stack.second});               // value
+        profile.Message(2, sample);
+    }
+
+    static const char* const cpu_names[] = {"68k", "z80", "ssp1601"};
+    ProtoBuffer mapping;
+    mapping.Field(1, 1);
+    mapping.Field(3, cpu_ == ProfileCpu::M68K ? 0x1000000 : 0x10000);  // memory_limit
+    mapping.Field(5, string_id(cpu_names[static_cast<int>(cpu_)]));   // filename
+    mapping.Field(7, 1);                                // has_functions
+    if (!elf_.GetLines().empty()) {
+        mapping.Field(8, 1);                            // has_filenames
+        mapping.Field(9, 1);                            // has_line_numbers
+    }
+    profile.Message(3, mapping);
+    profile.Append(locations);
+    profile.Append(functions);
+    for (const std::string& s : strings) {
+        profile.String(6, s);                           // string_table
+    }
+    profile.Message(11, value_type);                    // period_type
+    profile.Field(12, sample_rate_);                    // period
+    const std::vector<uint8_t>& body = profile.Data();
+
+    // gzip wrapper (windowBits 15 + 16)
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    std::vector<uint8_t> compressed(deflateBound(&stream, body.size()) + 32);
+    stream.next_in = const_cast<Bytef*>(body.data());
+    stream.avail_in = static_cast<uInt>(body.size());
+    stream.next_out = compressed.data();
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    int result = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        return false;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+    return out.good();
+}
+
 bool Profiler::IsCallOpcode(uint16_t opcode) const {
     // JSR: 0100 1110 10xx xxxx (0x4E80-0x4EBF)
     // BSR: 0110 0001 xxxx xxxx (0x6100-0x61FF)
     return ((opcode & 0xFFC0) == 0x4E80) || ((opcode & 0xFF00) == 0x6100);
 }
 
-bool Profiler::IsReturnOpcode(uint16_t opcode) const {
-    // RTS: 0x4E75
-    // RTR: 0x4E77
-    return opcode == 0x4E75 || opcode == 0x4E77;
+bool Profiler::IsZ80Call(uint32_t from_pc, uint32_t to_pc) const {
+    uint8_t opcode = ReadZ80Byte(from_pc);
+    // CALL nn: 0xCD; RST p: 11ppp111
+    if (opcode == 0xCD || (opcode & 0xC7) == 0xC7) return true;
+    // CALL cc,nn: 11ccc100 - only a call when taken
+    return (opcode & 0xC7) == 0xC4 && to_pc != ((from_pc + 3) & 0xFFFF);
+}
+
+bool Profiler::IsZ80Return(uint32_t from_pc, uint32_t to_pc) const {
+    uint8_t opcode = ReadZ80Byte(from_pc);
+    // RET: 0xC9; RETI/RETN: 0xED 0x4D / 0xED 0x45
+    if (opcode == 0xC9) return true;
+    if (opcode == 0xED) {
+        uint8_t next = ReadZ80Byte(from_pc + 1);
+        return next == 0x4D || next == 0x45;
+    }
+    // RET cc: 11ccc000 - only a return when taken
+    return (opcode & 0xC7) == 0xC0 && to_pc != ((from_pc + 1) & 0xFFFF);
 }
 
 } // namespace GX
@@ -0,0 +1,234 @@
+/**
+ * state_store.cpp - Content-addressed, deduplicating state store
+ */
+
+#include "state_store.h"
+#include <algorithm>
+#include <cstring>
+
+// Vendored xxHash (shipped with zstd), compiled inline into this file
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+namespace GX {
+
+StateStore::StateStore(size_t chunk_size)
+    : chunk_size_(chunk_size ? chunk_size : DEFAULT_CHUNK_SIZE) {}
+
+// ---------------------------------------------------------------------------
+// Chunk management
+// ---------------------------------------------------------------------------
+
+uint32_t StateStore::AllocateChunk() {
+    if (free_chunks_ != NO_CHUNK) {
+        uint32_t index = free_chunks_;
+        free_chunks_ = chunks_[index].next;
+        return index;
+    }
+
+    uint32_t index = static_cast<uint32_t>(chunks_.size());
+    if (index % CHUNKS_PER_SLAB == 0) {
+        slabs_.emplace_back(new uint8_t[CHUNKS_PER_SLAB * chunk_size_]);
+    }
+    chunks_.push_back(Chunk{});
+    return index;
+}
+
+uint32_t StateStore::InternChunk(const uint8_t* data, uint32_t size) {
+    // Seed with the size so a short tail never matches a full chunk prefix
+    uint64_t hash = XXH64(data, size, size);
+
+    auto it = index_.find(hash);
+    uint32_t head = (it != index_.end()) ? it->second : NO_CHUNK;
+
+    // Verify contents: a hash match alone is not proof of equality
+    for (uint32_t i = head; i != NO_CHUNK; i = chunks_[i].next) {
+        if (chunks_[i].size == size && memcmp(ChunkData(i), data, size) == 0) {
+            chunks_[i].refs++;
+            return i;
+        }
+    }
+
+    uint32_t index = AllocateChunk();
+    memcpy(ChunkData(index), data, size);
+
+    Chunk& chunk = chunks_[index];
+    chunk.hash = hash;
+    chunk.size = size;
+    chunk.refs = 1;
+    chunk.next = head;
+    index_[hash] = index;
+    live_chunks_++;
+    return index;
+}
+
+void StateStore::ReleaseChunk(uint32_t index) {
+    Chunk& chunk = chunks_[index];
+    if (--chunk.refs > 0) return;
+
+    // Unlink from the hash chain
+    auto it = index_.find(chunk.hash);
+    if (it->second == index) {
+        if (chunk.next == NO_CHUNK) {
+            index_.erase(it);
+        } else {
+            it->second = chunk.next;
+        }
+    } else {
+        uint32_t prev = it->second;
+        while (chunks_[prev].next != index) {
+            prev = chunks_[prev].next;
+        }
+        chunks_[prev].next = chunk.next;
+    }
+
+    chunk.next = free_chunks_;
+    free_chunks_ = index;
+    live_chunks_--;
+}
+
+void StateStore::Assemble(const State& state, uint8_t* out) const {
+    for (uint32_t index : state.chunks) {
+        const Chunk& chunk = chunks_[index];
+        memcpy(out, ChunkData(index), chunk.size);
+        out += chunk.size;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Insert / Restore
+// ---------------------------------------------------------------------------
+
+StateStore::StateId StateStore::Insert(const uint8_t* data, size_t size) {
+    if (!data || size == 0 || size > UINT32_MAX) return INVALID_STATE;
+
+    StateId id;
+    if (!free_states_.empty()) {
+        id = free_states_.back();
+        free_states_.pop_back();
+    } else {
+        id = static_cast<StateId>(states_.size());
+        states_.emplace_back();
+    }
+
+    State& state = states_[id];
+    state.chunks.clear();
+    state.chunks.reserve((size + chunk_size_ - 1) / chunk_size_);
+
+    for (size_t offset = 0; offset < size; offset += chunk_size_) {
+        uint32_t n = static_cast<uint32_t>(std::min(chunk_size_, size - offset));
+        state.chunks.push_back(InternChunk(data + offset, n));
+    }
+
+    state.size = static_cast<uint32_t>(size);
+    state.live = true;
+    state_count_++;
+    chunk_refs_ += state.chunks.size();
+    logical_bytes_ += size;
+    return id;
+}
+
+StateStore::StateId StateStore::Insert(const Snapshot& snapshot) {
+    return Insert(snapshot.GetData(), snapshot.GetSize());
+}
+
+StateStore::StateId StateStore::Insert(const Emulator& emu) {
+    if (!emu.SaveSnapshot(scratch_)) return INVALID_STATE;
+    return Insert(scratch_);
+}
+
+bool StateStore::Restore(StateId id, Snapshot& snapshot) const {
+    if (!Contains(id)) return false;
+
+    const State& state = states_[id];
+    snapshot.Reserve(state.size);
+    Assemble(state, snapshot.arena_.get());
+    snapshot.size_ = state.size;
+    return true;
+}
+
+bool StateStore::Restore(StateId id, Emulator& emu) {
+    if (!Restore(id, scratch_)) return false;
+    return emu.RestoreSnapshot(scratch_);
+}
+
+std::vector<uint8_t> StateStore::Get(StateId id) const {
+    std::vector<uint8_t> data;
+    if (Contains(id)) {
+        data.resize(states_[id].size);
+        Assemble(states_[id], data.data());
+    }
+    return data;
+}
+
+bool StateStore::Remove(StateId id) {
+    if (!Contains(id)) return false;
+
+    State& state = states_[id];
+    for (uint32_t index : state.chunks) {
+        ReleaseChunk(index);
+    }
+
+    state_count_--;
+    chunk_refs_ -= state.chunks.size();
+    logical_bytes_ -= state.size;
+
+    // Release the reference list too: removed ids may stay unused for a while
+    std::vector<uint32_t>().swap(state.chunks);
+    state.size = 0;
+    state.live = false;
+    free_states_.push_back(id);
+    return true;
+}
+
+bool StateStore::Contains(StateId id) const {
+    return id < states_.size() && states_[id].live;
+}
+
+size_t StateStore::GetStateSize(StateId id) const {
+    return Contains(id) ? states_[id].size : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Stats
+// ---------------------------------------------------------------------------
+
+StateStore::Stats StateStore::GetStats() const {
+    Stats stats;
+    stats.state_count = state_count_;
+    stats.chunk_count = live_chunks_;
+    stats.chunk_refs = chunk_refs_;
+    stats.logical_bytes = logical_bytes_;
+    stats.stored_bytes = static_cast<uint64_t>(slabs_.size()) * CHUNKS_PER_SLAB * chunk_size_;
+
+    uint64_t overhead = chunks_.capacity() * sizeof(Chunk);
+    overhead += states_.capacity() * sizeof(State);
+    overhead += free_states_.capacity() * sizeof(StateId);
+    overhead += slabs_.capacity() * sizeof(slabs_[0]);
+    for (const State& state : states_) {
+        overhead += state.chunks.capacity() * sizeof(uint32_t);
+    }
+    // unordered_map: one node per entry plus the bucket array
+    overhead += index_.size() * (sizeof(std::pair<const uint64_t, uint32_t>) + 2 * sizeof(void*));
+    overhead += index_.bucket_count() * sizeof(void*);
+    stats.overhead_bytes = overhead;
+
+    return stats;
+}
+
+void StateStore::Clear() {
+    // Swap with empty containers so capacity is released as well
+    std::vector<std::unique_ptr<uint8_t[]>>().swap(slabs_);
+    std::vector<Chunk>().swap(chunks_);
+    std::unordered_map<uint64_t, uint32_t>().swap(index_);
+    free_chunks_ = NO_CHUNK;
+    live_chunks_ = 0;
+
+    std::vector<State>().swap(states_);
+    std::vector<StateId>().swap(free_states_);
+    state_count_ = 0;
+    chunk_refs_ = 0;
+    logical_bytes_ = 0;
+}
+
+} // namespace GX
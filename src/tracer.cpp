@@ -0,0 +1,577 @@
+/**
+ * tracer.cpp - Compact binary 68k instruction trace recorder
+ *
+ * Stream format (per chunk, before compression). Each record starts with a
+ * varint header whose low 2 bits give the record type:
+ *
+ *   INSN       header = zigzag(pc delta) << 2 | 0, varint cycle delta,
+ *              opcode (2 bytes, big-endian)
+ *   INSN_REGS  as INSN with type 1, then a varint mask of the registers that
+ *              changed (D0-D7, A0-A7, SR) and a zigzag varint delta for each
+ *   FRAME      header = 2, end of a frame
+ *   KEYFRAME   header = 3, then the decoder state as varints: frame,
+ *              instruction index, cycle, pc and (if recorded) all registers
+ *
+ * Every chunk starts with a keyframe, so chunks decode independently.
+ *
+ * Trace file: "GXTRACE1", u32 flags (bit 0 = registers), then per chunk a
+ * header (u64 first instruction, u32 instruction count, u32 first frame,
+ * u32 frame count, u32 raw size, u32 compressed size) and the compressed data.
+ * All integers are little-endian.
+ */
+
+#include "tracer.h"
+#include <cstring>
+
+// Genesis Plus GX headers (C linkage)
+extern "C" {
+#include "shared.h"
+#include "cpuhook.h"
+}
+
+// Vendored zlib
+#include "zlib.h"
+
+namespace GX {
+
+namespace {
+
+enum : uint8_t {
+    REC_INSN = 0,
+    REC_INSN_REGS = 1,
+    REC_FRAME = 2,
+    REC_KEYFRAME = 3,
+};
+
+constexpr int NUM_REGS = 17;            // D0-D7, A0-A7, SR
+constexpr size_t MAX_RECORD = 128;      // Largest record (keyframe with registers)
+constexpr size_t MIN_CHUNK_SIZE = 4096;
+constexpr char FILE_MAGIC[8] = {'G', 'X', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr uint32_t FLAG_REGISTERS = 1;
+constexpr size_t CHUNK_HEADER_SIZE = 28;
+
+inline uint8_t* PutVarint(uint8_t* p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(value);
+    return p;
+}
+
+inline uint32_t ZigZag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t UnZigZag(uint32_t value) {
+    return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+void PutLE(uint8_t* p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint64_t GetLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+// Hook subscriber callback - 68k instructions and frame ends
+void TracerHook(void* param, hook_type_t type, int /*width*/,
+                unsigned int address, unsigned int value) {
+    Tracer* tracer = static_cast<Tracer*>(param);
+    if (type == HOOK_M68K_E) {
+        tracer->OnExecute(address);
+    } else {
+        tracer->OnFrameEnd(value);
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Tracer
+// ---------------------------------------------------------------------------
+
+Tracer::Tracer() {}
+
+Tracer::~Tracer() {
+    if (running_) {
+        Stop();
+    }
+}
+
+bool Tracer::Start(const TraceOptions& options) {
+    if (running_) return false;
+    return StartTrace(options);
+}
+
+bool Tracer::Start(const std::string& path, const TraceOptions& options) {
+    if (running_) return false;
+
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) return false;
+
+    uint8_t header[12];
+    memcpy(header, FILE_MAGIC, 8);
+    PutLE(header + 8, options.record_registers ? FLAG_REGISTERS : 0, 4);
+    if (fwrite(header, 1, sizeof(header), file_) != sizeof(header) || !StartTrace(options)) {
+        fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool Tracer::StartTrace(const TraceOptions& options) {
+    hook_id_ = cpu_hook_subscribe(HOOK_M68K_E | HOOK_FRAME, 0, 0xFFFFFF, TracerHook, this);
+    if (hook_id_ < 0) return false;  // All hook slots in use
+
+    record_registers_ = options.record_registers;
+    compression_level_ = options.compression_level;
+    chunk_size_ = options.chunk_size > MIN_CHUNK_SIZE ? options.chunk_size : MIN_CHUNK_SIZE;
+    chunk_limit_ = chunk_size_ - MAX_RECORD;
+    max_pending_ = options.max_pending_chunks > 0 ? options.max_pending_chunks : 1;
+
+    chunks_.clear();
+    raw_bytes_ = 0;
+    compressed_bytes_ = 0;
+    write_error_ = false;
+    stopping_ = false;
+
+    instructions_ = 0;
+    total_cycles_ = 0;
+    last_cycles_ = m68k.cycles;
+    last_pc_ = 0;
+    frame_ = 0;
+    if (record_registers_) {
+        ReadRegisters(regs_);
+    } else {
+        memset(regs_, 0, sizeof(regs_));
+    }
+
+    BeginChunk();
+    worker_ = std::thread(&Tracer::WorkerLoop, this);
+    running_ = true;
+    return true;
+}
+
+bool Tracer::Stop() {
+    if (!running_) return true;
+
+    cpu_hook_unsubscribe(hook_id_);
+    hook_id_ = -1;
+    running_ = false;
+
+    if (chunk_.instruction_count > 0 || chunk_.frame_count > 0) {
+        SubmitChunk();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_one();
+    worker_.join();
+
+    buffer_ = std::vector<uint8_t>();
+    free_buffers_.clear();
+    if (file_) {
+        if (fclose(file_) != 0) {
+            write_error_ = true;
+        }
+        file_ = nullptr;
+    }
+    return !write_error_;
+}
+
+uint64_t Tracer::GetRawBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return raw_bytes_;
+}
+
+uint64_t Tracer::GetCompressedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compressed_bytes_;
+}
+
+std::vector<TraceChunk> Tracer::GetChunks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chunks_;
+}
+
+void Tracer::ReadRegisters(uint32_t* regs) const {
+    memcpy(regs, m68k.dar, 16 * sizeof(uint32_t));
+    regs[16] = m68k_get_reg(M68K_REG_SR);
+}
+
+void Tracer::OnExecute(uint32_t pc) {
+    if (pos_ > chunk_limit_) {
+        SubmitChunk();
+        BeginChunk();
+    }
+
+    int64_t now = m68k.cycles;
+    int64_t delta = now - last_cycles_;
+    last_cycles_ = now;
+    if (delta < 0) delta = 0;  // Counter reloaded (state load, reset)
+    total_cycles_ += delta;
+
+    uint64_t pc_delta = ZigZag(static_cast<int32_t>(pc - last_pc_));
+    last_pc_ = pc;
+    uint16_t opcode = *reinterpret_cast<const uint16_t*>(
+        m68k.memory_map[(pc >> 16) & 0xFF].base + (pc & 0xFFFF));
+
+    uint8_t* p = buffer_.data() + pos_;
+    if (record_registers_) {
+        uint32_t regs[NUM_REGS];
+        ReadRegisters(regs);
+        uint32_t mask = 0;
+        for (int i = 0; i < NUM_REGS; i++) {
+            if (regs[i] != regs_[i]) mask |= 1u << i;
+        }
+        p = PutVarint(p, (pc_delta << 2) | (mask ? REC_INSN_REGS : REC_INSN));
+        p = PutVarint(p, static_cast<uint64_t>(delta));
+        *p++ = static_cast<uint8_t>(opcode >> 8);
+        *p++ = static_cast<uint8_t>(opcode);
+        if (mask) {
+            p = PutVarint(p, mask);
+            for (int i = 0; i < NUM_REGS; i++) {
+                if (mask & (1u << i)) {
+                    p = PutVarint(p, ZigZag(static_cast<int32_t>(regs[i] - regs_[i])));
+                    regs_[i] = regs[i];
+                }
+            }
+        }
+    } else {
+        p = PutVarint(p, (pc_delta << 2) | REC_INSN);
+        p = PutVarint(p, static_cast<uint64_t>(delta));
+        *p++ = static_cast<uint8_t>(opcode >> 8);
+        *p++ = static_cast<uint8_t>(opcode);
+    }
+    pos_ = p - buffer_.data();
+
+    chunk_.instruction_count++;
+    instructions_++;
+}
+
+void Tracer::OnFrameEnd(uint32_t frame_cycles) {
+    if (pos_ > chunk_limit_) {
+        SubmitChunk();
+        BeginChunk();
+    }
+    buffer_[pos_++] = REC_FRAME;
+    chunk_.frame_count++;
+    frame_++;
+
+    // Cycle counters are rewound by the frame length once the frame ends
+    last_cycles_ -= frame_cycles;
+}
+
+void Tracer::BeginChunk() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_buffers_.empty()) {
+            buffer_ = std::move(free_buffers_.back());
+            free_buffers_.pop_back();
+        }
+    }
+    buffer_.resize(chunk_size_);
+
+    chunk_ = TraceChunk();
+    chunk_.first_instruction = instructions_;
+    chunk_.first_frame = frame_;
+
+    uint8_t* p = buffer_.data();
+    *p++ = REC_KEYFRAME;
+    p = PutVarint(p, frame_);
+    p = PutVarint(p, instructions_);
+    p = PutVarint(p, total_cycles_);
+    p = PutVarint(p, last_pc_);
+    if (record_registers_) {
+        for (int i = 0; i < NUM_REGS; i++) {
+            p = PutVarint(p, regs_[i]);
+        }
+    }
+    pos_ = p - buffer_.data();
+}
+
+void Tracer::SubmitChunk() {
+    PendingChunk pending;
+    pending.info = chunk_;
+    pending.info.raw_size = static_cast<uint32_t>(pos_);
+    pending.data = std::move(buffer_);
+    buffer_ = std::vector<uint8_t>();
+
+    // Wait for the compression thread when it falls behind (bounded memory)
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [this] { return queue_.size() < max_pending_; });
+    queue_.push_back(std::move(pending));
+    lock.unlock();
+    work_cv_.notify_one();
+}
+
+void Tracer::WorkerLoop() {
+    std::vector<uint8_t> compressed;
+    for (;;) {
+        PendingChunk pending;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+            if (queue_.empty()) return;
+            pending = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        space_cv_.notify_one();
+
+        TraceChunk& info = pending.info;
+        uLongf size = compressBound(info.raw_size);
+        compressed.resize(size);
+        if (compress2(compressed.data(), &size, pending.data.data(), info.raw_size,
+                      compression_level_) != Z_OK) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            write_error_ = true;
+            continue;
+        }
+        info.compressed_size = static_cast<uint32_t>(size);
+
+        bool write_ok = true;
+        if (file_) {
+            uint8_t header[CHUNK_HEADER_SIZE];
+            PutLE(header, info.first_instruction, 8);
+            PutLE(header + 8, info.instruction_count, 4);
+            PutLE(header + 12, info.first_frame, 4);
+            PutLE(header + 16, info.frame_count, 4);
+            PutLE(header + 20, info.raw_size, 4);
+            PutLE(header + 24, info.compressed_size, 4);
+            write_ok = fwrite(header, 1, sizeof(header), file_) == sizeof(header);
+            info.file_offset = static_cast<uint64_t>(ftell(file_));
+            write_ok = write_ok && fwrite(compressed.data(), 1, size, file_) == size;
+        } else {
+            info.data = std::make_shared<const std::vector<uint8_t>>(
+                compressed.begin(), compressed.begin() + size);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        write_error_ = write_error_ || !write_ok;
+        chunks_.push_back(info);
+        raw_bytes_ += info.raw_size;
+        compressed_bytes_ += info.compressed_size;
+        if (free_buffers_.size() < 2) {
+            free_buffers_.push_back(std::move(pending.data));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// TraceReader
+// ---------------------------------------------------------------------------
+
+TraceReader::TraceReader() {}
+
+TraceReader::~TraceReader() {
+    Close();
+}
+
+bool TraceReader::Open(const std::string& path) {
+    Close();
+
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) return false;
+
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), file_) != sizeof(header) ||
+        memcmp(header, FILE_MAGIC, 8) != 0) {
+        Close();
+        return false;
+    }
+    has_registers_ = (GetLE(header + 8, 4) & FLAG_REGISTERS) != 0;
+
+    // Build the chunk index; data is read when a chunk is decoded
+    uint8_t chunk_header[CHUNK_HEADER_SIZE];
+    while (fread(chunk_header, 1, sizeof(chunk_header), file_) == sizeof(chunk_header)) {
+        TraceChunk chunk;
+        chunk.first_instruction = GetLE(chunk_header, 8);
+        chunk.instruction_count = static_cast<uint32_t>(GetLE(chunk_header + 8, 4));
+        chunk.first_frame = static_cast<uint32_t>(GetLE(chunk_header + 12, 4));
+        chunk.frame_count = static_cast<uint32_t>(GetLE(chunk_header + 16, 4));
+        chunk.raw_size = static_cast<uint32_t>(GetLE(chunk_header + 20, 4));
+        chunk.compressed_size = static_cast<uint32_t>(GetLE(chunk_header + 24, 4));
+        chunk.file_offset = static_cast<uint64_t>(ftell(file_));
+        if (fseek(file_, chunk.compressed_size, SEEK_CUR) != 0) break;
+        chunks_.push_back(chunk);
+    }
+
+    Rewind();
+    return true;
+}
+
+bool TraceReader::Open(const Tracer& tracer) {
+    Close();
+    if (tracer.IsRunning()) return false;
+
+    std::vector<TraceChunk> chunks = tracer.GetChunks();
+    for (const auto& chunk : chunks) {
+        if (!chunk.data) return false;  // Traced into a file
+    }
+    chunks_ = std::move(chunks);
+    has_registers_ = tracer.HasRegisters();
+    Rewind();
+    return true;
+}
+
+void TraceReader::Close() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    chunks_.clear();
+    raw_.clear();
+    compressed_.clear();
+    has_registers_ = false;
+    Rewind();
+}
+
+uint64_t TraceReader::GetInstructionCount() const {
+    if (chunks_.empty()) return 0;
+    return chunks_.back().first_instruction + chunks_.back().instruction_count;
+}
+
+uint32_t TraceReader::GetFrameCount() const {
+    if (chunks_.empty()) return 0;
+    return chunks_.back().first_frame + chunks_.back().frame_count;
+}
+
+void TraceReader::Rewind() {
+    chunk_index_ = 0;
+    chunk_loaded_ = false;
+    skip_until_frame_ = 0;
+}
+
+bool TraceReader::SeekFrame(uint32_t frame) {
+    // First chunk that reaches the frame (it may start in an earlier one)
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        if (chunks_[i].first_frame + chunks_[i].frame_count >= frame) {
+            chunk_index_ = i;
+            chunk_loaded_ = false;
+            skip_until_frame_ = frame;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceReader::LoadChunk(size_t index) {
+    if (index >= chunks_.size()) return false;
+    const TraceChunk& chunk = chunks_[index];
+
+    const uint8_t* src;
+    if (chunk.data) {
+        src = chunk.data->data();
+    } else {
+        compressed_.resize(chunk.compressed_size);
+        if (!file_ ||
+            fseek(file_, static_cast<long>(chunk.file_offset), SEEK_SET) != 0 ||
+            fread(compressed_.data(), 1, chunk.compressed_size, file_) != chunk.compressed_size) {
+            return false;
+        }
+        src = compressed_.data();
+    }
+
+    raw_.resize(chunk.raw_size);
+    uLongf size = chunk.raw_size;
+    if (uncompress(raw_.data(), &size, src, chunk.compressed_size) != Z_OK ||
+        size != chunk.raw_size) {
+        return false;
+    }
+
+    chunk_index_ = index;
+    chunk_loaded_ = true;
+    pos_ = 0;
+    return true;
+}
+
+bool TraceReader::ReadVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos_ >= raw_.size()) return false;
+        uint8_t byte = raw_[pos_++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool TraceReader::Next(TraceEvent& event) {
+    for (;;) {
+        if (!chunk_loaded_ || pos_ >= raw_.size()) {
+            if (!LoadChunk(chunk_loaded_ ? chunk_index_ + 1 : chunk_index_)) return false;
+            continue;
+        }
+
+        uint64_t header;
+        if (!ReadVarint(header)) return false;
+
+        uint64_t value;
+        switch (header & 3) {
+            case REC_KEYFRAME:
+                if (!ReadVarint(value)) return false;
+                frame_ = static_cast<uint32_t>(value);
+                if (!ReadVarint(index_) || !ReadVarint(cycle_)) return false;
+                if (!ReadVarint(value)) return false;
+                pc_ = static_cast<uint32_t>(value);
+                if (has_registers_) {
+                    for (int i = 0; i < NUM_REGS; i++) {
+                        if (!ReadVarint(value)) return false;
+                        regs_[i] = static_cast<uint32_t>(value);
+                    }
+                }
+                continue;
+            case REC_FRAME:
+                frame_++;
+                continue;
+            default:
+                break;
+        }
+
+        uint64_t cycle_delta;
+        if (!ReadVarint(cycle_delta) || pos_ + 2 > raw_.size()) return false;
+        uint16_t opcode = static_cast<uint16_t>((raw_[pos_] << 8) | raw_[pos_ + 1]);
+        pos_ += 2;
+
+        pc_ += UnZigZag(static_cast<uint32_t>(header >> 2));
+        cycle_ += cycle_delta;
+        if ((header & 3) == REC_INSN_REGS) {
+            uint64_t mask;
+            if (!ReadVarint(mask)) return false;
+            for (int i = 0; i < NUM_REGS; i++) {
+                if (mask & (1u << i)) {
+                    if (!ReadVarint(value)) return false;
+                    regs_[i] += UnZigZag(static_cast<uint32_t>(value));
+                }
+            }
+        }
+        uint64_t index = index_++;
+
+        if (frame_ < skip_until_frame_) continue;
+
+        event.index = index;
+        event.cycle = cycle_;
+        event.frame = frame_;
+        event.pc = pc_;
+        event.opcode = opcode;
+        event.has_registers = has_registers_;
+        if (has_registers_) {
+            memcpy(event.d, regs_, sizeof(event.d));
+            memcpy(event.a, regs_ + 8, sizeof(event.a));
+            event.sr = static_cast<uint16_t>(regs_[16]);
+        }
+        return true;
+    }
+}
+
+} // namespace GX
@@ -0,0 +1,297 @@
+/**
+ * vdp_profiler.cpp - Per-frame VDP workload counters
+ *
+ * DMA timeslices arrive as HOOK_VDP_DMA events before the core performs
+ * them. DMA from the 68k bus then writes through the same path as the data
+ * port, so the next VRAM / CRAM / VSRAM write events of such a timeslice are
+ * DMA writes, not CPU writes. Fills and copies write VDP memory directly and
+ * only show up as the DMA event.
+ */
+
+#include "vdp_profiler.h"
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+
+// Genesis Plus GX headers (C linkage)
+extern "C" {
+#include "shared.h"
+#include "cpuhook.h"
+}
+
+namespace GX {
+
+namespace {
+
+constexpr uint32_t MAX_DISPLAY_LINES = 480;   // Interlace mode 2
+
+void VdpProfilerHook(void* param, hook_type_t type, int width,
+                     unsigned int address, unsigned int value) {
+    VdpProfiler* vdp = static_cast<VdpProfiler*>(param);
+    switch (type) {
+        case HOOK_VDP_DMA:
+            vdp->OnDma(width, address, value);
+            break;
+        case HOOK_VDP_STALL:
+            vdp->OnStall(width, value);
+            break;
+        case HOOK_SPRITE_LINE:
+            vdp->OnSpriteLine(address, width, value);
+            break;
+        case HOOK_VRAM_W:
+            vdp->OnWrite(VdpTarget::Vram, width);
+            break;
+        case HOOK_CRAM_W:
+            vdp->OnWrite(VdpTarget::Cram, width);
+            break;
+        case HOOK_VSRAM_W:
+            vdp->OnWrite(VdpTarget::Vsram, width);
+            break;
+        case HOOK_FRAME:
+            vdp->OnFrameEnd();
+            break;
+        default:
+            break;
+    }
+}
+
+/** Target of a VDP write code (CD3-CD0), or false for reads and invalid codes */
+bool GetWriteTarget(uint32_t code, VdpTarget& target) {
+    switch (code) {
+        case 0x1: target = VdpTarget::Vram; return true;
+        case 0x3: target = VdpTarget::Cram; return true;
+        case 0x5: target = VdpTarget::Vsram; return true;
+        default: return false;
+    }
+}
+
+/** DMA kind of a DMA mode (register #23 bits 7-4), as dispatched by the core */
+VdpDmaKind GetDmaKind(uint32_t mode) {
+    if (mode < 4) return VdpDmaKind::Ext68k;
+    if (mode < 8) return VdpDmaKind::Ram68k;    // Mode 5 (I/O area) included
+    if (mode < 12) return VdpDmaKind::Fill;
+    return VdpDmaKind::Copy;
+}
+
+} // namespace
+
+const char* VdpDmaKindName(VdpDmaKind kind) {
+    switch (kind) {
+        case VdpDmaKind::Ext68k: return "68k ext";
+        case VdpDmaKind::Ram68k: return "68k ram";
+        case VdpDmaKind::Fill: return "fill";
+        case VdpDmaKind::Copy: return "copy";
+    }
+    return "?";
+}
+
+const char* VdpTargetName(VdpTarget target) {
+    switch (target) {
+        case VdpTarget::Vram: return "VRAM";
+        case VdpTarget::Cram: return "CRAM";
+        case VdpTarget::Vsram: return "VSRAM";
+    }
+    return "?";
+}
+
+uint64_t VdpFrameStats::DmaBytes() const {
+    uint64_t total = 0;
+    for (uint64_t bytes : dma_bytes) {
+        total += bytes;
+    }
+    return total;
+}
+
+// ---------------------------------------------------------------------------
+// VdpProfiler
+// ---------------------------------------------------------------------------
+
+VdpProfiler::VdpProfiler() = default;
+
+VdpProfiler::~VdpProfiler() {
+    if (running_) {
+        Stop();
+    }
+}
+
+bool VdpProfiler::Start() {
+    if (running_) return false;
+
+    hook_id_ = cpu_hook_subscribe(HOOK_VDP_DMA | HOOK_VDP_STALL | HOOK_SPRITE_LINE |
+                                  HOOK_VRAM_W | HOOK_CRAM_W | HOOK_VSRAM_W | HOOK_FRAME,
+                                  0, 0xFFFFFF, VdpProfilerHook, this);
+    if (hook_id_ < 0) return false;  // All hook slots in use
+
+    current_ = VdpFrameStats();
+    current_.frame = frames_.size();
+    dma_in_progress_ = dma_length != 0;
+    pending_dma_words_ = 0;
+    running_ = true;
+    return true;
+}
+
+void VdpProfiler::Stop() {
+    if (!running_) return;
+    cpu_hook_unsubscribe(hook_id_);
+    hook_id_ = -1;
+    running_ = false;
+}
+
+void VdpProfiler::Reset() {
+    frames_.clear();
+    current_ = VdpFrameStats();
+}
+
+VdpFrameStats VdpProfiler::GetTotals(uint64_t first, uint64_t last) const {
+    VdpFrameStats totals;
+    last = std::min<uint64_t>(last, frames_.size());
+    totals.frame = first;
+    for (uint64_t i = first; i < last; i++) {
+        const VdpFrameStats& frame = frames_[i];
+        for (size_t k = 0; k < VDP_DMA_KIND_COUNT; k++) {
+            totals.dma_transfers[k] += frame.dma_transfers[k];
+            totals.dma_bytes[k] += frame.dma_bytes[k];
+        }
+        totals.dma_active_bytes += frame.dma_active_bytes;
+        totals.fifo_stall_cycles += frame.fifo_stall_cycles;
+        totals.dma_stall_cycles += frame.dma_stall_cycles;
+        for (size_t t = 0; t < VDP_TARGET_COUNT; t++) {
+            totals.cpu_write_bytes[t] += frame.cpu_write_bytes[t];
+            totals.dma_write_bytes[t] += frame.dma_write_bytes[t];
+        }
+        totals.max_sprites = std::max(totals.max_sprites, frame.max_sprites);
+        totals.max_sprite_pixels = std::max(totals.max_sprite_pixels, frame.max_sprite_pixels);
+        totals.sprite_overflow_lines += frame.sprite_overflow_lines;
+        totals.pixel_overflow_lines += frame.pixel_overflow_lines;
+    }
+    return totals;
+}
+
+void VdpProfiler::OnDma(uint32_t mode, uint32_t target, uint32_t length) {
+    VdpDmaKind kind = GetDmaKind(mode);
+    size_t k = static_cast<size_t>(kind);
+    if (!dma_in_progress_) {
+        current_.dma_transfers[k]++;
+    }
+    dma_in_progress_ = dma_length != 0;  // Already updated for this timeslice
+
+    VdpTarget write_target = VdpTarget::Vram;
+    bool valid = GetWriteTarget(target >> 16, write_target);
+    uint64_t bytes;
+    if (kind == VdpDmaKind::Copy) {
+        bytes = length;
+        write_target = VdpTarget::Vram;
+        valid = true;
+    } else if (kind == VdpDmaKind::Fill) {
+        bytes = write_target == VdpTarget::Vram ? length : 2ull * length;
+    } else {
+        bytes = 2ull * length;
+        if (valid) {
+            pending_dma_words_ += length;
+        }
+    }
+
+    current_.dma_bytes[k] += bytes;
+    if (!(status & 8) && (reg[1] & 0x40)) {
+        current_.dma_active_bytes += bytes;
+    }
+    if (valid) {
+        current_.dma_write_bytes[static_cast<size_t>(write_target)] += bytes;
+    }
+}
+
+void VdpProfiler::OnStall(uint32_t reason, uint32_t cycles) {
+    if (reason == 0) {
+        current_.fifo_stall_cycles += cycles;
+    } else {
+        current_.dma_stall_cycles += cycles;
+    }
+}
+
+void VdpProfiler::OnWrite(VdpTarget target, uint32_t width) {
+    if (pending_dma_words_ > 0) {
+        pending_dma_words_--;  // Counted by OnDma()
+        return;
+    }
+    current_.cpu_write_bytes[static_cast<size_t>(target)] += width;
+}
+
+void VdpProfiler::OnSpriteLine(uint32_t line, uint32_t sprites, uint32_t pixels) {
+    if (line >= MAX_DISPLAY_LINES) return;
+    if (current_.sprites_per_line.size() <= line) {
+        current_.sprites_per_line.resize(line + 1, 0);
+        current_.sprite_pixels_per_line.resize(line + 1, 0);
+    }
+    current_.sprites_per_line[line] = static_cast<uint8_t>(sprites);
+    current_.sprite_pixels_per_line[line] = static_cast<uint16_t>(pixels);
+    current_.max_sprites = std::max(current_.max_sprites, sprites);
+    current_.max_sprite_pixels = std::max(current_.max_sprite_pixels, pixels);
+    if (sprites > static_cast<uint32_t>(bitmap.viewport.w >> 4)) {
+        current_.sprite_overflow_lines++;
+    }
+    if (pixels > max_sprite_pixels) {
+        current_.pixel_overflow_lines++;
+    }
+}
+
+void VdpProfiler::OnFrameEnd() {
+    pending_dma_words_ = 0;
+    size_t lines = current_.sprites_per_line.size();
+    frames_.push_back(std::move(current_));
+    current_ = VdpFrameStats();
+    current_.frame = frames_.size();
+    current_.sprites_per_line.reserve(lines);
+    current_.sprite_pixels_per_line.reserve(lines);
+}
+
+void VdpProfiler::PrintReport(std::ostream& out) const {
+    out << "\nVDP workload over " << frames_.size() << " frames\n";
+    if (frames_.empty()) return;
+
+    out << std::setw(30) << std::left << "Counter"
+        << std::setw(12) << std::right << "Avg/frame"
+        << std::setw(12) << "Peak"
+        << std::setw(10) << "Frame"
+        << "\n";
+    out << std::string(64, '-') << "\n";
+
+    auto row = [&](const std::string& name, const std::function<uint64_t(const VdpFrameStats&)>& value) {
+        uint64_t sum = 0, peak = 0, peak_frame = 0;
+        for (const VdpFrameStats& frame : frames_) {
+            uint64_t v = value(frame);
+            sum += v;
+            if (v > peak) {
+                peak = v;
+                peak_frame = frame.frame;
+            }
+        }
+        out << std::setw(30) << std::left << name
+            << std::setw(12) << std::right << sum / frames_.size()
+            << std::setw(12) << peak
+            << std::setw(10) << peak_frame
+            << "\n";
+    };
+
+    for (size_t k = 0; k < VDP_DMA_KIND_COUNT; k++) {
+        row(std::string("DMA ") + VdpDmaKindName(static_cast<VdpDmaKind>(k)) + " bytes",
+            [k](const VdpFrameStats& f) { return f.dma_bytes[k]; });
+    }
+    row("DMA bytes", [](const VdpFrameStats& f) { return f.DmaBytes(); });
+    row("DMA bytes in active display", [](const VdpFrameStats& f) { return f.dma_active_bytes; });
+    row("FIFO stall cycles", [](const VdpFrameStats& f) { return f.fifo_stall_cycles; });
+    row("DMA stall cycles", [](const VdpFrameStats& f) { return f.dma_stall_cycles; });
+    for (size_t t = 0; t < VDP_TARGET_COUNT; t++) {
+        std::string name = VdpTargetName(static_cast<VdpTarget>(t));
+        row(name + " CPU bytes", [t](const VdpFrameStats& f) { return f.cpu_write_bytes[t]; });
+        row(name + " DMA bytes", [t](const VdpFrameStats& f) { return f.dma_write_bytes[t]; });
+    }
+    row("Max sprites per line", [](const VdpFrameStats& f) { return f.max_sprites; });
+    row("Max sprite pixels per line", [](const VdpFrameStats& f) { return f.max_sprite_pixels; });
+
+    VdpFrameStats totals = GetTotals();
+    out << std::string(64, '-') << "\n";
+    out << "Sprite overflow lines: " << totals.sprite_overflow_lines
+        << ", pixel overflow lines: " << totals.pixel_overflow_lines << "\n";
+}
+
+} // namespace GX
@@ -0,0 +1,203 @@
+/**
+ * gxtest - Boot Cache Test
+ *
+ * Tests the per-ROM boot snapshot cache used by fixture SetUp.
+ * Verifies:
+ * 1. The first boot runs the script, later boots restore the cached state
+ * 2. A restored boot is identical to a fresh boot
+ * 3. Entries are keyed by ROM content, boot script and harness toggles
+ * 4. The on-disk cache is reused across processes and rejects bad entries
+ */
+
+#include <gxtest.h>
+#include "prime_sieve_rom.h"
+#include "symbol_example_rom.h"
+#include "symbol_example_symbols.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+class BootCacheTest : public GX::Test {
+protected:
+    void SetUp() override {
+        GX::Emulator::ClearBootCache();
+        saved_dir = GX::Emulator::GetBootCacheDir();
+        GX::Emulator::SetBootCacheDir("");
+    }
+
+    void TearDown() override {
+        GX::Emulator::ClearBootCache();
+        GX::Emulator::SetBootCacheDir(saved_dir);
+    }
+
+    bool BootSymbolExample(const GX::BootScript& script) {
+        return BootRom(SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE, script);
+    }
+
+    std::string saved_dir;
+};
+
+/**
+ * Test that only the first boot runs the script
+ */
+TEST_F(BootCacheTest, SecondBootHitsCache) {
+    int runs = 0;
+    GX::BootScript script{"counted", [&runs](GX::Emulator& e) {
+        runs++;
+        e.RunFrames(2);
+    }};
+
+    ASSERT_TRUE(BootSymbolExample(script));
+    ASSERT_TRUE(BootSymbolExample(script));
+    ASSERT_TRUE(BootSymbolExample(script));
+
+    EXPECT_EQ(runs, 1);
+    GX::BootCacheStats stats = GX::Emulator::GetBootCacheStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(GetFrameCount(), 2u);
+}
+
+/**
+ * Test that a cached boot is indistinguishable from a fresh boot
+ */
+TEST_F(BootCacheTest, RestoredBootMatchesFreshBoot) {
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    auto fresh = emu.SaveState();
+    uint16_t frame_counter = ReadWord(Sym::frame_count);
+
+    // Diverge, then boot again from the cache
+    RunFrames(10);
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().hits, 1u);
+
+    EXPECT_EQ(emu.SaveState(), fresh);
+    EXPECT_EQ(ReadWord(Sym::frame_count), frame_counter);
+
+    // Execution continues identically
+    RunFrames(30);
+    auto from_cache = emu.SaveState();
+    GX::Emulator::ClearBootCache();
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    RunFrames(30);
+    EXPECT_EQ(emu.SaveState(), from_cache);
+}
+
+/**
+ * Test that entries are keyed by script and by ROM content
+ */
+TEST_F(BootCacheTest, KeyedByScriptAndRom) {
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(1)));
+    uint16_t after_one = ReadWord(Sym::frame_count);
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    EXPECT_NE(ReadWord(Sym::frame_count), after_one);
+
+    ASSERT_TRUE(BootRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE, GX::BootScript::Frames(5)));
+    EXPECT_EQ(ReadWord(DONE_FLAG_ADDR), DONE_FLAG_VALUE);
+
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().misses, 3u);
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().hits, 0u);
+
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(1)));
+    EXPECT_EQ(ReadWord(Sym::frame_count), after_one);
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().hits, 1u);
+}
+
+/**
+ * Test that a boot captured under one skip setting is not reused under another
+ */
+TEST_F(BootCacheTest, KeyedByHarnessToggles) {
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+
+    GX::Emulator::SetIdleSkipEnabled(true);
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    GX::Emulator::SetIdleSkipEnabled(false);
+
+    GX::Emulator::SetSvpIdleSkipEnabled(false);
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    GX::Emulator::SetSvpIdleSkipEnabled(true);
+
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().misses, 3u);
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().hits, 0u);
+
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().hits, 1u);
+}
+
+/**
+ * Test that booting does not depend on what ran before in the process
+ * (cache entries must not capture leftover CPU registers)
+ */
+TEST_F(BootCacheTest, LoadRomIsDeterministic) {
+    ASSERT_TRUE(emu.LoadRom(SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE));
+    RunFrames(2);
+    auto first = emu.SaveState();
+
+    RunFrames(10);
+    ASSERT_TRUE(emu.LoadRom(SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE));
+    RunFrames(2);
+    EXPECT_EQ(emu.SaveState(), first);
+}
+
+/**
+ * Test that Boot() requires a loaded ROM
+ */
+TEST_F(BootCacheTest, RequiresRom) {
+    EXPECT_FALSE(emu.Boot(GX::BootScript::Frames(1)));
+}
+
+/**
+ * Test the on-disk cache: reuse across "processes" and corrupt entries
+ */
+TEST_F(BootCacheTest, DiskCache) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() /
+                   ("gxtest_boot_cache_" + std::to_string(std::random_device()()));
+    fs::create_directories(dir);
+    GX::Emulator::SetBootCacheDir(dir.string());
+
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    auto fresh = emu.SaveState();
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().misses, 1u);
+
+    std::vector<fs::path> files;
+    for (const auto& file : fs::directory_iterator(dir)) {
+        files.push_back(file.path());
+    }
+    ASSERT_EQ(files.size(), 1u) << "Expected exactly one cache entry on disk";
+
+    // Simulate a new process: in-memory cache gone, disk entry reused
+    GX::Emulator::ClearBootCache();
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().disk_hits, 1u);
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().misses, 0u);
+    EXPECT_EQ(emu.SaveState(), fresh);
+    EXPECT_EQ(GetFrameCount(), 2u);
+
+    // Truncated entry: falls back to booting (and rewrites the entry)
+    fs::resize_file(files[0], 64);
+    GX::Emulator::ClearBootCache();
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().misses, 1u);
+    EXPECT_EQ(emu.SaveState(), fresh);
+    EXPECT_GT(fs::file_size(files[0]), 64u);
+
+    // Entry from another core version: rejected
+    {
+        std::fstream file(files[0], std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(8);
+        file.write("OTHER-CORE 0.0.0", 16);
+    }
+    GX::Emulator::ClearBootCache();
+    ASSERT_TRUE(BootSymbolExample(GX::BootScript::Frames(2)));
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().disk_hits, 0u);
+    EXPECT_EQ(GX::Emulator::GetBootCacheStats().misses, 1u);
+
+    fs::remove_all(dir);
+}
+
+} // namespace
@@ -0,0 +1,283 @@
+/**
+ * gxtest - Cycle Budget Test
+ *
+ * Tests per-call cycle tracking and the cycle budget assertions using a small
+ * game loop: run an update of adjustable length, then wait for V-INT, whose
+ * handler also runs an adjustable delay.
+ * Verifies:
+ * 1. Per-call cycles and frames of a function, and their percentiles
+ * 2. Run lengths of the V-INT handler
+ * 3. EXPECT_FUNC_CYCLES_LE, EXPECT_FUNC_MAX_CALL_CYCLES_LE and the other
+ *    budget assertions, by name and by address
+ * 4. Failure messages naming the worst frame
+ */
+
+#include <gxtest.h>
+#include <profiler.h>
+#include <profiler_assertions.h>
+#include "rom_builder.h"
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// Program functions
+constexpr uint32_t FUNC_MAIN = 0x200;
+constexpr uint32_t FUNC_UPDATE = 0x220;
+constexpr uint32_t FUNC_UPDATE_END = 0x22C;
+constexpr uint32_t FUNC_WAIT_VBLANK = 0x240;
+constexpr uint32_t FUNC_WAIT_VBLANK_END = 0x250;
+constexpr uint32_t FUNC_VINT = 0x300;
+constexpr uint32_t FUNC_VINT_END = 0x316;
+
+// Work RAM variables, besides VINT_COUNTER
+constexpr uint32_t UPDATE_LOOPS = 0xFF0004;  // Word, delay loop count of update
+constexpr uint32_t VINT_LOOPS = 0xFF0008;    // Word, delay loop count of the V-INT handler
+
+// A dbra loop iteration takes 10 68k cycles (70 master cycles)
+constexpr double LOOP_CYCLES = 70.0;
+constexpr uint16_t LIGHT_UPDATE = 0x200;
+constexpr uint16_t HEAVY_UPDATE = 0x800;
+constexpr uint16_t LIGHT_VINT = 0x40;
+constexpr uint16_t HEAVY_VINT = 1500;        // About 12% of a frame
+
+/*
+ * main:        lea $C00004,a5; enable display and V-INT; loop { update; wait_vblank }
+ * update:      dbra UPDATE_LOOPS times
+ * wait_vblank: spin until VINT_COUNTER changes
+ * vint:        dbra VINT_LOOPS times, increment VINT_COUNTER
+ */
+std::vector<uint8_t> MakeBudgetRom() {
+    RomBuilder rom(FUNC_MAIN);
+    rom.SetVector(GX::VECTOR_VINT, FUNC_VINT);
+    rom.PutGameLoop(FUNC_MAIN, {FUNC_UPDATE, FUNC_WAIT_VBLANK});
+    rom.PutCode(FUNC_UPDATE, {
+        0x3039, 0x00FF, 0x0004,         // update: move.w $FF0004,d0
+        0x51C8, 0xFFFE,                 //        dbra    d0,*
+        0x4E75,                         //        rts
+    });
+    rom.PutWaitVBlank(FUNC_WAIT_VBLANK);
+    rom.PutCode(FUNC_VINT, {
+        0x2F00,                         // vint:  move.l  d0,-(sp)
+        0x3039, 0x00FF, 0x0008,         //        move.w  $FF0008,d0
+        0x51C8, 0xFFFE,                 //        dbra    d0,*
+        0x201F,                         //        move.l  (sp)+,d0
+        0x52B9, 0x00FF, 0x0000,         //        addq.l  #1,$FF0000
+        0x4E73,                         //        rte
+    });
+    return rom.Data();
+}
+
+class CycleBudgetTest : public ProfiledRomTest {
+protected:
+    std::vector<uint8_t> rom = MakeBudgetRom();
+
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+        profiler.AddFunction(FUNC_MAIN, FUNC_UPDATE, "main");
+        profiler.AddFunction(FUNC_UPDATE, FUNC_UPDATE_END, "update");
+        profiler.AddFunction(FUNC_WAIT_VBLANK, FUNC_WAIT_VBLANK_END, "wait_vblank");
+        profiler.AddFunction(FUNC_VINT, FUNC_VINT_END, "vint");
+
+        WriteWord(UPDATE_LOOPS, LIGHT_UPDATE);
+        WriteWord(VINT_LOOPS, LIGHT_VINT);
+        RunFrames(2);  // Past the setup code
+    }
+
+    void TearDown() override {
+        EXPECT_FALSE(profiler.IsRunning());
+        ProfiledRomTest::TearDown();
+    }
+
+    /** Profile frames one at a time, with the update length of each frame */
+    void ProfileUpdates(const std::vector<uint16_t>& loops) {
+        profiler.Reset();
+        profiler.Start(CallCycleOptions());
+        for (uint16_t count : loops) {
+            WriteWord(UPDATE_LOOPS, count);
+            RunFrames(1);
+        }
+        WriteWord(UPDATE_LOOPS, LIGHT_UPDATE);
+        profiler.Stop();
+    }
+};
+
+/**
+ * Test that every call is kept with its cycles and frame
+ */
+TEST_F(CycleBudgetTest, CallCycles) {
+    ProfileFrames(30);
+
+    const std::vector<GX::CallSample>& calls = profiler.GetCalls(FUNC_UPDATE);
+    ASSERT_EQ(calls.size(), 30u);
+    uint64_t total = 0;
+    for (size_t i = 0; i < calls.size(); i++) {
+        EXPECT_EQ(calls[i].frame, i);
+        EXPECT_NEAR(static_cast<double>(calls[i].cycles), LIGHT_UPDATE * LOOP_CYCLES,
+                    LIGHT_UPDATE * LOOP_CYCLES * 0.05);
+        total += calls[i].cycles;
+    }
+    const GX::FunctionStats* stats = profiler.GetStats(FUNC_UPDATE);
+    ASSERT_NE(stats, nullptr);
+    EXPECT_EQ(total, stats->cycles_inclusive);
+
+    GX::CallCycleStats update = CallCycles("update");
+    EXPECT_EQ(update.calls, 30u);
+    EXPECT_EQ(update.total_cycles, total);
+    EXPECT_LE(update.min_cycles, update.p50);
+    EXPECT_LE(update.p50, update.p90);
+    EXPECT_LE(update.p90, update.p99);
+    EXPECT_LE(update.p99, update.max_cycles);
+    EXPECT_NEAR(update.Average(), LIGHT_UPDATE * LOOP_CYCLES, LIGHT_UPDATE * LOOP_CYCLES * 0.05);
+
+    // wait_vblank spins through most of each frame; the last call returns
+    // after the V-INT of the next frame, so it is still running
+    EXPECT_EQ(profiler.GetCalls(FUNC_WAIT_VBLANK).size(), 29u);
+    EXPECT_GT(CallCycles("wait_vblank").min_cycles, 600000u);
+
+    // Exception handlers are kept by vector
+    EXPECT_TRUE(profiler.GetCalls(FUNC_VINT).empty());
+    const std::vector<GX::CallSample>& vint = profiler.GetInterruptCalls(GX::VECTOR_VINT);
+    ASSERT_EQ(vint.size(), 30u);
+    for (size_t i = 0; i < vint.size(); i++) {
+        EXPECT_EQ(vint[i].frame, i);
+        // Plus the exception entry, the register save and the counter update
+        EXPECT_GT(vint[i].cycles, LIGHT_VINT * LOOP_CYCLES);
+        EXPECT_LT(vint[i].cycles, LIGHT_VINT * LOOP_CYCLES + 2000);
+    }
+
+    // Reset discards the calls
+    profiler.Reset();
+    EXPECT_TRUE(profiler.GetCalls(FUNC_UPDATE).empty());
+    EXPECT_TRUE(profiler.GetInterruptCalls(GX::VECTOR_VINT).empty());
+    EXPECT_EQ(CallCycles("update").calls, 0u);
+}
+
+/**
+ * Test nearest-rank percentiles over calls of increasing length
+ */
+TEST_F(CycleBudgetTest, Percentiles) {
+    std::vector<uint16_t> loops;
+    for (uint16_t i = 1; i <= 20; i++) {
+        loops.push_back(i * 0x40);
+    }
+    ProfileUpdates(loops);
+
+    const std::vector<GX::CallSample>& calls = profiler.GetCalls(FUNC_UPDATE);
+    ASSERT_EQ(calls.size(), 20u);
+    GX::CallCycleStats stats = profiler.GetCallCycles(FUNC_UPDATE);
+    EXPECT_EQ(stats.min_cycles, calls[0].cycles);
+    EXPECT_EQ(stats.max_cycles, calls[19].cycles);
+    EXPECT_EQ(stats.max_frame, 19u);
+    EXPECT_EQ(stats.p50, calls[9].cycles);   // 10th of 20
+    EXPECT_EQ(stats.p90, calls[17].cycles);  // 18th
+    EXPECT_EQ(stats.p99, calls[19].cycles);
+    EXPECT_EQ(GX::CallCyclesPercentile(calls, 0), stats.min_cycles);
+    EXPECT_EQ(GX::CallCyclesPercentile(calls, 100), stats.max_cycles);
+    EXPECT_EQ(GX::CallCyclesPercentile(calls, 25), calls[4].cycles);
+    EXPECT_EQ(GX::CallCyclesPercentile({}, 50), 0u);
+    EXPECT_NEAR(static_cast<double>(stats.p50), 10 * 0x40 * LOOP_CYCLES, 10 * 0x40 * LOOP_CYCLES * 0.05);
+}
+
+/**
+ * Test the budget assertions on a run within budget
+ */
+TEST_F(CycleBudgetTest, WithinBudget) {
+    ProfileFrames(30);
+
+    const uint64_t per_call = static_cast<uint64_t>(LIGHT_UPDATE * LOOP_CYCLES * 1.1);
+    EXPECT_FUNC_CYCLES_LE(profiler, "update", 30 * per_call);
+    EXPECT_FUNC_CYCLES_LE(profiler, FUNC_UPDATE, 30 * per_call);
+    EXPECT_FUNC_AVG_CALL_CYCLES_LE(profiler, "update", per_call);
+    EXPECT_FUNC_MAX_CALL_CYCLES_LE(profiler, "update", per_call);
+    EXPECT_FUNC_MAX_CALL_CYCLES_LE(profiler, FUNC_UPDATE, per_call);
+    EXPECT_FUNC_CALL_PERCENTILE_LE(profiler, "update", 99, per_call);
+    EXPECT_INTERRUPT_LOAD_LE(profiler, GX::VECTOR_VINT, 0.10);
+
+    // Under budget by less than the cycles used
+    EXPECT_FALSE(GX::FuncCyclesLE(profiler, "update", 30 * per_call / 2));
+    EXPECT_FALSE(GX::FuncMaxCallCyclesLE(profiler, "update", per_call / 2));
+}
+
+/**
+ * Test that a slow call fails the per-call budgets, naming its frame
+ */
+TEST_F(CycleBudgetTest, SlowCall) {
+    std::vector<uint16_t> loops(20, LIGHT_UPDATE);
+    loops[10] = HEAVY_UPDATE;
+    ProfileUpdates(loops);
+
+    const uint64_t per_call = static_cast<uint64_t>(LIGHT_UPDATE * LOOP_CYCLES * 1.1);
+    EXPECT_FUNC_CALL_PERCENTILE_LE(profiler, "update", 90, per_call);
+
+    ::testing::AssertionResult max = GX::FuncMaxCallCyclesLE(profiler, "update", per_call);
+    EXPECT_FALSE(max);
+    std::string message = max.message();
+    EXPECT_NE(message.find("1 of 20 call(s) of update"), std::string::npos) << message;
+    EXPECT_NE(message.find("in frame 10"), std::string::npos) << message;
+    EXPECT_NE(message.find("\n  frame 10: 1 call(s) over"), std::string::npos) << message;
+
+    ::testing::AssertionResult p99 = GX::FuncCallPercentileLE(profiler, "update", 99, per_call);
+    EXPECT_FALSE(p99);
+    message = p99.message();
+    EXPECT_NE(message.find("p99 of update"), std::string::npos) << message;
+    EXPECT_NE(message.find("\n  frame 10:"), std::string::npos) << message;
+
+    // The average absorbs one slow call in 20
+    EXPECT_FUNC_AVG_CALL_CYCLES_LE(profiler, "update", per_call * 1.5);
+    ::testing::AssertionResult avg = GX::FuncAvgCallCyclesLE(profiler, "update", per_call);
+    EXPECT_FALSE(avg);
+    EXPECT_NE(std::string(avg.message()).find("slowest call: "), std::string::npos) << avg.message();
+
+    ::testing::AssertionResult total = GX::FuncCyclesLE(profiler, FUNC_UPDATE, 20 * per_call);
+    EXPECT_FALSE(total);
+    message = total.message();
+    EXPECT_NE(message.find("update used "), std::string::npos) << message;
+    EXPECT_NE(message.find("inclusive cycles"), std::string::npos) << message;
+    EXPECT_NE(message.find("worst frame 10: "), std::string::npos) << message;
+}
+
+/**
+ * Test that a long V-INT handler run fails the interrupt load budget
+ */
+TEST_F(CycleBudgetTest, VintOverBudget) {
+    profiler.Start(CallCycleOptions());
+    RunFrames(5);
+    WriteWord(VINT_LOOPS, HEAVY_VINT);
+    RunFrames(1);                    // Frame 5 starts with the long V-INT
+    WriteWord(VINT_LOOPS, LIGHT_VINT);
+    RunFrames(4);
+    profiler.Stop();
+
+    EXPECT_INTERRUPT_LOAD_LE(profiler, GX::VECTOR_VINT, 0.15);
+    ::testing::AssertionResult result = GX::InterruptLoadLE(profiler, GX::VECTOR_VINT, 0.10);
+    EXPECT_FALSE(result);
+    std::string message = result.message();
+    EXPECT_NE(message.find("1 of 10 V-INT run(s) over 10% of a frame"), std::string::npos) << message;
+    EXPECT_NE(message.find("\n  frame 5: "), std::string::npos) << message;
+}
+
+/**
+ * Test the failure messages when there is nothing to check
+ */
+TEST_F(CycleBudgetTest, MissingData) {
+    EXPECT_FALSE(GX::FuncCyclesLE(profiler, "nope", 1000));
+    EXPECT_NE(std::string(GX::FuncCyclesLE(profiler, "nope", 1000).message()).find("No function nope"),
+              std::string::npos);
+    EXPECT_NE(std::string(GX::FuncMaxCallCyclesLE(profiler, 0x1234u, 1000).message()).find("$001234"),
+              std::string::npos);
+
+    // Simple mode keeps no calls; the total budget still works on exclusive cycles
+    ProfileFrames(5, GX::ProfileOptions());
+    ::testing::AssertionResult result = GX::FuncMaxCallCyclesLE(profiler, "update", 1000000);
+    EXPECT_FALSE(result);
+    EXPECT_NE(std::string(result.message()).find("No completed calls of update"), std::string::npos)
+        << result.message();
+    EXPECT_FALSE(GX::InterruptLoadLE(profiler, GX::VECTOR_VINT, 1.0));
+    EXPECT_FUNC_CYCLES_LE(profiler, "update", static_cast<uint64_t>(5 * LIGHT_UPDATE * LOOP_CYCLES * 1.1));
+    EXPECT_FALSE(GX::FuncCyclesLE(profiler, "update", 1000));
+    EXPECT_NE(std::string(GX::FuncCyclesLE(profiler, "update", 1000).message()).find("exclusive cycles"),
+              std::string::npos);
+}
+
+} // namespace
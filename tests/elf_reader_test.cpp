@@ -0,0 +1,584 @@
+/**
+ * gxtest - ELF Reader Test
+ *
+ * Tests the in-process ELF symbol and DWARF line table reader using ELF
+ * images built in memory: the prime sieve ROM's symbols plus line tables in
+ * DWARF 4 and DWARF 5 form.
+ * Verifies:
+ * 1. Symbol table decoding, code symbol detection and sizing
+ * 2. Line table rows, file names and address lookup
+ * 3. Profiler::LoadSymbolsFromELF and per-line address histograms
+ * 4. Rejection of files that are not ELF32, and truncated images
+ * 5. Load time of a large ELF
+ */
+
+#include <gxtest.h>
+#include <elf_reader.h>
+#include <profiler.h>
+#include "prime_sieve_rom.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// Prime sieve ROM functions (see profiler_test.cpp)
+constexpr uint32_t FUNC_START = 0x200;
+constexpr uint32_t FUNC_CLEAR_SIEVE = 0x210;
+constexpr uint32_t FUNC_MARK_TRIVIAL = 0x224;
+constexpr uint32_t FUNC_RUN_SIEVE = 0x236;
+constexpr uint32_t FUNC_COLLECT_PRIMES = 0x26A;
+constexpr uint32_t FUNC_MAIN = 0x2A0;
+constexpr uint32_t FUNC_MAIN_END = 0x2C2;
+
+// ELF symbol types, bindings and section numbers
+constexpr uint8_t STT_NOTYPE = 0, STT_OBJECT = 1, STT_FUNC = 2, STT_SECTION = 3, STT_FILE = 4;
+constexpr uint8_t STB_LOCAL = 0, STB_GLOBAL = 1;
+constexpr uint16_t SHN_TEXT = 1, SHN_BSS = 2, SHN_ABS = 0xFFF1;
+
+// Big-endian byte buffer
+struct Bytes : std::vector<uint8_t> {
+    void U8(uint32_t v) { push_back(static_cast<uint8_t>(v)); }
+    void U16(uint32_t v) { U8(v >> 8); U8(v); }
+    void U32(uint32_t v) { U16(v >> 16); U16(v); }
+    void Str(const std::string& s) { insert(end(), s.begin(), s.end()); U8(0); }
+    void Uleb(uint64_t v) {
+        do {
+            uint8_t b = v & 0x7F;
+            v >>= 7;
+            U8(v ? b | 0x80 : b);
+        } while (v);
+    }
+    void Sleb(int64_t v) {
+        bool more = true;
+        while (more) {
+            uint8_t b = v & 0x7F;
+            v >>= 7;
+            more = !((v == 0 && !(b & 0x40)) || (v == -1 && (b & 0x40)));
+            U8(more ? b | 0x80 : b);
+        }
+    }
+    void Append(const std::vector<uint8_t>& other) { insert(end(), other.begin(), other.end()); }
+    void Put32(size_t offset, uint32_t v) {
+        for (int i = 0; i < 4; i++) (*this)[offset + i] = static_cast<uint8_t>(v >> (24 - 8 * i));
+    }
+};
+
+// Line number program with the header parameters used below
+constexpr int LINE_BASE = -5;
+constexpr int LINE_RANGE = 14;
+constexpr int OPCODE_BASE = 13;
+constexpr int MIN_INST_LENGTH = 2;
+
+struct LineProgram : Bytes {
+    void SetAddress(uint32_t addr) { U8(0); Uleb(5); U8(2); U32(addr); }
+    void AdvancePc(uint32_t delta) { U8(2); Uleb(delta / MIN_INST_LENGTH); }
+    void AdvanceLine(int delta) { U8(3); Sleb(delta); }
+    void SetFile(uint32_t file) { U8(4); Uleb(file); }
+    void SetColumn(uint32_t column) { U8(5); Uleb(column); }
+    void Copy() { U8(1); }
+    void EndSequence() { U8(0); Uleb(1); U8(1); }
+    // Special opcode: advance address and line, then emit a row
+    void Special(uint32_t addr_delta, int line_delta) {
+        assert(line_delta >= LINE_BASE && line_delta < LINE_BASE + LINE_RANGE);
+        U8((line_delta - LINE_BASE) + LINE_RANGE * (addr_delta / MIN_INST_LENGTH) + OPCODE_BASE);
+    }
+};
+
+// Line program unit: DWARF 4 (include_directories / file_names lists) or
+// DWARF 5 (entry formats, paths in .debug_line_str)
+Bytes LineUnit(int version, const Bytes& tables, const LineProgram& program) {
+    Bytes header;
+    header.U8(MIN_INST_LENGTH);
+    header.U8(1);                   // Maximum operations per instruction
+    header.U8(1);                   // Default is_stmt
+    header.U8(static_cast<uint8_t>(LINE_BASE));
+    header.U8(LINE_RANGE);
+    header.U8(OPCODE_BASE);
+    for (uint8_t length : {0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1}) header.U8(length);
+    header.Append(tables);
+
+    Bytes unit;
+    unit.U16(version);
+    if (version >= 5) {
+        unit.U8(4);                 // Address size
+        unit.U8(0);                 // Segment selector size
+    }
+    unit.U32(static_cast<uint32_t>(header.size()));
+    unit.Append(header);
+    unit.Append(program);
+
+    Bytes out;
+    out.U32(static_cast<uint32_t>(unit.size()));
+    out.Append(unit);
+    return out;
+}
+
+// ELF32 big-endian image built from a symbol list and debug sections
+struct ElfBuilder {
+    Bytes symtab;
+    Bytes strtab;
+    Bytes debug_line;
+    Bytes debug_line_str;
+    uint32_t text_addr = FUNC_START;
+    uint32_t text_size = FUNC_MAIN_END - FUNC_START;
+
+    ElfBuilder() {
+        strtab.U8(0);
+        for (int i = 0; i < 16; i++) symtab.U8(0);  // Null symbol
+    }
+
+    void Symbol(const std::string& name, uint32_t addr, uint32_t size, uint8_t type, uint8_t bind,
+                uint16_t shndx) {
+        symtab.U32(name.empty() ? 0 : static_cast<uint32_t>(strtab.size()));
+        if (!name.empty()) strtab.Str(name);
+        symtab.U32(addr);
+        symtab.U32(size);
+        symtab.U8((bind << 4) | type);
+        symtab.U8(0);
+        symtab.U16(shndx);
+    }
+
+    uint32_t LineString(const std::string& s) {
+        uint32_t offset = static_cast<uint32_t>(debug_line_str.size());
+        debug_line_str.Str(s);
+        return offset;
+    }
+
+    std::vector<uint8_t> Build() const {
+        struct Section {
+            std::string name;
+            uint32_t type, flags, addr, size, link, entsize;
+            const Bytes* data;
+        };
+        const Section sections[] = {
+            {"", 0, 0, 0, 0, 0, 0, nullptr},
+            {".text", 1, 6, text_addr, text_size, 0, 0, nullptr},          // PROGBITS, AX
+            {".bss", 8, 3, 0xFF0000, 0x1000, 0, 0, nullptr},               // NOBITS, WA
+            {".symtab", 2, 0, 0, 0, 4, 16, &symtab},
+            {".strtab", 3, 0, 0, 0, 0, 0, &strtab},
+            {".debug_line", 1, 0, 0, 0, 0, 0, &debug_line},
+            {".debug_line_str", 1, 0x30, 0, 0, 0, 1, &debug_line_str},
+            {".shstrtab", 3, 0, 0, 0, 0, 0, nullptr},
+        };
+        constexpr size_t count = sizeof(sections) / sizeof(sections[0]);
+
+        Bytes shstrtab;
+        shstrtab.U8(0);
+        std::vector<uint32_t> names;
+        for (const Section& s : sections) {
+            names.push_back(s.name.empty() ? 0 : static_cast<uint32_t>(shstrtab.size()));
+            if (!s.name.empty()) shstrtab.Str(s.name);
+        }
+
+        Bytes elf;
+        elf.resize(52);
+        std::vector<uint32_t> offsets(count, 0), sizes(count, 0);
+        for (size_t i = 0; i < count; i++) {
+            const Bytes* data = i == count - 1 ? &shstrtab : sections[i].data;
+            if (!data) {
+                sizes[i] = sections[i].size;
+                continue;
+            }
+            offsets[i] = static_cast<uint32_t>(elf.size());
+            sizes[i] = static_cast<uint32_t>(data->size());
+            elf.Append(*data);
+        }
+        while (elf.size() % 4) elf.U8(0);
+        uint32_t shoff = static_cast<uint32_t>(elf.size());
+        for (size_t i = 0; i < count; i++) {
+            const Section& s = sections[i];
+            elf.U32(names[i]);
+            elf.U32(s.type);
+            elf.U32(s.flags);
+            elf.U32(s.addr);
+            elf.U32(s.type == 1 && !s.data ? 0 : offsets[i]);
+            elf.U32(sizes[i]);
+            elf.U32(s.link);
+            elf.U32(0);             // Info
+            elf.U32(1);             // Alignment
+            elf.U32(s.entsize);
+        }
+
+        const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 1, 2, 1};
+        memcpy(elf.data(), ident, sizeof(ident));
+        Bytes header;
+        header.U16(2);              // Executable
+        header.U16(4);              // Motorola 68000
+        header.U32(1);
+        header.U32(FUNC_START);     // Entry
+        header.U32(0);              // No program headers
+        header.U32(shoff);
+        header.U32(0);              // Flags
+        header.U16(52);
+        header.U16(32);
+        header.U16(0);
+        header.U16(40);
+        header.U16(static_cast<uint16_t>(count));
+        header.U16(static_cast<uint16_t>(count - 1));
+        memcpy(elf.data() + 16, header.data(), header.size());
+        return elf;
+    }
+};
+
+// Prime sieve symbols as a C compiler and the linker would emit them
+void AddSieveSymbols(ElfBuilder& elf) {
+    elf.Symbol("main.c", 0, 0, STT_FILE, STB_LOCAL, SHN_ABS);
+    elf.Symbol("", FUNC_START, 0, STT_SECTION, STB_LOCAL, SHN_TEXT);
+    elf.Symbol("clear_sieve", FUNC_CLEAR_SIEVE, 0x14, STT_FUNC, STB_LOCAL, SHN_TEXT);
+    elf.Symbol("mark_trivial_composites", FUNC_MARK_TRIVIAL, 0x12, STT_FUNC, STB_LOCAL, SHN_TEXT);
+    elf.Symbol("run_sieve", FUNC_RUN_SIEVE, 0x34, STT_FUNC, STB_LOCAL, SHN_TEXT);
+    elf.Symbol(".L5", FUNC_RUN_SIEVE + 8, 0, STT_NOTYPE, STB_LOCAL, SHN_TEXT);
+    elf.Symbol("collect_primes", FUNC_COLLECT_PRIMES, 0x36, STT_FUNC, STB_LOCAL, SHN_TEXT);
+    elf.Symbol("main_entry", FUNC_MAIN, 0, STT_NOTYPE, STB_GLOBAL, SHN_TEXT);
+    elf.Symbol("main", FUNC_MAIN, 0x22, STT_FUNC, STB_GLOBAL, SHN_TEXT);
+    elf.Symbol("_start", FUNC_START, 0, STT_NOTYPE, STB_GLOBAL, SHN_TEXT);  // From crt0.s
+    elf.Symbol("sieve", 0xFF0000, 0x100, STT_OBJECT, STB_GLOBAL, SHN_BSS);
+    elf.Symbol("__stack", 0xFFFE00, 0, STT_NOTYPE, STB_GLOBAL, SHN_ABS);
+    elf.Symbol("memset", 0, 0, STT_FUNC, STB_GLOBAL, 0);                    // Undefined
+}
+
+/*
+ * DWARF 4 unit for the sieve code in main.c (with one range in src/util.h)
+ * and a DWARF 5 unit for a separate range at 0x1000.
+ */
+void AddLineTables(ElfBuilder& elf) {
+    Bytes tables4;
+    tables4.Str("src");
+    tables4.U8(0);
+    tables4.Str("main.c");
+    tables4.Uleb(0); tables4.Uleb(0); tables4.Uleb(0);
+    tables4.Str("util.h");
+    tables4.Uleb(1); tables4.Uleb(0); tables4.Uleb(0);
+    tables4.U8(0);
+
+    LineProgram p4;
+    p4.SetAddress(FUNC_CLEAR_SIEVE);
+    p4.AdvanceLine(19);
+    p4.Copy();                      // 0x210 main.c:20
+    p4.AdvancePc(0x14);
+    p4.AdvanceLine(10);
+    p4.Copy();                      // 0x224 main.c:30
+    p4.AdvanceLine(2);
+    p4.Special(0x12, 8);            // 0x236 main.c:40
+    p4.SetColumn(5);
+    p4.Special(0x0E, 1);            // 0x244 main.c:41
+    p4.SetFile(2);
+    p4.AdvanceLine(-34);
+    p4.Special(0x0C, 0);            // 0x250 src/util.h:7
+    p4.SetFile(1);
+    p4.AdvanceLine(36);
+    p4.Special(0x0C, 0);            // 0x25C main.c:43
+    p4.Special(0x0E, 7);            // 0x26A main.c:50
+    p4.Special(0x00, 0);            // 0x26A main.c:50 again (merged)
+    p4.AdvancePc(FUNC_MAIN - FUNC_COLLECT_PRIMES);
+    p4.AdvanceLine(10);
+    p4.Copy();                      // 0x2A0 main.c:60
+    p4.AdvancePc(FUNC_MAIN_END - FUNC_MAIN);
+    p4.EndSequence();
+    elf.debug_line.Append(LineUnit(4, tables4, p4));
+
+    Bytes tables5;
+    tables5.U8(1);                  // Directory entry format: path as line_strp
+    tables5.Uleb(1); tables5.Uleb(0x1F);
+    tables5.Uleb(2);
+    tables5.U32(elf.LineString("/build"));
+    tables5.U32(elf.LineString("lib"));
+    tables5.U8(3);                  // File entry format: path, directory, MD5
+    tables5.Uleb(1); tables5.Uleb(0x08);
+    tables5.Uleb(2); tables5.Uleb(0x0F);
+    tables5.Uleb(5); tables5.Uleb(0x1E);
+    tables5.Uleb(2);
+    tables5.Str("sound.c"); tables5.Uleb(1); for (int i = 0; i < 16; i++) tables5.U8(i);
+    tables5.Str("sound.h"); tables5.Uleb(0); for (int i = 0; i < 16; i++) tables5.U8(i);
+
+    LineProgram p5;
+    p5.SetAddress(0x1000);
+    p5.AdvanceLine(99);
+    p5.SetFile(0);
+    p5.Copy();                      // 0x1000 lib/sound.c:100
+    p5.SetFile(1);
+    p5.AdvanceLine(-97);
+    p5.Special(0x08, 0);            // 0x1008 sound.h:3
+    p5.AdvancePc(0x08);
+    p5.EndSequence();
+    elf.debug_line.Append(LineUnit(5, tables5, p5));
+}
+
+std::string SourceOf(const GX::ElfReader& elf, uint32_t addr) {
+    const GX::SourceLine* line = elf.FindLine(addr);
+    if (!line) return "none";
+    return elf.GetFiles()[line->file] + ":" + std::to_string(line->line);
+}
+
+std::string WriteTemp(const std::vector<uint8_t>& data, const char* name) {
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return path;
+}
+
+class ElfReaderTest : public GX::Test {
+protected:
+    std::vector<uint8_t> image;
+
+    void SetUp() override {
+        ElfBuilder builder;
+        AddSieveSymbols(builder);
+        AddLineTables(builder);
+        image = builder.Build();
+    }
+};
+
+/**
+ * Test symbol decoding and code symbol sizes
+ */
+TEST_F(ElfReaderTest, Symbols) {
+    GX::ElfReader elf;
+    ASSERT_TRUE(elf.Load(image.data(), image.size()));
+
+    std::map<std::string, GX::ElfSymbol> symbols;
+    uint32_t last_addr = 0;
+    for (const GX::ElfSymbol& sym : elf.GetSymbols()) {
+        EXPECT_GE(sym.addr, last_addr) << "Symbols should be sorted by address";
+        last_addr = sym.addr;
+        symbols[sym.name] = sym;
+    }
+
+    // Section, file, undefined and local label symbols are left out
+    EXPECT_EQ(symbols.size(), 9u);
+    EXPECT_EQ(symbols.count("main.c"), 0u);
+    EXPECT_EQ(symbols.count("memset"), 0u);
+    EXPECT_EQ(symbols.count(".L5"), 0u);
+
+    EXPECT_TRUE(symbols["run_sieve"].code);
+    EXPECT_TRUE(symbols["run_sieve"].function);
+    EXPECT_FALSE(symbols["run_sieve"].global);
+    EXPECT_EQ(symbols["run_sieve"].size, 0x34u);
+    EXPECT_TRUE(symbols["main"].global);
+
+    // Unsized code symbols run to the next code symbol or the section end
+    EXPECT_TRUE(symbols["_start"].code);
+    EXPECT_FALSE(symbols["_start"].function);
+    EXPECT_EQ(symbols["_start"].size, FUNC_CLEAR_SIEVE - FUNC_START);
+    EXPECT_EQ(symbols["main_entry"].size, FUNC_MAIN_END - FUNC_MAIN);
+
+    EXPECT_FALSE(symbols["sieve"].code);
+    EXPECT_EQ(symbols["sieve"].size, 0x100u);
+    EXPECT_FALSE(symbols["__stack"].code);
+    EXPECT_EQ(symbols["__stack"].addr, 0xFFFE00u);
+}
+
+/**
+ * Test line table decoding from DWARF 4 and DWARF 5 units
+ */
+TEST_F(ElfReaderTest, LineTable) {
+    GX::ElfReader elf;
+    ASSERT_TRUE(elf.Load(image.data(), image.size()));
+
+    EXPECT_EQ(SourceOf(elf, FUNC_CLEAR_SIEVE), "main.c:20");
+    EXPECT_EQ(SourceOf(elf, FUNC_MARK_TRIVIAL - 2), "main.c:20");
+    EXPECT_EQ(SourceOf(elf, FUNC_MARK_TRIVIAL), "main.c:30");
+    EXPECT_EQ(SourceOf(elf, FUNC_RUN_SIEVE), "main.c:40");
+    EXPECT_EQ(SourceOf(elf, 0x24E), "main.c:41");
+    EXPECT_EQ(SourceOf(elf, 0x250), "src/util.h:7");
+    EXPECT_EQ(SourceOf(elf, 0x25C), "main.c:43");
+    EXPECT_EQ(SourceOf(elf, FUNC_COLLECT_PRIMES), "main.c:50");
+    EXPECT_EQ(SourceOf(elf, FUNC_MAIN_END - 2), "main.c:60");
+    EXPECT_EQ(SourceOf(elf, FUNC_MAIN_END), "none");
+    EXPECT_EQ(SourceOf(elf, FUNC_START), "none");
+
+    EXPECT_EQ(SourceOf(elf, 0x1000), "lib/sound.c:100");
+    EXPECT_EQ(SourceOf(elf, 0x1006), "lib/sound.c:100");
+    EXPECT_EQ(SourceOf(elf, 0x1008), "sound.h:3");
+    EXPECT_EQ(SourceOf(elf, 0x1010), "none");
+
+    // Repeated rows are merged
+    size_t rows_at_collect = 0;
+    for (const GX::SourceLine& row : elf.GetLines()) {
+        if (row.addr == FUNC_COLLECT_PRIMES) rows_at_collect++;
+    }
+    EXPECT_EQ(rows_at_collect, 1u);
+}
+
+/**
+ * Test the profiler loads functions from the ELF like hand-added symbols
+ */
+TEST_F(ElfReaderTest, ProfilerLoadsSymbols) {
+    std::string path = WriteTemp(image, "gxtest_elf_reader.elf");
+    GX::Profiler from_elf;
+    EXPECT_EQ(from_elf.LoadSymbolsFromELF(path), 6);
+    std::remove(path.c_str());
+    EXPECT_EQ(from_elf.GetSymbolCount(), 6u);
+    EXPECT_EQ(from_elf.GetVariableCount(), 1u);  // sieve, in .bss
+    EXPECT_GT(from_elf.GetLineCount(), 0u);
+
+    GX::Profiler manual;
+    manual.AddFunction(FUNC_START, FUNC_CLEAR_SIEVE, "_start");
+    manual.AddFunction(FUNC_CLEAR_SIEVE, FUNC_MARK_TRIVIAL, "clear_sieve");
+    manual.AddFunction(FUNC_MARK_TRIVIAL, FUNC_RUN_SIEVE, "mark_trivial_composites");
+    manual.AddFunction(FUNC_RUN_SIEVE, FUNC_COLLECT_PRIMES, "run_sieve");
+    manual.AddFunction(FUNC_COLLECT_PRIMES, FUNC_MAIN, "collect_primes");
+    manual.AddFunction(FUNC_MAIN, FUNC_MAIN_END, "main");
+
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    from_elf.Start();
+    manual.Start();
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+    manual.Stop();
+    from_elf.Stop();
+
+    for (uint32_t addr : {FUNC_START, FUNC_CLEAR_SIEVE, FUNC_MARK_TRIVIAL, FUNC_RUN_SIEVE,
+                          FUNC_COLLECT_PRIMES, FUNC_MAIN}) {
+        const GX::FunctionStats* a = from_elf.GetStats(addr);
+        const GX::FunctionStats* b = manual.GetStats(addr);
+        ASSERT_NE(a, nullptr) << std::hex << addr;
+        ASSERT_NE(b, nullptr);
+        EXPECT_EQ(a->cycles_exclusive, b->cycles_exclusive) << std::hex << addr;
+        EXPECT_EQ(a->call_count, b->call_count) << std::hex << addr;
+    }
+
+    std::ostringstream report;
+    from_elf.PrintReport(report);
+    EXPECT_NE(report.str().find("main"), std::string::npos);     // Not main_entry
+    EXPECT_EQ(report.str().find("main_entry"), std::string::npos);
+}
+
+/**
+ * Test the address histogram summed per source line
+ */
+TEST_F(ElfReaderTest, LineHistogram) {
+    std::string path = WriteTemp(image, "gxtest_elf_lines.elf");
+    GX::Profiler profiler;
+    ASSERT_EQ(profiler.LoadSymbolsFromELF(path), 6);
+    std::remove(path.c_str());
+
+    std::string file;
+    uint32_t line = 0;
+    ASSERT_TRUE(profiler.LookupLine(0x250, &file, &line));
+    EXPECT_EQ(file, "src/util.h");
+    EXPECT_EQ(line, 7u);
+    EXPECT_FALSE(profiler.LookupLine(FUNC_START, &file, &line));
+
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    GX::ProfileOptions options;
+    options.collect_address_histogram = true;
+    profiler.Start(options);
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+    profiler.Stop();
+
+    uint64_t covered = 0;
+    for (const auto& kv : profiler.GetAddressHistogram()) {
+        if (kv.first >= FUNC_CLEAR_SIEVE && kv.first < FUNC_MAIN_END) covered += kv.second;
+    }
+
+    std::vector<GX::LineStats> lines = profiler.GetLineHistogram();
+    ASSERT_FALSE(lines.empty());
+    uint64_t total = 0;
+    uint64_t sieve = 0;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i > 0) {
+            EXPECT_LE(lines[i].cycles, lines[i - 1].cycles);
+        }
+        total += lines[i].cycles;
+        std::string where = lines[i].file + ":" + std::to_string(lines[i].line);
+        if (where == "main.c:40" || where == "main.c:41" || where == "src/util.h:7" || where == "main.c:43") {
+            sieve += lines[i].cycles;
+        }
+    }
+    EXPECT_EQ(total, covered);
+    EXPECT_EQ(sieve, profiler.GetStats(FUNC_RUN_SIEVE)->cycles_exclusive);
+
+    std::ostringstream report;
+    profiler.PrintReport(report);
+    EXPECT_NE(report.str().find("Source line"), std::string::npos);
+    EXPECT_NE(report.str().find("main.c:4"), std::string::npos);
+}
+
+/**
+ * Test files that are not ELF32, and truncated images
+ */
+TEST_F(ElfReaderTest, BadFiles) {
+    GX::ElfReader elf;
+    EXPECT_FALSE(elf.Load("/nonexistent/file.elf"));
+    GX::Profiler profiler;
+    EXPECT_EQ(profiler.LoadSymbolsFromELF("/nonexistent/file.elf"), -1);
+
+    std::vector<uint8_t> elf64 = image;
+    elf64[4] = 2;
+    EXPECT_FALSE(elf.Load(elf64.data(), elf64.size()));
+    EXPECT_FALSE(elf.Load(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+
+    // The symbols survive a file missing its tail; cut anywhere, loading
+    // fails or keeps a subset without reading out of bounds
+    ASSERT_TRUE(elf.Load(image.data(), image.size()));
+    size_t full_symbols = elf.GetSymbols().size();
+    size_t full_lines = elf.GetLines().size();
+    for (size_t size = 0; size < image.size(); size += 3) {
+        std::vector<uint8_t> cut(image.begin(), image.begin() + size);
+        if (elf.Load(cut.data(), cut.size())) {
+            EXPECT_LE(elf.GetSymbols().size(), full_symbols);
+            EXPECT_LE(elf.GetLines().size(), full_lines);
+        }
+    }
+
+    // Corrupt line programs are cut short, not fatal
+    std::vector<uint8_t> corrupt = image;
+    for (size_t i = 0; i + 4 < corrupt.size(); i += 7) corrupt[i] ^= 0x5A;
+    elf.Load(corrupt.data(), corrupt.size());
+}
+
+/**
+ * Measure load time of an ELF with many functions and line rows
+ */
+TEST_F(ElfReaderTest, LargeElfLoadTime) {
+    constexpr uint32_t FUNCTIONS = 50000;
+    constexpr uint32_t FUNC_SIZE = 0x40;
+    ElfBuilder builder;
+    builder.text_addr = 0x200;
+    builder.text_size = FUNCTIONS * FUNC_SIZE;
+
+    Bytes tables;
+    tables.U8(0);
+    tables.Str("big.c");
+    tables.Uleb(0); tables.Uleb(0); tables.Uleb(0);
+    tables.U8(0);
+    LineProgram program;
+    program.SetAddress(builder.text_addr);
+    for (uint32_t i = 0; i < FUNCTIONS; i++) {
+        builder.Symbol("func_" + std::to_string(i), builder.text_addr + i * FUNC_SIZE, FUNC_SIZE,
+                       STT_FUNC, STB_GLOBAL, SHN_TEXT);
+        for (int row = 0; row < 8; row++) {
+            program.Special(FUNC_SIZE / 8, row == 0 ? 3 : 1);
+        }
+    }
+    program.EndSequence();
+    builder.debug_line = LineUnit(4, tables, program);
+    std::string path = WriteTemp(builder.Build(), "gxtest_elf_large.elf");
+
+    GX::Profiler profiler;
+    auto start = std::chrono::steady_clock::now();
+    int count = profiler.LoadSymbolsFromELF(path);
+    auto end = std::chrono::steady_clock::now();
+    std::remove(path.c_str());
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    EXPECT_EQ(count, static_cast<int>(FUNCTIONS));
+    EXPECT_EQ(profiler.GetLineCount(), FUNCTIONS * 8);  // Last row is the sequence end
+    std::string file;
+    uint32_t line = 0;
+    ASSERT_TRUE(profiler.LookupLine(0x200 + 1000 * FUNC_SIZE + FUNC_SIZE / 8, &file, &line));
+    EXPECT_EQ(file, "big.c");
+
+    std::cout << "Loaded " << count << " functions and " << profiler.GetLineCount()
+              << " line rows in " << ms << " ms\n";
+}
+
+} // namespace
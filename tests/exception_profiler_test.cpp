@@ -0,0 +1,273 @@
+/**
+ * gxtest - Exception Profiler Test
+ *
+ * Tests the profiler's exception-aware shadow call stack using a small
+ * program with a V-INT handler and a TRAP inside a called function.
+ * Verifies:
+ * 1. Exception events reach hook subscribers with their vector number
+ * 2. Per-vector exception counts and cycles
+ * 3. Inclusive cycles stay balanced across interrupts and RTE
+ * 4. Per-frame interrupt load
+ * 5. Exception frames in folded stacks
+ */
+
+#include <gxtest.h>
+#include <profiler.h>
+#include "rom_builder.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+extern "C" {
+#include "cpuhook.h"
+}
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// Program functions
+constexpr uint32_t FUNC_MAIN = 0x200;
+constexpr uint32_t FUNC_WORK = 0x220;
+constexpr uint32_t FUNC_WORK_END = 0x22C;
+constexpr uint32_t FUNC_VINT = 0x300;
+constexpr uint32_t FUNC_VINT_END = 0x30C;
+constexpr uint32_t FUNC_VSUB = 0x310;
+constexpr uint32_t FUNC_VSUB_END = 0x31A;
+constexpr uint32_t FUNC_TRAP = 0x340;
+constexpr uint32_t FUNC_TRAP_END = 0x344;
+
+/*
+ * The main loop calls a delay function that ends with TRAP #0, while V-INT
+ * is enabled. The V-INT handler calls a subroutine of its own, so interrupts
+ * land both in the main loop and inside called functions.
+ */
+std::vector<uint8_t> MakeExceptionRom() {
+    RomBuilder rom(FUNC_MAIN);
+    rom.SetVector(GX::VECTOR_VINT, FUNC_VINT);
+    rom.SetVector(GX::VECTOR_TRAP0, FUNC_TRAP);
+    rom.PutGameLoop(FUNC_MAIN, {FUNC_WORK});
+    rom.PutCode(FUNC_WORK, {
+        0x303C, 0x03FF,                 // work:  move.w  #$3FF,d0
+        0x51C8, 0xFFFE,                 //        dbra    d0,*
+        0x4E40,                         //        trap    #0
+        0x4E75,                         //        rts
+    });
+    rom.PutCode(FUNC_VINT, {
+        0x6100, 0x000E,                 // vint:  bsr.w   vsub
+        0x52B9, 0x00FF, 0x0000,         //        addq.l  #1,$FF0000
+        0x4E73,                         //        rte
+    });
+    rom.PutCode(FUNC_VSUB, {
+        0x323C, 0x00FF,                 // vsub:  move.w  #$FF,d1
+        0x51C9, 0xFFFE,                 //        dbra    d1,*
+        0x4E75,                         //        rts
+    });
+    rom.PutCode(FUNC_TRAP, {
+        0x4E71,                         // trap:  nop
+        0x4E73,                         //        rte
+    });
+    return rom.Data();
+}
+
+// Records the exceptions seen by a plain hook subscriber
+struct ExceptionRecorder {
+    std::map<uint32_t, uint32_t> counts;
+    std::map<uint32_t, uint32_t> handlers;
+
+    static void Callback(void* param, hook_type_t type, int, unsigned int address, unsigned int value) {
+        ExceptionRecorder* self = static_cast<ExceptionRecorder*>(param);
+        if (type == HOOK_M68K_EXC) {
+            self->counts[value]++;
+            self->handlers[value] = address;
+        }
+    }
+};
+
+class ExceptionProfilerTest : public ProfiledRomTest {
+protected:
+    std::vector<uint8_t> rom = MakeExceptionRom();
+
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+        profiler.AddFunction(FUNC_MAIN, FUNC_WORK, "main");
+        profiler.AddFunction(FUNC_WORK, FUNC_WORK_END, "work");
+        profiler.AddFunction(FUNC_VINT, FUNC_VINT_END, "vint");
+        profiler.AddFunction(FUNC_VSUB, FUNC_VSUB_END, "vsub");
+        profiler.AddFunction(FUNC_TRAP, FUNC_TRAP_END, "trap");
+    }
+};
+
+/**
+ * Test that exceptions are reported with their vector and handler address
+ */
+TEST_F(ExceptionProfilerTest, ExceptionHook) {
+    ExceptionRecorder recorder;
+    int id = cpu_hook_subscribe(HOOK_M68K_EXC, 0, 0xFFFFFF, ExceptionRecorder::Callback, &recorder);
+    ASSERT_GE(id, 0);
+    RunFrames(10);
+    cpu_hook_unsubscribe(id);
+
+    uint32_t vints = ReadLong(VINT_COUNTER);
+    EXPECT_GE(vints, 9u);
+    EXPECT_EQ(recorder.counts[GX::VECTOR_VINT], vints);
+    EXPECT_EQ(recorder.handlers[GX::VECTOR_VINT], FUNC_VINT);
+    EXPECT_GT(recorder.counts[GX::VECTOR_TRAP0], 0u);
+    EXPECT_EQ(recorder.handlers[GX::VECTOR_TRAP0], FUNC_TRAP);
+    EXPECT_EQ(recorder.counts.size(), 2u);
+}
+
+/**
+ * Test per-vector exception stats and that frames balance across RTE
+ */
+TEST_F(ExceptionProfilerTest, CallStackAcrossInterrupts) {
+    RunFrames(2);  // Past the setup code
+    uint32_t vints_before = ReadLong(VINT_COUNTER);
+
+    GX::ProfileOptions options;
+    options.mode = GX::ProfileMode::CallStack;
+    profiler.Start(options);
+    RunFrames(60);
+    profiler.Stop();
+    uint32_t vints = ReadLong(VINT_COUNTER) - vints_before;
+
+    const auto& exceptions = profiler.GetInterruptStats();
+    ASSERT_EQ(exceptions.count(GX::VECTOR_VINT), 1u);
+    ASSERT_EQ(exceptions.count(GX::VECTOR_TRAP0), 1u);
+    const GX::InterruptStats& vint = exceptions.at(GX::VECTOR_VINT);
+    const GX::InterruptStats& trap = exceptions.at(GX::VECTOR_TRAP0);
+    EXPECT_EQ(vint.count, vints);
+
+    const GX::FunctionStats* work = profiler.GetStats(FUNC_WORK);
+    const GX::FunctionStats* vint_func = profiler.GetStats(FUNC_VINT);
+    const GX::FunctionStats* vsub = profiler.GetStats(FUNC_VSUB);
+    const GX::FunctionStats* trap_func = profiler.GetStats(FUNC_TRAP);
+    ASSERT_NE(work, nullptr);
+    ASSERT_NE(vint_func, nullptr);
+    ASSERT_NE(vsub, nullptr);
+    ASSERT_NE(trap_func, nullptr);
+
+    // Handlers are entered once per exception
+    EXPECT_EQ(trap_func->call_count, trap.count);
+    EXPECT_EQ(vsub->call_count, vint.count);
+
+    // The handler's time covers its code and its subroutine
+    uint64_t vint_code = vint_func->cycles_exclusive + vsub->cycles_exclusive;
+    EXPECT_GE(vint.cycles, vint_code);
+    EXPECT_LT(vint.cycles, vint_code + vint.count * 100 * 7);
+    EXPECT_GE(trap.cycles, trap_func->cycles_exclusive);
+
+    // Frames close on RTS and RTE: the subroutine's inclusive time is its own,
+    // and work only includes the TRAPs and the interrupts that hit it
+    EXPECT_NEAR(static_cast<double>(vsub->cycles_inclusive), vsub->cycles_exclusive,
+                vsub->cycles_exclusive * 0.02);
+    EXPECT_GE(work->cycles_inclusive, work->cycles_exclusive);
+    EXPECT_LE(work->cycles_inclusive, work->cycles_exclusive + vint.cycles + trap.cycles);
+    EXPECT_GT(work->cycles_inclusive, work->cycles_exclusive + trap.cycles / 2);
+
+    profiler.PrintReport(std::cout);
+}
+
+/**
+ * Test exception stats in Simple mode and the per-frame interrupt load
+ */
+TEST_F(ExceptionProfilerTest, InterruptLoad) {
+    profiler.Start();
+    RunFrames(30);
+    profiler.Stop();
+
+    const auto& exceptions = profiler.GetInterruptStats();
+    ASSERT_EQ(exceptions.count(GX::VECTOR_VINT), 1u);
+    const GX::InterruptStats& vint = exceptions.at(GX::VECTOR_VINT);
+    EXPECT_GE(vint.count, 29u);
+    EXPECT_GT(vint.cycles, 0u);
+
+    const auto& frames = profiler.GetFrameLoads();
+    ASSERT_EQ(frames.size(), 30u);
+    uint64_t interrupt_cycles = 0;
+    uint64_t exception_cycles = 0;
+    for (const auto& kv : exceptions) {
+        exception_cycles += kv.second.cycles;
+    }
+    for (const auto& frame : frames) {
+        EXPECT_GT(frame.frame_cycles, 0u);
+        EXPECT_LE(frame.interrupt_cycles, frame.cpu_cycles);
+        interrupt_cycles += frame.interrupt_cycles;
+    }
+    for (size_t i = 1; i < frames.size(); i++) {
+        EXPECT_GT(frames[i].InterruptLoad(), 0.0) << "frame " << i;
+        EXPECT_LT(frames[i].InterruptLoad(), 0.2) << "frame " << i;
+    }
+
+    // Frame interrupt time is counted per instruction, exception time from
+    // entry to return: they differ by at most one instruction per exception
+    uint64_t count = 0;
+    for (const auto& kv : exceptions) {
+        count += kv.second.count;
+    }
+    EXPECT_NEAR(static_cast<double>(interrupt_cycles), exception_cycles, count * 200.0);
+
+    std::ostringstream report;
+    profiler.PrintReport(report);
+    EXPECT_NE(report.str().find("V-INT"), std::string::npos);
+    EXPECT_NE(report.str().find("TRAP #0"), std::string::npos);
+}
+
+/**
+ * Test that handlers appear in folded stacks below what they interrupted
+ */
+TEST_F(ExceptionProfilerTest, FoldedStacks) {
+    RunFrames(2);  // Past the setup code
+    profiler.Start(GX::ProfileMode::CallStack);
+    RunFrames(20);
+    profiler.Stop();
+
+    std::string path = (std::filesystem::temp_directory_path() / "gxtest_exception_folded.txt").string();
+    ASSERT_TRUE(profiler.WriteFoldedStacks(path));
+    std::map<std::string, uint64_t> stacks;
+    std::ifstream file(path);
+    std::string line;
+    uint64_t total = 0;
+    while (std::getline(file, line)) {
+        size_t space = line.rfind(' ');
+        ASSERT_NE(space, std::string::npos);
+        uint64_t cycles = std::stoull(line.substr(space + 1));
+        stacks[line.substr(0, space)] += cycles;
+        total += cycles;
+    }
+    file.close();
+    std::remove(path.c_str());
+
+    EXPECT_EQ(total, profiler.GetTotalCycles());
+    EXPECT_GT(stacks["main;work"], 0u);
+    EXPECT_GT(stacks["main;work;[TRAP #0];trap"], 0u);
+    EXPECT_GT(stacks["main;work;[V-INT];vint;vsub"], 0u);
+
+    // Every V-INT handler stack sits on an interrupted stack
+    uint64_t vsub = 0;
+    for (const auto& kv : stacks) {
+        if (kv.first.size() >= 5 && kv.first.compare(kv.first.size() - 5, 5, ";vsub") == 0) {
+            EXPECT_NE(kv.first.find("[V-INT];vint;vsub"), std::string::npos) << kv.first;
+            vsub += kv.second;
+        }
+    }
+    EXPECT_EQ(vsub, profiler.GetStats(FUNC_VSUB)->cycles_exclusive);
+}
+
+/**
+ * Test that Reset clears exception stats
+ */
+TEST_F(ExceptionProfilerTest, ResetClearsExceptions) {
+    profiler.Start();
+    RunFrames(5);
+    EXPECT_FALSE(profiler.GetInterruptStats().empty());
+    profiler.Reset();
+    EXPECT_TRUE(profiler.GetInterruptStats().empty());
+    EXPECT_TRUE(profiler.GetFrameLoads().empty());
+    profiler.Stop();
+}
+
+} // namespace
@@ -0,0 +1,35 @@
+// ROM images of arbitrary size
+// Shared by the tests that measure loading and memory use rather than what
+// the ROM does
+
+#ifndef FILLER_ROM_H
+#define FILLER_ROM_H
+
+#include "prime_sieve_rom.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace GX {
+namespace TestRoms {
+
+/**
+ * Build a ROM of the given size: the prime sieve program followed by a
+ * deterministic filler pattern
+ */
+inline std::vector<uint8_t> MakeRom(size_t size) {
+    std::vector<uint8_t> rom(size);
+    uint32_t x = static_cast<uint32_t>(size);
+    for (size_t i = 0; i < size; i++) {
+        x = x * 1103515245u + 12345u;
+        rom[i] = static_cast<uint8_t>(x >> 16);
+    }
+    memcpy(rom.data(), PRIME_SIEVE_ROM, std::min(size, sizeof(PRIME_SIEVE_ROM)));
+    return rom;
+}
+
+} // namespace TestRoms
+} // namespace GX
+
+#endif // FILLER_ROM_H
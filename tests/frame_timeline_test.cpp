@@ -0,0 +1,211 @@
+/**
+ * gxtest - Frame Timeline Test
+ *
+ * Tests the profiler's per-frame timeline using a small game loop: poll the
+ * controller, run an update of adjustable length, then wait for V-INT.
+ * Verifies:
+ * 1. Per-frame cycles, V-INT handler cycles and function breakdown
+ * 2. Scanline at which the main loop reaches its VBlank wait
+ * 3. Lag frames from an update overrunning VBlank or input not polled
+ * 4. EXPECT_NO_LAG_FRAMES and its failure message
+ */
+
+#include <gxtest.h>
+#include <profiler.h>
+#include <profiler_assertions.h>
+#include "rom_builder.h"
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// Program functions
+constexpr uint32_t FUNC_MAIN = 0x200;
+constexpr uint32_t FUNC_UPDATE = 0x220;
+constexpr uint32_t FUNC_UPDATE_END = 0x23A;
+constexpr uint32_t FUNC_WAIT_VBLANK = 0x240;
+constexpr uint32_t FUNC_WAIT_VBLANK_END = 0x250;
+constexpr uint32_t FUNC_VINT = 0x300;
+constexpr uint32_t FUNC_VINT_END = 0x308;
+
+// Work RAM variables, besides VINT_COUNTER
+constexpr uint32_t UPDATE_LOOPS = 0xFF0004;  // Word, delay loop count of update
+constexpr uint32_t SKIP_INPUT = 0xFF0006;    // Byte, nonzero = update skips the pad
+
+// Update lengths: a few scanlines, and more than a whole frame
+constexpr uint16_t LIGHT_UPDATE = 0x200;
+constexpr uint16_t HEAVY_UPDATE = 0x4000;
+
+/*
+ * main:        lea $C00004,a5; enable display and V-INT; loop { update; wait_vblank }
+ * update:      read pad 1 unless SKIP_INPUT, then dbra UPDATE_LOOPS times
+ * wait_vblank: spin until VINT_COUNTER changes
+ * vint:        increment VINT_COUNTER
+ */
+std::vector<uint8_t> MakeGameLoopRom() {
+    RomBuilder rom(FUNC_MAIN);
+    rom.SetVector(GX::VECTOR_VINT, FUNC_VINT);
+    rom.PutGameLoop(FUNC_MAIN, {FUNC_UPDATE, FUNC_WAIT_VBLANK});
+    rom.PutCode(FUNC_UPDATE, {
+        0x4A39, 0x00FF, 0x0006,         // update: tst.b  $FF0006
+        0x6606,                         //        bne.s   .skip
+        0x1039, 0x00A1, 0x0003,         //        move.b  $A10003,d0      ; pad 1
+        0x3039, 0x00FF, 0x0004,         // .skip: move.w  $FF0004,d0
+        0x51C8, 0xFFFE,                 //        dbra    d0,*
+        0x4E75,                         //        rts
+    });
+    rom.PutWaitVBlank(FUNC_WAIT_VBLANK);
+    rom.PutVIntCounter(FUNC_VINT);
+    return rom.Data();
+}
+
+class FrameTimelineTest : public ProfiledRomTest {
+protected:
+    std::vector<uint8_t> rom = MakeGameLoopRom();
+    GX::ProfileOptions options;
+
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+        profiler.AddFunction(FUNC_MAIN, FUNC_UPDATE, "main");
+        profiler.AddFunction(FUNC_UPDATE, FUNC_UPDATE_END, "update");
+        profiler.AddFunction(FUNC_WAIT_VBLANK, FUNC_WAIT_VBLANK_END, "wait_vblank");
+        profiler.AddFunction(FUNC_VINT, FUNC_VINT_END, "vint");
+
+        WriteWord(UPDATE_LOOPS, LIGHT_UPDATE);
+        RunFrames(2);  // Past the setup code
+
+        options.collect_timeline = true;
+        options.vblank_wait_start = FUNC_WAIT_VBLANK;
+        options.vblank_wait_end = FUNC_WAIT_VBLANK_END;
+    }
+};
+
+/**
+ * Test per-frame cycles, V-INT time, function breakdown and wait scanline
+ */
+TEST_F(FrameTimelineTest, FrameBreakdown) {
+    profiler.Start(options);
+    RunFrames(30);
+    profiler.Stop();
+
+    const std::vector<GX::FrameProfile>& timeline = profiler.GetTimeline();
+    ASSERT_EQ(timeline.size(), 30u);
+    const GX::FunctionStats* vint = profiler.GetStats(FUNC_VINT);
+    ASSERT_NE(vint, nullptr);
+
+    uint64_t vint_cycles = 0;
+    for (size_t i = 0; i < timeline.size(); i++) {
+        const GX::FrameProfile& frame = timeline[i];
+        EXPECT_EQ(frame.frame, i);
+        EXPECT_TRUE(frame.input_polled);
+        EXPECT_FALSE(frame.lag) << "Frame " << i;
+        EXPECT_EQ(frame.cpu_cycles, profiler.GetFrameLoads()[i].cpu_cycles);
+
+        // The update takes a few lines after V-INT at the start of VBlank
+        EXPECT_GT(frame.wait_line, 224) << "Frame " << i;
+        EXPECT_LT(frame.wait_line, 250) << "Frame " << i;
+
+        // Spinning in wait_vblank takes most of the frame
+        ASSERT_FALSE(frame.functions.empty());
+        EXPECT_EQ(frame.functions[0].first, FUNC_WAIT_VBLANK);
+        uint64_t sum = 0;
+        uint64_t update = 0;
+        for (const auto& kv : frame.functions) {
+            sum += kv.second;
+            if (kv.first == FUNC_UPDATE) update = kv.second;
+        }
+        EXPECT_LE(sum, frame.cpu_cycles);
+        EXPECT_NEAR(static_cast<double>(update), LIGHT_UPDATE * 70.0, LIGHT_UPDATE * 70.0 * 0.05);
+
+        EXPECT_GT(frame.vint_cycles, 0u);
+        vint_cycles += frame.vint_cycles;
+    }
+    EXPECT_GE(vint_cycles, vint->cycles_exclusive);
+    EXPECT_LE(vint_cycles, vint->cycles_exclusive + 30 * 100);
+
+    EXPECT_NO_LAG_FRAMES(profiler, 0, 30);
+}
+
+/**
+ * Test that an update running past VBlank marks that frame as lagging
+ */
+TEST_F(FrameTimelineTest, UpdateOverrun) {
+    profiler.Start(options);
+    RunFrames(10);
+    WriteWord(UPDATE_LOOPS, HEAVY_UPDATE);
+    RunFrames(1);                    // Frame 10 starts the long update
+    WriteWord(UPDATE_LOOPS, LIGHT_UPDATE);
+    RunFrames(9);
+    profiler.Stop();
+
+    const std::vector<GX::FrameProfile>& timeline = profiler.GetTimeline();
+    ASSERT_EQ(timeline.size(), 20u);
+    EXPECT_EQ(profiler.GetLagFrames(), (std::vector<uint64_t>{10, 11}));
+
+    // The main loop never reached the wait in frame 10. It got there in
+    // active display of frame 11 and waited through frame 11's V-INT, so
+    // frame 11 had no update and no input read.
+    EXPECT_EQ(timeline[10].wait_line, -1);
+    EXPECT_TRUE(timeline[10].input_polled);
+    EXPECT_EQ(timeline[10].functions[0].first, FUNC_UPDATE);
+    EXPECT_GE(timeline[11].wait_line, 0);
+    EXPECT_LT(timeline[11].wait_line, 224);
+    EXPECT_FALSE(timeline[11].input_polled);
+
+    EXPECT_NO_LAG_FRAMES(profiler, 0, 10);
+    EXPECT_NO_LAG_FRAMES(profiler, 12, 20);
+
+    ::testing::AssertionResult result = GX::NoLagFrames(profiler, 0, 20);
+    EXPECT_FALSE(result);
+    EXPECT_NE(std::string(result.message()).find("frame 10:"), std::string::npos) << result.message();
+
+    std::ostringstream report;
+    profiler.PrintReport(report);
+    EXPECT_NE(report.str().find("Lag frames: 2 of 20 (10, 11)"), std::string::npos) << report.str();
+}
+
+/**
+ * Test that frames without a controller read are lag frames
+ */
+TEST_F(FrameTimelineTest, InputNotPolled) {
+    options.vblank_wait_start = options.vblank_wait_end = 0;  // Input polling only
+    profiler.Start(options);
+    RunFrames(5);
+    WriteByte(SKIP_INPUT, 1);
+    RunFrames(3);
+    WriteByte(SKIP_INPUT, 0);
+    RunFrames(5);
+    profiler.Stop();
+
+    // The update reads the flag right after V-INT, so frames 5-7 skip the pad
+    EXPECT_EQ(profiler.GetLagFrames(), (std::vector<uint64_t>{5, 6, 7}));
+    EXPECT_FALSE(profiler.GetTimeline()[5].input_polled);
+    EXPECT_EQ(profiler.GetTimeline()[5].wait_line, -1);  // Not tracked
+
+    ::testing::AssertionResult result = GX::NoLagFrames(profiler, 0, 13);
+    EXPECT_FALSE(result);
+    EXPECT_NE(std::string(result.message()).find("input not polled"), std::string::npos);
+    EXPECT_FALSE(GX::NoLagFrames(profiler, 0, 100)) << "Range past the timeline";
+}
+
+/**
+ * Test the timeline is off by default and cleared by Reset()
+ */
+TEST_F(FrameTimelineTest, DisabledAndReset) {
+    profiler.Start();
+    RunFrames(5);
+    profiler.Stop();
+    EXPECT_TRUE(profiler.GetTimeline().empty());
+    EXPECT_EQ(profiler.GetFrameLoads().size(), 5u);
+
+    profiler.Start(options);
+    RunFrames(5);
+    profiler.Stop();
+    EXPECT_EQ(profiler.GetTimeline().size(), 5u);
+    profiler.Reset();
+    EXPECT_TRUE(profiler.GetTimeline().empty());
+}
+
+} // namespace
@@ -0,0 +1,213 @@
+/**
+ * gxtest - Hook Bus Test
+ *
+ * Tests hook subscribers filtered by event type and address range.
+ * Verifies:
+ * 1. Subscribers only see events of their types inside their range
+ * 2. The profiler runs alongside other subscribers and set_cpu_hook()
+ * 3. Subscribers can be removed from within a callback, slots are limited
+ * 4. Scanline events arrive once per line, in order
+ * 5. Cost of unmatched subscribers
+ */
+
+#include <gxtest.h>
+#include <profiler.h>
+#include "prime_sieve_rom.h"
+#include <chrono>
+#include <iostream>
+
+extern "C" {
+#include "cpuhook.h"
+}
+
+namespace {
+
+using namespace GX::TestRoms;
+
+struct Counter {
+    unsigned int types;
+    unsigned int start;
+    unsigned int end;
+    uint64_t events = 0;
+    uint64_t violations = 0;
+    int id = -1;
+
+    Counter(unsigned int t, unsigned int s, unsigned int e) : types(t), start(s), end(e) {}
+
+    static void Callback(void* param, hook_type_t type, int, unsigned int address, unsigned int) {
+        Counter* self = static_cast<Counter*>(param);
+        self->events++;
+        if (!(type & self->types) || address < self->start || address > self->end) {
+            self->violations++;
+        }
+    }
+
+    void Subscribe() { id = cpu_hook_subscribe(types, start, end, Callback, this); }
+    void Unsubscribe() { cpu_hook_unsubscribe(id); id = -1; }
+};
+
+class HookBusTest : public GX::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    }
+
+    void TearDown() override {
+        set_cpu_hook(nullptr);
+        EXPECT_EQ(cpu_hook_types, 0u) << "Test left subscribers behind";
+    }
+};
+
+/**
+ * Test that each subscriber gets exactly its types and range
+ */
+TEST_F(HookBusTest, FilteredByTypeAndRange) {
+    Counter ram_writes(HOOK_M68K_W, 0xFF0000, 0xFFFFFF);
+    Counter ram_reads(HOOK_M68K_R, 0xFF0000, 0xFFFFFF);
+    Counter sieve_code(HOOK_M68K_E, 0x236, 0x269);
+    Counter everything(HOOK_M68K_E | HOOK_M68K_RW, 0, 0xFFFFFF);
+    for (Counter* c : {&ram_writes, &ram_reads, &sieve_code, &everything}) {
+        c->Subscribe();
+        ASSERT_GE(c->id, 0);
+    }
+
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+
+    for (Counter* c : {&ram_writes, &ram_reads, &sieve_code, &everything}) {
+        EXPECT_GT(c->events, 0u);
+        EXPECT_EQ(c->violations, 0u);
+        c->Unsubscribe();
+    }
+    EXPECT_GT(everything.events, ram_writes.events + sieve_code.events);
+}
+
+/**
+ * Test that the profiler, a write tracer and a legacy hook run together
+ */
+TEST_F(HookBusTest, ProfilerAlongsideOtherSubscribers) {
+    GX::Profiler alone;
+    alone.AddFunction(0x200, 0x2C2, "all");
+    alone.Start();
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+    alone.Stop();
+
+    static uint64_t legacy_events;
+    legacy_events = 0;
+    set_cpu_hook([](hook_type_t, int, unsigned int, unsigned int) { legacy_events++; });
+
+    Counter writes(HOOK_M68K_W, 0xFF0000, 0xFFFFFF);
+    writes.Subscribe();
+
+    GX::Profiler profiler;
+    profiler.AddFunction(0x200, 0x2C2, "all");
+    GX::Profiler second;
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    profiler.Start();
+    second.Start();
+    EXPECT_TRUE(profiler.IsRunning());
+    EXPECT_TRUE(second.IsRunning());
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+    profiler.Stop();
+    second.Stop();
+    writes.Unsubscribe();
+
+    EXPECT_EQ(profiler.GetTotalCycles(), alone.GetTotalCycles());
+    EXPECT_EQ(second.GetTotalCycles(), alone.GetTotalCycles());
+    EXPECT_GT(writes.events, 0u);
+    EXPECT_EQ(writes.violations, 0u);
+    EXPECT_GT(legacy_events, writes.events);
+}
+
+/**
+ * Test removing subscribers from a callback and the slot limit
+ */
+TEST_F(HookBusTest, UnsubscribeInCallbackAndSlotLimit) {
+    struct OneShot {
+        int id = -1;
+        int calls = 0;
+        static void Callback(void* param, hook_type_t, int, unsigned int, unsigned int) {
+            OneShot* self = static_cast<OneShot*>(param);
+            self->calls++;
+            cpu_hook_unsubscribe(self->id);
+        }
+    } one_shot;
+    one_shot.id = cpu_hook_subscribe(HOOK_M68K_E, 0, 0xFFFFFF, OneShot::Callback, &one_shot);
+    ASSERT_GE(one_shot.id, 0);
+    RunFrames(2);
+    EXPECT_EQ(one_shot.calls, 1);
+    EXPECT_EQ(cpu_hook_types, 0u);
+
+    std::vector<Counter> counters(CPU_HOOK_MAX_SUBSCRIBERS, Counter(HOOK_VRAM_W, 0, 0xFFFF));
+    for (Counter& c : counters) {
+        c.Subscribe();
+        EXPECT_GE(c.id, 0);
+    }
+    Counter extra(HOOK_VRAM_W, 0, 0xFFFF);
+    extra.Subscribe();
+    EXPECT_EQ(extra.id, -1);
+    for (Counter& c : counters) {
+        c.Unsubscribe();
+    }
+
+    // Invalid ranges and callbacks are rejected
+    EXPECT_EQ(cpu_hook_subscribe(HOOK_M68K_E, 0x200, 0x100, Counter::Callback, &extra), -1);
+    EXPECT_EQ(cpu_hook_subscribe(HOOK_M68K_E, 0, 0xFFFFFF, nullptr, nullptr), -1);
+}
+
+/**
+ * Test that HOOK_LINE fires at the end of every scanline with its number
+ */
+TEST_F(HookBusTest, LineEvents) {
+    struct Lines {
+        std::vector<unsigned int> lines;
+        static void Callback(void* param, hook_type_t type, int, unsigned int, unsigned int value) {
+            if (type == HOOK_LINE) {
+                static_cast<Lines*>(param)->lines.push_back(value);
+            }
+        }
+    } lines;
+    int id = cpu_hook_subscribe(HOOK_LINE, 0, 0xFFFFFF, Lines::Callback, &lines);
+    ASSERT_GE(id, 0);
+    EXPECT_EQ(cpu_hook_types & (HOOK_M68K_E | HOOK_M68K_RW), 0u);
+    RunFrames(3);
+    cpu_hook_unsubscribe(id);
+
+    const unsigned int lines_per_frame = 262;  // NTSC
+    ASSERT_EQ(lines.lines.size(), 3u * lines_per_frame);
+    for (size_t i = 1; i < lines.lines.size(); i++) {
+        EXPECT_EQ(lines.lines[i], (lines.lines[i - 1] + 1) % lines_per_frame) << "Event " << i;
+    }
+}
+
+/**
+ * Benchmark: subscribers that never match cost (almost) nothing
+ */
+TEST_F(HookBusTest, Benchmark) {
+    auto time_frames = [this]() {
+        EXPECT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+        auto start = std::chrono::high_resolution_clock::now();
+        RunFrames(300);
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    double none = time_frames();
+
+    // VRAM writes only: the 68k stays on the unhooked core
+    Counter vram(HOOK_VRAM_W, 0, 0xFFFF);
+    vram.Subscribe();
+    double vram_only = time_frames();
+    vram.Unsubscribe();
+
+    // 68k writes to a range the ROM never touches
+    Counter unmatched(HOOK_M68K_W, 0xA10000, 0xA1FFFF);
+    unmatched.Subscribe();
+    double filtered = time_frames();
+    unmatched.Unsubscribe();
+    EXPECT_EQ(unmatched.events, 0u);
+
+    std::cout << "300 frames: no subscribers " << none << " ms, VRAM subscriber " << vram_only
+              << " ms, unmatched 68k subscriber " << filtered << " ms" << std::endl;
+}
+
+} // namespace
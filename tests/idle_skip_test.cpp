@@ -0,0 +1,124 @@
+/**
+ * gxtest - Idle Skip Test
+ *
+ * Tests 68k idle loop skipping (BRA to itself fast-forwarded to the end of
+ * the timeslice).
+ * Verifies:
+ * 1. Execution with skipping is identical to the plain interpreter
+ * 2. Execution after a state restore is identical as well
+ * 3. Speed of both on a CPU-bound loop and on the prime sieve and symbol
+ *    example ROMs
+ */
+
+#include <gxtest.h>
+#include "prime_sieve_rom.h"
+#include "rom_builder.h"
+#include "symbol_example_rom.h"
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// CPU-bound ROM: an arithmetic loop at 0x200 that never waits for the VDP
+std::vector<uint8_t> MakeLoopRom() {
+    RomBuilder rom(0x200);
+    rom.PutCode(0x200, {
+        0x7000,                         //        moveq   #0,d0
+        0x5280,                         // loop:  addq.l  #1,d0
+        0xD280,                         //        add.l   d0,d1
+        0xB382,                         //        eor.l   d1,d2
+        0xD682,                         //        add.l   d2,d3
+        0xE69B,                         //        ror.l   #3,d3
+        0x60F4,                         //        bra.s   loop
+    });
+    return rom.Data();
+}
+
+class IdleSkipTest : public GX::Test {
+protected:
+    void TearDown() override {
+        GX::Emulator::SetIdleSkipEnabled(false);
+    }
+
+    // Final state after loading a ROM and running it, with or without skipping
+    std::vector<uint8_t> Run(const uint8_t* rom, size_t size, int frames, bool skip) {
+        GX::Emulator::SetIdleSkipEnabled(skip);
+        EXPECT_TRUE(emu.LoadRom(rom, size));
+        for (int i = 0; i < frames; i++) {
+            // Vary input so the symbol example takes different paths
+            GX::Input input;
+            input.right = (i / 16) % 2 == 0;
+            input.a = (i % 7) == 0;
+            emu.SetInput(0, input);
+            RunFrames(1);
+        }
+        emu.SetInput(0, GX::Input());
+        return emu.SaveState();
+    }
+};
+
+/**
+ * Test that skipping idle loops gives the same states as running them
+ */
+TEST_F(IdleSkipTest, MatchesInterpreter) {
+    EXPECT_EQ(Run(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE, 30, true),
+              Run(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE, 30, false));
+    EXPECT_EQ(ReadWord(PRIME_COUNT_ADDR), NUM_PRIMES);
+
+    EXPECT_EQ(Run(SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE, 300, true),
+              Run(SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE, 300, false));
+}
+
+/**
+ * Test that execution after a state restore matches the interpreter
+ */
+TEST_F(IdleSkipTest, RestoreMatchesInterpreter) {
+    std::vector<uint8_t> results[2];
+    for (int skip = 0; skip < 2; skip++) {
+        Run(SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE, 20, skip != 0);
+        auto state = emu.SaveState();
+        RunFrames(40);
+        ASSERT_TRUE(emu.LoadState(state));
+        RunFrames(40);
+        results[skip] = emu.SaveState();
+    }
+    EXPECT_EQ(results[0], results[1]);
+}
+
+/**
+ * Benchmark: plain interpreter vs idle loop skipping
+ *
+ * The example ROMs spend most frames in a BRA-to-self loop; the CPU-bound
+ * loop never idles.
+ */
+TEST_F(IdleSkipTest, Benchmark) {
+    std::vector<uint8_t> loop = MakeLoopRom();
+    struct Case {
+        const char* name;
+        const uint8_t* rom;
+        size_t size;
+        int frames;
+    } cases[] = {
+        {"CPU-bound loop", loop.data(), loop.size(), 300},
+        {"Prime sieve", PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE, 600},
+        {"Symbol example", SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE, 600},
+    };
+
+    for (const Case& c : cases) {
+        double ms[2];
+        for (int skip = 0; skip < 2; skip++) {
+            GX::Emulator::SetIdleSkipEnabled(skip != 0);
+            ASSERT_TRUE(emu.LoadRom(c.rom, c.size));
+            auto start = std::chrono::high_resolution_clock::now();
+            RunFrames(c.frames);
+            auto end = std::chrono::high_resolution_clock::now();
+            ms[skip] = std::chrono::duration<double, std::milli>(end - start).count();
+        }
+        std::cout << c.name << " (" << c.frames << " frames): interpreter " << ms[0]
+                  << " ms, idle skip " << ms[1] << " ms (" << ms[0] / ms[1] << "x)" << std::endl;
+    }
+}
+
+} // namespace
@@ -0,0 +1,324 @@
+/**
+ * gxtest - Memory Access Profiler Test
+ *
+ * Tests the profiler's memory access counts using a small program that
+ * copies a ROM table to work RAM, uploads it to the VDP, writes the Z80
+ * mailbox and touches a few other ports, then stops.
+ * Verifies:
+ * 1. Reads and writes per function and memory region, exactly
+ * 2. Work RAM heatmap and per-variable counts from nm output and ELF symbols
+ * 3. Heatmap export (JSON and binary) and report
+ */
+
+#include <gxtest.h>
+#include <profiler.h>
+#include "rom_builder.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// Program functions
+constexpr uint32_t FUNC_MAIN = 0x200;
+constexpr uint32_t FUNC_MAIN_END = 0x220;
+constexpr uint32_t FUNC_COPY_TABLE = 0x240;
+constexpr uint32_t FUNC_COPY_TABLE_END = 0x256;
+constexpr uint32_t FUNC_UPLOAD = 0x260;
+constexpr uint32_t FUNC_UPLOAD_END = 0x27E;
+constexpr uint32_t FUNC_MAILBOX = 0x290;
+constexpr uint32_t FUNC_MAILBOX_END = 0x2AA;
+constexpr uint32_t TABLE = 0x400;
+
+// Work RAM variables
+constexpr uint32_t FRAME_COUNTER = 0xFF0000;  // Word
+constexpr uint32_t BUFFER = 0xFF0100;         // 16 words
+constexpr uint32_t STACK_SLOT = 0xFFFDFC;     // Return address of calls from main
+
+/*
+ * main:       copy_table; upload; mailbox; addq.w #1,frame_counter;
+ *             read pad 1 and the HV counter; stop
+ * copy_table: copy 16 words from the ROM table to buffer
+ * upload:     set a VRAM write address, write buffer to the VDP data port
+ * mailbox:    request the Z80 bus, write a byte to Z80 RAM, release the bus
+ */
+std::vector<uint8_t> MakeMemoryRom() {
+    RomBuilder rom(FUNC_MAIN);
+
+    rom.PutCode(FUNC_MAIN, {
+        0x6100, 0x003E,                 //        bsr.w   copy_table
+        0x6100, 0x005A,                 //        bsr.w   upload
+        0x6100, 0x0086,                 //        bsr.w   mailbox
+        0x5279, 0x00FF, 0x0000,         //        addq.w  #1,$FF0000
+        0x1039, 0x00A1, 0x0003,         //        move.b  $A10003,d0      ; pad 1
+        0x3039, 0x00C0, 0x0008,         //        move.w  $C00008,d0      ; HV counter
+        0x60FE,                         //        bra.s   *
+    });
+    rom.PutCode(FUNC_COPY_TABLE, {
+        0x41F9, 0x0000, 0x0400,         // copy_table: lea $400,a0
+        0x43F9, 0x00FF, 0x0100,         //        lea     $FF0100,a1
+        0x700F,                         //        moveq   #15,d0
+        0x32D8,                         // .copy: move.w  (a0)+,(a1)+
+        0x51C8, 0xFFFC,                 //        dbra    d0,.copy
+        0x4E75,                         //        rts
+    });
+    rom.PutCode(FUNC_UPLOAD, {
+        0x41F9, 0x00C0, 0x0000,         // upload: lea    $C00000,a0
+        0x217C, 0x4000, 0x0000, 0x0004, //        move.l  #$40000000,4(a0) ; VRAM write at 0
+        0x43F9, 0x00FF, 0x0100,         //        lea     $FF0100,a1
+        0x700F,                         //        moveq   #15,d0
+        0x3099,                         // .copy: move.w  (a1)+,(a0)
+        0x51C8, 0xFFFC,                 //        dbra    d0,.copy
+        0x4E75,                         //        rts
+    });
+    rom.PutCode(FUNC_MAILBOX, {
+        0x33FC, 0x0100, 0x00A1, 0x1100, // mailbox: move.w #$100,$A11100  ; Z80 bus request
+        0x13FC, 0x0042, 0x00A0, 0x1F00, //        move.b  #$42,$A01F00
+        0x33FC, 0x0000, 0x00A1, 0x1100, //        move.w  #0,$A11100
+        0x4E75,                         //        rts
+    });
+    for (uint32_t i = 0; i < 16; i++) {
+        rom.Put16(TABLE + i * 2, static_cast<uint16_t>(0x1111 * i));
+    }
+    return rom.Data();
+}
+
+std::string TempPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+class MemoryProfilerTest : public ProfiledRomTest {
+protected:
+    std::vector<uint8_t> rom = MakeMemoryRom();
+    GX::ProfileOptions options;
+
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+        profiler.AddFunction(FUNC_MAIN, FUNC_MAIN_END, "main");
+        profiler.AddFunction(FUNC_COPY_TABLE, FUNC_COPY_TABLE_END, "copy_table");
+        profiler.AddFunction(FUNC_UPLOAD, FUNC_UPLOAD_END, "upload");
+        profiler.AddFunction(FUNC_MAILBOX, FUNC_MAILBOX_END, "mailbox");
+        options.collect_memory_access = true;
+    }
+
+    // Run the whole program under the profiler
+    void RunProgram() {
+        profiler.Start(options);
+        RunFrames(2);
+        profiler.Stop();
+        ASSERT_EQ(ReadWord(FRAME_COUNTER), 1);
+    }
+
+    static void ExpectAccess(const GX::MemoryAccessStats& s, uint64_t reads, uint64_t writes,
+                             uint64_t read_bytes, uint64_t write_bytes) {
+        EXPECT_EQ(s.reads, reads);
+        EXPECT_EQ(s.writes, writes);
+        EXPECT_EQ(s.read_bytes, read_bytes);
+        EXPECT_EQ(s.write_bytes, write_bytes);
+    }
+};
+
+/**
+ * Test region classification of 68k addresses
+ */
+TEST_F(MemoryProfilerTest, Regions) {
+    EXPECT_EQ(GX::GetMemoryRegion(0x000400), GX::MemoryRegion::Rom);
+    EXPECT_EQ(GX::GetMemoryRegion(0x3FFFFF), GX::MemoryRegion::Rom);
+    EXPECT_EQ(GX::GetMemoryRegion(0xA01F00), GX::MemoryRegion::Z80);
+    EXPECT_EQ(GX::GetMemoryRegion(0xA10003), GX::MemoryRegion::Io);
+    EXPECT_EQ(GX::GetMemoryRegion(0xA11100), GX::MemoryRegion::System);
+    EXPECT_EQ(GX::GetMemoryRegion(0xA14000), GX::MemoryRegion::System);
+    EXPECT_EQ(GX::GetMemoryRegion(0xC00002), GX::MemoryRegion::VdpData);
+    EXPECT_EQ(GX::GetMemoryRegion(0xC00004), GX::MemoryRegion::VdpControl);
+    EXPECT_EQ(GX::GetMemoryRegion(0xC00024), GX::MemoryRegion::VdpControl);  // Mirror
+    EXPECT_EQ(GX::GetMemoryRegion(0xC00008), GX::MemoryRegion::VdpOther);
+    EXPECT_EQ(GX::GetMemoryRegion(0xC00011), GX::MemoryRegion::VdpOther);    // PSG
+    EXPECT_EQ(GX::GetMemoryRegion(0xE00000), GX::MemoryRegion::WorkRam);
+    EXPECT_EQ(GX::GetMemoryRegion(0xFF0100), GX::MemoryRegion::WorkRam);
+    EXPECT_EQ(GX::GetMemoryRegion(0x400000), GX::MemoryRegion::Other);
+    EXPECT_STREQ(GX::MemoryRegionName(GX::MemoryRegion::VdpData), "VDP data");
+}
+
+/**
+ * Test exact reads and writes per function and region
+ */
+TEST_F(MemoryProfilerTest, FunctionRegionCounts) {
+    RunProgram();
+
+    using R = GX::MemoryRegion;
+    // Calls push a long return address, returns pop it
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_MAIN, R::WorkRam), 1, 4, 2, 3 * 4 + 2);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_MAIN, R::Io), 1, 0, 1, 0);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_MAIN, R::VdpOther), 1, 0, 2, 0);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_COPY_TABLE, R::Rom), 16, 0, 32, 0);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_COPY_TABLE, R::WorkRam), 1, 16, 4, 32);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_UPLOAD, R::VdpControl), 0, 1, 0, 4);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_UPLOAD, R::VdpData), 0, 16, 0, 32);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_UPLOAD, R::WorkRam), 17, 0, 36, 0);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_MAILBOX, R::System), 0, 2, 0, 4);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_MAILBOX, R::Z80), 0, 1, 0, 1);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_MAILBOX, R::WorkRam), 1, 0, 4, 0);
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_MAILBOX, R::Rom), 0, 0, 0, 0);
+
+    // Region totals, nothing outside the functions
+    ExpectAccess(profiler.GetMemoryAccess(R::WorkRam), 20, 20, 46, 46);
+    ExpectAccess(profiler.GetMemoryAccess(R::Rom), 16, 0, 32, 0);
+    ExpectAccess(profiler.GetMemoryAccess(R::Other), 0, 0, 0, 0);
+    ExpectAccess(profiler.GetMemoryAccess(0x1234, R::WorkRam), 0, 0, 0, 0);  // Not a function
+
+    // Work RAM heatmap counts accesses at their start address
+    const std::vector<GX::MemoryAccessStats>& ram = profiler.GetWorkRamAccess();
+    ASSERT_EQ(ram.size(), 0x10000u);
+    ExpectAccess(ram[STACK_SLOT & 0xFFFF], 3, 3, 12, 12);
+    ExpectAccess(ram[(STACK_SLOT & 0xFFFF) + 2], 0, 0, 0, 0);
+    ExpectAccess(ram[FRAME_COUNTER & 0xFFFF], 1, 1, 2, 2);
+    ExpectAccess(ram[(BUFFER & 0xFFFF) + 30], 1, 1, 2, 2);
+
+    // Counts accumulate over runs until Reset()
+    ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+    RunProgram();
+    ExpectAccess(profiler.GetMemoryAccess(FUNC_COPY_TABLE, R::Rom), 32, 0, 64, 0);
+    profiler.Reset();
+    ExpectAccess(profiler.GetMemoryAccess(R::WorkRam), 0, 0, 0, 0);
+    EXPECT_EQ(profiler.GetWorkRamAccess()[STACK_SLOT & 0xFFFF].Accesses(), 0u);
+}
+
+/**
+ * Test that memory access profiling is off by default and works with
+ * functions added while running
+ */
+TEST_F(MemoryProfilerTest, DisabledAndSymbolsChanged) {
+    profiler.Start();
+    RunFrames(2);
+    profiler.Stop();
+    EXPECT_EQ(profiler.GetMemoryAccess(GX::MemoryRegion::WorkRam).Accesses(), 0u);
+    EXPECT_TRUE(profiler.GetWorkRamAccess().empty());
+
+    GX::Profiler late;
+    late.AddFunction(FUNC_MAIN, FUNC_MAIN_END, "main");
+    ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+    late.Start(options);
+    late.AddFunction(FUNC_COPY_TABLE, FUNC_COPY_TABLE_END, "copy_table");
+    RunFrames(2);
+    late.Stop();
+    ExpectAccess(late.GetMemoryAccess(FUNC_COPY_TABLE, GX::MemoryRegion::Rom), 16, 0, 32, 0);
+    EXPECT_EQ(late.GetMemoryAccess(FUNC_MAIN, GX::MemoryRegion::WorkRam).writes, 4u);
+
+    // Accesses by code outside any function still count in the totals
+    ExpectAccess(late.GetMemoryAccess(GX::MemoryRegion::WorkRam), 20, 20, 46, 46);
+}
+
+/**
+ * Test per-variable counts with variables from nm output (elf2sym input)
+ */
+TEST_F(MemoryProfilerTest, VariablesFromNm) {
+    std::string path = TempPath("gxtest_memory_vars.txt");
+    {
+        std::ofstream out(path);
+        out << "00000200 T main\n"
+            << "00ff0000 B frame_counter\n"
+            << "00ff0100 B buffer\n"
+            << "00ff0120 B _end\n"
+            << "00fffe00 A __stack\n";
+    }
+    EXPECT_EQ(profiler.LoadVariablesFromFile(path), 2);
+    std::remove(path.c_str());
+    EXPECT_EQ(profiler.GetVariableCount(), 2u);
+    EXPECT_EQ(profiler.LoadVariablesFromFile("/nonexistent/vars.txt"), -1);
+
+    RunProgram();
+
+    std::vector<GX::VariableAccess> vars = profiler.GetVariableAccess();
+    ASSERT_EQ(vars.size(), 2u);
+    EXPECT_EQ(vars[0].name, "buffer");  // Most accessed first
+    EXPECT_EQ(vars[0].addr, BUFFER);
+    EXPECT_EQ(vars[0].size, 0x20u);
+    ExpectAccess(vars[0].access, 16, 16, 32, 32);
+    EXPECT_EQ(vars[1].name, "frame_counter");
+    EXPECT_EQ(vars[1].size, 0x100u);    // Up to the next symbol
+    ExpectAccess(vars[1].access, 1, 1, 2, 2);
+
+    // Sized symbols (nm -S) replace the guess
+    GX::Profiler sized;
+    path = TempPath("gxtest_memory_vars_sized.txt");
+    {
+        std::ofstream out(path);
+        out << "00ff0000 00000002 B frame_counter\n"
+            << "00ff0100 00000020 b buffer\n";
+    }
+    EXPECT_EQ(sized.LoadVariablesFromFile(path), 2);
+    std::remove(path.c_str());
+    std::vector<GX::VariableAccess> unprofiled = sized.GetVariableAccess();
+    ASSERT_EQ(unprofiled.size(), 2u);
+    EXPECT_EQ(unprofiled[0].name, "frame_counter");  // Ties stay in address order
+    EXPECT_EQ(unprofiled[0].size, 2u);
+    EXPECT_EQ(unprofiled[0].access.Accesses(), 0u);
+
+    // Variables outside work RAM are ignored
+    sized.AddVariable(0x400, 32, "table");
+    sized.AddVariable(0xFF0200, 0, "empty");
+    EXPECT_EQ(sized.GetVariableCount(), 2u);
+    sized.ClearSymbols();
+    EXPECT_EQ(sized.GetVariableCount(), 0u);
+}
+
+/**
+ * Test the heatmap export and the report
+ */
+TEST_F(MemoryProfilerTest, HeatmapExportAndReport) {
+    profiler.AddVariable(FRAME_COUNTER, 2, "frame_counter");
+    profiler.AddVariable(BUFFER, 32, "buffer");
+    profiler.AddVariable(0xFF0200, 2, "quoted \"name\" \\ path");
+    RunProgram();
+
+    std::string json_path = TempPath("gxtest_heatmap.json");
+    ASSERT_TRUE(profiler.WriteMemoryHeatmap(json_path));
+    std::ifstream json_file(json_path);
+    std::stringstream json;
+    json << json_file.rdbuf();
+    std::remove(json_path.c_str());
+    EXPECT_NE(json.str().find("\"base\": 16711680"), std::string::npos) << json.str();
+    EXPECT_NE(json.str().find("\"00fffdfc\": [3, 3, 12, 12]"), std::string::npos) << json.str();
+    EXPECT_NE(json.str().find("{\"name\": \"buffer\", \"addr\": 16711936, \"size\": 32, \"reads\": 16, "
+                              "\"writes\": 16, \"read_bytes\": 32, \"write_bytes\": 32}"),
+              std::string::npos) << json.str();
+    EXPECT_NE(json.str().find("{\"name\": \"quoted \\\"name\\\" \\\\ path\", \"addr\": 16712192"),
+              std::string::npos) << json.str();
+
+    std::string bin_path = TempPath("gxtest_heatmap.bin");
+    ASSERT_TRUE(profiler.WriteMemoryHeatmap(bin_path, GX::HistogramFormat::Binary));
+    std::ifstream bin_file(bin_path, std::ios::binary);
+    std::vector<uint8_t> bin((std::istreambuf_iterator<char>(bin_file)), std::istreambuf_iterator<char>());
+    std::remove(bin_path.c_str());
+    ASSERT_EQ(bin.size(), 16u + 0x10000u * 32u);
+    EXPECT_EQ(memcmp(bin.data(), "GXHEAT01", 8), 0);
+    auto get = [&bin](size_t offset, int bytes) {
+        uint64_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--) {
+            value = (value << 8) | bin[offset + i];
+        }
+        return value;
+    };
+    EXPECT_EQ(get(8, 4), 0xFF0000u);
+    EXPECT_EQ(get(12, 4), 0x10000u);
+    size_t entry = 16 + (STACK_SLOT & 0xFFFF) * 32;
+    EXPECT_EQ(get(entry, 8), 3u);
+    EXPECT_EQ(get(entry + 8, 8), 3u);
+    EXPECT_EQ(get(entry + 16, 8), 12u);
+    EXPECT_EQ(get(entry + 24, 8), 12u);
+
+    std::ostringstream report;
+    profiler.PrintReport(report);
+    std::cout << report.str();
+    EXPECT_NE(report.str().find("Memory region"), std::string::npos);
+    EXPECT_NE(report.str().find("VDP data"), std::string::npos);
+    EXPECT_NE(report.str().find("copy_table: ROM"), std::string::npos);
+    EXPECT_NE(report.str().find("buffer"), std::string::npos);
+}
+
+} // namespace
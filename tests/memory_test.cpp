@@ -0,0 +1,106 @@
+/**
+ * gxtest - Memory Footprint Test
+ *
+ * Tests the per-process memory footprint of the emulator.
+ * Verifies:
+ * 1. Resident memory is reported
+ * 2. ROM memory follows the loaded ROM (a small ROM after a large one
+ *    releases the large one's pages)
+ * 3. Forked workers reloading their parent's ROM keep sharing its pages
+ */
+
+#include <gxtest.h>
+#include "filler_rom.h"
+#include "prime_sieve_rom.h"
+#include <iostream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using namespace GX::TestRoms;
+
+const size_t MB = 1024 * 1024;
+
+class MemoryTest : public GX::Test {
+protected:
+    void SetUp() override {
+        if (GX::Emulator::GetMemoryStats().rss == 0) {
+            GTEST_SKIP() << "Resident memory not reported on this platform";
+        }
+        GX::Emulator::ClearRomCache();
+    }
+
+    void Print(const char* label) {
+        GX::MemoryStats stats = GX::Emulator::GetMemoryStats();
+        std::cout << label << ": RSS " << stats.rss / 1024 << " KB, shared "
+                  << stats.shared / 1024 << " KB, private dirty "
+                  << stats.private_dirty / 1024 << " KB, ROM "
+                  << stats.rom_bytes / 1024 << " KB" << std::endl;
+    }
+};
+
+/**
+ * Test that the footprint reported follows the loaded ROM
+ */
+TEST_F(MemoryTest, RomFootprintFollowsLoadedRom) {
+    auto large = MakeRom(16 * MB);
+    ASSERT_TRUE(emu.LoadRom(large.data(), large.size()));
+    RunFrames(1);
+    Print("16 MB ROM");
+    GX::MemoryStats after_large = GX::Emulator::GetMemoryStats();
+    EXPECT_GE(after_large.rom_bytes, 16 * MB);
+
+    // Drop the source buffer and the cached image, then load a small ROM
+    std::vector<uint8_t>().swap(large);
+    GX::Emulator::ClearRomCache();
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    RunFrames(1);
+    Print("Small ROM");
+    GX::MemoryStats after_small = GX::Emulator::GetMemoryStats();
+
+    EXPECT_LT(after_small.rom_bytes, after_large.rom_bytes);
+    EXPECT_LT(after_small.rss + 12 * MB, after_large.rss)
+        << "Pages of the previous ROM are still resident";
+    EXPECT_EQ(ReadWord(0x100000), 0);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * Test that forked workers reloading the parent's ROM do not copy it
+ */
+TEST_F(MemoryTest, ForkedReloadSharesRom) {
+    auto rom = MakeRom(8 * MB);
+    ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+    Print("Parent");
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        // Child: reload (from the inherited ROM cache) and run
+        GX::MemoryStats before = GX::Emulator::GetMemoryStats();
+        bool ok = emu.LoadRom(rom.data(), rom.size());
+        emu.RunFrames(5);
+        ok = ok && emu.ReadWord(DONE_FLAG_ADDR) == DONE_FLAG_VALUE;
+        GX::MemoryStats after = GX::Emulator::GetMemoryStats();
+        Print("Child");
+
+        // A private copy of the ROM would be 8 MB of new dirty pages
+        size_t growth = after.private_dirty - before.private_dirty;
+        std::cout << "Child private dirty growth: " << growth / 1024 << " KB" << std::endl;
+        _exit(!ok ? 1 : growth > 4 * MB ? 2 : 0);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_NE(WEXITSTATUS(status), 1) << "Child failed to run the ROM";
+    EXPECT_NE(WEXITSTATUS(status), 2) << "Child copied the ROM image";
+}
+#endif
+
+} // namespace
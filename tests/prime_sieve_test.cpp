@@ -148,9 +148,8 @@ TEST_F(PrimeSieveTest, PerformanceBenchmark) {
 
 /**
  * Test save/load state preserves computation results
- * DISABLED: State save/load crashes due to incomplete stub implementations
  */
-TEST_F(PrimeSieveTest, DISABLED_SaveStatePreservesResults) {
+TEST_F(PrimeSieveTest, SaveStatePreservesResults) {
     // Run until completion
     emu.RunUntil([this]() {
         return ReadWord(DONE_FLAG_ADDR) == DONE_FLAG_VALUE;
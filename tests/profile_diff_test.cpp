@@ -0,0 +1,346 @@
+/**
+ * gxtest - Profile Diff Test
+ *
+ * Profiles two builds of a small game loop, where the second build moves
+ * every function and makes update 25% slower, and compares them.
+ * Verifies:
+ * 1. WriteProfile() / LoadProfile() round trip
+ * 2. Functions matched by name across builds, with cycle and call deltas
+ * 3. Address histograms (JSON and binary) summed per function by symbols
+ * 4. Regression thresholds, added and removed functions
+ * 5. gxprof-diff exit status
+ */
+
+#include <gxtest.h>
+#include <profiler.h>
+#include <profile_diff.h>
+#include "rom_builder.h"
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/wait.h>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+constexpr uint32_t FUNC_MAIN = 0x200;
+constexpr uint32_t FUNC_MAIN_END = 0x21C;
+constexpr uint16_t BASE_UPDATE_LOOPS = 0x200;
+constexpr uint16_t SLOW_UPDATE_LOOPS = 0x280;
+constexpr uint16_t DRAW_LOOPS = 0x200;
+constexpr int FRAMES = 30;
+
+/** Function addresses of one build */
+struct Build {
+    uint32_t update;
+    uint32_t draw;
+    uint32_t wait_vblank;
+    uint32_t vint;
+
+    explicit Build(uint32_t offset)
+        : update(0x300 + offset), draw(0x340 + offset),
+          wait_vblank(0x380 + offset), vint(0x3C0 + offset) {}
+};
+
+/*
+ * main:        enable display and V-INT; loop { update; draw; wait_vblank }
+ * update:      dbra update_loops times
+ * draw:        dbra DRAW_LOOPS times
+ * wait_vblank: spin until the V-INT counter at $FF0000 changes
+ * vint:        increment $FF0000
+ */
+std::vector<uint8_t> MakeBuildRom(const Build& build, uint16_t update_loops) {
+    RomBuilder rom(FUNC_MAIN);
+    rom.SetVector(GX::VECTOR_VINT, build.vint);
+    rom.PutGameLoop(FUNC_MAIN, {build.update, build.draw, build.wait_vblank});
+    rom.PutCode(build.update, {
+        0x303C, update_loops,           // update: move.w #n,d0
+        0x51C8, 0xFFFE,                 //        dbra    d0,*
+        0x4E75,                         //        rts
+    });
+    rom.PutCode(build.draw, {
+        0x303C, DRAW_LOOPS,             // draw:  move.w  #n,d0
+        0x51C8, 0xFFFE,                 //        dbra    d0,*
+        0x4E75,                         //        rts
+    });
+    rom.PutWaitVBlank(build.wait_vblank);
+    rom.PutVIntCounter(build.vint);
+    return rom.Data();
+}
+
+std::string TempPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+class ProfileDiffTest : public GX::Test {
+protected:
+    const Build base_build = Build(0);
+    const Build slow_build = Build(0x20);
+
+    void AddSymbols(GX::Profiler& profiler, const Build& build) {
+        profiler.AddFunction(FUNC_MAIN, FUNC_MAIN_END, "main");
+        profiler.AddFunction(build.update, build.update + 10, "update");
+        profiler.AddFunction(build.draw, build.draw + 10, "draw");
+        profiler.AddFunction(build.wait_vblank, build.wait_vblank + 16, "wait_vblank");
+        profiler.AddFunction(build.vint, build.vint + 8, "vint");
+    }
+
+    /** Profile FRAMES frames of a build after its setup code */
+    void ProfileBuild(GX::Profiler& profiler, const Build& build, uint16_t update_loops,
+                      const GX::ProfileOptions& options = GX::ProfileOptions()) {
+        rom_ = MakeBuildRom(build, update_loops);
+        ASSERT_TRUE(emu.LoadRom(rom_.data(), rom_.size()));
+        AddSymbols(profiler, build);
+        RunFrames(2);
+        profiler.Start(options);
+        RunFrames(FRAMES);
+        profiler.Stop();
+    }
+
+    const GX::FunctionDelta* FindDelta(const GX::ProfileDiff& diff, const std::string& name) {
+        for (const GX::FunctionDelta& delta : diff.functions) {
+            if (delta.name == name) return &delta;
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<uint8_t> rom_;
+};
+
+/**
+ * Test that a written profile loads back with the same results
+ */
+TEST_F(ProfileDiffTest, WriteAndLoad) {
+    GX::Profiler profiler;
+    ProfileBuild(profiler, base_build, BASE_UPDATE_LOOPS);
+    std::string path = TempPath("gxtest_profile_base.gxprof");
+    ASSERT_TRUE(profiler.WriteProfile(path));
+
+    GX::ProfileData profile;
+    std::string error;
+    ASSERT_TRUE(GX::LoadProfile(path, profile, {}, &error)) << error;
+    EXPECT_EQ(profile.cpu, GX::ProfileCpu::M68K);
+    EXPECT_EQ(profile.sample_rate, 1u);
+    EXPECT_EQ(profile.total_cycles, profiler.GetTotalCycles());
+    EXPECT_EQ(profile.frames, static_cast<uint64_t>(FRAMES));
+
+    ASSERT_EQ(profile.functions.size(), 5u);
+    EXPECT_EQ(profile.functions[0].name, "draw");   // Sorted by name
+    EXPECT_EQ(profile.functions[4].name, "wait_vblank");
+    for (const GX::ProfileFunction& func : profile.functions) {
+        const GX::FunctionStats* stats = profiler.GetStats(func.addr);
+        ASSERT_NE(stats, nullptr) << func.name;
+        EXPECT_EQ(func.cycles, stats->cycles_exclusive) << func.name;
+        EXPECT_EQ(func.calls, stats->call_count) << func.name;
+    }
+    std::filesystem::remove(path);
+}
+
+/**
+ * Test comparing two builds whose functions moved
+ */
+TEST_F(ProfileDiffTest, DiffBuilds) {
+    GX::Profiler base_profiler;
+    ProfileBuild(base_profiler, base_build, BASE_UPDATE_LOOPS);
+    GX::Profiler slow_profiler;
+    ProfileBuild(slow_profiler, slow_build, SLOW_UPDATE_LOOPS);
+
+    std::string base_path = TempPath("gxtest_diff_base.gxprof");
+    std::string slow_path = TempPath("gxtest_diff_slow.gxprof");
+    ASSERT_TRUE(base_profiler.WriteProfile(base_path));
+    ASSERT_TRUE(slow_profiler.WriteProfile(slow_path));
+    GX::ProfileData base, slow;
+    ASSERT_TRUE(GX::LoadProfile(base_path, base));
+    ASSERT_TRUE(GX::LoadProfile(slow_path, slow));
+
+    GX::ProfileDiff diff = GX::DiffProfiles(base, slow);
+    ASSERT_EQ(diff.functions.size(), 5u);
+
+    // update takes 0x80 more dbra loops (10 68k cycles each) per frame, and
+    // wait_vblank spins that much less
+    const GX::FunctionDelta* update = FindDelta(diff, "update");
+    ASSERT_NE(update, nullptr);
+    double expected = (SLOW_UPDATE_LOOPS - BASE_UPDATE_LOOPS) * 70.0 * FRAMES;
+    EXPECT_NEAR(static_cast<double>(update->CycleDelta()), expected, expected * 0.02);
+    EXPECT_NEAR(update->CycleChange(), 0.25, 0.01);
+    EXPECT_EQ(update->CallDelta(), 0);
+    EXPECT_FALSE(update->added);
+    EXPECT_FALSE(update->removed);
+
+    const GX::FunctionDelta* wait = FindDelta(diff, "wait_vblank");
+    ASSERT_NE(wait, nullptr);
+    EXPECT_LT(wait->CycleDelta(), 0);
+    EXPECT_LT(std::llabs(FindDelta(diff, "draw")->CycleDelta()), 100);  // Only interrupt timing
+
+    // Sorted by impact: update and wait_vblank moved the most
+    EXPECT_TRUE(diff.functions[0].name == "update" || diff.functions[0].name == "wait_vblank");
+    EXPECT_TRUE(diff.functions[1].name == "update" || diff.functions[1].name == "wait_vblank");
+    for (size_t i = 1; i < diff.functions.size(); i++) {
+        EXPECT_GE(std::llabs(diff.functions[i - 1].CycleDelta()), std::llabs(diff.functions[i].CycleDelta()));
+    }
+
+    // The frames take the same time, only update regressed
+    EXPECT_NEAR(diff.TotalChange(), 0.0, 0.001);
+    std::vector<std::string> regressions = GX::FindRegressions(diff, GX::RegressionThresholds());
+    ASSERT_EQ(regressions.size(), 1u);
+    EXPECT_EQ(regressions[0].rfind("update: ", 0), 0u) << regressions[0];
+    EXPECT_NE(regressions[0].find("threshold +5.00%"), std::string::npos) << regressions[0];
+
+    GX::RegressionThresholds loose;
+    loose.function_change = 0.30;
+    EXPECT_TRUE(GX::FindRegressions(diff, loose).empty());
+    GX::RegressionThresholds large;
+    large.min_cycles = static_cast<uint64_t>(expected * 2);
+    EXPECT_TRUE(GX::FindRegressions(diff, large).empty());
+
+    // The reverse is an improvement
+    EXPECT_TRUE(GX::FindRegressions(GX::DiffProfiles(slow, base), GX::RegressionThresholds()).empty());
+
+    std::ostringstream report;
+    GX::PrintDiff(report, diff, 1);
+    EXPECT_NE(report.str().find(diff.functions[0].name), std::string::npos) << report.str();
+    EXPECT_EQ(report.str().find(diff.functions[1].name), std::string::npos) << report.str();
+
+    std::filesystem::remove(base_path);
+    std::filesystem::remove(slow_path);
+}
+
+/**
+ * Test address histograms summed per function with each build's symbols
+ */
+TEST_F(ProfileDiffTest, AddressHistograms) {
+    GX::ProfileOptions options;
+    options.collect_address_histogram = true;
+    GX::Profiler base_profiler;
+    ProfileBuild(base_profiler, base_build, BASE_UPDATE_LOOPS, options);
+    GX::Profiler slow_profiler;
+    ProfileBuild(slow_profiler, slow_build, SLOW_UPDATE_LOOPS, options);
+
+    std::string json_path = TempPath("gxtest_diff_hist.json");
+    std::string bin_path = TempPath("gxtest_diff_hist.bin");
+    ASSERT_TRUE(base_profiler.WriteAddressHistogram(json_path, GX::HistogramFormat::JSON));
+    ASSERT_TRUE(slow_profiler.WriteAddressHistogram(bin_path, GX::HistogramFormat::Binary));
+
+    GX::ProfileData base, slow;
+    std::string error;
+    ASSERT_TRUE(GX::LoadProfile(json_path, base, base_profiler.GetFunctions(), &error)) << error;
+    ASSERT_TRUE(GX::LoadProfile(bin_path, slow, slow_profiler.GetFunctions(), &error)) << error;
+    EXPECT_EQ(base.total_cycles, base_profiler.GetTotalCycles());
+    EXPECT_EQ(slow.frames, 0u);
+
+    for (const GX::ProfileFunction& func : slow.functions) {
+        const GX::FunctionStats* stats = slow_profiler.GetStats(func.addr);
+        ASSERT_NE(stats, nullptr) << func.name;
+        EXPECT_EQ(func.cycles, stats->cycles_exclusive) << func.name;
+        EXPECT_EQ(func.calls, 0u) << "Histograms have no call counts";
+    }
+
+    GX::ProfileDiff diff = GX::DiffProfiles(base, slow);
+    EXPECT_NEAR(FindDelta(diff, "update")->CycleChange(), 0.25, 0.01);
+    EXPECT_EQ(GX::FindRegressions(diff, GX::RegressionThresholds()).size(), 1u);
+
+    // Without symbols, addresses are kept as names and do not match across builds
+    GX::ProfileData unnamed;
+    ASSERT_TRUE(GX::LoadProfile(bin_path, unnamed));
+    ASSERT_FALSE(unnamed.functions.empty());
+    EXPECT_EQ(unnamed.functions[0].name[0], '$');
+
+    std::filesystem::remove(json_path);
+    std::filesystem::remove(bin_path);
+}
+
+/**
+ * Test added and removed functions and the total threshold
+ */
+TEST_F(ProfileDiffTest, AddedRemovedAndTotal) {
+    GX::ProfileData base;
+    base.total_cycles = 1000000;
+    base.functions = {{"physics", 0x1000, 60, 400000, 0}, {"old_draw", 0x2000, 60, 300000, 0}};
+    GX::ProfileData current;
+    current.total_cycles = 1050000;
+    current.functions = {{"new_draw", 0x2000, 60, 350000, 0}, {"physics", 0x1100, 60, 400000, 0}};
+
+    GX::ProfileDiff diff = GX::DiffProfiles(base, current);
+    ASSERT_EQ(diff.functions.size(), 3u);
+    EXPECT_EQ(diff.functions[0].name, "new_draw");
+    EXPECT_TRUE(diff.functions[0].added);
+    EXPECT_TRUE(std::isinf(diff.functions[0].CycleChange()));
+    EXPECT_EQ(diff.functions[1].name, "old_draw");
+    EXPECT_TRUE(diff.functions[1].removed);
+    EXPECT_DOUBLE_EQ(diff.functions[1].CycleChange(), -1.0);
+    EXPECT_EQ(diff.functions[2].CycleDelta(), 0);
+    EXPECT_DOUBLE_EQ(diff.TotalChange(), 0.05);
+
+    std::vector<std::string> regressions = GX::FindRegressions(diff, GX::RegressionThresholds());
+    ASSERT_EQ(regressions.size(), 2u);
+    EXPECT_EQ(regressions[0], "Total: 1000000 -> 1050000 cycles (+50000, +5.00%, threshold +1.00%)");
+    EXPECT_EQ(regressions[1], "new_draw: 0 -> 350000 cycles (+350000, new, threshold +5.00%)");
+
+    std::ostringstream report;
+    GX::PrintDiff(report, diff, 2);
+    EXPECT_NE(report.str().find("removed"), std::string::npos) << report.str();
+    EXPECT_EQ(report.str().find("physics"), std::string::npos) << report.str();
+}
+
+/**
+ * Test load errors
+ */
+TEST_F(ProfileDiffTest, LoadErrors) {
+    GX::ProfileData profile;
+    std::string error;
+    EXPECT_FALSE(GX::LoadProfile(TempPath("gxtest_missing.gxprof"), profile, {}, &error));
+    EXPECT_NE(error.find("cannot open"), std::string::npos) << error;
+
+    std::string path = TempPath("gxtest_bad.gxprof");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "not a profile";
+    }
+    EXPECT_FALSE(GX::LoadProfile(path, profile, {}, &error));
+    EXPECT_NE(error.find("not a profile"), std::string::npos) << error;
+
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write("GXPROF01\0\0\0\0\1\0\0\0", 16);
+    }
+    EXPECT_FALSE(GX::LoadProfile(path, profile, {}, &error));
+    EXPECT_NE(error.find("truncated"), std::string::npos) << error;
+    std::filesystem::remove(path);
+}
+
+#ifdef GXPROF_DIFF_PATH
+/**
+ * Test the gxprof-diff exit status that CI gates on
+ */
+TEST_F(ProfileDiffTest, ToolExitStatus) {
+    GX::Profiler base_profiler;
+    ProfileBuild(base_profiler, base_build, BASE_UPDATE_LOOPS);
+    GX::Profiler slow_profiler;
+    ProfileBuild(slow_profiler, slow_build, SLOW_UPDATE_LOOPS);
+    std::string base_path = TempPath("gxtest_tool_base.gxprof");
+    std::string slow_path = TempPath("gxtest_tool_slow.gxprof");
+    ASSERT_TRUE(base_profiler.WriteProfile(base_path));
+    ASSERT_TRUE(slow_profiler.WriteProfile(slow_path));
+
+    auto run = [](const std::string& args) {
+        std::string command = std::string(GXPROF_DIFF_PATH) + " " + args + " > /dev/null 2>&1";
+        int status = std::system(command.c_str());
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    };
+    EXPECT_EQ(run(base_path + " " + base_path), 0);
+    EXPECT_EQ(run(base_path + " " + slow_path), 1);
+    EXPECT_EQ(run("--threshold 30 " + base_path + " " + slow_path), 0);
+    EXPECT_EQ(run(slow_path + " " + base_path), 0);
+    EXPECT_EQ(run(base_path + " " + TempPath("gxtest_missing.gxprof")), 2);
+    EXPECT_EQ(run(base_path), 2);
+
+    std::filesystem::remove(base_path);
+    std::filesystem::remove(slow_path);
+}
+#endif
+
+} // namespace
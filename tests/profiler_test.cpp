@@ -7,6 +7,9 @@
  * 2. Function attribution via manually added symbols
  * 3. Sample-based profiling produces reasonable estimates
  * 4. Profiler state management (start/stop/reset)
+ * 5. Per-instruction profiling overhead
+ * 6. Folded stack and pprof export
+ * 7. Hook-free scanline sampling
  */
 
 #include <gxtest.h>
@@ -18,7 +21,14 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <vector>
+#include "zlib.h"
+
+extern "C" {
+#include "cpuhook.h"
+}
 
 namespace {
 
@@ -39,6 +49,98 @@ constexpr uint32_t FUNC_COLLECT_PRIMES = 0x26A;
 constexpr uint32_t FUNC_MAIN = 0x2A0;
 constexpr uint32_t FUNC_MAIN_END = 0x2C2;
 
+// Decoded protocol buffer message: field number -> varints / length-delimited payloads
+struct ProtoMessage {
+    std::multimap<uint32_t, uint64_t> varints;
+    std::multimap<uint32_t, std::string> bytes;
+
+    explicit ProtoMessage(const std::string& data) {
+        size_t pos = 0;
+        auto varint = [&data, &pos]() {
+            uint64_t value = 0;
+            for (int shift = 0; pos < data.size(); shift += 7) {
+                uint8_t b = static_cast<uint8_t>(data[pos++]);
+                value |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) break;
+            }
+            return value;
+        };
+        while (pos < data.size()) {
+            uint64_t key = varint();
+            if ((key & 7) == 0) {
+                varints.emplace(static_cast<uint32_t>(key >> 3), varint());
+            } else if ((key & 7) == 2) {
+                size_t size = varint();
+                bytes.emplace(static_cast<uint32_t>(key >> 3), data.substr(pos, size));
+                pos += size;
+            } else {
+                ADD_FAILURE() << "Unexpected wire type " << (key & 7);
+                return;
+            }
+        }
+    }
+
+    uint64_t Varint(uint32_t field) const {
+        auto it = varints.find(field);
+        return it != varints.end() ? it->second : 0;
+    }
+
+    // Packed repeated varints
+    std::vector<uint64_t> Packed(uint32_t field) const {
+        std::vector<uint64_t> values;
+        auto it = bytes.find(field);
+        if (it == bytes.end()) return values;
+        const std::string& data = it->second;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            uint64_t value = 0;
+            for (int shift = 0; pos < data.size(); shift += 7) {
+                uint8_t b = static_cast<uint8_t>(data[pos++]);
+                value |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) break;
+            }
+            values.push_back(value);
+        }
+        return values;
+    }
+};
+
+// Read a gzip file
+std::string ReadGzip(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::string compressed((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    z_stream stream = {};
+    inflateInit2(&stream, 15 + 16);
+    stream.next_in = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    std::string out;
+    char buffer[16384];
+    int result;
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (result == Z_OK);
+    inflateEnd(&stream);
+    EXPECT_EQ(result, Z_STREAM_END) << "Not a complete gzip stream";
+    return out;
+}
+
+// Folded stack lines ("a;b;c cycles") by stack
+std::map<std::string, uint64_t> ReadFolded(const std::string& path) {
+    std::map<std::string, uint64_t> stacks;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t space = line.rfind(' ');
+        EXPECT_NE(space, std::string::npos) << line;
+        if (space == std::string::npos) continue;
+        stacks[line.substr(0, space)] += std::stoull(line.substr(space + 1));
+    }
+    return stacks;
+}
+
 class ProfilerTest : public GX::Test {
 protected:
     GX::Profiler profiler;
@@ -201,40 +303,171 @@ TEST_F(ProfilerTest, SampledProfilingCycles) {
 }
 
 /**
- * Test that higher sample rates reduce profiler overhead (faster execution)
- * This is a sanity check that sampling is actually skipping work
+ * Benchmark per-instruction profiling overhead
+ *
+ * Runs the same 60 frames unprofiled and under each profiling configuration
+ * (best of 3) and reports the cost per instruction. Attribution with a large
+ * symbol table must match the small one exactly.
  */
-TEST_F(ProfilerTest, SamplingReducesOverhead) {
-    // Time full profiling
-    auto start1 = std::chrono::high_resolution_clock::now();
-    profiler.Start(GX::ProfileMode::Simple);
-    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+TEST_F(ProfilerTest, OverheadBenchmark) {
+    constexpr int FRAMES = 60;
+    constexpr int REPEATS = 3;
+    std::vector<uint8_t> start_state = emu.SaveState();
+
+    // Count the instructions of the run
+    uint64_t instructions = 0;
+    int counter = cpu_hook_subscribe(HOOK_M68K_E, 0, 0xFFFFFF,
+        [](void* param, hook_type_t, int, unsigned int, unsigned int) {
+            (*static_cast<uint64_t*>(param))++;
+        }, &instructions);
+    ASSERT_GE(counter, 0);
+    RunFrames(FRAMES);
+    cpu_hook_unsubscribe(counter);
+    ASSERT_GT(instructions, 0u);
+
+    // Same functions among 4000 others across ROM and RAM
+    GX::Profiler large;
+    large.AddFunction(FUNC_START, FUNC_CLEAR_SIEVE, "_start");
+    large.AddFunction(FUNC_CLEAR_SIEVE, FUNC_MARK_TRIVIAL, "clear_sieve");
+    large.AddFunction(FUNC_MARK_TRIVIAL, FUNC_RUN_SIEVE, "mark_trivial_composites");
+    large.AddFunction(FUNC_RUN_SIEVE, FUNC_COLLECT_PRIMES, "run_sieve");
+    large.AddFunction(FUNC_COLLECT_PRIMES, FUNC_MAIN, "collect_primes");
+    large.AddFunction(FUNC_MAIN, FUNC_MAIN_END, "main");
+    for (uint32_t i = 0; i < 2000; i++) {
+        large.AddFunction(0x1000 + i * 0x40, 0x1000 + i * 0x40 + 0x30, "rom_func_" + std::to_string(i));
+        large.AddFunction(0xFF0000 + i * 0x20, 0xFF0000 + i * 0x20 + 0x20, "ram_func_" + std::to_string(i));
+    }
+
+    // Best time over the repeats, each from the same state
+    auto time_run = [&](GX::Profiler* p, const GX::ProfileOptions& opts) {
+        double best = 0.0;
+        for (int i = 0; i < REPEATS; i++) {
+            EXPECT_TRUE(emu.LoadState(start_state));
+            if (p) {
+                p->Reset();
+                p->Start(opts);
+            }
+            auto start = std::chrono::steady_clock::now();
+            RunFrames(FRAMES);
+            auto end = std::chrono::steady_clock::now();
+            if (p) p->Stop();
+            double us = std::chrono::duration<double, std::micro>(end - start).count();
+            best = (i == 0 || us < best) ? us : best;
+        }
+        return best;
+    };
+
+    GX::ProfileOptions simple;
+    GX::ProfileOptions callstack;
+    callstack.mode = GX::ProfileMode::CallStack;
+    GX::ProfileOptions histogram;
+    histogram.collect_address_histogram = true;
+    GX::ProfileOptions sampled;
+    sampled.sample_rate = 100;
+    GX::ProfileOptions scanline;
+    scanline.mode = GX::ProfileMode::Scanline;
+    GX::ProfileOptions stack_walk = scanline;
+    stack_walk.stack_walk_depth = 16;
+    GX::ProfileOptions memory;
+    memory.collect_memory_access = true;
+
+    double base_us = time_run(nullptr, simple);
+    double large_us = time_run(&large, simple);
+    auto large_stats = large.GetAllStats();
+    double callstack_us = time_run(&profiler, callstack);
+    double histogram_us = time_run(&profiler, histogram);
+    double sampled_us = time_run(&profiler, sampled);
+    double scanline_us = time_run(&profiler, scanline);
+    double stack_walk_us = time_run(&profiler, stack_walk);
+    double memory_us = time_run(&profiler, memory);
+    double full_us = time_run(&profiler, simple);
+
+    // Attribution does not depend on the size of the symbol table
+    for (uint32_t func : {FUNC_START, FUNC_CLEAR_SIEVE, FUNC_MARK_TRIVIAL,
+                          FUNC_RUN_SIEVE, FUNC_COLLECT_PRIMES, FUNC_MAIN}) {
+        const GX::FunctionStats* small_stats = profiler.GetStats(func);
+        ASSERT_NE(small_stats, nullptr);
+        EXPECT_EQ(large_stats.at(func).cycles_exclusive, small_stats->cycles_exclusive);
+        EXPECT_EQ(large_stats.at(func).call_count, small_stats->call_count);
+    }
+    EXPECT_EQ(large.GetTotalCycles(), profiler.GetTotalCycles());
+
+    auto report = [&](const char* name, double us) {
+        std::printf("  %-28s %9.0f us  %6.2f ns/instr overhead\n",
+                    name, us, (us - base_us) * 1000.0 / instructions);
+    };
+    std::printf("Profiling overhead, %d frames, %llu instructions:\n",
+                FRAMES, static_cast<unsigned long long>(instructions));
+    report("Unprofiled", base_us);
+    report("Simple (6 functions)", full_us);
+    report("Simple (4006 functions)", large_us);
+    report("CallStack", callstack_us);
+    report("Simple + address histogram", histogram_us);
+    report("Sampled (1/100)", sampled_us);
+    report("Scanline", scanline_us);
+    report("Scanline + stack walk", stack_walk_us);
+    report("Simple + memory access", memory_us);
+
+    // Just verify all completed - timing can be noisy on fast operations
+    EXPECT_GT(full_us, 0);
+    EXPECT_GT(sampled_us, 0);
+}
+
+// =============================================================================
+// Hooked / Unhooked Core Tests
+// =============================================================================
+
+/**
+ * Test that the instrumented core variant emulates exactly like the fast one
+ */
+TEST_F(ProfilerTest, HookedCoreMatchesFastCore) {
+    RunFrames(30);
+    auto fast = emu.SaveState();
+
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    profiler.Start();
+    RunFrames(30);
     profiler.Stop();
-    auto end1 = std::chrono::high_resolution_clock::now();
-    auto full_time = std::chrono::duration_cast<std::chrono::microseconds>(end1 - start1);
 
-    emu.Reset();
-    profiler.Reset();
+    EXPECT_GT(profiler.GetTotalCycles(), 0u);
+    EXPECT_EQ(emu.SaveState(), fast);
+}
 
-    // Time sampled profiling (1/100)
-    GX::ProfileOptions opts;
-    opts.sample_rate = 100;
+/**
+ * Test that stopping the profiler returns to the unhooked core
+ */
+TEST_F(ProfilerTest, StoppedProfilerCostsNothing) {
+    // Warm up both variants
+    profiler.Start();
+    RunFrames(5);
+    profiler.Stop();
+    uint64_t profiled = profiler.GetTotalCycles();
+
+    auto time_frames = [this](int frames) {
+        ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+        RunFrames(frames);
+    };
+
+    auto start1 = std::chrono::high_resolution_clock::now();
+    time_frames(300);
+    auto end1 = std::chrono::high_resolution_clock::now();
 
+    profiler.Start();
     auto start2 = std::chrono::high_resolution_clock::now();
-    profiler.Start(opts);
-    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
-    profiler.Stop();
+    time_frames(300);
     auto end2 = std::chrono::high_resolution_clock::now();
-    auto sampled_time = std::chrono::duration_cast<std::chrono::microseconds>(end2 - start2);
+    profiler.Stop();
 
-    // Sampled should be faster (or at least not slower)
-    // Note: For very fast ROMs like prime_sieve, the difference may be small
-    std::cout << "Full profiling: " << full_time.count() << " us" << std::endl;
-    std::cout << "Sampled (1/100): " << sampled_time.count() << " us" << std::endl;
+    // Nothing is recorded once stopped
+    uint64_t after = profiler.GetTotalCycles();
+    RunFrames(10);
+    EXPECT_EQ(profiler.GetTotalCycles(), after);
+    EXPECT_GT(after, profiled);
 
-    // Just verify both completed - timing can be noisy on fast operations
-    EXPECT_GT(full_time.count(), 0);
-    EXPECT_GT(sampled_time.count(), 0);
+    auto unhooked = std::chrono::duration_cast<std::chrono::microseconds>(end1 - start1);
+    auto hooked = std::chrono::duration_cast<std::chrono::microseconds>(end2 - start2);
+    std::cout << "300 frames unhooked: " << unhooked.count() << " us" << std::endl;
+    std::cout << "300 frames profiled: " << hooked.count() << " us" << std::endl;
 }
 
 // =============================================================================
@@ -552,6 +785,62 @@ TEST_F(ProfilerTest, WriteAddressHistogramInvalidPath) {
         << "WriteAddressHistogram should return false for invalid path";
 }
 
+/**
+ * Test the binary histogram format holds the same entries as the histogram
+ */
+TEST_F(ProfilerTest, WriteAddressHistogramBinary) {
+    GX::ProfileOptions opts;
+    opts.collect_address_histogram = true;
+    opts.sample_rate = 3;
+
+    profiler.Start(opts);
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+    profiler.Stop();
+
+    std::string temp_path = (std::filesystem::temp_directory_path() / "gxtest_histogram_test.bin").string();
+    ASSERT_TRUE(profiler.WriteAddressHistogram(temp_path, GX::HistogramFormat::Binary));
+
+    std::ifstream file(temp_path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(temp_path.c_str());
+
+    auto get = [&data](size_t offset, int bytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+        }
+        return value;
+    };
+
+    ASSERT_GE(data.size(), 32u);
+    EXPECT_EQ(std::string(data.begin(), data.begin() + 8), "GXHIST01");
+    EXPECT_EQ(get(8, 4), 3u);
+    EXPECT_EQ(get(12, 4), static_cast<uint64_t>(GX::ProfileCpu::M68K));
+    EXPECT_EQ(get(16, 8), profiler.GetTotalCycles());
+
+    const auto& histogram = profiler.GetAddressHistogram();
+    uint64_t count = get(24, 8);
+    ASSERT_EQ(count, histogram.size());
+    ASSERT_EQ(data.size(), 32 + count * 12);
+
+    uint64_t total = 0;
+    uint32_t last_addr = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint32_t addr = static_cast<uint32_t>(get(32 + i * 12, 4));
+        uint64_t cycles = get(36 + i * 12, 8);
+        if (i > 0) {
+            EXPECT_GT(addr, last_addr) << "Entries should be sorted by address";
+        }
+        ASSERT_EQ(histogram.count(addr), 1u);
+        EXPECT_EQ(histogram.at(addr), cycles);
+        total += cycles;
+        last_addr = addr;
+    }
+    EXPECT_EQ(total, profiler.GetTotalCycles());
+}
+
 /**
  * Test address histogram contains expected addresses from known code
  */
@@ -589,4 +878,252 @@ TEST_F(ProfilerTest, AddressHistogramContainsKnownAddresses) {
         << "run_sieve should account for significant portion of cycles";
 }
 
+// =============================================================================
+// Folded Stack / pprof Export Tests
+// =============================================================================
+
+/**
+ * Test folded stacks from CallStack mode hold every cycle under its callers
+ */
+TEST_F(ProfilerTest, WriteFoldedStacksCallStack) {
+    profiler.Start(GX::ProfileMode::CallStack);
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+    profiler.Stop();
+
+    std::string temp_path = (std::filesystem::temp_directory_path() / "gxtest_folded_test.txt").string();
+    ASSERT_TRUE(profiler.WriteFoldedStacks(temp_path));
+    auto stacks = ReadFolded(temp_path);
+    std::remove(temp_path.c_str());
+
+    uint64_t total = 0;
+    for (const auto& kv : stacks) {
+        total += kv.second;
+    }
+    EXPECT_EQ(total, profiler.GetTotalCycles());
+
+    // The sieve runs below main, which _start calls
+    ASSERT_EQ(stacks.count("_start;main;run_sieve"), 1u);
+    EXPECT_EQ(stacks["_start;main;run_sieve"], profiler.GetStats(FUNC_RUN_SIEVE)->cycles_exclusive);
+    EXPECT_EQ(stacks.count("_start;main;collect_primes"), 1u);
+    EXPECT_EQ(stacks.count("run_sieve"), 0u) << "Callees should be below their callers";
+}
+
+/**
+ * Test folded stacks without CallStack mode: one frame per function
+ */
+TEST_F(ProfilerTest, WriteFoldedStacksSimple) {
+    profiler.Start();
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+    profiler.Stop();
+
+    std::string temp_path = (std::filesystem::temp_directory_path() / "gxtest_folded_simple.txt").string();
+    ASSERT_TRUE(profiler.WriteFoldedStacks(temp_path));
+    auto stacks = ReadFolded(temp_path);
+    std::remove(temp_path.c_str());
+
+    for (const auto& kv : profiler.GetAllStats()) {
+        const GX::FunctionStats* stats = profiler.GetStats(kv.first);
+        if (stats->cycles_exclusive == 0) continue;
+        bool found = false;
+        for (const auto& stack : stacks) {
+            EXPECT_EQ(stack.first.find(';'), std::string::npos);
+            if (stack.second == stats->cycles_exclusive) found = true;
+        }
+        EXPECT_TRUE(found) << std::hex << kv.first;
+    }
+    EXPECT_EQ(stacks.count("run_sieve"), 1u);
+
+    EXPECT_FALSE(profiler.WriteFoldedStacks("/nonexistent/directory/profile.folded"));
+}
+
+/**
+ * Test the pprof profile decodes to the same stacks, functions and addresses
+ */
+TEST_F(ProfilerTest, WritePprof) {
+    profiler.Start(GX::ProfileMode::CallStack);
+    emu.RunUntilMemoryEquals(DONE_FLAG_ADDR + 1, 0xAD, 60);
+    profiler.Stop();
+
+    std::string temp_path = (std::filesystem::temp_directory_path() / "gxtest_profile.pb.gz").string();
+    ASSERT_TRUE(profiler.WritePprof(temp_path));
+    ProtoMessage profile(ReadGzip(temp_path));
+    std::remove(temp_path.c_str());
+
+    std::vector<std::string> strings;
+    for (auto it = profile.bytes.lower_bound(6); it != profile.bytes.upper_bound(6); ++it) {
+        strings.push_back(it->second);
+    }
+    ASSERT_FALSE(strings.empty());
+    EXPECT_EQ(strings[0], "");
+
+    ProtoMessage sample_type(profile.bytes.find(1)->second);
+    ASSERT_LT(sample_type.Varint(1), strings.size());
+    EXPECT_EQ(strings[sample_type.Varint(1)], "cycles");
+    EXPECT_EQ(profile.Varint(12), 1u);  // period = sample rate
+
+    // function id -> name, location id -> (address, function id)
+    std::map<uint64_t, std::string> functions;
+    for (auto it = profile.bytes.lower_bound(5); it != profile.bytes.upper_bound(5); ++it) {
+        ProtoMessage function(it->second);
+        ASSERT_LT(function.Varint(2), strings.size());
+        functions[function.Varint(1)] = strings[function.Varint(2)];
+    }
+    std::map<uint64_t, std::pair<uint64_t, uint64_t>> locations;
+    for (auto it = profile.bytes.lower_bound(4); it != profile.bytes.upper_bound(4); ++it) {
+        ProtoMessage location(it->second);
+        auto line = location.bytes.find(4);
+        uint64_t function_id = line != location.bytes.end() ? ProtoMessage(line->second).Varint(1) : 0;
+        locations[location.Varint(1)] = {location.Varint(3), function_id};
+    }
+
+    uint64_t total = 0;
+    uint64_t sieve = 0;
+    for (auto it = profile.bytes.lower_bound(2); it != profile.bytes.upper_bound(2); ++it) {
+        ProtoMessage sample(it->second);
+        std::vector<uint64_t> ids = sample.Packed(1);
+        std::vector<uint64_t> values = sample.Packed(2);
+        ASSERT_EQ(values.size(), 1u);
+        ASSERT_FALSE(ids.empty());
+        total += values[0];
+
+        // Every location lies in the function it names
+        for (uint64_t id : ids) {
+            ASSERT_EQ(locations.count(id), 1u);
+            uint64_t address = locations[id].first;
+            const std::string& name = functions[locations[id].second];
+            if (name == "run_sieve") {
+                EXPECT_GE(address, FUNC_RUN_SIEVE);
+                EXPECT_LT(address, FUNC_COLLECT_PRIMES);
+            } else if (name == "main") {
+                EXPECT_GE(address, FUNC_MAIN);
+                EXPECT_LT(address, FUNC_MAIN_END);
+            }
+        }
+        if (functions[locations[ids[0]].second] == "run_sieve") {
+            sieve += values[0];
+            EXPECT_EQ(functions[locations[ids.back()].second], "_start");
+        }
+    }
+    EXPECT_EQ(total, profiler.GetTotalCycles());
+    EXPECT_EQ(sieve, profiler.GetStats(FUNC_RUN_SIEVE)->cycles_exclusive);
+}
+
+// =============================================================================
+// Scanline Sampling Tests
+// =============================================================================
+
+/**
+ * Test that scanline sampling runs without per-instruction hooks, one
+ * sample per line (or every Nth line)
+ */
+TEST_F(ProfilerTest, ScanlineSamplingIsHookFree) {
+    RunFrames(10);
+    auto start_state = emu.SaveState();
+    RunFrames(20);
+    ASSERT_TRUE(emu.LoadState(start_state));
+    RunFrames(20);
+    auto unprofiled = emu.SaveState();
+    ASSERT_TRUE(emu.LoadState(start_state));
+
+    GX::ProfileOptions options;
+    options.mode = GX::ProfileMode::Scanline;
+    profiler.Start(options);
+    EXPECT_EQ(cpu_hook_types & (HOOK_M68K_E | HOOK_M68K_RW), 0u);
+    RunFrames(20);
+    profiler.Stop();
+    EXPECT_EQ(emu.SaveState(), unprofiled);
+
+    // NTSC: 262 lines per frame, the first sample covers a whole line
+    EXPECT_EQ(profiler.GetSampleCount(), 20u * 262);
+    EXPECT_EQ(profiler.GetFrameLoads().size(), 20u);
+    EXPECT_NEAR(static_cast<double>(profiler.GetTotalCycles()), 20.0 * 262 * 3420, 3420);
+
+    GX::Profiler every4;
+    options.sample_lines = 4;
+    every4.Start(options);
+    RunFrames(20);
+    every4.Stop();
+    EXPECT_EQ(every4.GetSampleCount(), 20u * 262 / 4);
+
+    std::ostringstream report;
+    profiler.PrintReport(report);
+    EXPECT_NE(report.str().find("Scanline sampling: every 1 line(s), 5240 samples"), std::string::npos)
+        << report.str();
+}
+
+/**
+ * Test that the sampled profile approximates the exact one
+ */
+TEST_F(ProfilerTest, ScanlineSamplingMatchesExact) {
+    GX::Profiler exact;
+    exact.AddFunction(FUNC_START, FUNC_CLEAR_SIEVE, "_start");
+    exact.AddFunction(FUNC_CLEAR_SIEVE, FUNC_MARK_TRIVIAL, "clear_sieve");
+    exact.AddFunction(FUNC_MARK_TRIVIAL, FUNC_RUN_SIEVE, "mark_trivial_composites");
+    exact.AddFunction(FUNC_RUN_SIEVE, FUNC_COLLECT_PRIMES, "run_sieve");
+    exact.AddFunction(FUNC_COLLECT_PRIMES, FUNC_MAIN, "collect_primes");
+    exact.AddFunction(FUNC_MAIN, FUNC_MAIN_END, "main");
+
+    GX::ProfileOptions options;
+    options.mode = GX::ProfileMode::Scanline;
+    options.collect_address_histogram = true;
+    profiler.Start(options);
+    exact.Start();
+    RunFrames(60);
+    exact.Stop();
+    profiler.Stop();
+
+    ASSERT_GT(profiler.GetSampleCount(), 10000u);
+    for (uint32_t func : {FUNC_CLEAR_SIEVE, FUNC_MARK_TRIVIAL, FUNC_RUN_SIEVE,
+                          FUNC_COLLECT_PRIMES, FUNC_MAIN}) {
+        double sampled = static_cast<double>(profiler.GetStats(func)->cycles_exclusive) /
+                         profiler.GetTotalCycles();
+        double actual = static_cast<double>(exact.GetStats(func)->cycles_exclusive) /
+                        exact.GetTotalCycles();
+        EXPECT_NEAR(sampled, actual, 0.02) << std::hex << func;
+        EXPECT_EQ(profiler.GetStats(func)->call_count, 0u) << "Calls are not counted";
+    }
+
+    uint64_t histogram_total = 0;
+    for (const auto& kv : profiler.GetAddressHistogram()) {
+        histogram_total += kv.second;
+    }
+    EXPECT_EQ(histogram_total, profiler.GetTotalCycles());
+}
+
+/**
+ * Test call stacks recovered from return addresses on the 68k stack
+ */
+TEST_F(ProfilerTest, ScanlineSamplingStackWalk) {
+    GX::ProfileOptions options;
+    options.mode = GX::ProfileMode::Scanline;
+    options.stack_walk_depth = 16;
+    profiler.Start(options);
+    RunFrames(60);
+    profiler.Stop();
+
+    std::string temp_path = (std::filesystem::temp_directory_path() / "gxtest_folded_scanline.txt").string();
+    ASSERT_TRUE(profiler.WriteFoldedStacks(temp_path));
+    auto stacks = ReadFolded(temp_path);
+    std::remove(temp_path.c_str());
+
+    uint64_t total = 0;
+    for (const auto& kv : stacks) {
+        total += kv.second;
+    }
+    EXPECT_EQ(total, profiler.GetTotalCycles());
+
+    // Same stacks as CallStack mode finds
+    ASSERT_EQ(stacks.count("_start;main;run_sieve"), 1u);
+    EXPECT_EQ(stacks["_start;main;run_sieve"], profiler.GetStats(FUNC_RUN_SIEVE)->cycles_exclusive);
+    EXPECT_EQ(stacks.count("run_sieve"), 0u) << "Callees should be below their callers";
+
+    // Inclusive cycles from the recovered stacks
+    const GX::FunctionStats* start = profiler.GetStats(FUNC_START);
+    const GX::FunctionStats* main_stats = profiler.GetStats(FUNC_MAIN);
+    const GX::FunctionStats* sieve = profiler.GetStats(FUNC_RUN_SIEVE);
+    EXPECT_EQ(sieve->cycles_inclusive, sieve->cycles_exclusive);
+    EXPECT_GE(main_stats->cycles_inclusive, main_stats->cycles_exclusive + sieve->cycles_exclusive);
+    EXPECT_EQ(start->cycles_inclusive, profiler.GetTotalCycles());
+}
+
 } // namespace
@@ -0,0 +1,138 @@
+// Small hand-assembled test ROMs
+// Shared by the tests that need a specific 68k program rather than a
+// prebuilt ROM image
+
+#ifndef ROM_BUILDER_H
+#define ROM_BUILDER_H
+
+#include <gxtest.h>
+#include <profiler_assertions.h>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+extern "C" {
+#include "cpuhook.h"
+}
+
+namespace GX {
+namespace TestRoms {
+
+// Long incremented by the handler from PutVIntCounter()
+constexpr uint32_t VINT_COUNTER = 0xFF0000;
+
+/**
+ * Builds a cartridge image word by word
+ *
+ * The image starts with the stack pointer at the top of work RAM, the reset
+ * PC and the "SEGA MEGA DRIVE" header; everything else is zero until code and
+ * data are placed at fixed offsets.
+ */
+class RomBuilder {
+public:
+    explicit RomBuilder(uint32_t entry, size_t size = 0x10000) : rom_(size, 0) {
+        Put32(0x000, 0x00FFFE00);   // SSP
+        Put32(0x004, entry);        // PC
+        PutBytes(0x100, "SEGA MEGA DRIVE ", 16);
+    }
+
+    void Put16(uint32_t offset, uint16_t value) {
+        rom_[offset] = static_cast<uint8_t>(value >> 8);
+        rom_[offset + 1] = static_cast<uint8_t>(value);
+    }
+
+    void Put32(uint32_t offset, uint32_t value) {
+        Put16(offset, static_cast<uint16_t>(value >> 16));
+        Put16(offset + 2, static_cast<uint16_t>(value));
+    }
+
+    void PutBytes(uint32_t offset, const void* data, size_t size) {
+        memcpy(&rom_[offset], data, size);
+    }
+
+    /** Place opcode words one after the other */
+    void PutCode(uint32_t offset, std::initializer_list<uint16_t> code) {
+        for (uint16_t word : code) {
+            Put16(offset, word);
+            offset += 2;
+        }
+    }
+
+    /** Point an exception vector (GX::VECTOR_*) at a handler */
+    void SetVector(int vector, uint32_t handler) {
+        Put32(4 * vector, handler);
+    }
+
+    /**
+     * Main loop calling each subroutine once per iteration
+     *
+     *        lea     $C00004,a5
+     *        move.w  #$8164,(a5)     ; display, V-INT on
+     *        move.w  #$2000,sr
+     * loop:  bsr.w   <subroutine>    ; for each subroutine
+     *        bra.s   loop
+     */
+    void PutGameLoop(uint32_t offset, std::initializer_list<uint32_t> subroutines) {
+        PutCode(offset, {0x4BF9, 0x00C0, 0x0004, 0x3ABC, 0x8164, 0x46FC, 0x2000});
+        uint32_t loop = offset + 14;
+        uint32_t pc = loop;
+        for (uint32_t target : subroutines) {
+            PutCode(pc, {0x6100, static_cast<uint16_t>(target - (pc + 2))});
+            pc += 4;
+        }
+        Put16(pc, static_cast<uint16_t>(0x6000 | ((loop - (pc + 2)) & 0xFF)));
+    }
+
+    /**
+     * Wait for the next V-INT (16 bytes)
+     *
+     * wait_vblank: move.l $FF0000,d1
+     * .wait: cmp.l   $FF0000,d1
+     *        beq.s   .wait
+     *        rts
+     */
+    void PutWaitVBlank(uint32_t offset) {
+        PutCode(offset, {0x2239, 0x00FF, 0x0000, 0xB2B9, 0x00FF, 0x0000, 0x67F8, 0x4E75});
+    }
+
+    /**
+     * V-INT handler counting frames (8 bytes)
+     *
+     * vint:  addq.l  #1,$FF0000
+     *        rte
+     */
+    void PutVIntCounter(uint32_t offset) {
+        PutCode(offset, {0x52B9, 0x00FF, 0x0000, 0x4E73});
+    }
+
+    const std::vector<uint8_t>& Data() const { return rom_; }
+
+private:
+    std::vector<uint8_t> rom_;
+};
+
+/** Fail the current test if it left cpu_hook subscribers installed */
+inline void ExpectNoHookSubscribers() {
+    EXPECT_EQ(cpu_hook_types, 0u) << "Test left subscribers behind";
+}
+
+/**
+ * Profiler fixture for hand-assembled ROMs
+ *
+ * Stops a profiler the test left running, then checks that no hooks remain.
+ */
+class ProfiledRomTest : public ProfileTest {
+protected:
+    void TearDown() override {
+        if (profiler.IsRunning()) {
+            profiler.Stop();
+        }
+        ExpectNoHookSubscribers();
+    }
+};
+
+} // namespace TestRoms
+} // namespace GX
+
+#endif // ROM_BUILDER_H
@@ -0,0 +1,485 @@
+/**
+ * gxtest - ROM Load Test
+ *
+ * Tests the ROM loading path (file mapping, byteswap-copy, tail clearing).
+ * Verifies:
+ * 1. Loading from a file matches loading from memory
+ * 2. ROM words are visible big-endian in 68k address space, odd sizes too
+ * 3. Loading a small ROM after a large one behaves like a fresh load
+ * 4. Reloads served by the decoded ROM cache are indistinguishable
+ * 5. .gz / .zip archives and .smd interleaved images load like plain images
+ * 6. Load latency per ROM size, cold and cached
+ */
+
+#include <gxtest.h>
+#include "filler_rom.h"
+#include "prime_sieve_rom.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "zlib.h"
+
+namespace {
+
+using namespace GX::TestRoms;
+namespace fs = std::filesystem;
+
+std::vector<uint8_t> Deflate(const std::vector<uint8_t>& data, int window_bits) {
+    z_stream stream = {};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY);
+    std::vector<uint8_t> out(deflateBound(&stream, static_cast<uLong>(data.size())));
+    stream.next_in = const_cast<Bytef*>(data.data());
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = out.data();
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+std::vector<uint8_t> MakeGzip(const std::vector<uint8_t>& data) {
+    return Deflate(data, 15 + 16);
+}
+
+/**
+ * Build a zip archive of deflated entries (an empty name adds a directory)
+ */
+std::vector<uint8_t> MakeZip(const std::vector<std::pair<std::string, std::vector<uint8_t>>>& files) {
+    std::vector<uint8_t> zip, central;
+    auto put = [](std::vector<uint8_t>& out, uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    };
+
+    for (const auto& file : files) {
+        const std::string& name = file.first;
+        bool dir = !name.empty() && name.back() == '/';
+        auto packed = dir ? std::vector<uint8_t>() : Deflate(file.second, -15);
+        uint32_t crc = static_cast<uint32_t>(crc32(0, file.second.data(), static_cast<uInt>(file.second.size())));
+        uint32_t offset = static_cast<uint32_t>(zip.size());
+
+        put(zip, 0x04034B50, 4);
+        put(zip, 20, 2);                 // Version needed
+        put(zip, 0, 2);                  // Flags
+        put(zip, dir ? 0 : 8, 2);        // Method
+        put(zip, 0, 4);                  // Time and date
+        put(zip, crc, 4);
+        put(zip, static_cast<uint32_t>(packed.size()), 4);
+        put(zip, static_cast<uint32_t>(file.second.size()), 4);
+        put(zip, static_cast<uint32_t>(name.size()), 2);
+        put(zip, 0, 2);                  // Extra field length
+        zip.insert(zip.end(), name.begin(), name.end());
+        zip.insert(zip.end(), packed.begin(), packed.end());
+
+        put(central, 0x02014B50, 4);
+        put(central, 20, 2);             // Version made by
+        put(central, 20, 2);
+        put(central, 0, 2);
+        put(central, dir ? 0 : 8, 2);
+        put(central, 0, 4);
+        put(central, crc, 4);
+        put(central, static_cast<uint32_t>(packed.size()), 4);
+        put(central, static_cast<uint32_t>(file.second.size()), 4);
+        put(central, static_cast<uint32_t>(name.size()), 2);
+        put(central, 0, 2);              // Extra field length
+        put(central, 0, 2);              // Comment length
+        put(central, 0, 2);              // Disk number
+        put(central, 0, 2);              // Internal attributes
+        put(central, 0, 4);              // External attributes
+        put(central, offset, 4);
+        central.insert(central.end(), name.begin(), name.end());
+    }
+
+    uint32_t central_offset = static_cast<uint32_t>(zip.size());
+    zip.insert(zip.end(), central.begin(), central.end());
+    put(zip, 0x06054B50, 4);
+    put(zip, 0, 4);                      // Disk numbers
+    put(zip, static_cast<uint32_t>(files.size()), 2);
+    put(zip, static_cast<uint32_t>(files.size()), 2);
+    put(zip, static_cast<uint32_t>(central.size()), 4);
+    put(zip, central_offset, 4);
+    put(zip, 0, 2);                      // Comment length
+    return zip;
+}
+
+/**
+ * Interleave a ROM into .smd format: 512-byte header, then 16KB blocks with
+ * the odd bytes in the first half and the even bytes in the second
+ */
+std::vector<uint8_t> MakeSmd(const std::vector<uint8_t>& rom, bool marker) {
+    std::vector<uint8_t> smd(512, 0);
+    smd[0] = static_cast<uint8_t>(rom.size() / 0x4000);
+    if (marker) {
+        smd[8] = 0xAA;
+        smd[9] = 0xBB;
+    }
+    for (size_t block = 0; block < rom.size(); block += 0x4000) {
+        size_t base = smd.size();
+        smd.resize(base + 0x4000);
+        for (size_t i = 0; i < 0x2000; i++) {
+            smd[base + i] = rom[block + i * 2 + 1];
+            smd[base + 0x2000 + i] = rom[block + i * 2];
+        }
+    }
+    return smd;
+}
+
+class RomLoadTest : public GX::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() /
+              ("gxtest_rom_load_" + std::to_string(std::random_device()()));
+        fs::create_directories(dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    std::string WriteRom(const std::string& name, const std::vector<uint8_t>& rom) {
+        std::string path = (dir / name).string();
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+        return path;
+    }
+
+    void ExpectRomVisible(const std::vector<uint8_t>& rom) {
+        // Sample words across the cartridge area (and the first 4KB densely)
+        size_t visible = std::min<size_t>(rom.size(), 0x400000);
+        size_t step = std::max<size_t>(2, (visible / 4096) & ~static_cast<size_t>(1));
+        for (size_t addr = 0; addr + 1 < visible; addr += (addr < 0x1000 ? 2 : step)) {
+            uint16_t expected = static_cast<uint16_t>((rom[addr] << 8) | rom[addr + 1]);
+            ASSERT_EQ(ReadWord(static_cast<uint32_t>(addr)), expected)
+                << "ROM word mismatch at 0x" << std::hex << addr;
+        }
+    }
+
+    bool RunSieve() {
+        int frames = emu.RunUntil([this]() {
+            return ReadWord(DONE_FLAG_ADDR) == DONE_FLAG_VALUE;
+        }, 60);
+        return frames >= 0 && ReadWord(PRIME_COUNT_ADDR) == NUM_PRIMES;
+    }
+
+    fs::path dir;
+};
+
+/**
+ * Test that a file load maps the same image as a buffer load
+ */
+TEST_F(RomLoadTest, FileMatchesBuffer) {
+    auto rom = MakeRom(512 * 1024);
+    std::string path = WriteRom("rom.bin", rom);
+
+    ASSERT_TRUE(LoadRom(path));
+    ExpectRomVisible(rom);
+    EXPECT_TRUE(RunSieve());
+
+    ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+    ExpectRomVisible(rom);
+    EXPECT_TRUE(RunSieve());
+}
+
+/**
+ * Test that every byte survives the vectorized swap (all tail lengths)
+ */
+TEST_F(RomLoadTest, SwapTailLengths) {
+    for (size_t extra = 0; extra < 34; extra += 2) {
+        auto rom = MakeRom(0x10000 + extra);
+        ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+        for (size_t addr = 0xFF00; addr < rom.size(); addr++) {
+            ASSERT_EQ(ReadByte(static_cast<uint32_t>(addr)), rom[addr])
+                << "Size 0x" << std::hex << rom.size() << ", address 0x" << addr;
+        }
+    }
+}
+
+/**
+ * Test that the last byte of an odd-sized ROM is kept
+ */
+TEST_F(RomLoadTest, OddSize) {
+    auto rom = MakeRom(0x10000 + 0x1235);
+    ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+    ExpectRomVisible(rom);
+    EXPECT_EQ(ReadByte(static_cast<uint32_t>(rom.size() - 1)), rom.back());
+    EXPECT_TRUE(RunSieve());
+}
+
+/**
+ * Test that loading a small ROM after a large one behaves like a fresh load
+ */
+TEST_F(RomLoadTest, SmallAfterLarge) {
+    const uint32_t PROBES[] = {0x00FFFE, 0x010100, 0x080000, 0x200000, 0x3FFFFE};
+
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    std::vector<uint16_t> fresh;
+    for (uint32_t addr : PROBES) {
+        fresh.push_back(ReadWord(addr));
+    }
+    RunFrames(3);
+    auto reference = emu.SaveState();
+
+    auto large = MakeRom(4 * 1024 * 1024);
+    ASSERT_TRUE(LoadRom(WriteRom("large.bin", large)));
+    RunFrames(3);
+
+    // Nothing of the large ROM may remain past the small one
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    for (size_t i = 0; i < fresh.size(); i++) {
+        EXPECT_EQ(ReadWord(PROBES[i]), fresh[i]) << "Stale data at 0x" << std::hex << PROBES[i];
+    }
+    RunFrames(3);
+    EXPECT_EQ(emu.SaveState(), reference);
+}
+
+/**
+ * Test that missing and empty files are rejected
+ */
+TEST_F(RomLoadTest, RejectsBadFiles) {
+    EXPECT_FALSE(LoadRom((dir / "missing.bin").string()));
+    EXPECT_FALSE(LoadRom(WriteRom("empty.bin", {})));
+}
+
+/**
+ * Test that a cached reload is indistinguishable from decoding the ROM
+ */
+TEST_F(RomLoadTest, CachedReloadMatchesCold) {
+    GX::Emulator::ClearRomCache();
+    auto rom = MakeRom(256 * 1024 + 1);
+
+    ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+    std::string name = emu.GetRomName();
+    RunFrames(3);
+    auto cold = emu.SaveState();
+
+    ASSERT_TRUE(LoadRom(WriteRom("rom.bin", rom)));
+    GX::RomCacheStats stats = GX::Emulator::GetRomCacheStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_GE(stats.bytes, rom.size());
+
+    ExpectRomVisible(rom);
+    EXPECT_EQ(emu.GetRomName(), name);
+    RunFrames(3);
+    EXPECT_EQ(emu.SaveState(), cold);
+
+    // Shared with other Emulator instances
+    GX::Emulator other;
+    ASSERT_TRUE(other.LoadRom(rom.data(), rom.size()));
+    EXPECT_EQ(GX::Emulator::GetRomCacheStats().hits, 2u);
+}
+
+/**
+ * Test that different contents of the same size are not confused
+ */
+TEST_F(RomLoadTest, CacheKeyedByContent) {
+    GX::Emulator::ClearRomCache();
+    auto a = MakeRom(128 * 1024);
+    auto b = a;
+    b[0x20000 - 2] ^= 0xFF;
+
+    ASSERT_TRUE(emu.LoadRom(a.data(), a.size()));
+    ASSERT_TRUE(emu.LoadRom(b.data(), b.size()));
+    ExpectRomVisible(b);
+    EXPECT_EQ(GX::Emulator::GetRomCacheStats().misses, 2u);
+
+    ASSERT_TRUE(emu.LoadRom(a.data(), a.size()));
+    ExpectRomVisible(a);
+    EXPECT_EQ(GX::Emulator::GetRomCacheStats().hits, 1u);
+}
+
+/**
+ * Test the cache memory limit (least recently used images are evicted)
+ */
+TEST_F(RomLoadTest, CacheLimit) {
+    GX::Emulator::ClearRomCache();
+    GX::Emulator::SetRomCacheLimit(2 * 128 * 1024);
+
+    auto a = MakeRom(128 * 1024);
+    auto b = MakeRom(128 * 1024 - 2);
+    auto c = MakeRom(128 * 1024 - 4);
+
+    ASSERT_TRUE(emu.LoadRom(a.data(), a.size()));
+    ASSERT_TRUE(emu.LoadRom(b.data(), b.size()));
+    ASSERT_TRUE(emu.LoadRom(a.data(), a.size()));   // a is now most recent
+    ASSERT_TRUE(emu.LoadRom(c.data(), c.size()));   // evicts b
+    EXPECT_EQ(GX::Emulator::GetRomCacheStats().entries, 2u);
+    EXPECT_LE(GX::Emulator::GetRomCacheStats().bytes, 2u * 128 * 1024);
+
+    ASSERT_TRUE(emu.LoadRom(a.data(), a.size()));
+    ExpectRomVisible(a);
+    EXPECT_EQ(GX::Emulator::GetRomCacheStats().hits, 2u);
+
+    GX::Emulator::SetRomCacheLimit(0);
+    ASSERT_TRUE(emu.LoadRom(a.data(), a.size()));
+    EXPECT_EQ(GX::Emulator::GetRomCacheStats().entries, 0u);
+    ExpectRomVisible(a);
+
+    GX::Emulator::SetRomCacheLimit(256 * 1024 * 1024);
+}
+
+/**
+ * Test that .gz and .zip images inflate to the same ROM as a plain file
+ */
+TEST_F(RomLoadTest, CompressedImages) {
+    auto rom = MakeRom(512 * 1024 + 1);
+
+    ASSERT_TRUE(LoadRom(WriteRom("rom.bin", rom)));
+    RunFrames(3);
+    auto reference = emu.SaveState();
+
+    ASSERT_TRUE(LoadRom(WriteRom("rom.bin.gz", MakeGzip(rom))));
+    ExpectRomVisible(rom);
+    RunFrames(3);
+    EXPECT_EQ(emu.SaveState(), reference);
+
+    // Directory entries are skipped, the first file is loaded
+    ASSERT_TRUE(LoadRom(WriteRom("rom.zip", MakeZip({{"roms/", {}}, {"roms/rom.bin", rom}}))));
+    ExpectRomVisible(rom);
+    RunFrames(3);
+    EXPECT_EQ(emu.SaveState(), reference);
+
+    // Magic bytes decide, not the file name
+    ASSERT_TRUE(LoadRom(WriteRom("rom.md", MakeGzip(rom))));
+    ExpectRomVisible(rom);
+    EXPECT_TRUE(RunSieve());
+}
+
+/**
+ * Test that .smd images are de-interleaved, plain and inside archives
+ */
+TEST_F(RomLoadTest, SmdImages) {
+    auto rom = MakeRom(256 * 1024);
+
+    // Copier marker: detected from memory and from any file name
+    auto smd = MakeSmd(rom, true);
+    ASSERT_TRUE(emu.LoadRom(smd.data(), smd.size()));
+    ExpectRomVisible(rom);
+    ASSERT_TRUE(LoadRom(WriteRom("game.bin", smd)));
+    ExpectRomVisible(rom);
+    EXPECT_TRUE(RunSieve());
+
+    // No marker: detected by the .smd extension (also of a zip entry)
+    auto plain = MakeSmd(rom, false);
+    ASSERT_TRUE(LoadRom(WriteRom("game.smd", plain)));
+    ExpectRomVisible(rom);
+    ASSERT_TRUE(LoadRom(WriteRom("game.smd.gz", MakeGzip(plain))));
+    ExpectRomVisible(rom);
+    ASSERT_TRUE(LoadRom(WriteRom("game.zip", MakeZip({{"GAME.SMD", plain}}))));
+    ExpectRomVisible(rom);
+    EXPECT_TRUE(RunSieve());
+}
+
+/**
+ * Test that corrupt archives are rejected and leave nothing behind
+ */
+TEST_F(RomLoadTest, RejectsCorruptArchives) {
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    RunFrames(3);
+    auto reference = emu.SaveState();
+
+    auto rom = MakeRom(1024 * 1024);
+
+    auto gz = MakeGzip(rom);
+    gz.resize(gz.size() / 2);
+    EXPECT_FALSE(LoadRom(WriteRom("truncated.gz", gz)));
+
+    auto zip = MakeZip({{"rom.bin", rom}});
+    zip[14] ^= 0xFF;    // Stored CRC
+    EXPECT_FALSE(LoadRom(WriteRom("bad_crc.zip", zip)));
+
+    EXPECT_FALSE(LoadRom(WriteRom("empty.zip", MakeZip({{"dir/", {}}}))));
+
+    // Partially inflated data must not leak into the next load
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    EXPECT_EQ(ReadWord(0x080000), 0);
+    RunFrames(3);
+    EXPECT_EQ(emu.SaveState(), reference);
+}
+
+/**
+ * Test that archives inflating past MAXROMSIZE are rejected without writing
+ * outside cart.rom, while an image of exactly MAXROMSIZE still loads
+ */
+TEST_F(RomLoadTest, RejectsOversizedArchives) {
+    const size_t max_size = 32 * 1024 * 1024;   // MAXROMSIZE of the build
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    RunFrames(3);
+    auto reference = emu.SaveState();
+
+    // Zero filler keeps the archives small and quick to build
+    std::vector<uint8_t> rom(max_size + 1);
+    memcpy(rom.data(), PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE);
+    EXPECT_FALSE(LoadRom(WriteRom("oversized.bin.gz", MakeGzip(rom))));
+
+    // Passes the up-front size check of .zip entries (which allows a header)
+    rom.resize(max_size + 256);
+    EXPECT_FALSE(LoadRom(WriteRom("oversized.zip", MakeZip({{"rom.bin", rom}}))));
+
+    rom.resize(max_size);
+    EXPECT_TRUE(LoadRom(WriteRom("max.bin.gz", MakeGzip(rom))));
+
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    RunFrames(3);
+    EXPECT_EQ(emu.SaveState(), reference);
+}
+
+/**
+ * Benchmark: load latency per ROM size, cold and served by the ROM cache
+ */
+TEST_F(RomLoadTest, LoadLatencyBySize) {
+    const size_t SIZES[] = {
+        64 * 1024, 512 * 1024, 1024 * 1024, 4 * 1024 * 1024, 8 * 1024 * 1024
+    };
+    const int ITERATIONS = 20;
+
+    for (size_t size : SIZES) {
+        auto rom = MakeRom(size);
+        std::string path = WriteRom("bench.bin", rom);
+
+        auto start1 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < ITERATIONS; i++) {
+            GX::Emulator::ClearRomCache();
+            ASSERT_TRUE(LoadRom(path));
+        }
+        auto end1 = std::chrono::high_resolution_clock::now();
+
+        auto start2 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < ITERATIONS; i++) {
+            ASSERT_TRUE(LoadRom(path));
+        }
+        auto end2 = std::chrono::high_resolution_clock::now();
+
+        double cold_us = std::chrono::duration<double, std::micro>(end1 - start1).count() / ITERATIONS;
+        double cached_us = std::chrono::duration<double, std::micro>(end2 - start2).count() / ITERATIONS;
+
+        std::cout << "ROM " << size / 1024 << " KB: cold " << cold_us
+                  << " us, cached " << cached_us << " us" << std::endl;
+        ExpectRomVisible(rom);
+    }
+
+    // Compressed images (the filler pattern barely compresses: worst case)
+    auto rom = MakeRom(4 * 1024 * 1024);
+    std::string paths[] = {
+        WriteRom("bench.bin.gz", MakeGzip(rom)),
+        WriteRom("bench.zip", MakeZip({{"bench.bin", rom}})),
+    };
+    for (const std::string& path : paths) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < ITERATIONS; i++) {
+            ASSERT_TRUE(LoadRom(path));
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double us = std::chrono::duration<double, std::micro>(end - start).count() / ITERATIONS;
+        std::cout << fs::path(path).filename().string() << " (4096 KB): " << us << " us" << std::endl;
+        ExpectRomVisible(rom);
+    }
+}
+
+} // namespace
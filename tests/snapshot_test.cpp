@@ -0,0 +1,195 @@
+/**
+ * gxtest - Snapshot Test
+ *
+ * Tests in-memory snapshots (SaveSnapshot/RestoreSnapshot).
+ * Verifies:
+ * 1. Snapshots restore memory and CPU state
+ * 2. Restoring a snapshot is equivalent to LoadState() (deterministic replay)
+ * 3. The snapshot arena is reused across captures
+ * 4. Round-trip cost compared to SaveState()/LoadState()
+ */
+
+#include <gxtest.h>
+#include "prime_sieve_rom.h"
+#include "symbol_example_rom.h"
+#include "symbol_example_symbols.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+class SnapshotTest : public GX::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE))
+            << "Failed to load symbol example ROM";
+    }
+};
+
+/**
+ * Test that SaveState/LoadState round-trips (SaveState used to crash)
+ */
+TEST_F(SnapshotTest, SaveStateRoundTrip) {
+    RunFrames(2);  // Mid-game: the ROM's loop finishes within a few frames
+
+    auto state = emu.SaveState();
+    ASSERT_FALSE(state.empty());
+
+    uint16_t frame_counter = ReadWord(Sym::frame_count);
+    RunFrames(1);
+    EXPECT_NE(ReadWord(Sym::frame_count), frame_counter);
+
+    ASSERT_TRUE(emu.LoadState(state));
+    EXPECT_EQ(ReadWord(Sym::frame_count), frame_counter);
+}
+
+/**
+ * Test that a snapshot restores RAM and registers
+ */
+TEST_F(SnapshotTest, RestoresMemoryAndRegisters) {
+    RunFrames(2);
+
+    GX::Snapshot snapshot;
+    EXPECT_FALSE(snapshot.IsValid());
+    ASSERT_TRUE(emu.SaveSnapshot(snapshot));
+    EXPECT_TRUE(snapshot.IsValid());
+
+    uint16_t frame_counter = ReadWord(Sym::frame_count);
+    uint32_t score = ReadLong(Sym::player_score);
+    uint32_t pc = GetPC();
+    uint32_t sp = GetA(7);
+
+    RunFrames(10);
+    EXPECT_NE(ReadWord(Sym::frame_count), frame_counter);
+    EXPECT_EQ(ReadWord(Sym::done_flag), DONE_SENTINEL);
+
+    ASSERT_TRUE(emu.RestoreSnapshot(snapshot));
+    EXPECT_EQ(ReadWord(Sym::frame_count), frame_counter);
+    EXPECT_EQ(ReadLong(Sym::player_score), score);
+    EXPECT_EQ(GetPC(), pc);
+    EXPECT_EQ(GetA(7), sp);
+    EXPECT_NE(ReadWord(Sym::done_flag), DONE_SENTINEL);
+}
+
+/**
+ * Test that running from a restored snapshot matches running after LoadState
+ */
+TEST_F(SnapshotTest, MatchesLoadState) {
+    RunFrames(1);
+
+    GX::Snapshot snapshot;
+    ASSERT_TRUE(emu.SaveSnapshot(snapshot));
+    auto state = emu.SaveState();
+    ASSERT_EQ(state.size(), snapshot.GetSize());
+
+    ASSERT_TRUE(emu.LoadState(state));
+    RunFrames(60);
+    auto via_load_state = emu.SaveState();
+
+    ASSERT_TRUE(emu.RestoreSnapshot(snapshot));
+    RunFrames(60);
+    auto via_snapshot = emu.SaveState();
+
+    EXPECT_EQ(via_snapshot, via_load_state)
+        << "Replay from snapshot diverged from replay after LoadState";
+}
+
+/**
+ * Test that repeated captures reuse the same arena
+ */
+TEST_F(SnapshotTest, ArenaReused) {
+    GX::Snapshot snapshot;
+    ASSERT_TRUE(emu.SaveSnapshot(snapshot));
+    const uint8_t* arena = snapshot.GetData();
+
+    for (int i = 0; i < 10; i++) {
+        RunFrames(1);
+        ASSERT_TRUE(emu.SaveSnapshot(snapshot));
+        EXPECT_EQ(snapshot.GetData(), arena) << "Capture " << i << " reallocated";
+    }
+}
+
+/**
+ * Test snapshot copy via Assign()
+ */
+TEST_F(SnapshotTest, AssignCopiesState) {
+    RunFrames(2);
+    auto state = emu.SaveState();
+    uint16_t frame_counter = ReadWord(Sym::frame_count);
+
+    GX::Snapshot snapshot;
+    snapshot.Assign(state.data(), state.size());
+    EXPECT_EQ(snapshot.GetSize(), state.size());
+
+    RunFrames(10);
+    ASSERT_TRUE(emu.RestoreSnapshot(snapshot));
+    EXPECT_EQ(ReadWord(Sym::frame_count), frame_counter);
+}
+
+/**
+ * Test that an empty snapshot is rejected
+ */
+TEST_F(SnapshotTest, EmptySnapshotRejected) {
+    GX::Snapshot snapshot;
+    EXPECT_FALSE(emu.RestoreSnapshot(snapshot));
+}
+
+/**
+ * Benchmark: snapshot round-trip vs SaveState/LoadState round-trip
+ */
+TEST_F(SnapshotTest, RoundTripBenchmark) {
+    const int ITERATIONS = 2000;
+    RunFrames(2);
+
+    auto start1 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        auto state = emu.SaveState();
+        ASSERT_TRUE(emu.LoadState(state));
+    }
+    auto end1 = std::chrono::high_resolution_clock::now();
+
+    GX::Snapshot snapshot;
+    auto start2 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        ASSERT_TRUE(emu.SaveSnapshot(snapshot));
+        ASSERT_TRUE(emu.RestoreSnapshot(snapshot));
+    }
+    auto end2 = std::chrono::high_resolution_clock::now();
+
+    double state_us = std::chrono::duration<double, std::micro>(end1 - start1).count() / ITERATIONS;
+    double snapshot_us = std::chrono::duration<double, std::micro>(end2 - start2).count() / ITERATIONS;
+
+    std::cout << "State size: " << snapshot.GetSize() << " bytes" << std::endl;
+    std::cout << "SaveState/LoadState round-trip: " << state_us << " us" << std::endl;
+    std::cout << "SaveSnapshot/RestoreSnapshot round-trip: " << snapshot_us << " us" << std::endl;
+
+    EXPECT_GT(state_us, 0.0);
+    EXPECT_GT(snapshot_us, 0.0);
+}
+
+/**
+ * Test snapshots with the prime sieve ROM (display disabled, CPU-bound)
+ */
+TEST(SnapshotPrimeSieveTest, RestartsComputation) {
+    GX::Emulator emu;
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+
+    GX::Snapshot boot;
+    ASSERT_TRUE(emu.SaveSnapshot(boot));
+
+    for (int iter = 0; iter < 3; iter++) {
+        ASSERT_TRUE(emu.RestoreSnapshot(boot));
+        EXPECT_NE(emu.ReadWord(DONE_FLAG_ADDR), DONE_FLAG_VALUE);
+
+        int frames = emu.RunUntil([&emu]() {
+            return emu.ReadWord(DONE_FLAG_ADDR) == DONE_FLAG_VALUE;
+        }, 60);
+        ASSERT_GE(frames, 0) << "Iteration " << iter << " did not complete";
+        EXPECT_EQ(emu.ReadWord(PRIME_COUNT_ADDR), NUM_PRIMES);
+    }
+}
+
+} // namespace
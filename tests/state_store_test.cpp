@@ -0,0 +1,240 @@
+/**
+ * gxtest - State Store Test
+ *
+ * Tests the deduplicating, content-addressed state store.
+ * Verifies:
+ * 1. Stored states reassemble byte-for-byte (including short tail chunks)
+ * 2. Identical chunks are stored once and released when unreferenced
+ * 3. Restoring from the store is equivalent to restoring a snapshot
+ * 4. Memory savings and insert/restore cost on a real state corpus
+ */
+
+#include <state_store.h>
+#include "symbol_example_rom.h"
+#include "symbol_example_symbols.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+std::vector<uint8_t> MakeBuffer(size_t size, uint8_t seed) {
+    // Simple LCG so that no two chunks of a buffer are alike
+    std::vector<uint8_t> data(size);
+    uint32_t x = seed;
+    for (size_t i = 0; i < size; i++) {
+        x = x * 1103515245u + 12345u;
+        data[i] = static_cast<uint8_t>(x >> 16);
+    }
+    return data;
+}
+
+/**
+ * Test that raw buffers round-trip, including a partial tail chunk
+ */
+TEST(StateStoreTest, RawRoundTrip) {
+    GX::StateStore store(64);
+
+    auto a = MakeBuffer(1000, 1);   // 15 full chunks + 40-byte tail
+    auto b = MakeBuffer(64, 2);     // Exactly one chunk
+    auto c = MakeBuffer(10, 3);     // Tail only
+
+    auto ia = store.Insert(a.data(), a.size());
+    auto ib = store.Insert(b.data(), b.size());
+    auto ic = store.Insert(c.data(), c.size());
+
+    EXPECT_EQ(store.GetStateCount(), 3u);
+    EXPECT_EQ(store.Get(ia), a);
+    EXPECT_EQ(store.Get(ib), b);
+    EXPECT_EQ(store.Get(ic), c);
+    EXPECT_EQ(store.GetStateSize(ia), a.size());
+}
+
+/**
+ * Test that invalid input and unknown ids are rejected
+ */
+TEST(StateStoreTest, RejectsInvalid) {
+    GX::StateStore store;
+    uint8_t byte = 0;
+
+    EXPECT_EQ(store.Insert(&byte, 0), GX::StateStore::INVALID_STATE);
+    EXPECT_EQ(store.Insert(nullptr, 16), GX::StateStore::INVALID_STATE);
+
+    GX::Snapshot empty;
+    EXPECT_EQ(store.Insert(empty), GX::StateStore::INVALID_STATE);
+
+    GX::Snapshot snapshot;
+    EXPECT_FALSE(store.Contains(0));
+    EXPECT_FALSE(store.Restore(0, snapshot));
+    EXPECT_FALSE(store.Remove(0));
+    EXPECT_TRUE(store.Get(0).empty());
+}
+
+/**
+ * Test that identical chunks are stored once
+ */
+TEST(StateStoreTest, DeduplicatesChunks) {
+    GX::StateStore store(256);
+    auto base = MakeBuffer(256 * 16, 7);
+
+    store.Insert(base.data(), base.size());
+    EXPECT_EQ(store.GetStats().chunk_count, 16u);
+
+    // Same state again: no new chunks
+    for (int i = 0; i < 10; i++) {
+        store.Insert(base.data(), base.size());
+    }
+    EXPECT_EQ(store.GetStats().chunk_count, 16u);
+
+    // Change one byte: exactly one new chunk
+    auto modified = base;
+    modified[256 * 5 + 3] ^= 0xFF;
+    auto id = store.Insert(modified.data(), modified.size());
+
+    GX::StateStore::Stats stats = store.GetStats();
+    EXPECT_EQ(stats.state_count, 12u);
+    EXPECT_EQ(stats.chunk_count, 17u);
+    EXPECT_EQ(stats.chunk_refs, 12u * 16u);
+    EXPECT_EQ(stats.logical_bytes, 12u * base.size());
+    EXPECT_EQ(store.Get(id), modified);
+}
+
+/**
+ * Test that a short tail chunk never aliases a full chunk with the same prefix
+ */
+TEST(StateStoreTest, TailChunkIsDistinct) {
+    GX::StateStore store(64);
+    std::vector<uint8_t> zeros_full(128, 0);
+    std::vector<uint8_t> zeros_tail(100, 0);
+
+    auto ifull = store.Insert(zeros_full.data(), zeros_full.size());
+    auto itail = store.Insert(zeros_tail.data(), zeros_tail.size());
+
+    EXPECT_EQ(store.GetStats().chunk_count, 2u);
+    EXPECT_EQ(store.Get(ifull), zeros_full);
+    EXPECT_EQ(store.Get(itail), zeros_tail);
+}
+
+/**
+ * Test that removal releases unreferenced chunks and recycles ids
+ */
+TEST(StateStoreTest, RemoveReleasesChunks) {
+    GX::StateStore store(128);
+    auto a = MakeBuffer(128 * 4, 1);
+    auto b = a;
+    b[0] ^= 1;
+
+    auto ia = store.Insert(a.data(), a.size());
+    auto ib = store.Insert(b.data(), b.size());
+    EXPECT_EQ(store.GetStats().chunk_count, 5u);
+
+    ASSERT_TRUE(store.Remove(ib));
+    EXPECT_FALSE(store.Contains(ib));
+    EXPECT_FALSE(store.Remove(ib));
+    EXPECT_EQ(store.GetStats().chunk_count, 4u);
+    EXPECT_EQ(store.Get(ia), a);
+
+    // The freed id and chunk slot are reused
+    auto c = MakeBuffer(128 * 4, 9);
+    auto ic = store.Insert(c.data(), c.size());
+    EXPECT_EQ(ic, ib);
+    EXPECT_EQ(store.Get(ic), c);
+    EXPECT_EQ(store.Get(ia), a);
+
+    ASSERT_TRUE(store.Remove(ia));
+    ASSERT_TRUE(store.Remove(ic));
+    GX::StateStore::Stats stats = store.GetStats();
+    EXPECT_EQ(stats.state_count, 0u);
+    EXPECT_EQ(stats.chunk_count, 0u);
+    EXPECT_EQ(stats.logical_bytes, 0u);
+
+    store.Clear();
+    EXPECT_EQ(store.GetStats().stored_bytes, 0u);
+    EXPECT_FALSE(store.Contains(ia));
+}
+
+class StateStoreEmulatorTest : public GX::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(SYMBOL_EXAMPLE_ROM, SYMBOL_EXAMPLE_ROM_SIZE))
+            << "Failed to load symbol example ROM";
+    }
+};
+
+/**
+ * Test that a stored emulator state restores like a snapshot
+ */
+TEST_F(StateStoreEmulatorTest, RestoresEmulator) {
+    GX::StateStore store;
+    RunFrames(2);
+
+    auto reference = emu.SaveState();
+    uint16_t frame_counter = ReadWord(Sym::frame_count);
+    uint32_t pc = GetPC();
+
+    auto id = store.Insert(emu);
+    ASSERT_NE(id, GX::StateStore::INVALID_STATE);
+    EXPECT_EQ(store.Get(id), reference);
+
+    RunFrames(10);
+    EXPECT_NE(ReadWord(Sym::frame_count), frame_counter);
+
+    ASSERT_TRUE(store.Restore(id, emu));
+    EXPECT_EQ(ReadWord(Sym::frame_count), frame_counter);
+    EXPECT_EQ(GetPC(), pc);
+    EXPECT_EQ(emu.SaveState(), reference);
+}
+
+/**
+ * Test memory savings and throughput on a corpus of real states
+ */
+TEST_F(StateStoreEmulatorTest, CorpusDedupBenchmark) {
+    const int STATES = 500;
+    GX::StateStore store;
+    GX::Snapshot snapshot;
+    std::vector<GX::StateStore::StateId> ids;
+
+    // Branch many states off a few points, the way an input search does
+    RunFrames(1);
+    ASSERT_TRUE(emu.SaveSnapshot(snapshot));
+
+    auto start1 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < STATES; i++) {
+        if (i % 50 == 0) {
+            ASSERT_TRUE(emu.RestoreSnapshot(snapshot));
+        }
+        WriteWord(Sym::player_x, static_cast<uint16_t>(i));
+        RunFrames(1);
+        ids.push_back(store.Insert(emu));
+    }
+    auto end1 = std::chrono::high_resolution_clock::now();
+
+    GX::Snapshot restored;
+    auto start2 = std::chrono::high_resolution_clock::now();
+    for (auto id : ids) {
+        ASSERT_TRUE(store.Restore(id, restored));
+    }
+    auto end2 = std::chrono::high_resolution_clock::now();
+
+    // Spot check the last state against the live emulator
+    EXPECT_EQ(store.Get(ids.back()), emu.SaveState());
+
+    GX::StateStore::Stats stats = store.GetStats();
+    double insert_us = std::chrono::duration<double, std::micro>(end1 - start1).count() / STATES;
+    double restore_us = std::chrono::duration<double, std::micro>(end2 - start2).count() / STATES;
+
+    std::cout << "States: " << stats.state_count
+              << ", distinct chunks: " << stats.chunk_count << std::endl;
+    std::cout << "Logical: " << stats.logical_bytes / 1024 << " KB, stored: "
+              << stats.GetTotalBytes() / 1024 << " KB ("
+              << stats.GetDedupRatio() << "x)" << std::endl;
+    std::cout << "Frame + insert: " << insert_us << " us, restore: "
+              << restore_us << " us" << std::endl;
+
+    EXPECT_EQ(stats.state_count, static_cast<size_t>(STATES));
+    EXPECT_GT(stats.GetDedupRatio(), 5.0);
+}
+
+} // namespace
@@ -0,0 +1,213 @@
+/**
+ * gxtest - SVP Test
+ *
+ * Tests SVP (SSP1601 DSP) idle loop skipping and profiling using a small
+ * cartridge where the DSP waits for commands from the 68k.
+ * Verifies:
+ * 1. Skipping idle loops does not change emulation, frame by frame
+ * 2. Idle time is reported and skipped
+ * 3. The profiler's SVP mode attributes SSP cycles and fills the PC histogram,
+ *    with idle skipping paused while it runs
+ */
+
+#include <gxtest.h>
+#include <profiler.h>
+#include "prime_sieve_rom.h"
+#include "rom_builder.h"
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// SSP1601 program functions (word addresses)
+constexpr uint32_t SSP_WAIT = 0x400;
+constexpr uint32_t SSP_WORK = 0x405;
+constexpr uint32_t SSP_END = 0x413;
+
+/*
+ * The 68k posts a command to XST every ~84 lines. The DSP spins on XST, then
+ * counts the command in its RAM, runs a 512 iteration loop and clears XST.
+ */
+std::vector<uint8_t> MakeSvpRom() {
+    RomBuilder rom(0x200, 0x20000);
+    rom.PutBytes(0x1C8, "SV", 2);                    // SVP chip present
+
+    rom.PutCode(0x200, {
+        0x33FC, 0x0001, 0x00A1, 0x5000, // loop:  move.w  #1,$A15000     ; XST
+        0x323C, 0x1000,                 //        move.w  #$1000,d1
+        0x51C9, 0xFFFE,                 // wait:  dbra    d1,wait
+        0x60EE,                         //        bra.s   loop
+    });
+
+    const uint16_t ssp[] = {
+        0x003B,                         // 400 wait:  ld    A, XST
+        0x6800, 0x0000,                 // 401        cmpi  A, 0
+        0x4D50, 0x0400,                 // 403        bra   Z=1, wait
+        0x0600,                         // 405 work:  ld    A, [0]
+        0x8800, 0x0001,                 // 406        addi  A, 1
+        0x0E00,                         // 408        ld    [0], A
+        0x0830, 0x0200,                 // 409        ldi   A, $200
+        0x2800, 0x0001,                 // 40B loop:  subi  A, 1
+        0x4C50, 0x040B,                 // 40D        bra   Z=0, loop
+        0x08B0, 0x0000,                 // 40F        ldi   XST, 0
+        0x4C00, 0x0400,                 // 411        bra   wait
+    };
+    static_assert(sizeof(ssp) / 2 == SSP_END - SSP_WAIT, "SSP program size");
+    for (size_t i = 0; i < sizeof(ssp) / sizeof(ssp[0]); i++) {
+        rom.Put16(2 * (SSP_WAIT + i), ssp[i]);
+    }
+    return rom.Data();
+}
+
+class SvpTest : public GX::Test {
+protected:
+    std::vector<uint8_t> rom = MakeSvpRom();
+
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+    }
+
+    void TearDown() override {
+        GX::Emulator::SetSvpIdleSkipEnabled(true);
+    }
+
+    // State after each of the given number of frames from power-on
+    std::vector<std::vector<uint8_t>> RunStates(int frames, bool skip) {
+        GX::Emulator::SetSvpIdleSkipEnabled(skip);
+        EXPECT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+        std::vector<std::vector<uint8_t>> states;
+        for (int i = 0; i < frames; i++) {
+            RunFrames(1);
+            states.push_back(emu.SaveState());
+        }
+        return states;
+    }
+};
+
+/**
+ * Test that skipping idle loops gives the same state after every frame
+ */
+TEST_F(SvpTest, IdleSkipMatchesFullRun) {
+    auto full = RunStates(30, false);
+    GX::SvpStats full_stats = emu.GetSvpStats();
+    auto skipped = RunStates(30, true);
+    GX::SvpStats skip_stats = emu.GetSvpStats();
+
+    ASSERT_EQ(full.size(), skipped.size());
+    for (size_t i = 0; i < full.size(); i++) {
+        ASSERT_EQ(full[i], skipped[i]) << "State differs after frame " << i + 1;
+    }
+
+    EXPECT_EQ(full_stats.idle_cycles, 0u);
+    EXPECT_GT(full_stats.cycles, 0u);
+    EXPECT_EQ(skip_stats.cycles, full_stats.cycles);
+}
+
+/**
+ * Test that most SSP time is idle and gets skipped
+ */
+TEST_F(SvpTest, IdleCyclesSkipped) {
+    RunFrames(10);
+    GX::SvpStats stats = emu.GetSvpStats();
+
+    EXPECT_GT(stats.idle_cycles, 0u);
+    EXPECT_GT(static_cast<double>(stats.idle_cycles) / stats.cycles, 0.9);
+}
+
+/**
+ * Test that a cartridge without SVP reports no SSP cycles
+ */
+TEST_F(SvpTest, NoSvpCartridge) {
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    RunFrames(2);
+    EXPECT_EQ(emu.GetSvpStats().cycles, 0u);
+    EXPECT_EQ(emu.GetSvpStats().idle_cycles, 0u);
+}
+
+/**
+ * Test SVP profiling: per-function SSP cycles and PC histogram
+ */
+TEST_F(SvpTest, ProfilerSvpMode) {
+    GX::Profiler profiler;
+    profiler.AddFunction(SSP_WAIT, SSP_WORK, "wait_command");
+    profiler.AddFunction(SSP_WORK, SSP_END, "run_command");
+
+    GX::ProfileOptions options;
+    options.cpu = GX::ProfileCpu::SVP;
+    options.collect_address_histogram = true;
+    profiler.Start(options);
+    ASSERT_TRUE(profiler.IsRunning());
+
+    GX::SvpStats start = emu.GetSvpStats();
+    RunFrames(10);
+    profiler.Stop();
+    uint32_t cycles = emu.GetSvpStats().cycles - start.cycles;
+
+    // Idle loops run instruction by instruction while profiling, and are
+    // skipped again once the profiler stops
+    EXPECT_EQ(emu.GetSvpStats().idle_cycles, start.idle_cycles);
+    RunFrames(1);
+    EXPECT_GT(emu.GetSvpStats().idle_cycles, start.idle_cycles);
+
+    // Every SSP cycle is attributed (cycles since the last instruction are
+    // only counted at the next one, which leaves at most one 800 cycle
+    // timeslice out)
+    uint64_t total = profiler.GetTotalCycles();
+    EXPECT_GT(total, 0u);
+    EXPECT_LE(total, cycles);
+    EXPECT_GT(total, cycles - 800);
+
+    const GX::FunctionStats* wait = profiler.GetStats(SSP_WAIT);
+    const GX::FunctionStats* work = profiler.GetStats(SSP_WORK);
+    ASSERT_NE(wait, nullptr);
+    ASSERT_NE(work, nullptr);
+    EXPECT_GT(wait->cycles_exclusive, work->cycles_exclusive);
+
+    // One command every ~84 lines: about 3 per frame
+    EXPECT_GE(work->call_count, 25u);
+    EXPECT_LE(work->call_count, 35u);
+    EXPECT_NEAR(static_cast<double>(work->cycles_exclusive) / work->call_count, 3 * 512, 16);
+
+    const auto& histogram = profiler.GetAddressHistogram();
+    uint64_t histogram_total = 0;
+    for (const auto& kv : histogram) {
+        EXPECT_GE(kv.first, SSP_WAIT);
+        EXPECT_LT(kv.first, SSP_END);
+        histogram_total += kv.second;
+    }
+    EXPECT_EQ(histogram_total, total);
+    EXPECT_GT(histogram.count(0x40D), 0u) << "Work loop branch missing from histogram";
+
+    // Each pass through the wait loop is counted, not just the loop head
+    ASSERT_GT(histogram.count(0x401), 0u);
+    ASSERT_GT(histogram.count(0x403), 0u);
+    EXPECT_EQ(histogram.at(0x401), histogram.at(0x403));
+    EXPECT_LT(histogram.at(SSP_WAIT), 3 * histogram.at(0x401));
+
+    profiler.PrintReport(std::cout);
+}
+
+/**
+ * Compare SVP cartridge speed with and without idle skipping
+ */
+TEST_F(SvpTest, IdleSkipSpeed) {
+    constexpr int FRAMES = 120;
+    auto time_run = [this](bool skip) {
+        GX::Emulator::SetSvpIdleSkipEnabled(skip);
+        EXPECT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+        auto start = std::chrono::steady_clock::now();
+        RunFrames(FRAMES);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    double full_ms = time_run(false);
+    double skip_ms = time_run(true);
+
+    std::cout << "SVP " << FRAMES << " frames: " << full_ms << " ms without idle skip, "
+              << skip_ms << " ms with idle skip\n";
+}
+
+} // namespace
@@ -0,0 +1,324 @@
+/**
+ * gxtest - Tracer Test
+ *
+ * Tests the compact binary 68k instruction trace using the prime sieve ROM.
+ * Verifies:
+ * 1. The decoded trace matches the instructions seen by a hook subscriber
+ * 2. Registers, opcodes and cycle counts round-trip
+ * 3. Seeking by frame, file traces and small chunks
+ * 4. Recording speed and size per instruction
+ */
+
+#include <gxtest.h>
+#include <tracer.h>
+#include "prime_sieve_rom.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+extern "C" {
+#include "cpuhook.h"
+}
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// Reference recorder: every instruction as seen by a plain hook subscriber
+struct Reference {
+    struct Insn {
+        uint32_t pc;
+        uint32_t d[8];
+        uint32_t a[8];
+    };
+
+    GX::Emulator* emu;
+    std::vector<Insn> insns;
+    int id = -1;
+
+    explicit Reference(GX::Emulator* e) : emu(e) {}
+
+    static void Callback(void* param, hook_type_t, int, unsigned int address, unsigned int) {
+        Reference* self = static_cast<Reference*>(param);
+        Insn insn;
+        insn.pc = address;
+        for (int i = 0; i < 8; i++) {
+            insn.d[i] = self->emu->GetDataRegister(i);
+            insn.a[i] = self->emu->GetAddressRegister(i);
+        }
+        self->insns.push_back(insn);
+    }
+
+    void Subscribe() { id = cpu_hook_subscribe(HOOK_M68K_E, 0, 0xFFFFFF, Callback, this); }
+    void Unsubscribe() { cpu_hook_unsubscribe(id); id = -1; }
+};
+
+class TracerTest : public GX::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    }
+
+    void TearDown() override {
+        EXPECT_EQ(cpu_hook_types, 0u) << "Test left subscribers behind";
+    }
+
+    // Opcode at a ROM address
+    uint16_t RomWord(uint32_t addr) const {
+        return static_cast<uint16_t>((PRIME_SIEVE_ROM[addr] << 8) | PRIME_SIEVE_ROM[addr + 1]);
+    }
+
+    std::string TempPath(const char* name) const {
+        return std::string(testing::TempDir()) + name;
+    }
+};
+
+/**
+ * Test that the trace holds exactly the executed instructions and registers
+ */
+TEST_F(TracerTest, MatchesHookedExecution) {
+    Reference reference(&emu);
+    GX::Tracer tracer;
+    GX::TraceOptions options;
+    options.record_registers = true;
+    ASSERT_TRUE(tracer.Start(options));
+    reference.Subscribe();
+    RunFrames(5);
+    reference.Unsubscribe();
+    ASSERT_TRUE(tracer.Stop());
+
+    ASSERT_GT(reference.insns.size(), 10000u);
+    EXPECT_EQ(tracer.GetInstructionCount(), reference.insns.size());
+    EXPECT_EQ(tracer.GetFrameCount(), 5u);
+
+    GX::TraceReader reader;
+    ASSERT_TRUE(reader.Open(tracer));
+    EXPECT_TRUE(reader.HasRegisters());
+    EXPECT_EQ(reader.GetInstructionCount(), reference.insns.size());
+    EXPECT_EQ(reader.GetFrameCount(), 5u);
+
+    GX::TraceEvent event;
+    uint64_t last_cycle = 0;
+    uint32_t last_frame = 0;
+    size_t count = 0;
+    while (reader.Next(event)) {
+        ASSERT_LT(count, reference.insns.size());
+        const Reference::Insn& expected = reference.insns[count];
+        ASSERT_EQ(event.index, count);
+        ASSERT_EQ(event.pc, expected.pc) << "at instruction " << count;
+        ASSERT_TRUE(event.has_registers);
+        for (int i = 0; i < 8; i++) {
+            ASSERT_EQ(event.d[i], expected.d[i]) << "D" << i << " at instruction " << count;
+            ASSERT_EQ(event.a[i], expected.a[i]) << "A" << i << " at instruction " << count;
+        }
+        if (event.pc < PRIME_SIEVE_ROM_SIZE) {
+            ASSERT_EQ(event.opcode, RomWord(event.pc)) << "at instruction " << count;
+        }
+        ASSERT_GE(event.cycle, last_cycle);
+        ASSERT_GE(event.frame, last_frame);
+        last_cycle = event.cycle;
+        last_frame = event.frame;
+        count++;
+    }
+    EXPECT_EQ(count, reference.insns.size());
+    EXPECT_EQ(last_frame, 4u);
+
+    // Five frames of master cycles, give or take the last instruction
+    EXPECT_GT(last_cycle, 4 * 896040u);
+    EXPECT_LT(last_cycle, 5 * 896040u);
+}
+
+/**
+ * Test cycle deltas against the instructions' known timing
+ */
+TEST_F(TracerTest, CycleDeltas) {
+    GX::Tracer tracer;
+    ASSERT_TRUE(tracer.Start());
+    RunFrames(2);
+    ASSERT_TRUE(tracer.Stop());
+
+    GX::TraceReader reader;
+    ASSERT_TRUE(reader.Open(tracer));
+    EXPECT_FALSE(reader.HasRegisters());
+
+    // 68k instructions take at least 4 clocks (28 master cycles), in steps of 2
+    GX::TraceEvent prev, event;
+    ASSERT_TRUE(reader.Next(prev));
+    uint64_t checked = 0;
+    while (reader.Next(event)) {
+        if (event.frame == prev.frame) {
+            uint64_t delta = event.cycle - prev.cycle;
+            ASSERT_GE(delta, 28u) << "after " << std::hex << prev.pc;
+            ASSERT_EQ(delta % 7, 0u);
+            checked++;
+        }
+        EXPECT_FALSE(event.has_registers);
+        prev = event;
+    }
+    EXPECT_GT(checked, 1000u);
+}
+
+/**
+ * Test seeking to a frame gives the same events as reading up to it
+ */
+TEST_F(TracerTest, SeekFrame) {
+    GX::Tracer tracer;
+    GX::TraceOptions options;
+    options.chunk_size = 4096;  // Many chunks, frames spread over several
+    ASSERT_TRUE(tracer.Start(options));
+    RunFrames(10);
+    ASSERT_TRUE(tracer.Stop());
+
+    GX::TraceReader reader;
+    ASSERT_TRUE(reader.Open(tracer));
+    ASSERT_GT(reader.GetChunkCount(), 20u);
+
+    // First instruction of each frame, by reading everything
+    std::vector<GX::TraceEvent> frame_starts;
+    GX::TraceEvent event;
+    while (reader.Next(event)) {
+        if (frame_starts.size() == event.frame) {
+            frame_starts.push_back(event);
+        }
+    }
+    ASSERT_EQ(frame_starts.size(), 10u);
+
+    for (uint32_t frame : {7u, 0u, 3u, 9u}) {
+        ASSERT_TRUE(reader.SeekFrame(frame));
+        ASSERT_TRUE(reader.Next(event));
+        EXPECT_EQ(event.frame, frame);
+        EXPECT_EQ(event.index, frame_starts[frame].index);
+        EXPECT_EQ(event.pc, frame_starts[frame].pc);
+        EXPECT_EQ(event.cycle, frame_starts[frame].cycle);
+    }
+
+    EXPECT_FALSE(reader.SeekFrame(11));
+
+    reader.Rewind();
+    ASSERT_TRUE(reader.Next(event));
+    EXPECT_EQ(event.index, 0u);
+}
+
+/**
+ * Test a trace written to a file reads back like the same run traced in memory
+ */
+TEST_F(TracerTest, FileTrace) {
+    std::vector<uint8_t> start = emu.SaveState();
+    std::string path = TempPath("gxtest_tracer_file.gxt");
+
+    GX::Tracer file_tracer;
+    GX::TraceOptions options;
+    options.record_registers = true;
+    ASSERT_TRUE(file_tracer.Start(path, options));
+    RunFrames(3);
+    ASSERT_TRUE(file_tracer.Stop());
+
+    ASSERT_TRUE(emu.LoadState(start));
+    GX::Tracer memory_tracer;
+    ASSERT_TRUE(memory_tracer.Start(options));
+    RunFrames(3);
+    ASSERT_TRUE(memory_tracer.Stop());
+
+    // A file trace can only be read from the file
+    GX::TraceReader memory_reader;
+    EXPECT_FALSE(memory_reader.Open(file_tracer));
+    ASSERT_TRUE(memory_reader.Open(memory_tracer));
+
+    GX::TraceReader file_reader;
+    ASSERT_TRUE(file_reader.Open(path));
+    EXPECT_TRUE(file_reader.HasRegisters());
+    EXPECT_EQ(file_reader.GetInstructionCount(), memory_reader.GetInstructionCount());
+    EXPECT_EQ(file_reader.GetFrameCount(), 3u);
+    EXPECT_EQ(file_reader.GetChunkCount(), memory_reader.GetChunkCount());
+
+    GX::TraceEvent a, b;
+    uint64_t count = 0;
+    while (memory_reader.Next(a)) {
+        ASSERT_TRUE(file_reader.Next(b));
+        ASSERT_EQ(a.pc, b.pc);
+        ASSERT_EQ(a.cycle, b.cycle);
+        ASSERT_EQ(a.opcode, b.opcode);
+        ASSERT_EQ(a.d[0], b.d[0]);
+        ASSERT_EQ(a.sr, b.sr);
+        count++;
+    }
+    EXPECT_FALSE(file_reader.Next(b));
+    EXPECT_EQ(count, memory_tracer.GetInstructionCount());
+
+    file_reader.Close();
+    std::remove(path.c_str());
+}
+
+/**
+ * Test error handling
+ */
+TEST_F(TracerTest, Errors) {
+    GX::TraceReader reader;
+    EXPECT_FALSE(reader.Open(TempPath("gxtest_tracer_missing.gxt")));
+
+    std::string path = TempPath("gxtest_tracer_bad.gxt");
+    FILE* f = fopen(path.c_str(), "wb");
+    ASSERT_NE(f, nullptr);
+    fputs("not a trace", f);
+    fclose(f);
+    EXPECT_FALSE(reader.Open(path));
+    std::remove(path.c_str());
+
+    GX::Tracer tracer;
+    EXPECT_FALSE(tracer.Start("/nonexistent_dir/trace.gxt"));
+    EXPECT_FALSE(tracer.IsRunning());
+
+    ASSERT_TRUE(tracer.Start());
+    EXPECT_FALSE(tracer.Start());
+    EXPECT_FALSE(reader.Open(tracer));  // Still running
+    RunFrames(1);
+    ASSERT_TRUE(tracer.Stop());
+    EXPECT_TRUE(reader.Open(tracer));
+
+    // The reader keeps its data when the tracer starts over
+    uint64_t count = tracer.GetInstructionCount();
+    ASSERT_TRUE(tracer.Start());
+    RunFrames(1);
+    ASSERT_TRUE(tracer.Stop());
+    EXPECT_EQ(reader.GetInstructionCount(), count);
+}
+
+/**
+ * Measure recording speed and trace size
+ */
+TEST_F(TracerTest, Speed) {
+    constexpr int FRAMES = 120;
+    auto time_run = [this](GX::Tracer* tracer, const GX::TraceOptions& options) {
+        if (tracer) tracer->Start(options);
+        auto start = std::chrono::steady_clock::now();
+        RunFrames(FRAMES);
+        if (tracer) tracer->Stop();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    GX::TraceOptions options;
+    double plain_ms = time_run(nullptr, options);
+    GX::Tracer tracer;
+    double trace_ms = time_run(&tracer, options);
+    options.record_registers = true;
+    GX::Tracer reg_tracer;
+    double reg_ms = time_run(&reg_tracer, options);
+
+    uint64_t count = tracer.GetInstructionCount();
+    ASSERT_GT(count, 0u);
+    EXPECT_LT(tracer.GetCompressedBytes(), tracer.GetRawBytes());
+    EXPECT_LT(static_cast<double>(tracer.GetRawBytes()) / count, 6.0);
+
+    std::cout << FRAMES << " frames, " << count << " instructions: "
+              << plain_ms << " ms untraced, "
+              << trace_ms << " ms traced ("
+              << count / trace_ms / 1000.0 << " M instr/s, "
+              << static_cast<double>(tracer.GetRawBytes()) / count << " raw / "
+              << static_cast<double>(tracer.GetCompressedBytes()) / count << " compressed bytes per instr), "
+              << reg_ms << " ms with registers ("
+              << static_cast<double>(reg_tracer.GetCompressedBytes()) / count
+              << " compressed bytes per instr)\n";
+}
+
+} // namespace
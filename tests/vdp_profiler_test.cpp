@@ -0,0 +1,305 @@
+/**
+ * gxtest - VDP Profiler Test
+ *
+ * Tests GX::VdpProfiler with a program that, every frame, runs one DMA of
+ * each kind in VBlank and then writes a burst of words through the data
+ * port in active display, over a sprite table with too many sprites on some
+ * lines. Verifies:
+ * 1. DMA transfers and bytes by kind, and the 68k cycles lost to DMA and FIFO
+ * 2. VRAM / CRAM writes split between CPU and DMA
+ * 3. Sprites and sprite pixels per line, and lines over either limit
+ * 4. DMA spilling into active display
+ * 5. EXPECT_DMA_WITHIN_BUDGET / EXPECT_NO_SPRITE_OVERFLOW and their messages
+ */
+
+#include <gxtest.h>
+#include <vdp_profiler.h>
+#include <profiler_assertions.h>
+#include "rom_builder.h"
+#include <sstream>
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// Work RAM variables
+constexpr uint32_t DMA_LENGTH_LO = 0xFF0000;  // Word, $93xx: work RAM DMA length bits 7-0 (words)
+constexpr uint32_t DMA_LENGTH_HI = 0xFF0002;  // Word, $94xx: work RAM DMA length bits 15-8
+
+// Per frame DMA: palette from ROM, N words from work RAM, VRAM fill and copy
+constexpr uint64_t PALETTE_BYTES = 32;
+constexpr uint64_t FILL_BYTES = 0x100;
+constexpr uint64_t COPY_BYTES = 0x80;
+constexpr uint64_t BURST_BYTES = 128;   // Data port writes in active display
+constexpr uint64_t FILL_DATA_BYTES = 2; // Data port write that starts the fill
+
+// Sprite table: a row of 8x8 sprites on lines 100-107, then a row of 32x32
+// sprites on lines 150-181
+constexpr uint32_t SMALL_ROW_LINE = 100;
+constexpr uint32_t WIDE_ROW_LINE = 150;
+
+/*
+ * main:  H40, SAT at $F000, upload the SAT from ROM by DMA, display on
+ * loop:  wait for VBlank
+ *        DMA 16 words ROM -> CRAM 0
+ *        DMA (DMA_LENGTH) words $FF1000 -> VRAM 0
+ *        DMA fill $100 bytes at VRAM $2000, wait
+ *        DMA copy $80 bytes VRAM $2000 -> $3000, wait
+ *        wait for active display
+ *        write 64 words to VRAM $4000
+ */
+std::vector<uint8_t> MakeVdpRom(int small_sprites, int wide_sprites) {
+    RomBuilder rom(0x200);
+    rom.PutCode(0x200, {
+        0x49F9, 0x00C0, 0x0004,         //        lea     $C00004,a4
+        0x4BF9, 0x00C0, 0x0000,         //        lea     $C00000,a5
+        0x38BC, 0x8004,                 //        move.w  #$8004,(a4)
+        0x38BC, 0x8114,                 //        move.w  #$8114,(a4)     ; Mode 5, DMA on
+        0x38BC, 0x8C81,                 //        move.w  #$8C81,(a4)     ; H40
+        0x38BC, 0x8F02,                 //        move.w  #$8F02,(a4)     ; auto-increment 2
+        0x38BC, 0x8578,                 //        move.w  #$8578,(a4)     ; SAT at $F000
+        0x38BC, 0x9384,                 //        move.w  #$9384,(a4)     ; 132 words
+        0x38BC, 0x9400,                 //        move.w  #$9400,(a4)
+        0x38BC, 0x9500,                 //        move.w  #$9500,(a4)     ; from $000800
+        0x38BC, 0x9604,                 //        move.w  #$9604,(a4)
+        0x38BC, 0x9700,                 //        move.w  #$9700,(a4)
+        0x28BC, 0x7000, 0x0083,         //        move.l  #$70000083,(a4) ; to VRAM $F000
+        0x38BC, 0x8154,                 //        move.w  #$8154,(a4)     ; display on
+        0x3014,                         // loop:  move.w  (a4),d0
+        0x0800, 0x0003,                 //        btst    #3,d0
+        0x67F8,                         //        beq.s   loop
+        0x38BC, 0x9310,                 //        move.w  #$9310,(a4)     ; 16 words
+        0x38BC, 0x9400,                 //        move.w  #$9400,(a4)
+        0x38BC, 0x9580,                 //        move.w  #$9580,(a4)     ; from $000700
+        0x38BC, 0x9603,                 //        move.w  #$9603,(a4)
+        0x38BC, 0x9700,                 //        move.w  #$9700,(a4)
+        0x28BC, 0xC000, 0x0080,         //        move.l  #$C0000080,(a4) ; to CRAM 0
+        0x38B9, 0x00FF, 0x0000,         //        move.w  $FF0000,(a4)
+        0x38B9, 0x00FF, 0x0002,         //        move.w  $FF0002,(a4)
+        0x38BC, 0x9500,                 //        move.w  #$9500,(a4)     ; from $FF1000
+        0x38BC, 0x9688,                 //        move.w  #$9688,(a4)
+        0x38BC, 0x977F,                 //        move.w  #$977F,(a4)
+        0x28BC, 0x4000, 0x0080,         //        move.l  #$40000080,(a4) ; to VRAM 0
+        0x38BC, 0x9300,                 //        move.w  #$9300,(a4)     ; $100 bytes
+        0x38BC, 0x9401,                 //        move.w  #$9401,(a4)
+        0x38BC, 0x9780,                 //        move.w  #$9780,(a4)     ; fill
+        0x28BC, 0x6000, 0x0080,         //        move.l  #$60000080,(a4) ; VRAM $2000
+        0x3ABC, 0x1100,                 //        move.w  #$1100,(a5)
+        0x3014,                         // .fill: move.w  (a4),d0
+        0x0800, 0x0001,                 //        btst    #1,d0
+        0x66F8,                         //        bne.s   .fill
+        0x38BC, 0x9380,                 //        move.w  #$9380,(a4)     ; $80 bytes
+        0x38BC, 0x9400,                 //        move.w  #$9400,(a4)
+        0x38BC, 0x9500,                 //        move.w  #$9500,(a4)     ; from VRAM $2000
+        0x38BC, 0x9620,                 //        move.w  #$9620,(a4)
+        0x38BC, 0x97C0,                 //        move.w  #$97C0,(a4)     ; copy
+        0x28BC, 0x3000, 0x00C0,         //        move.l  #$300000C0,(a4) ; to VRAM $3000
+        0x3014,                         // .copy: move.w  (a4),d0
+        0x0800, 0x0001,                 //        btst    #1,d0
+        0x66F8,                         //        bne.s   .copy
+        0x3014,                         // .disp: move.w  (a4),d0
+        0x0800, 0x0003,                 //        btst    #3,d0
+        0x66F8,                         //        bne.s   .disp
+        0x28BC, 0x4000, 0x0001,         //        move.l  #$40000001,(a4) ; VRAM $4000
+        0x703F,                         //        moveq   #63,d0
+        0x3A80,                         // .burst: move.w d0,(a5)
+        0x51C8, 0xFFFC,                 //        dbra    d0,.burst
+        0x6000, 0xFF68,                 //        bra.w   loop
+    });
+
+    // Palette
+    for (int i = 0; i < 16; i++) {
+        rom.Put16(0x700 + 2 * i, static_cast<uint16_t>(i * 0x111));
+    }
+
+    // Sprite table: y, size | link, attributes, x
+    int count = small_sprites + wide_sprites;
+    for (int i = 0; i < count; i++) {
+        bool wide = i >= small_sprites;
+        uint32_t entry = 0x800 + 8 * i;
+        uint16_t link = i + 1 < count ? static_cast<uint16_t>(i + 1) : 0;
+        rom.Put16(entry, static_cast<uint16_t>(0x80 + (wide ? WIDE_ROW_LINE : SMALL_ROW_LINE)));
+        rom.Put16(entry + 2, static_cast<uint16_t>((wide ? 0x0F00 : 0x0000) | link));
+        rom.Put16(entry + 4, 0x0001);
+        rom.Put16(entry + 6, static_cast<uint16_t>(0x80 + (wide ? (i - small_sprites) * 24 : i * 8)));
+    }
+    return rom.Data();
+}
+
+class VdpProfilerTest : public GX::Test {
+protected:
+    GX::VdpProfiler vdp;
+
+    void Boot(int small_sprites, int wide_sprites, uint16_t ram_dma_words) {
+        rom_ = MakeVdpRom(small_sprites, wide_sprites);
+        ASSERT_TRUE(emu.LoadRom(rom_.data(), rom_.size()));
+        WriteWord(DMA_LENGTH_LO, 0x9300 | (ram_dma_words & 0xFF));
+        WriteWord(DMA_LENGTH_HI, 0x9400 | (ram_dma_words >> 8));
+        RunFrames(3);  // Past the setup code
+    }
+
+    void TearDown() override {
+        vdp.Stop();
+        ExpectNoHookSubscribers();
+    }
+
+private:
+    std::vector<uint8_t> rom_;
+};
+
+/**
+ * Test DMA transfers, stalls and the CPU / DMA split of VDP writes per frame
+ */
+TEST_F(VdpProfilerTest, DmaAndWrites) {
+    constexpr uint16_t RAM_WORDS = 0x100;
+    Boot(20, 10, RAM_WORDS);
+    ASSERT_TRUE(vdp.Start());
+    RunFrames(10);
+    vdp.Stop();
+
+    const std::vector<GX::VdpFrameStats>& frames = vdp.GetFrames();
+    ASSERT_EQ(frames.size(), 10u);
+    const size_t vram = static_cast<size_t>(GX::VdpTarget::Vram);
+    const size_t cram = static_cast<size_t>(GX::VdpTarget::Cram);
+    const size_t vsram = static_cast<size_t>(GX::VdpTarget::Vsram);
+    for (size_t i = 0; i < frames.size(); i++) {
+        const GX::VdpFrameStats& frame = frames[i];
+        SCOPED_TRACE("Frame " + std::to_string(i));
+        EXPECT_EQ(frame.frame, i);
+        for (size_t k = 0; k < GX::VDP_DMA_KIND_COUNT; k++) {
+            EXPECT_EQ(frame.dma_transfers[k], 1u) << GX::VdpDmaKindName(static_cast<GX::VdpDmaKind>(k));
+        }
+        EXPECT_EQ(frame.dma_bytes[static_cast<size_t>(GX::VdpDmaKind::Ext68k)], PALETTE_BYTES);
+        EXPECT_EQ(frame.dma_bytes[static_cast<size_t>(GX::VdpDmaKind::Ram68k)], 2u * RAM_WORDS);
+        EXPECT_EQ(frame.dma_bytes[static_cast<size_t>(GX::VdpDmaKind::Fill)], FILL_BYTES);
+        EXPECT_EQ(frame.dma_bytes[static_cast<size_t>(GX::VdpDmaKind::Copy)], COPY_BYTES);
+        EXPECT_EQ(frame.dma_active_bytes, 0u);
+
+        EXPECT_EQ(frame.dma_write_bytes[vram], 2u * RAM_WORDS + FILL_BYTES + COPY_BYTES);
+        EXPECT_EQ(frame.dma_write_bytes[cram], PALETTE_BYTES);
+        EXPECT_EQ(frame.dma_write_bytes[vsram], 0u);
+        EXPECT_EQ(frame.cpu_write_bytes[vram], BURST_BYTES + FILL_DATA_BYTES);
+        EXPECT_EQ(frame.cpu_write_bytes[cram], 0u);
+
+        // The 68k is halted for 68k bus DMA (at least 2 words per line in
+        // VBlank at 3420 cycles per line), and the burst outruns the FIFO
+        EXPECT_GT(frame.dma_stall_cycles, (2u * RAM_WORDS + PALETTE_BYTES) / 205 * 3420);
+        EXPECT_GT(frame.fifo_stall_cycles, 0u);
+        EXPECT_EQ(frame.StallCycles(), frame.dma_stall_cycles + frame.fifo_stall_cycles);
+    }
+
+    GX::VdpFrameStats totals = vdp.GetTotals(2, 6);
+    EXPECT_EQ(totals.frame, 2u);
+    EXPECT_EQ(totals.dma_transfers[static_cast<size_t>(GX::VdpDmaKind::Fill)], 4u);
+    EXPECT_EQ(totals.DmaBytes(), 4 * frames[0].DmaBytes());
+
+    const uint64_t frame_bytes = PALETTE_BYTES + 2u * RAM_WORDS + FILL_BYTES + COPY_BYTES;
+    EXPECT_DMA_WITHIN_BUDGET(vdp, frame_bytes, 0, 10);
+    ::testing::AssertionResult result = GX::DmaWithinBudget(vdp, frame_bytes - 1, 0, 10);
+    EXPECT_FALSE(result);
+    EXPECT_NE(std::string(result.message()).find("10 frame(s) over the DMA budget"), std::string::npos)
+        << result.message();
+    EXPECT_NE(std::string(result.message()).find("68k ram 512"), std::string::npos) << result.message();
+    EXPECT_FALSE(GX::DmaWithinBudget(vdp, frame_bytes, 0, 11)) << "Range past the frames";
+}
+
+/**
+ * Test sprites and sprite pixels per line against the H40 limits
+ */
+TEST_F(VdpProfilerTest, SpriteOverflow) {
+    Boot(22, 11, 0x10);
+    ASSERT_TRUE(vdp.Start());
+    RunFrames(3);
+    vdp.Stop();
+
+    const std::vector<GX::VdpFrameStats>& frames = vdp.GetFrames();
+    ASSERT_EQ(frames.size(), 3u);
+    for (const GX::VdpFrameStats& frame : frames) {
+        ASSERT_GE(frame.sprites_per_line.size(), 224u);
+        EXPECT_EQ(frame.sprites_per_line[SMALL_ROW_LINE - 1], 0);
+        EXPECT_EQ(frame.sprites_per_line[SMALL_ROW_LINE], 22);
+        EXPECT_EQ(frame.sprites_per_line[SMALL_ROW_LINE + 7], 22);
+        EXPECT_EQ(frame.sprites_per_line[SMALL_ROW_LINE + 8], 0);
+        EXPECT_EQ(frame.sprite_pixels_per_line[SMALL_ROW_LINE], 22 * 8);
+        EXPECT_EQ(frame.sprites_per_line[WIDE_ROW_LINE], 11);
+        EXPECT_EQ(frame.sprite_pixels_per_line[WIDE_ROW_LINE], 11 * 32);
+        EXPECT_EQ(frame.sprites_per_line[WIDE_ROW_LINE + 32], 0);
+
+        EXPECT_EQ(frame.max_sprites, 22u);
+        EXPECT_EQ(frame.max_sprite_pixels, 11u * 32);
+        EXPECT_EQ(frame.sprite_overflow_lines, 8u);
+        EXPECT_EQ(frame.pixel_overflow_lines, 32u);
+    }
+
+    ::testing::AssertionResult result = GX::NoSpriteOverflow(vdp, 1, 3);
+    EXPECT_FALSE(result);
+    EXPECT_NE(std::string(result.message()).find(
+        "frame 1: 8 line(s) over the sprite limit, 32 over the pixel limit, peak 22 sprites / 352 pixels"),
+        std::string::npos) << result.message();
+}
+
+/**
+ * Test a full sprite row at the limits does not overflow
+ */
+TEST_F(VdpProfilerTest, SpritesWithinLimits) {
+    Boot(20, 10, 0x10);
+    ASSERT_TRUE(vdp.Start());
+    RunFrames(3);
+    vdp.Stop();
+
+    EXPECT_NO_SPRITE_OVERFLOW(vdp, 0, 3);
+    EXPECT_EQ(vdp.GetFrames()[0].max_sprites, 20u);
+    EXPECT_EQ(vdp.GetFrames()[0].max_sprite_pixels, 320u);
+}
+
+/**
+ * Test DMA too long for VBlank runs on into active display
+ */
+TEST_F(VdpProfilerTest, DmaIntoActiveDisplay) {
+    constexpr uint16_t RAM_WORDS = 0x1400;  // 10KB, VBlank fits about 7.5KB in H40
+    Boot(20, 10, RAM_WORDS);
+    ASSERT_TRUE(vdp.Start());
+    RunFrames(10);
+    vdp.Stop();
+
+    GX::VdpFrameStats totals = vdp.GetTotals();
+    EXPECT_GT(totals.dma_active_bytes, 0u);
+    EXPECT_LT(totals.dma_active_bytes, totals.DmaBytes());
+
+    ::testing::AssertionResult result = GX::DmaWithinBudget(vdp, 8192, 0, 10);
+    EXPECT_FALSE(result);
+    EXPECT_NE(std::string(result.message()).find("in active display"), std::string::npos)
+        << result.message();
+}
+
+/**
+ * Test the report, Reset() and restarting
+ */
+TEST_F(VdpProfilerTest, ReportAndReset) {
+    Boot(22, 11, 0x100);
+    ASSERT_TRUE(vdp.Start());
+    EXPECT_FALSE(vdp.Start()) << "Already running";
+    RunFrames(4);
+    vdp.Stop();
+    EXPECT_FALSE(vdp.IsRunning());
+
+    std::ostringstream report;
+    vdp.PrintReport(report);
+    EXPECT_NE(report.str().find("VDP workload over 4 frames"), std::string::npos) << report.str();
+    EXPECT_NE(report.str().find("DMA 68k ram bytes"), std::string::npos) << report.str();
+    EXPECT_NE(report.str().find("VRAM CPU bytes"), std::string::npos) << report.str();
+    EXPECT_NE(report.str().find("Sprite overflow lines: 32, pixel overflow lines: 128"),
+              std::string::npos) << report.str();
+
+    // Frames are kept across Stop() / Start() until Reset()
+    ASSERT_TRUE(vdp.Start());
+    RunFrames(2);
+    vdp.Stop();
+    ASSERT_EQ(vdp.GetFrames().size(), 6u);
+    EXPECT_EQ(vdp.GetFrames()[5].frame, 5u);
+
+    vdp.Reset();
+    EXPECT_TRUE(vdp.GetFrames().empty());
+}
+
+} // namespace
@@ -0,0 +1,322 @@
+/**
+ * gxtest - Z80 Profiler Test
+ *
+ * Tests the Z80 hooks and the profiler's Z80 mode using a small sound
+ * driver-like program uploaded by the 68k.
+ * Verifies:
+ * 1. Z80 execute, memory and 68k bus events reach hook subscribers
+ * 2. Per-function Z80 cycles and call counts
+ * 3. 68k bus stalls caused by Z80 bank accesses
+ * 4. Per-frame Z80 load, excluding time the Z80 is held by the 68k
+ */
+
+#include <gxtest.h>
+#include <profiler.h>
+#include "prime_sieve_rom.h"
+#include "rom_builder.h"
+#include <iostream>
+#include <sstream>
+
+extern "C" {
+#include "cpuhook.h"
+}
+
+namespace {
+
+using namespace GX::TestRoms;
+
+// Z80 program functions
+constexpr uint32_t Z80_INIT = 0x0000;
+constexpr uint32_t Z80_MAIN_LOOP = 0x0006;
+constexpr uint32_t Z80_DELAY = 0x0010;
+constexpr uint32_t Z80_END = 0x0015;
+
+// Z80 RAM counter incremented once per main loop iteration
+constexpr uint32_t Z80_COUNTER = 0x1000;
+
+/*
+ * 68k code at 0x200 copies the Z80 program from 0x300 to Z80 RAM, keeps the
+ * Z80 stopped for a while, then releases it and idles.
+ */
+std::vector<uint8_t> MakeZ80Rom() {
+    RomBuilder rom(0x200);
+
+    const uint8_t z80[] = {
+        0x31, 0x00, 0x20,   // 0000 init:  ld   sp,$2000
+        0x21, 0x00, 0x10,   // 0003        ld   hl,$1000
+        0x34,               // 0006 loop:  inc  (hl)
+        0x3A, 0x00, 0x80,   // 0007        ld   a,($8000)   ; 68k bank
+        0xCD, 0x10, 0x00,   // 000A        call delay
+        0xC3, 0x06, 0x00,   // 000D        jp   loop
+        0x06, 0x0A,         // 0010 delay: ld   b,10
+        0x10, 0xFE,         // 0012        djnz $
+        0xC9,               // 0014        ret
+    };
+    static_assert(sizeof(z80) == Z80_END, "Z80 program size");
+    rom.PutBytes(0x300, z80, sizeof(z80));
+
+    rom.PutCode(0x200, {
+        0x33FC, 0x0100, 0x00A1, 0x1100, //        move.w  #$100,$A11100   ; BUSREQ
+        0x33FC, 0x0100, 0x00A1, 0x1200, //        move.w  #$100,$A11200   ; release RESET
+        0x41F9, 0x0000, 0x0300,         //        lea     $300,a0
+        0x43F9, 0x00A0, 0x0000,         //        lea     $A00000,a1
+        0x303C, sizeof(z80) - 1,        //        move.w  #size-1,d0
+        0x12D8,                         // copy:  move.b  (a0)+,(a1)+
+        0x51C8, 0xFFFC,                 //        dbra    d0,copy
+        0x323C, 3000,                   //        move.w  #3000,d1
+        0x51C9, 0xFFFE,                 // wait:  dbra    d1,wait
+        0x33FC, 0x0000, 0x00A1, 0x1100, //        move.w  #0,$A11100      ; release BUSREQ
+        0x60FE,                         // idle:  bra.s   idle
+    });
+    return rom.Data();
+}
+
+struct Recorder {
+    uint64_t events = 0;
+    uint64_t bad_address = 0;
+    uint64_t values = 0;
+    unsigned int address = 0;
+
+    static void Callback(void* param, hook_type_t, int, unsigned int address, unsigned int value) {
+        Recorder* self = static_cast<Recorder*>(param);
+        self->events++;
+        self->values += value;
+        if (self->events > 1 && address != self->address) {
+            self->bad_address++;
+        }
+        self->address = address;
+    }
+};
+
+class Z80ProfilerTest : public ProfiledRomTest {
+protected:
+    std::vector<uint8_t> rom = MakeZ80Rom();
+
+    void SetUp() override {
+        ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+
+        profiler.AddFunction(Z80_INIT, Z80_MAIN_LOOP, "init");
+        profiler.AddFunction(Z80_MAIN_LOOP, Z80_DELAY, "main_loop");
+        profiler.AddFunction(Z80_DELAY, Z80_END, "delay");
+    }
+
+    void StartZ80(GX::ProfileMode mode = GX::ProfileMode::Simple) {
+        GX::ProfileOptions options;
+        options.mode = mode;
+        options.cpu = GX::ProfileCpu::Z80;
+        profiler.Start(options);
+        ASSERT_TRUE(profiler.IsRunning());
+    }
+};
+
+// =============================================================================
+// Z80 Hooks
+// =============================================================================
+
+/**
+ * Test that Z80 memory and bus events carry the expected addresses
+ */
+TEST_F(Z80ProfilerTest, MemoryAndBusEvents) {
+    Recorder writes, bank_reads, bus;
+    int w = cpu_hook_subscribe(HOOK_Z80_W, Z80_COUNTER, Z80_COUNTER, Recorder::Callback, &writes);
+    int r = cpu_hook_subscribe(HOOK_Z80_R, 0x8000, 0xFFFF, Recorder::Callback, &bank_reads);
+    int b = cpu_hook_subscribe(HOOK_Z80_BUSREQ, 0, 0xFFFFFF, Recorder::Callback, &bus);
+
+    RunFrames(5);
+
+    cpu_hook_unsubscribe(w);
+    cpu_hook_unsubscribe(r);
+    cpu_hook_unsubscribe(b);
+
+    // One counter update, one bank read and one bus access per loop iteration
+    uint64_t iterations = emu.GetZ80Ram()[Z80_COUNTER];
+    EXPECT_GT(writes.events, 256u);
+    EXPECT_EQ(writes.events % 256, iterations);
+    // (the last iteration may stop between the two)
+    EXPECT_LE(writes.events - bank_reads.events, 1u);
+    EXPECT_EQ(bus.events, bank_reads.events);
+
+    EXPECT_EQ(bank_reads.address, 0x8000u);
+    EXPECT_EQ(bank_reads.bad_address, 0u);
+    EXPECT_EQ(bus.address, 0x000000u) << "Bank 0 maps $8000 to 68k address 0";
+    EXPECT_EQ(bus.bad_address, 0u);
+
+    // Each access stalls the 68k for 10 or 11 68k cycles (70 or 77 master cycles)
+    EXPECT_GE(bus.values, 70 * bus.events);
+    EXPECT_LE(bus.values, 77 * bus.events);
+}
+
+/**
+ * Test that Z80 hooks do not change emulation
+ */
+TEST_F(Z80ProfilerTest, HookedRunMatchesUnhooked) {
+    RunFrames(10);
+    auto plain = emu.SaveState();
+
+    ASSERT_TRUE(emu.LoadRom(rom.data(), rom.size()));
+    StartZ80(GX::ProfileMode::CallStack);
+    RunFrames(10);
+    profiler.Stop();
+
+    EXPECT_GT(profiler.GetTotalCycles(), 0u);
+    EXPECT_EQ(emu.SaveState(), plain);
+}
+
+// =============================================================================
+// Z80 Profiling
+// =============================================================================
+
+/**
+ * Test per-function Z80 cycles
+ */
+TEST_F(Z80ProfilerTest, FunctionCycles) {
+    StartZ80();
+    RunFrames(10);
+    profiler.Stop();
+
+    EXPECT_EQ(profiler.GetCpu(), GX::ProfileCpu::Z80);
+
+    const GX::FunctionStats* init = profiler.GetStats(Z80_INIT);
+    const GX::FunctionStats* loop = profiler.GetStats(Z80_MAIN_LOOP);
+    const GX::FunctionStats* delay = profiler.GetStats(Z80_DELAY);
+    ASSERT_NE(init, nullptr);
+    ASSERT_NE(loop, nullptr);
+    ASSERT_NE(delay, nullptr);
+
+    uint64_t total = profiler.GetTotalCycles();
+    EXPECT_EQ(init->cycles_exclusive + loop->cycles_exclusive + delay->cycles_exclusive, total)
+        << "All Z80 code lies inside the symbols";
+
+    // Cycles are charged to the function of the next instruction: delay gets
+    // the call (17 T-states) plus its own body minus the ret (142 - 10)
+    double delay_share = static_cast<double>(delay->cycles_exclusive) / total;
+    EXPECT_GT(delay_share, 0.6);
+    EXPECT_LT(delay_share, 0.8);
+    EXPECT_GT(delay->call_count, 1000u);
+    EXPECT_NEAR(static_cast<double>(delay->cycles_exclusive) / delay->call_count,
+                149 * 15, 15);
+
+    std::ostringstream report;
+    profiler.PrintReport(report);
+    EXPECT_NE(report.str().find("delay"), std::string::npos);
+    EXPECT_NE(report.str().find("68k bus stall"), std::string::npos);
+    EXPECT_NE(report.str().find("Z80 load"), std::string::npos);
+    std::cout << report.str();
+}
+
+/**
+ * Test Z80 inclusive cycles in CallStack mode
+ */
+TEST_F(Z80ProfilerTest, CallStackInclusive) {
+    StartZ80(GX::ProfileMode::CallStack);
+    RunFrames(10);
+    profiler.Stop();
+
+    const GX::FunctionStats* delay = profiler.GetStats(Z80_DELAY);
+    ASSERT_NE(delay, nullptr);
+    EXPECT_GT(delay->cycles_inclusive, 0u);
+    EXPECT_NEAR(static_cast<double>(delay->cycles_inclusive),
+                static_cast<double>(delay->cycles_exclusive),
+                0.05 * delay->cycles_exclusive);
+}
+
+/**
+ * Test that 68k bus stalls are attributed to the Z80 function causing them
+ */
+TEST_F(Z80ProfilerTest, BusStallAttributed) {
+    StartZ80();
+    RunFrames(10);
+    profiler.Stop();
+
+    const GX::FunctionStats* loop = profiler.GetStats(Z80_MAIN_LOOP);
+    const GX::FunctionStats* delay = profiler.GetStats(Z80_DELAY);
+    ASSERT_NE(loop, nullptr);
+    ASSERT_NE(delay, nullptr);
+
+    uint64_t stall = profiler.GetBusStallCycles();
+    EXPECT_GT(stall, 0u);
+    EXPECT_EQ(loop->bus_stall_cycles, stall);
+    EXPECT_EQ(delay->bus_stall_cycles, 0u);
+
+    // One bank access per main loop entry
+    double per_entry = static_cast<double>(stall) / loop->call_count;
+    EXPECT_GE(per_entry, 70.0);
+    EXPECT_LE(per_entry, 77.0);
+
+    uint64_t frame_stalls = 0;
+    for (const auto& frame : profiler.GetFrameLoads()) {
+        frame_stalls += frame.bus_stall_cycles;
+    }
+    EXPECT_EQ(frame_stalls, stall);
+}
+
+/**
+ * Test per-frame Z80 load, including the frame where the Z80 is released
+ */
+TEST_F(Z80ProfilerTest, FrameLoad) {
+    StartZ80();
+    RunFrames(10);
+    profiler.Stop();
+
+    const auto& frames = profiler.GetFrameLoads();
+    ASSERT_EQ(frames.size(), 10u);
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        EXPECT_EQ(frames[i].frame_cycles, frames[0].frame_cycles);
+        EXPECT_LE(frames[i].cpu_cycles, frames[i].frame_cycles + 200)
+            << "Frame " << i << " counted cycles the Z80 did not run";
+    }
+
+    // Held by the 68k until part way into a frame, then always running
+    size_t release = 0;
+    while (release < frames.size() && frames[release].cpu_cycles == 0) {
+        release++;
+    }
+    ASSERT_LT(release, 3u);
+    EXPECT_GT(frames[release].Load(), 0.05);
+    EXPECT_LT(frames[release].Load(), 0.95);
+    for (size_t i = release + 1; i < frames.size(); i++) {
+        EXPECT_NEAR(frames[i].Load(), 1.0, 0.01) << "Frame " << i;
+    }
+
+    uint64_t sum = 0;
+    for (const auto& frame : frames) {
+        sum += frame.cpu_cycles;
+    }
+    EXPECT_EQ(sum, profiler.GetTotalCycles());
+}
+
+/**
+ * Test that a Z80 kept in reset reports no activity
+ */
+TEST_F(Z80ProfilerTest, IdleZ80) {
+    ASSERT_TRUE(emu.LoadRom(PRIME_SIEVE_ROM, PRIME_SIEVE_ROM_SIZE));
+    StartZ80();
+    RunFrames(5);
+    profiler.Stop();
+
+    EXPECT_EQ(profiler.GetTotalCycles(), 0u);
+    EXPECT_EQ(profiler.GetBusStallCycles(), 0u);
+    ASSERT_EQ(profiler.GetFrameLoads().size(), 5u);
+    EXPECT_EQ(profiler.GetFrameLoads()[4].Load(), 0.0);
+}
+
+/**
+ * Test that Reset clears Z80 statistics
+ */
+TEST_F(Z80ProfilerTest, ResetClearsZ80Stats) {
+    StartZ80();
+    RunFrames(3);
+    profiler.Reset();
+
+    EXPECT_EQ(profiler.GetTotalCycles(), 0u);
+    EXPECT_EQ(profiler.GetBusStallCycles(), 0u);
+    EXPECT_TRUE(profiler.GetFrameLoads().empty());
+
+    RunFrames(2);
+    profiler.Stop();
+    EXPECT_EQ(profiler.GetFrameLoads().size(), 2u);
+    EXPECT_GT(profiler.GetBusStallCycles(), 0u);
+}
+
+} // namespace
@@ -0,0 +1,126 @@
+/**
+ * gxprof-diff - Compare two profiles and fail on performance regressions
+ *
+ * Usage: gxprof-diff [options] BASE CURRENT
+ *
+ * BASE and CURRENT are Profiler::WriteProfile() files or address histograms
+ * (Profiler::WriteAddressHistogram(), JSON or binary). Histograms need the
+ * symbols of their build to be matched by function name.
+ *
+ * Exit status: 0 if no threshold is exceeded, 1 on a regression, 2 on error.
+ */
+
+#include <profile_diff.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void PrintUsage() {
+    std::cerr <<
+        "Usage: gxprof-diff [options] BASE CURRENT\n"
+        "\n"
+        "Compares two profiles (WriteProfile() or WriteAddressHistogram() output),\n"
+        "matching functions by name, and exits with status 1 if a threshold is\n"
+        "exceeded.\n"
+        "\n"
+        "Options:\n"
+        "  --symbols FILE          ELF or symbol file (\"address size name\") for\n"
+        "                          address histograms (both builds)\n"
+        "  --base-symbols FILE     Symbols of the BASE build, if different\n"
+        "  --threshold PCT         Function slowdown threshold (default 5)\n"
+        "  --total-threshold PCT   Total slowdown threshold (default 1)\n"
+        "  --min-cycles N          Ignore function slowdowns under N cycles (default 10000)\n"
+        "  --top N                 Functions to print (default 20, 0 = all)\n";
+}
+
+/** Load symbols from an ELF or a text symbol file */
+bool LoadSymbols(const std::string& path, GX::Profiler& symbols) {
+    char magic[4] = {};
+    std::ifstream file(path, std::ios::binary);
+    file.read(magic, sizeof(magic));
+    bool elf = file.gcount() == 4 && memcmp(magic, "\x7F" "ELF", 4) == 0;
+    int count = elf ? symbols.LoadSymbolsFromELF(path) : symbols.LoadSymbolsFromFile(path);
+    if (count < 0) {
+        std::cerr << "gxprof-diff: cannot load symbols from " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    GX::RegressionThresholds thresholds;
+    std::string symbols_path;
+    std::string base_symbols_path;
+    size_t top = 20;
+    std::string paths[2];
+    int path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--symbols" && has_value) {
+            symbols_path = argv[++i];
+        } else if (arg == "--base-symbols" && has_value) {
+            base_symbols_path = argv[++i];
+        } else if (arg == "--threshold" && has_value) {
+            thresholds.function_change = atof(argv[++i]) / 100.0;
+        } else if (arg == "--total-threshold" && has_value) {
+            thresholds.total_change = atof(argv[++i]) / 100.0;
+        } else if (arg == "--min-cycles" && has_value) {
+            thresholds.min_cycles = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--top" && has_value) {
+            top = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        } else if (arg.compare(0, 2, "--") != 0 && path_count < 2) {
+            paths[path_count++] = arg;
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (path_count != 2) {
+        PrintUsage();
+        return 2;
+    }
+
+    GX::Profiler symbols;
+    GX::Profiler base_symbols;
+    if (!symbols_path.empty() && !LoadSymbols(symbols_path, symbols)) {
+        return 2;
+    }
+    if (!base_symbols_path.empty() && !LoadSymbols(base_symbols_path, base_symbols)) {
+        return 2;
+    }
+    const GX::Profiler& base_table = base_symbols_path.empty() ? symbols : base_symbols;
+
+    GX::ProfileData base;
+    GX::ProfileData current;
+    std::string error;
+    if (!GX::LoadProfile(paths[0], base, base_table.GetFunctions(), &error) ||
+        !GX::LoadProfile(paths[1], current, symbols.GetFunctions(), &error)) {
+        std::cerr << "gxprof-diff: " << error << "\n";
+        return 2;
+    }
+
+    GX::ProfileDiff diff = GX::DiffProfiles(base, current);
+    GX::PrintDiff(std::cout, diff, top);
+
+    std::vector<std::string> regressions = GX::FindRegressions(diff, thresholds);
+    if (regressions.empty()) {
+        std::cout << "\nNo regressions\n";
+        return 0;
+    }
+    std::cout << "\n" << regressions.size() << " regression(s):\n";
+    for (const std::string& message : regressions) {
+        std::cout << "  " << message << "\n";
+    }
+    return 1;
+}